@@ -1,4 +1,4 @@
-#include "Wire.h"
+#include "I2CBus.h"
 #include "SevSeg.h"
 
 SevSeg sevseg;
@@ -21,62 +21,96 @@ bool lastMinuteState  = 1;
 bool setHourState     = 0;
 bool lastHourState    = 1;
 
+#define debounceTime    50          // ms the buttons are ignored after a release
+unsigned long debounceStart = 0;
+
+// The DS1307 is read and written in the background by the TWI interrupt,
+// so loop() never stops refreshing the display to wait for the bus.
+#define rtcReadInterval 100         // ms between reads of the time
+I2CDevice rtc           = {0x68, 100000, 0, 0, 0, NULL, 0};
+const byte rtcStart     = 0;
+byte rtcTime[3];                    // seconds, minutes, hours
+byte rtcSet[8];                     // register address and the 7 time registers
+I2CRequest rtcRead      = {&rtc, &rtcStart, 1, rtcTime, 3, NULL, NULL};
+I2CRequest rtcWrite     = {&rtc, rtcSet, 8, NULL, 0, NULL, NULL};
+unsigned long rtcReadStart = 0;
+bool rtcReading         = false;    // rtcRead submitted, result not looked at yet
+bool rtcReadStale       = false;    // rtcRead started before the last write
+
+int seconds = 0;
+int minutes = 0;
+int hours   = 12;
+
+bool writeRTC(int s, int m, int h) {
+    // rtcSet belongs to the bus until the last write is done, the caller
+    // tries again on the next loop
+    if (rtcWrite.status == I2C_REQ_QUEUED || rtcWrite.status == I2C_REQ_ACTIVE)
+        return false;
+    rtcSet[0] = rtcStart;
+    rtcSet[1] = decToBcd(s);
+    rtcSet[2] = decToBcd(m);
+    rtcSet[3] = decToBcd(h);
+    rtcSet[4] = decToBcd(0);
+    rtcSet[5] = decToBcd(0);
+    rtcSet[6] = decToBcd(0);
+    rtcSet[7] = decToBcd(0);
+    if (!I2C.submit(&rtcWrite))
+        return false;
+    rtcReadStale = rtcReading;
+    return true;
+}
+
 void setup() {
-    Wire.begin();
+    I2C.begin(100000);
     sevseg.begin(COMMON_CATHODE, numDigitsIn, digitPins, segmentPins, 
                  resOnSegmentsIn, updateWithDelaysIn, leadingZerosIn, disableDecPoint);
     pinMode(setMinutePin, INPUT_PULLUP);
     pinMode(setHourPin, INPUT_PULLUP);
+    rtcReading = I2C.submit(&rtcRead);
 }
 
 void loop() {
-    Wire.beginTransmission(0x68);
-      Wire.write(0);
-      Wire.endTransmission();
-    Wire.requestFrom(0x68, 7);
-      int seconds = bcdToDec(Wire.read() & 0x7f);
-      int minutes = bcdToDec(Wire.read());
-      int hours   = bcdToDec(Wire.read() & 0x3f); 
-    if (hours == 0) hours = 12;
-    if (hours > 12) hours = hours - 12;
-
-    setHourState = digitalRead(setHourPin);
-    if (setHourState != lastHourState) {
-        if (setHourState == HIGH) {
-            hours++;
-            if (hours > 12) hours = 1;
-            Wire.beginTransmission(0x68);
-              Wire.write(0);
-              Wire.write(decToBcd(seconds));
-              Wire.write(decToBcd(minutes));
-              Wire.write(decToBcd(hours));
-              Wire.write(decToBcd(0));
-              Wire.write(decToBcd(0));
-              Wire.write(decToBcd(0));
-              Wire.write(decToBcd(0));
-            Wire.endTransmission();
-        } else delay(50);
+    I2C.poll();                     // times out a request stuck on the bus
+    if (rtcReading && rtcRead.status >= I2C_REQ_DONE) {
+        if (rtcRead.status == I2C_REQ_DONE && !rtcReadStale) {
+            seconds = bcdToDec(rtcTime[0] & 0x7f);
+            minutes = bcdToDec(rtcTime[1]);
+            hours   = bcdToDec(rtcTime[2] & 0x3f); 
+            if (hours == 0) hours = 12;
+            if (hours > 12) hours = hours - 12;
+        }
+        rtcReading   = false;
+        rtcReadStale = false;
     }
-    lastHourState = setHourState;
-    
-    setMinuteState = digitalRead(setMinutePin);
-    if (setMinuteState != lastMinuteState) {
-        if (setMinuteState == HIGH) {
-            minutes++;
-            if (minutes > 59) minutes = 1;
-            Wire.beginTransmission(0x68);
-              Wire.write(0);
-              Wire.write(decToBcd(0));
-              Wire.write(decToBcd(minutes));
-              Wire.write(decToBcd(hours));
-              Wire.write(decToBcd(0));
-              Wire.write(decToBcd(0));
-              Wire.write(decToBcd(0));
-              Wire.write(decToBcd(0));
-            Wire.endTransmission();
-        } else delay(50);
+    if (!rtcReading && millis() - rtcReadStart >= rtcReadInterval) {
+        rtcReadStart = millis();
+        rtcReading   = I2C.submit(&rtcRead);
+    }
+
+    if (millis() - debounceStart >= debounceTime) {
+        setHourState = digitalRead(setHourPin);
+        if (setHourState != lastHourState) {
+            if (setHourState == HIGH) {
+                int h = hours + 1;
+                if (h > 12) h = 1;
+                // A release that could not be written is seen again next loop
+                if (writeRTC(seconds, minutes, h)) hours = h;
+                else setHourState = lastHourState;
+            } else debounceStart = millis();
+        }
+        lastHourState = setHourState;
+        
+        setMinuteState = digitalRead(setMinutePin);
+        if (setMinuteState != lastMinuteState) {
+            if (setMinuteState == HIGH) {
+                int m = minutes + 1;
+                if (m > 59) m = 1;
+                if (writeRTC(0, m, hours)) minutes = m;
+                else setMinuteState = lastMinuteState;
+            } else debounceStart = millis();
+        }
+        lastMinuteState = setMinuteState;
     }
-    lastMinuteState = setMinuteState;
     
     sevseg.setNumber((hours*100)+minutes);
     sevseg.refreshDisplay();
@@ -55,10 +55,18 @@
 //   setup
 //   loop
 //
+// extras/host builds this file for Linux with ES100_HOST_HAL defined. The
+// user-supplied and I2C functions then come from extras/host/SimHAL.cpp,
+// which runs them against a simulated ES100 in virtual time.
+//
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
 
+#ifdef ES100_HOST_HAL
+#include "SimHAL.h"
+#else
 #include <Wire.h>
+#endif
 
 //------------------------------------------------------------------------------
 // MCU constants - USER TO MODIFY
@@ -114,6 +122,8 @@
 
 #define DT_LENGTH        10
 
+#ifndef ES100_HOST_HAL
+
 //------------------------------------------------------------------------------
 // mcu functions - USER TO MODIFY
 //------------------------------------------------------------------------------
@@ -194,6 +204,8 @@ void i2c_read(uint8_t slave_addr, uint8_t num_bytes, uint8_t *ptr)
   }
 }
 
+#endif // ES100_HOST_HAL
+
 //------------------------------------------------------------------------------
 // write data to an ES100 API register
 //------------------------------------------------------------------------------
@@ -0,0 +1,161 @@
+/*
+Linux backend of the Xtendwave example's mcu_* / i2c_* HAL, see SimHAL.h
+*/
+
+#include "Arduino.h"
+#include "SimES100.h"
+#include "SimHAL.h"
+
+SimHALStats		simHALStats;
+
+static SimES100		*device = NULL;
+static uint8_t		enPin, irqPin;
+
+// Tight loop detection, see mcu_gpio_read()
+static int			spinPin = -1;
+static uint8_t		spinLevel;
+static uint8_t		spinReads;				// Reads of spinPin in a row at spinLevel
+
+static void hang()
+{
+	fprintf(stderr, "waiting on a pin nothing will change, at %.3fs\n", simMicros() / 1e6);
+	exit(2);
+}
+
+void			(*simHang)() = hang;
+
+// Time on the bus: start, address, data bytes with their ACKs, stop
+static void busTime(uint8_t ack, uint8_t len)
+{
+	uint64_t	us = (2 + 9 * (1 + (ack ? len : 0))) * SIM_HAL_I2C_BIT_US;
+
+	spinPin = -1;
+	Wire.stats.transactions++;
+	if (!ack)
+		Wire.stats.nacks++;
+	else
+		Wire.stats.bytes += len;
+	Wire.stats.busMicros += us;
+	simAdvance(us);
+}
+
+/******************************************************************************
+ * Simulation
+ ******************************************************************************/
+SimES100 *simHALReset(uint8_t en, uint8_t irq, uint32_t utc)
+{
+	simReset();
+	delete device;
+	device = new SimES100(en, irq);
+	device->setUTC(utc);
+	simAttach(device);
+	Wire.attach(device);
+
+	enPin	= en;
+	irqPin	= irq;
+	spinPin	= -1;
+	memset(&simHALStats, 0, sizeof(simHALStats));
+
+	return device;
+}
+
+/******************************************************************************
+ * HAL
+ ******************************************************************************/
+void mcu_init(void)
+{
+	spinPin = -1;
+	pinMode(enPin, OUTPUT);
+	pinMode(irqPin, INPUT);
+}
+
+void mcu_gpio_set_high(int pin)
+{
+	spinPin = -1;
+	digitalWrite(pin, HIGH);
+}
+
+void mcu_gpio_set_low(int pin)
+{
+	spinPin = -1;
+	digitalWrite(pin, LOW);
+}
+
+int mcu_gpio_read(int pin)
+{
+	uint64_t	next;
+	uint8_t		level;
+
+	if (pin == spinPin && spinReads < 2) {
+		spinReads++;
+	} else if (pin != spinPin) {
+		spinPin		= pin;
+		spinReads	= 0;
+	}
+
+	// The same pin read again and again with nothing in between: only a
+	// device can change what the next read sees, so jump to the last read
+	// before its next event
+	next = simNextEvent();
+	if (spinReads >= 2 && next == SIM_NO_EVENT)
+		simHang();
+	if (spinReads >= 2 && next > simMicros() + SIM_DIGITALREAD_COST) {
+		uint64_t	skip = (next - simMicros() - 1) / SIM_DIGITALREAD_COST;
+
+		simAdvance(skip * SIM_DIGITALREAD_COST);
+		simHALStats.gpioReads += skip;
+	}
+
+	simHALStats.gpioReads++;
+	level = digitalRead(pin);
+
+	// A new level starts the count over
+	if (level != spinLevel)
+		spinReads = 0;
+	spinLevel = level;
+	return level;
+}
+
+int mcu_timer_read(void)
+{
+	spinPin = -1;
+	return (int)millis();
+}
+
+void mcu_timer_wait_us(int count)
+{
+	spinPin = -1;
+	delayMicroseconds(count);
+}
+
+void i2c_write(uint8_t slave_addr, uint8_t num_bytes, uint8_t *ptr)
+{
+	SimI2CTarget	*target = Wire.find(slave_addr);
+	uint8_t			ack = target != NULL && target->receive(ptr, 0);
+
+	// The target gets the bytes at the STOP, as from SimTWI
+	if (ack && num_bytes > 0)
+		target->receive(ptr, num_bytes);
+	busTime(ack, num_bytes);
+}
+
+void i2c_read(uint8_t slave_addr, uint8_t num_bytes, uint8_t *ptr)
+{
+	SimI2CTarget	*target = Wire.find(slave_addr);
+	uint8_t			first;
+	uint8_t			ack = false;
+
+	// The first byte is fetched on the address, its ACK is the target's
+	if (target != NULL && num_bytes > 0) {
+		target->readStarted();
+		ack = target->transmit(&first, 1) == 1;
+	}
+
+	if (ack) {
+		ptr[0] = first;
+		for (uint8_t i = 1; i < num_bytes; i++)
+			if (target->transmit(&ptr[i], 1) != 1)
+				ptr[i] = 0xFF;
+	}
+	busTime(ack, num_bytes);
+}
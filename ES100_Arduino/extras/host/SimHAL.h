@@ -0,0 +1,59 @@
+/*
+Linux backend of the Xtendwave example's mcu_* / i2c_* HAL
+
+ES100_Arduino.ino keeps the hardware behind mcu_init(), the mcu_gpio_*
+and mcu_timer_* functions, i2c_write() and i2c_read(). Built with
+ES100_HOST_HAL these come from SimHAL.cpp instead of the Arduino core.
+SimHAL.cpp is only the shim: the clock, the GPIO lines, Serial and the
+ES100 itself are the ES100 ADK's simulation host and its SimES100, in
+../../../Everset_ES100_ADK_V1.2/extras/host, so the example runs against
+the same device model as the ADK library:
+
+- time is the virtual time of SimHost. mcu_timer_wait_us() advances it,
+  a GPIO read costs what digitalRead() costs there and an i2c
+  transaction its bit time at 100kHz, so mcu_timer_read() reports what
+  the AVR would see
+- i2c_write() and i2c_read() are one blocking transaction each, the way
+  Wire does them, handed straight to the targets on Wire and counted in
+  Wire.stats. Like Wire, a NACKed read leaves the buffer as it was.
+
+A loop that does nothing but read the same unchanged pin, like
+es100_wait_for_irq(), is skipped ahead to the read that sees the next
+device event, so a two minute reception replays in microseconds of wall
+clock while mcu_timer_read() still lands on the same millisecond. If no
+event will ever come, the read calls simHang(), which by default reports
+it and exits.
+*/
+
+#ifndef SimHAL_h
+#define SimHAL_h
+
+#include <stdint.h>
+
+#define SIM_HAL_I2C_BIT_US		10			// 100kHz
+
+class SimES100;
+
+// The HAL the example calls
+void	mcu_init(void);
+void	mcu_gpio_set_high(int pin);
+void	mcu_gpio_set_low(int pin);
+int		mcu_gpio_read(int pin);
+int		mcu_timer_read(void);
+void	mcu_timer_wait_us(int count);
+void	i2c_write(uint8_t slave_addr, uint8_t num_bytes, uint8_t *ptr);
+void	i2c_read(uint8_t slave_addr, uint8_t num_bytes, uint8_t *ptr);
+
+struct SimHALStats
+{
+	uint64_t	gpioReads;			// Including the ones skipped over
+};
+
+// Starts the simulation over with a new ES100 on enPin and irqPin, whose
+// UTC clock reads utc (ES100 epoch seconds) at virtual time 0
+SimES100	*simHALReset(uint8_t enPin, uint8_t irqPin, uint32_t utc);
+
+extern SimHALStats	simHALStats;
+extern void			(*simHang)();			// A spin on a pin that will never change
+
+#endif
@@ -0,0 +1,261 @@
+/*
+Runs the Xtendwave example ES100_Arduino.ino on Linux
+
+The example is built unchanged apart from ES100_HOST_HAL, which swaps
+its mcu_* and i2c_* functions for the simulated ones in SimHAL.cpp, on
+top of the ES100 ADK's simulation host and SimES100. Each scenario
+scripts the ES100's reception cycles, runs the example's setup(), i.e.
+one es100_receive() and the printout, and checks the time and the timer
+count it reports against the simulated UTC clock. The example's own
+Serial output is shown indented.
+
+Per scenario it prints the virtual time the reception took, the wall
+clock it took here and the ratio of the two, and the i2c traffic. It
+exits non-zero if a check failed, so it can run in CI.
+
+With a script file it runs that instead, one statement per line:
+  utc 2024-03-10 06:58:00     UTC at virtual time 0
+  cycle 134000 ok             a cycle of 134s that decodes
+  cycle 134000 fail           ... or ends with CYCLE_COMPLETE
+and '#' starts a comment.
+
+Build and run on Linux, from this directory (-include does what the
+Arduino IDE does for a sketch):
+  ADK=../../../Everset_ES100_ADK_V1.2
+  g++ -std=gnu++11 -O2 -DES100_HOST_HAL -I. -I$ADK/extras/host -I$ADK \
+      -o es100_host *.cpp $ADK/extras/host/Sim{Host,TWI,Timer1,Timer2,ES100}.cpp \
+      -x c++ -include Arduino.h ../../ES100_Arduino.ino
+  ./es100_host
+  ./es100_host -q
+  ./es100_host my.scn
+*/
+
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "Arduino.h"
+#include "SimES100.h"
+#include "SimHAL.h"
+
+// As GPIO_EN and GPIO_IRQ in ES100_Arduino.ino
+#define EN_PIN			4
+#define IRQ_PIN			2
+
+void setup();
+
+static int		checks = 0;
+static int		failures = 0;
+static jmp_buf	hung;
+
+#define CHECK(cond)		check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char *what, int line)
+{
+	checks++;
+	if (ok)
+		return;
+
+	failures++;
+	printf("  FAIL line %d: %s\n", line, what);
+}
+
+static void hangHere()
+{
+	longjmp(hung, 1);
+}
+
+static uint8_t bcd(uint8_t v)
+{
+	return (v / 10) << 4 | v % 10;
+}
+
+static SimES100	*dev = NULL;
+
+static uint32_t cycles()
+{
+	return dev->stats.decodes + dev->stats.failures;
+}
+
+/******************************************************************************
+ * Scenarios
+ ******************************************************************************/
+struct Scenario
+{
+	const char		*name;
+	uint32_t		start;				// UTC at virtual time 0
+	uint8_t			steps;
+	SimES100Step	step[SIM_ES100_STEPS];
+};
+
+// The example's printout, parsed back
+struct Result
+{
+	uint8_t		hung;
+	uint8_t		time[6];			// BCD year to second
+	int			timer;				// ms at the second boundary
+	uint8_t		status;
+};
+
+static char		printed[4096];
+
+static Result run(const Scenario &s)
+{
+	Result		r;
+	FILE		*capture = fmemopen(printed, sizeof(printed) - 1, "w");
+	FILE		*shown = Serial.out;
+	unsigned	time[6];
+	const char	*p;
+	std::chrono::steady_clock::time_point	start;
+	double		wall;
+
+	memset(&r, 0, sizeof(r));
+	memset(printed, 0, sizeof(printed));
+	dev = simHALReset(EN_PIN, IRQ_PIN, s.start);
+	for (uint8_t i = 0; i < s.steps; i++)
+		dev->addStep(s.step[i]);
+
+	printf("%s\n", s.name);
+	Serial.out = capture;
+	simHang = hangHere;
+	start = std::chrono::steady_clock::now();
+	if (setjmp(hung) == 0)
+		setup();
+	else
+		r.hung = true;
+	wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	fclose(capture);
+	Serial.out = shown;
+
+	// The numbers are printed in hex, i.e. as the BCD registers read
+	if (!r.hung && (p = strstr(printed, "received UTC time = 20")) != NULL &&
+		sscanf(p, "received UTC time = 20%x:%x:%x %x:%x:%x", &time[0], &time[1], &time[2],
+			   &time[3], &time[4], &time[5]) == 6) {
+		for (uint8_t i = 0; i < 6; i++)
+			r.time[i] = time[i];
+	}
+	if ((p = strstr(printed, "timer count = ")) != NULL)
+		r.timer = atoi(p + 14);
+	if ((p = strstr(printed, "status register = 0x")) != NULL)
+		r.status = strtol(p + 20, NULL, 16);
+
+	if (Serial.out != NULL)
+		for (p = strtok(printed, "\n"); p != NULL; p = strtok(NULL, "\n"))
+			fprintf(Serial.out, "  > %s\n", p);
+
+	printf("  virtual %.3fs, wall %.1fus, %.0fx, %u cycles\n",
+		   simMicros() / 1e6, wall * 1e6, wall > 0 ? simMicros() / 1e6 / wall : 0, cycles());
+	printf("  i2c: %u transactions, %u bytes, %.2fms on the bus, %u NACKs; %llu IRQ- reads\n",
+		   Wire.stats.transactions, Wire.stats.bytes, Wire.stats.busMicros / 1e3, Wire.stats.nacks,
+		   (unsigned long long)simHALStats.gpioReads);
+
+	return r;
+}
+
+// The example reports the second of the last IRQ and when it saw it
+static void checkDecode(const Result &r)
+{
+	int			year;
+	uint8_t		month, day, hour, minute, second;
+
+	es100BreakTime(dev->getUTC(dev->lastIrqAt), &year, &month, &day, &hour, &minute, &second);
+
+	CHECK(!r.hung && r.status == 0x01);
+	CHECK(r.time[0] == bcd(year % 100) && r.time[1] == bcd(month) && r.time[2] == bcd(day));
+	CHECK(r.time[3] == bcd(hour) && r.time[4] == bcd(minute) && r.time[5] == bcd(second));
+	CHECK(r.timer == (int)(dev->lastIrqAt / 1000));
+	CHECK(Wire.stats.nacks == 0);
+	// Start and read back, status per IRQ, ten registers, each a write and a read but the start
+	CHECK(Wire.stats.transactions == 3 + 2 * cycles() + 20);
+}
+
+static void builtIn()
+{
+	Result		r;
+	Scenario	first = { "decode in the first cycle", es100MakeTime(2024, 3, 10, 6, 58, 0), 1,
+						  { { 134000, true } } };
+	Scenario	retry = { "three failed cycles, then a decode", es100MakeTime(2023, 12, 31, 23, 55, 30), 4,
+						  { { 134000, false }, { 134000, false }, { 134000, false }, { 134000, true } } };
+	Scenario	none = { "no signal", es100MakeTime(2024, 6, 1, 12, 0, 0), 2,
+						 { { 134000, false }, { 134000, false } } };
+
+	r = run(first);
+	checkDecode(r);
+	CHECK(cycles() == 1);
+
+	r = run(retry);
+	checkDecode(r);
+	CHECK(cycles() == 4 && r.time[0] == 0x24 && r.time[1] == 0x01);	// Across the new year
+
+	// The example waits for ever, the HAL says so instead of spinning
+	r = run(none);
+	CHECK(r.hung && cycles() == 2);
+}
+
+/******************************************************************************
+ * Script
+ ******************************************************************************/
+static int script(const char *path)
+{
+	FILE		*f = fopen(path, "r");
+	char		line[128], result[8];
+	int			lineNo = 0;
+	unsigned	y, mo, d, h, mi, sec, ms;
+	Scenario	s = { path, es100MakeTime(2024, 1, 1, 0, 0, 0), 0, { } };
+	Result		r;
+
+	if (f == NULL) {
+		perror(path);
+		return 2;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		char	*p = line + strspn(line, " \t");
+
+		lineNo++;
+		if (*p == '#' || *p == '\n' || *p == '\0')
+			continue;
+
+		if (sscanf(p, "utc %u-%u-%u %u:%u:%u", &y, &mo, &d, &h, &mi, &sec) == 6) {
+			s.start = es100MakeTime(y, mo, d, h, mi, sec);
+		} else if (sscanf(p, "cycle %u %7s", &ms, result) == 2 && s.steps < SIM_ES100_STEPS &&
+				   (strcmp(result, "ok") == 0 || strcmp(result, "fail") == 0)) {
+			s.step[s.steps].duration = ms;
+			s.step[s.steps++].ok = strcmp(result, "ok") == 0;
+		} else {
+			fprintf(stderr, "%s:%d: cannot parse: %s", path, lineNo, line);
+			fclose(f);
+			return 2;
+		}
+	}
+	fclose(f);
+
+	r = run(s);
+	if (r.hung)
+		printf("  no decode, the example would wait for ever\n");
+	else
+		checkDecode(r);
+	printf("\n%d checks, %d failed\n", checks, failures);
+	return failures ? 1 : 0;
+}
+
+/******************************************************************************
+ * Main
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+	int		arg = 1;
+
+	if (arg < argc && strcmp(argv[arg], "-q") == 0) {
+		Serial.out = NULL;
+		arg++;
+	}
+	if (arg < argc)
+		return script(argv[arg]);
+
+	builtIn();
+
+	printf("\n%d checks, %d failed\n", checks, failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,236 @@
+/*
+DS1307 real time clock on the queued i2c bus, see DS1307.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <Arduino.h>
+#include "DS1307.h"
+#include "ES100Time.h"
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define DS1307_CH			0x80		// Clock halt, bit 7 of the seconds register
+
+static const uint8_t	timeReg = 0x00;
+static const uint8_t	minuteReg = 0x01;
+static const uint8_t	controlReg = 0x07;
+static const uint8_t	ramReg = 0x08;
+
+static uint8_t bcdToDec(uint8_t value)
+{
+	return (value / 16 * 10) + (value % 16);
+}
+
+static uint8_t decToBcd(uint8_t value)
+{
+	return (value / 10 * 16) + (value % 10);
+}
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+uint8_t DS1307::_decode(const uint8_t *raw, DS1307Time *t)
+{
+	// A halted oscillator means the time was lost with the battery
+	if (raw[0] & DS1307_CH)
+		return false;
+
+	t->Second	= bcdToDec(raw[0] & 0x7F);
+	t->Minute	= bcdToDec(raw[1]);
+	t->Hour		= bcdToDec(raw[2] & 0x3F);		// 24 hour mode
+	t->Wday		= bcdToDec(raw[3]);
+	t->Day		= bcdToDec(raw[4]);
+	t->Month	= bcdToDec(raw[5]);
+	t->Year		= bcdToDec(raw[6]) + 30;		// The DS1307 counts from 2000
+
+	// ... and a clock that was never set may hold anything
+	return t->Second < 60 && t->Minute < 60 && t->Hour < 24 &&
+		   t->Month >= 1 && t->Month <= 12 && t->Day >= 1 && t->Day <= 31;
+}
+
+void DS1307::_encode(const DS1307Time *t, uint8_t *data)
+{
+	// Writing the seconds with CH clear also starts the oscillator
+	data[0] = timeReg;
+	data[1] = decToBcd(t->Second);
+	data[2] = decToBcd(t->Minute);
+	data[3] = decToBcd(t->Hour);
+	data[4] = decToBcd(t->Wday);
+	data[5] = decToBcd(t->Day);
+	data[6] = decToBcd(t->Month);
+	data[7] = decToBcd(t->Year - 30);
+}
+
+uint8_t DS1307::_store(const uint8_t *data, const DS1307Time *t)
+{
+	uint8_t		check[DS1307_TIME_LEN];
+
+	// Written and read back, the clock may tick in between
+	if (I2C.write(&device, data, 1 + DS1307_TIME_LEN) != I2C_REQ_DONE)
+		return false;
+	if (I2C.read(&device, timeReg, check, DS1307_TIME_LEN) != I2C_REQ_DONE)
+		return false;
+	if (memcmp(check + 1, data + 2, DS1307_TIME_LEN - 1) != 0 ||
+		(uint8_t)(bcdToDec(check[0]) - t->Second) > 1)
+		return false;
+
+	// A background read queued before the write has completed by now and
+	// holds the old time, get() returns the new one until the next
+	_refreshReq.status	= I2C_REQ_IDLE;
+	_last				= *t;
+	_valid				= true;
+
+	return true;
+}
+
+/******************************************************************************
+ * User API
+ ******************************************************************************/
+uint8_t DS1307::read(DS1307Time *t)
+{
+	uint8_t		raw[DS1307_TIME_LEN];
+
+	if (I2C.read(&device, timeReg, raw, DS1307_TIME_LEN) != I2C_REQ_DONE)
+		return false;
+
+	return _decode(raw, t);
+}
+
+uint8_t DS1307::write(const DS1307Time *t)
+{
+	uint8_t		data[1 + DS1307_TIME_LEN];
+
+	_encode(t, data);
+
+	// The bus retries a write that was not acknowledged, but a byte corrupted on
+	// the way is only found by reading it back
+	for (uint8_t i = 0; i <= I2C.retries; i++) {
+		if (_store(data, t))
+			return true;
+	}
+
+	return false;
+}
+
+uint8_t DS1307::writeAt(const DS1307Time *t, unsigned long at)
+{
+	uint8_t			data[1 + DS1307_TIME_LEN];
+	DS1307Time		next;
+	uint32_t		time = es100MakeTime(t->Year + 1970, t->Month, t->Day, t->Hour, t->Minute, t->Second);
+	uint32_t		k;
+	int				year;
+
+	for (uint8_t i = 0; i <= I2C.retries; i++) {
+		// The write has to go out the moment it is started
+		while (!I2C.isIdle()) {
+			I2C.poll();
+			yield();
+		}
+
+		// The first reference second far enough ahead to get the write ready
+		k = (micros() - at + DS1307_WRITE_LEAD + DS1307_WRITE_MARGIN) / 1000000UL + 1;
+		es100BreakTime(time + k, &year, &next.Month, &next.Day, &next.Hour, &next.Minute, &next.Second);
+		next.Year	= year - 1970;
+		next.Wday	= ((time + k) / ES100_SECS_PER_DAY + 6) % 7 + 1;	// 2000-01-01 was a Saturday
+		_encode(&next, data);
+
+		// Writing the seconds restarts the countdown chain, so the register rolls
+		// over a second after the seconds byte is in: that has to be at the boundary
+		while ((long)(at + k * 1000000UL - DS1307_WRITE_LEAD - micros()) > 0)
+			yield();
+
+		if (_store(data, &next))
+			return true;
+	}
+
+	return false;
+}
+
+uint8_t DS1307::adjust(const DS1307Time *t)
+{
+	uint8_t		data[1 + DS1307_TIME_LEN];
+	uint8_t		check[DS1307_TIME_LEN];
+
+	// From the minutes on, the seconds register and countdown chain run on
+	_encode(t, data);
+	data[1] = minuteReg;
+
+	for (uint8_t i = 0; i <= I2C.retries; i++) {
+		if (I2C.write(&device, data + 1, DS1307_TIME_LEN) != I2C_REQ_DONE)
+			continue;
+		if (I2C.read(&device, timeReg, check, DS1307_TIME_LEN) != I2C_REQ_DONE)
+			continue;
+		if (memcmp(check + 1, data + 2, DS1307_TIME_LEN - 1) != 0)
+			continue;
+
+		_refreshReq.status	= I2C_REQ_IDLE;
+		_decode(check, &_last);
+		_valid				= true;
+		return true;
+	}
+
+	return false;
+}
+
+uint8_t DS1307::setSQW(uint8_t control)
+{
+	uint8_t		data[2] = { controlReg, control };
+
+	return I2C.write(&device, data, sizeof(data)) == I2C_REQ_DONE;
+}
+
+uint8_t DS1307::readRAM(uint8_t addr, uint8_t *data, uint8_t len)
+{
+	if (addr + len > DS1307_RAM_LEN)
+		return false;
+
+	return I2C.read(&device, ramReg + addr, data, len) == I2C_REQ_DONE;
+}
+
+uint8_t DS1307::writeRAM(uint8_t addr, const uint8_t *data, uint8_t len)
+{
+	uint8_t		buf[1 + DS1307_RAM_LEN];
+	uint8_t		check[DS1307_RAM_LEN];
+
+	if (addr + len > DS1307_RAM_LEN)
+		return false;
+
+	buf[0] = ramReg + addr;
+	memcpy(buf + 1, data, len);
+
+	if (I2C.write(&device, buf, 1 + len) != I2C_REQ_DONE)
+		return false;
+	if (I2C.read(&device, buf[0], check, len) != I2C_REQ_DONE)
+		return false;
+
+	return memcmp(check, data, len) == 0;
+}
+
+void DS1307::refresh()
+{
+	// Only one read in flight, a request still on the bus is as good. One stuck
+	// there is timed out and the bus recovered by the poll.
+	I2C.poll();
+	if (_refreshReq.status == I2C_REQ_QUEUED || _refreshReq.status == I2C_REQ_ACTIVE)
+		return;
+
+	_refreshReq.dev		= &device;
+	_refreshReq.txData	= &timeReg;
+	_refreshReq.txLen	= 1;
+	_refreshReq.rxData	= _raw;
+	_refreshReq.rxLen	= DS1307_TIME_LEN;
+	I2C.submit(&_refreshReq);
+}
+
+uint8_t DS1307::get(DS1307Time *t)
+{
+	// _raw is left alone from completion until the next refresh()
+	if (_refreshReq.status == I2C_REQ_DONE)
+		_valid = _decode(_raw, &_last);
+
+	*t = _last;
+	return _valid;
+}
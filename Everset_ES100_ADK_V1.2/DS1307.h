@@ -0,0 +1,87 @@
+/*
+DS1307 real time clock on the queued i2c bus, for the ES100 ADK
+
+Takes the place of the DS1307RTC library, which needs Wire and so cannot
+share the bus with I2CBus. The clock keeps local time; the fields match
+TimeLib's tmElements_t, Year counting from 1970.
+
+read() and write() wait for the bus and are for the rare updates after a
+decode. The clock on the display comes from refresh(), which only queues
+a read of the time registers, and get(), which returns the last read that
+completed, so the LCD refresh never waits on the bus. Called once per
+refresh, the time shown is one refresh period old at most.
+
+write() reads the time back and writes it again if it does not match,
+as often as the bus retries a request.
+
+writeAt() sets the clock in phase with a reference second, such as the
+ES100 IRQ of a decode: given the time t of the boundary at micros() ==
+at, it waits for the next boundary it can still make and writes the
+seconds just before it. The DS1307 restarts its countdown chain when the seconds
+are written, so the register then rolls over with the reference, give or
+take the bus and interrupt latency. It blocks for up to a second. The 1 Hz
+SQW output, enabled with setSQW(), falls as the seconds increment and
+shows the remaining phase error. adjust() writes the minutes to the year
+only, for whole-minute steps like a DST change that keep the phase.
+
+The 56 bytes of RAM are battery-backed like the time and are read and
+written with readRAM() and writeRAM(), addressed from 0. A write is read
+back like the time.
+*/
+
+#ifndef DS1307_h
+#define DS1307_h
+
+#include <Arduino.h>
+#include "I2CBus.h"
+
+#define DS1307_ADDR					0x68
+#define DS1307_CLOCK				100000		// Hz, highest SCL frequency of the DS1307
+#define DS1307_TIME_LEN				7			// Seconds (0x00) to year (0x06)
+#define DS1307_RAM_LEN				56			// Bytes of RAM at 0x08-0x3F
+#define DS1307_SQW_OFF				0x00		// Control register: SQW/OUT low
+#define DS1307_SQW_1HZ				0x10		// Control register: SQWE, 1 Hz
+#define DS1307_SQW_EDGE				FALLING		// SQW edge the seconds increment on
+
+// us from starting a write to the seconds byte being in: START and 3 bytes
+#define DS1307_WRITE_LEAD			(28 * 1000000UL / DS1307_CLOCK)
+#define DS1307_WRITE_MARGIN			2000		// us, to get a write ready for its boundary
+
+struct DS1307Time
+{
+	uint8_t		Second;
+	uint8_t		Minute;
+	uint8_t		Hour;
+	uint8_t		Wday;			// 1-7, Sunday is 1
+	uint8_t		Day;
+	uint8_t		Month;
+	uint8_t		Year;			// Offset from 1970
+};
+
+class DS1307
+{
+	public:
+		uint8_t		read(DS1307Time *t);
+		uint8_t		write(const DS1307Time *t);
+		uint8_t		writeAt(const DS1307Time *t, unsigned long at);
+		uint8_t		adjust(const DS1307Time *t);
+		uint8_t		setSQW(uint8_t control);
+		uint8_t		readRAM(uint8_t addr, uint8_t *data, uint8_t len);
+		uint8_t		writeRAM(uint8_t addr, const uint8_t *data, uint8_t len);
+		void		refresh();
+		uint8_t		get(DS1307Time *t);
+
+		I2CDevice	device = {DS1307_ADDR, DS1307_CLOCK, 0, 0, 0, NULL, 0};
+
+	private:
+		uint8_t		_decode(const uint8_t *raw, DS1307Time *t);
+		void		_encode(const DS1307Time *t, uint8_t *data);
+		uint8_t		_store(const uint8_t *data, const DS1307Time *t);
+
+		I2CRequest	_refreshReq = {NULL, NULL, 0, NULL, 0, NULL, NULL};
+		uint8_t		_raw[DS1307_TIME_LEN];		// Filled by the queued read
+		DS1307Time	_last = {0, 0, 0, 0, 0, 0, 0};	// Decoded from the last completed read
+		uint8_t		_valid = false;
+};
+
+#endif
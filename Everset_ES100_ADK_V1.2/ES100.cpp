@@ -35,20 +35,50 @@ POSSIBILITY OF SUCH DAMAGE.
  * Includes
  ******************************************************************************/
 #include <Arduino.h>
-#include <Wire.h>
 #include "ES100.h"
-
-#define DEBUG
-//#define DEBUG_I2C
+#include "ES100Trace.h"
 
 /******************************************************************************
  * Definitions
  ******************************************************************************/
-volatile int 	timerValue = 0;
+// Register address written before reading the snapshot window
+static const uint8_t	snapshotFirstReg = ES100_SNAPSHOT_FIRST_REG;
+
+// attachInterrupt() takes a plain function, so every instance slot has a
+// stub that forwards the edge to the receiver registered in it.
+static ES100	*instances[ES100_MAX_INSTANCES];
 
-void interruptReceived()
+void es100Interrupt(uint8_t slot)
 {
-	timerValue = millis();
+	instances[slot]->_captureIRQ(0, false);
+}
+
+static void interruptReceived0() { es100Interrupt(0); }
+static void interruptReceived1() { es100Interrupt(1); }
+static void interruptReceived2() { es100Interrupt(2); }
+
+static void (* const interruptStubs[ES100_MAX_INSTANCES])(void) = {
+	interruptReceived0, interruptReceived1, interruptReceived2
+};
+
+void ES100::_captureIRQ(uint32_t ticks, uint8_t captured)
+{
+	uint32_t	now = micros();
+	uint8_t		next = (_irqHead + 1) & (ES100_IRQ_RING_SIZE - 1);
+
+	_timerValue = millis();
+	_irqSeq++;
+
+	if (next == _irqTail) {
+		_irqDropped++;
+		return;
+	}
+
+	_irqRing[_irqHead].micros	= now;
+	_irqRing[_irqHead].seq		= _irqSeq;
+	_irqRing[_irqHead].ticks	= ticks;
+	_irqRing[_irqHead].captured	= captured;
+	_irqHead = next;
 }
 
 uint8_t ES100::bcdToDec(uint8_t value)
@@ -56,111 +86,226 @@ uint8_t ES100::bcdToDec(uint8_t value)
 	return( (value/16*10) + (value%16) );
 }
 
-void ES100::_I2Cwrite(uint8_t addr, uint8_t numBytes, uint8_t *ptr)
+void ES100::_account(I2CRequest *req)
 {
-	int i;
+	// The write and the read of a request count as a transaction each
+	if (req->txLen > 0) {
+		ES100_TRACE(ES100_TRACE_I2C, ES100_EV_I2C_WRITE, req->dev->addr, req->txLen);
+		_busStats.transactions++;
+		_busStats.bytes += req->txLen;
+	}
 
-	#ifdef DEBUG_I2C
-		Serial.print("i2c write addr: 0x");
-		Serial.println(addr);
-	#endif
+	if (req->rxLen > 0) {
+		ES100_TRACE(ES100_TRACE_I2C, ES100_EV_I2C_READ, req->dev->addr, req->rxCount);
+		_busStats.transactions++;
+		_busStats.bytes += req->rxCount;
+	}
 
-	Wire.setClock(CLOCK_FREQ);
-	
-	Wire.beginTransmission(addr);
-
-	for (i=0; i<numBytes; i++)
-	{
-		Wire.write(ptr[i]);
-
-		#ifdef DEBUG_I2C
-			uint8_t d = ptr[i];
-			Serial.print("i2c Write ptr[");
-			Serial.print(i);
-			Serial.print("] : 0x");
-			Serial.println(d, HEX);
-		#endif
+	if (req->status != I2C_REQ_DONE) {
+		ES100_TRACE(ES100_TRACE_ERROR, ES100_EV_I2C_ERROR, req->dev->addr, req->status);
+		_busStats.errors++;
 	}
-	
-	Wire.endTransmission();
-	
-	Wire.setClock(DEFAULT_CLOCK);
 }
 
-void ES100::_I2Cread(uint8_t addr, uint8_t numBytes, uint8_t *ptr)
+uint8_t ES100::_transfer(const uint8_t *txData, uint8_t txLen, uint8_t *rxData, uint8_t rxLen)
 {
-	#ifdef DEBUG_I2C
-		Serial.print("i2c read addr: 0x");
-		Serial.println(addr, HEX);
-	#endif
-	
-	int i;
-	const uint8_t stopFlag = 1;
-	
-	Wire.setClock(CLOCK_FREQ);
-	
-	Wire.requestFrom(addr, numBytes, stopFlag);
+	I2CRequest	req = { &_dev, txData, txLen, rxData, rxLen, NULL, NULL };
 
-	for (i=0; (i<numBytes && Wire.available()); i++)
-	{
-		ptr[i] = Wire.read();
+	I2C.transfer(&req);
+	_account(&req);
 
-		#ifdef DEBUG_I2C
-			Serial.print("i2c read data: 0x");
-			Serial.println(ptr[i], HEX);
-		#endif
-	}
-	
-	Wire.setClock(DEFAULT_CLOCK);
+	return req.status;
 }
 
-void ES100::_writeRegister(uint8_t addr, uint8_t data)
+uint8_t ES100::_writeRegister(uint8_t addr, uint8_t data)
 {
 	uint8_t		writeArray[2];
 
 	writeArray[0] = addr;
 	writeArray[1] = data;
 
-	#ifdef DEBUG_I2C
-		Serial.print("writeRegister addr : 0x");
-		Serial.println(addr, HEX);
-		Serial.print("writeRegister data : 0x");
-		Serial.println(data, HEX);
-	#endif
+	ES100_TRACE(ES100_TRACE_INFO, ES100_EV_WRITE_REG, addr, data);
 
-	_I2Cwrite(ES100_ADDR, 0x2, writeArray);
+	return _transfer(writeArray, 0x2, NULL, 0) == I2C_REQ_DONE;
 }
 
 uint8_t ES100::_readRegister(uint8_t addr)
 {
-	uint8_t 	data;
+	uint8_t 	data = 0;
 
-	_I2Cwrite(ES100_ADDR, 0x1, &addr);
-	_I2Cread(ES100_ADDR, 0x1, &data);
+	// A failed read returns 0, which no register the driver reads holds when valid
+	if (_transfer(&addr, 0x1, &data, 0x1) != I2C_REQ_DONE)
+		data = 0;
 
-	#ifdef DEBUG_I2C
-		Serial.print("readRegister addr : 0x");
-		Serial.println(addr, HEX);
-		Serial.print("readRegister data : 0x");
-		Serial.println(data, HEX);
-	#endif
+	ES100_TRACE(ES100_TRACE_INFO, ES100_EV_READ_REG, addr, data);
 
 	return(data);
 }
 
+void ES100::_beginSnapshot()
+{
+	// IRQ- cannot fall again before IRQ_STATUS is read, so the newest
+	// captured edge is the one this window belongs to.
+	ES100IrqEvent	event;
+	while (_popIRQ(&event))
+		_snapshotIrq = event;
+
+	// The ES100 auto-increments its register pointer, so a single read
+	// returns the whole window starting at IRQ_STATUS.
+	_snapshotReq.dev	= &_dev;
+	_snapshotReq.txData	= &snapshotFirstReg;
+	_snapshotReq.txLen	= 1;
+	_snapshotReq.rxData	= _snapshot;
+	_snapshotReq.rxLen	= ES100_SNAPSHOT_LEN;
+	_readPending = I2C.submit(&_snapshotReq);
+}
+
+uint8_t ES100::_endSnapshot()
+{
+	// Waits for the read from _beginSnapshot() if it is still on the bus
+	if (!_readPending)
+		return _snapshotValid;
+
+	while (_snapshotReq.status < I2C_REQ_DONE) {
+		I2C.poll();
+		yield();
+	}
+
+	_readPending	= false;
+	_snapshotValid	= _snapshotReq.status == I2C_REQ_DONE;
+	_account(&_snapshotReq);
+
+	// A full decode, not a tracking one, carries the date and the DST schedule
+	if (_snapshotValid && _snapshotRegister(ES100_IRQ_STATUS_REG) == 0x01 &&
+		(_snapshotRegister(ES100_STATUS0_REG) & 0x81) == 0x01)
+		_decodeTransitions();
+
+	ES100_TRACE(ES100_TRACE_INFO, ES100_EV_READ_WINDOW, ES100_SNAPSHOT_FIRST_REG,
+				_snapshotRegister(ES100_IRQ_STATUS_REG));
+
+	return _snapshotValid;
+}
+
+uint8_t ES100::_snapshotRegister(uint8_t addr)
+{
+	return _snapshot[addr - ES100_SNAPSHOT_FIRST_REG];
+}
+
+void ES100::_cachedSnapshot()
+{
+	// Serve the getters from the last register window unless the device
+	// has raised a new interrupt since it was read. A read poll() has on
+	// the bus is the newest window there is.
+	_endSnapshot();
+
+	if (isSnapshotStale()) {
+		_busStats.snapshotReads++;
+		readSnapshot();
+	} else {
+		_busStats.cacheHits++;
+		ES100_TRACE(ES100_TRACE_INFO, ES100_EV_CACHE_HIT, ES100_SNAPSHOT_FIRST_REG,
+					_snapshotRegister(ES100_IRQ_STATUS_REG));
+	}
+}
+
+uint32_t ES100::_decodeEpoch()
+{
+	return es100MakeTime(ES100_EPOCH_YEAR + bcdToDec(_snapshotRegister(ES100_YEAR_REG)),
+						 bcdToDec(_snapshotRegister(ES100_MONTH_REG)),
+						 bcdToDec(_snapshotRegister(ES100_DAY_REG)),
+						 bcdToDec(_snapshotRegister(ES100_HOUR_REG)),
+						 bcdToDec(_snapshotRegister(ES100_MINUTE_REG)),
+						 bcdToDec(_snapshotRegister(ES100_SECOND_REG)));
+}
+
+int32_t ES100::_decodeLocalOffset()
+{
+	return getLocalOffsetAt(_decodeEpoch());
+}
+
+void ES100::_decodeTransitions()
+{
+	uint8_t			status	= _snapshotRegister(ES100_STATUS0_REG);
+	ES100Status0	status0;
+
+	status0.dstState	= (status & B01100000) >> 5;
+	status0.leapSecond	= (status & B00011000) >> 3;
+
+	restoreTransitions(_decodeEpoch(), status0, _decodeNextDst());
+}
+
+ES100DateTime ES100::_decodeDateTime()
+{
+	ES100DateTime	data;
+	int32_t			offset = _decodeLocalOffset();
+	int				year;
+
+	// A tracking reception only sets SECOND, the date registers are not
+	// a valid date. Zone offsets are whole minutes, so the second is local.
+	if (_snapshotRegister(ES100_STATUS0_REG) & B10000000) {
+		memset(&data, 0, sizeof(data));
+		data.second = bcdToDec(_snapshotRegister(ES100_SECOND_REG));
+		return data;
+	}
+
+	ES100_TRACE(ES100_TRACE_INFO, ES100_EV_DST_SHIFT, ES100_STATUS0_REG, (uint8_t)(offset / 3600));
+
+	es100BreakTime(_decodeEpoch() + offset, &year, &data.month, &data.day,
+				   &data.hour, &data.minute, &data.second);
+
+	data.year = (uint8_t)(year - ES100_EPOCH_YEAR);
+	
+	return data;
+}
+
+ES100NextDst ES100::_decodeNextDst()
+{
+	ES100NextDst data;
+
+	data.month 	= bcdToDec(_snapshotRegister(ES100_NEXT_DST_MONTH_REG));
+	data.day 	= bcdToDec(_snapshotRegister(ES100_NEXT_DST_DAY_REG));
+	data.hour 	= bcdToDec(_snapshotRegister(ES100_NEXT_DST_HOUR_REG));
+
+	return data;
+}
+
+ES100Status0 ES100::_decodeStatus0()
+{
+	ES100Status0 	data;
+	uint8_t 		_status = _snapshotRegister(ES100_STATUS0_REG);
+
+	data.rxOk		= (_status & B00000001);
+	data.antenna 	= (_status & B00000010) >> 1;
+	data.leapSecond	= (_status & B00011000) >> 3;
+	data.dstState	= (_status & B01100000) >> 5;
+	data.tracking	= (_status & B10000000) >> 7;
+
+	return data;
+}
+
 /******************************************************************************
  * Constructors
  ******************************************************************************/
+ES100::~ES100()
+{
+	// The bus must be done with _snapshot before it goes away
+	_endSnapshot();
+
+	// Free the interrupt slot, for receivers that are not global objects
+	if (_slot < ES100_MAX_INSTANCES) {
+		if (digitalPinToInterrupt(_int_pin) != NOT_AN_INTERRUPT)
+			detachInterrupt(digitalPinToInterrupt(_int_pin));
+		instances[_slot] = NULL;
+	}
+}
 
 /******************************************************************************
  * User API
  ******************************************************************************/
 void ES100::begin(uint8_t int_pin, uint8_t en_pin)
 {
-	#ifdef DEBUG 
-		Serial.println(F("ES100::begin"));
-	#endif
-	
+	ES100_TRACE(ES100_TRACE_INFO, ES100_EV_BEGIN, int_pin, en_pin);
+
 	_int_pin = int_pin;
 	pinMode(_int_pin, INPUT);
 	
@@ -168,150 +313,197 @@ void ES100::begin(uint8_t int_pin, uint8_t en_pin)
 	pinMode(_en_pin, OUTPUT);
 	digitalWrite(_en_pin, LOW);
 	
+	if (_slot == ES100_MAX_INSTANCES) {
+		for (uint8_t i = 0; i < ES100_MAX_INSTANCES; i++) {
+			if (instances[i] == NULL) {
+				instances[i]	= this;
+				_slot			= i;
+				break;
+			}
+		}
+	}
+
+	// Without a free slot the driver still works, but poll() is the only
+	// thing that sees IRQ- and getData().irq stays empty. A pin without an
+	// external interrupt is left to captureIRQ().
+	if (_slot < ES100_MAX_INSTANCES && digitalPinToInterrupt(_int_pin) != NOT_AN_INTERRUPT)
+		attachInterrupt(digitalPinToInterrupt(_int_pin), interruptStubs[_slot], FALLING);
+}
+
+void ES100::setStats(ES100Stats *stats)
+{
+	_stats = stats;
+}
+
+// For IRQ- on a timer's input capture pin rather than an external
+// interrupt: the sketch calls this from the capture interrupt with the
+// latched count, which getData().irq then carries along with micros().
+void ES100::captureIRQ(uint32_t ticks)
+{
+	_captureIRQ(ticks, true);
+}
+
+void ES100::setBus(uint8_t addr, I2CMux *mux, uint8_t channel)
+{
+	_dev.addr		= addr;
+	_dev.mux		= mux;
+	_dev.channel	= channel;
 }
 
 
 uint8_t ES100::getDeviceID()
 {
-	#ifdef DEBUG
-		Serial.println(F("ES100::getDeviceID"));
-	#endif
-	
 	uint8_t devID = _readRegister(ES100_DEVICE_ID_REG); 
 	return devID;
 }
 
 ES100DateTime ES100::getDateTime()
 {
-	int shiftBy = timezone + DSTenabled * (getDstState() > 1);
-	#ifdef DEBUG
-		Serial.println(F("ES100::getDateTime"));
-		Serial.println("Shifting by " + String(shiftBy));
-	#endif
+	_cachedSnapshot();
+	return _decodeDateTime();
+}
 
-	ES100DateTime data;
-	
-	int year    = (int)bcdToDec(_readRegister(ES100_YEAR_REG));
-	int month   = (int)bcdToDec(_readRegister(ES100_MONTH_REG));
-	int day     = (int)bcdToDec(_readRegister(ES100_DAY_REG));
-	int hours   = (int)bcdToDec(_readRegister(ES100_HOUR_REG)) + shiftBy;
-	int minutes = (int)bcdToDec(_readRegister(ES100_MINUTE_REG));
-	int seconds = (int)bcdToDec(_readRegister(ES100_SECOND_REG));
-	
-	shiftTime(&year, &month, &day, &hours, &minutes, &seconds);
-
-	data.year 	= (uint8_t)year;
-	data.month 	= (uint8_t)month;
-	data.day 	= (uint8_t)day;
-	data.hour 	= (uint8_t)hours;
-	data.minute = (uint8_t)minutes;
-	data.second	= (uint8_t)seconds;
-	
-	return data;
+uint32_t ES100::getEpoch()
+{
+	_cachedSnapshot();
+	return _decodeEpoch();
 }
 
-ES100NextDst ES100::getNextDst()
+int32_t ES100::getLocalOffset()
 {
-	#ifdef DEBUG
-		Serial.println(F("ES100::getNextDst"));
-	#endif
+	_cachedSnapshot();
+	return _decodeLocalOffset();
+}
 
-	ES100NextDst data;
+int32_t ES100::getLocalOffsetAt(uint32_t utc)
+{
+	// A single compare against the next change, the bus is not touched
+	uint8_t		dst = _transitions.dst;
 
-	data.month 	= bcdToDec(_readRegister(ES100_NEXT_DST_MONTH_REG));
-	data.day 	= bcdToDec(_readRegister(ES100_NEXT_DST_DAY_REG));
-	data.hour 	= bcdToDec(_readRegister(ES100_NEXT_DST_HOUR_REG));
+	if (_transitions.dstAt != 0 && utc >= _transitions.dstAt)
+		dst = !dst;
 
-	return data;
+	return (timezone + DSTenabled * dst) * 3600L + timezoneMinutes * 60L;
 }
 
-ES100Status0 ES100::getStatus0()
+// Works out the transitions from STATUS0 and NEXT_DST as decoded at utc,
+// e.g. as kept by the sketch from an earlier decode. The bus is not touched.
+ES100Transitions ES100::restoreTransitions(uint32_t utc, ES100Status0 status, ES100NextDst next)
 {
-	#ifdef DEBUG
-		Serial.println(F("ES100::getStatus0"));
-	#endif
+	uint32_t		now		= utc;
+	uint8_t			state	= status.dstState & 3;
+	uint8_t			leap	= status.leapSecond & 3;
+	int32_t			zone	= timezone * 3600L + timezoneMinutes * 60L;
+	uint8_t			dst		= state & 1;		// DST at the start of the local day, bit 1 is at its end
+	uint8_t			month, day, hour, minute, second;
+	int				year;
+	uint32_t		at;
+
+	// The NEXT_DST registers hold local time as it is before the change
+	es100BreakTime(now + zone + dst * 3600L, &year, &month, &day, &hour, &minute, &second);
+
+	_transitions.dst	= dst;
+	_transitions.dstAt	= 0;
+
+	if (next.month >= 1 && next.month <= 12 && next.day >= 1 && next.day <= 31) {
+		// "Begins today" or "ends today" with a later date: today's change is behind us
+		if ((state == 1 || state == 2) && (next.month != month || next.day != day))
+			dst = state >> 1;
+		if (next.month < month || (next.month == month && next.day < day))
+			year++;
+
+		at = es100MakeTime(year, next.month, next.day, next.hour, 0, 0) - zone - dst * 3600L;
+		if (at > now) {
+			_transitions.dst	= dst;
+			_transitions.dstAt	= at;
+		} else if (state == 1 || state == 2) {
+			_transitions.dst	= state >> 1;
+		}
+	}
 
-	ES100Status0 	data;
-	uint8_t 		_status = _readRegister(ES100_STATUS0_REG);
+	// A leap second goes in at the end of the last day of the month, UTC
+	es100BreakTime(now, &year, &month, &day, &hour, &minute, &second);
+	if (leap >= 2) {
+		_transitions.leapAt	= es100MakeTime(year + (month == 12), month % 12 + 1, 1, 0, 0, 0);
+		_transitions.leap	= leap == 3 ? 1 : -1;
+	} else {
+		_transitions.leapAt	= 0;
+		_transitions.leap	= 0;
+	}
 
-	data.rxOk		= (_status & B00000001);
-	data.antenna 	= (_status & B00000010) >> 1;
-	data.leapSecond	= (_status & B00011000) >> 3;
-	data.dstState	= (_status & B01100000) >> 5;
-	data.tracking	= (_status & B10000000) >> 7;
+	return _transitions;
+}
 
-	return data;
+ES100Transitions ES100::getTransitions()
+{
+	_cachedSnapshot();
+	return _transitions;
 }
 
-uint8_t ES100::getRxOk()
+ES100NextDst ES100::getNextDst()
 {
-	#ifdef DEBUG
-		Serial.println(F("ES100::getRxOk"));
-	#endif
+	_cachedSnapshot();
+	return _decodeNextDst();
+}
 
-	return (_readRegister(ES100_STATUS0_REG) & B00000001);
+ES100Status0 ES100::getStatus0()
+{
+	_cachedSnapshot();
+	return _decodeStatus0();
+}
+
+uint8_t ES100::getRxOk()
+{
+	_cachedSnapshot();
+	return (_snapshotRegister(ES100_STATUS0_REG) & B00000001);
 }
 
 uint8_t ES100::getAntenna()
 {
-	#ifdef DEBUG
-		Serial.println(F("ES100::getAntenna"));
-	#endif
-	
-	return (_readRegister(ES100_STATUS0_REG) & B00000010) >> 1;	
+	_cachedSnapshot();
+	return (_snapshotRegister(ES100_STATUS0_REG) & B00000010) >> 1;	
 }
 
 uint8_t ES100::getLeapSecond()
 {
-	#ifdef DEBUG
-		Serial.println(F("ES100::getLeapSecond"));
-	#endif
-	
-	return (_readRegister(ES100_STATUS0_REG) & B00011000) >> 3;	
+	_cachedSnapshot();
+	return (_snapshotRegister(ES100_STATUS0_REG) & B00011000) >> 3;	
 }
 
 uint8_t ES100::getDstState()
 {
-	#ifdef DEBUG
-		Serial.println(F("ES100::getDstState"));
-	#endif
-	
-	return (_readRegister(ES100_STATUS0_REG) & B01100000) >> 5;	
+	_cachedSnapshot();
+	return (_snapshotRegister(ES100_STATUS0_REG) & B01100000) >> 5;	
 }
 
 uint8_t ES100::getTracking()
 {
-	#ifdef DEBUG
-		Serial.println(F("ES100::getTracking"));
-	#endif
-	
-	return (_readRegister(ES100_STATUS0_REG) & B10000000) >> 7;	
+	_cachedSnapshot();
+	return (_snapshotRegister(ES100_STATUS0_REG) & B10000000) >> 7;	
 }
 
 uint8_t	ES100::getIRQStatus()
 {
-	#ifdef DEBUG
-		Serial.println(F("ES100::getIRQStatus"));
-	#endif
-	
-	return _readRegister(ES100_IRQ_STATUS_REG);
+	_cachedSnapshot();
+	return _snapshotRegister(ES100_IRQ_STATUS_REG);
 }
 
 ES100Data ES100::getData()
 {
-	#ifdef DEBUG
-		Serial.println(F("ES100::getData"));
-	#endif
-	
 	ES100Data data;
 
-	data.timerValue = timerValue;
-	data.irqStatus 	= getIRQStatus();
+	noInterrupts();
+	data.timerValue = _timerValue;
+	interrupts();
+
+	_cachedSnapshot();
+	data.irq		= _snapshotIrq;
+	data.irqStatus 	= _snapshotRegister(ES100_IRQ_STATUS_REG);
 
 	if (data.irqStatus == 0x01) {
-		data.dateTime 			= getDateTime();
-		data.nextDST 			= getNextDst();
-		data.status 			= getStatus0();
+		data.dateTime 			= _decodeDateTime();
+		data.nextDST 			= _decodeNextDst();
+		data.status 			= _decodeStatus0();
 	} else {
 		data.status.rxOk			= 0x0;
 	}
@@ -319,118 +511,296 @@ ES100Data ES100::getData()
 	return data;
 }
 
+void ES100::readSnapshot()
+{
+	// A read already on the bus is as fresh as a new one
+	if (!_readPending)
+		_beginSnapshot();
+	_endSnapshot();
+}
+
+uint8_t ES100::_popIRQ(ES100IrqEvent *event)
+{
+	uint8_t tail = _irqTail;
+
+	if (tail == _irqHead)
+		return false;
+
+	event->micros	= _irqRing[tail].micros;
+	event->seq		= _irqRing[tail].seq;
+	event->ticks	= _irqRing[tail].ticks;
+	event->captured	= _irqRing[tail].captured;
+	_irqTail = (tail + 1) & (ES100_IRQ_RING_SIZE - 1);
+
+	return true;
+}
+
+uint16_t ES100::getIRQCount()
+{
+	uint16_t count;
+
+	noInterrupts();
+	count = _irqSeq;
+	interrupts();
+
+	return count;
+}
+
+uint16_t ES100::getIRQDropped()
+{
+	uint16_t count;
+
+	noInterrupts();
+	count = _irqDropped;
+	interrupts();
+
+	return count;
+}
+
+uint8_t ES100::isSnapshotStale()
+{
+	// IRQ- stays low until IRQ_STATUS is read, so a low line on an enabled
+	// device means the cached registers belong to an earlier event, unless
+	// the read is on the bus already.
+	if (_readPending)
+		return false;
+
+	if (!_snapshotValid)
+		return true;
+
+	return (_enabled && !digitalRead(_int_pin));
+}
+
+ES100BusStats ES100::getBusStats()
+{
+	_busStats.busMicros = _dev.busMicros;
+	return _busStats;
+}
+
+void ES100::resetBusStats()
+{
+	_busStats.transactions	= 0;
+	_busStats.bytes			= 0;
+	_busStats.snapshotReads	= 0;
+	_busStats.cacheHits		= 0;
+	_busStats.errors		= 0;
+	_dev.busMicros			= 0;
+}
+
 void ES100::enable()
 {
 	// Set the IRQ pin LOW to be able to wait until the ES100 makes it high when ready
 	digitalWrite(_int_pin, LOW);
 	
-	#ifdef DEBUG
-		Serial.print(F("ES100::enable..."));
-	#endif
+	ES100_TRACE(ES100_TRACE_INFO, ES100_EV_ENABLE, 0, 0);
 
 	// Set enable pin HIGH to enable the device
 	digitalWrite(_en_pin, HIGH);
+	_enabled		= true;
+	_snapshotValid	= false;
 	
 	// Wait for the ES100 to be ready
-	while (!digitalRead(_int_pin)) {
+	unsigned long start = millis();
+	while (!digitalRead(_int_pin) && (millis() - start < readyTimeout)) {
 		
 	}
-	delay(40);
-	#ifdef DEBUG
-		Serial.println(F("done."));
-	#endif
+	if (!digitalRead(_int_pin))
+		ES100_TRACE(ES100_TRACE_ERROR, ES100_EV_TIMEOUT, 0, ES100_STATE_ENABLING);
+	delay(ES100_READY_DELAY);
 }
 
 void ES100::disable()
 {
-	#ifdef DEBUG
-		Serial.println(F("ES100::disable"));
-	#endif
+	ES100_TRACE(ES100_TRACE_INFO, ES100_EV_DISABLE, 0, 0);
 	// Set enable pin LOW to disable device
 	digitalWrite(_en_pin, LOW);
+	_enabled		= false;
 }
 
-void ES100::startRx(uint8_t tracking)
+uint8_t ES100::startRx(uint8_t tracking)
 {
-	if (!tracking) {
-		#ifdef DEBUG
-			Serial.println(F("ES100::startRx Tracking off"));
-		#endif
-		_writeRegister(ES100_CONTROL0_REG, 0x01);
-	} else {
-		#ifdef DEBUG
-			Serial.println(F("ES100::startRx Tracking on"));
-		#endif
-		_writeRegister(ES100_CONTROL0_REG, 0x13);
+	uint8_t control0 = ES100_CONTROL0_START | (antennaMode & (ES100_CONTROL0_ANT1_OFF |
+						ES100_CONTROL0_ANT2_OFF | ES100_CONTROL0_START_ANT2));
+
+	// Tracking runs on one antenna only, antenna 2 unless told otherwise
+	if (tracking) {
+		if (antennaMode != ES100_ANT_ONLY1)
+			control0 = ES100_CONTROL0_START | ES100_ANT_ONLY2;
+		control0 |= ES100_CONTROL0_TRACKING;
 	}
+
+	ES100_TRACE(ES100_TRACE_INFO, ES100_EV_START_RX, ES100_CONTROL0_REG, control0);
+	_snapshotValid	= false;
+	if (!_writeRegister(ES100_CONTROL0_REG, control0))
+		return false;
+
+	_control0 = control0;
+	return true;
+}
+
+uint8_t ES100::_cycleAntenna(uint8_t cycle)
+{
+	// Which antenna the given reception cycle (from 0) ran on
+	if (_control0 & ES100_CONTROL0_ANT1_OFF)
+		return 1;
+	if (_control0 & ES100_CONTROL0_ANT2_OFF)
+		return 0;
+
+	return ((_control0 & ES100_CONTROL0_START_ANT2) ? 1 : 0) ^ (cycle & 1);
 }
 
 void ES100::stopRx()
 {
-	#ifdef DEBUG
-		Serial.println("ES100::stopRx");
-	#endif
+	ES100_TRACE(ES100_TRACE_INFO, ES100_EV_STOP_RX, ES100_CONTROL0_REG, 0x00);
 	_writeRegister(ES100_CONTROL0_REG, 0x00);
+	_snapshotValid = false;
+}
+
+
+void ES100::_enterState(uint8_t state, unsigned long now)
+{
+	if (state == ES100_STATE_TIMEOUT)
+		ES100_TRACE(ES100_TRACE_ERROR, ES100_EV_TIMEOUT, 0, _state);
+	else
+		ES100_TRACE(ES100_TRACE_INFO, ES100_EV_STATE, 0, state);
+
+	_state		= state;
+	_phaseStart	= now;
 }
 
+void ES100::beginRx(unsigned long now, uint8_t tracking)
+{
+	ES100_TRACE(ES100_TRACE_INFO, ES100_EV_ENABLE, 0, 0);
+
+	_tracking = tracking;
+	memset(&_phaseTimes, 0, sizeof(_phaseTimes));
+	_endSnapshot();
+	_rxRead = false;
+
+	if (_stats)
+		_stats->recordStart();
+
+	// Same as enable(), but the wait for IRQ- is left to poll()
+	digitalWrite(_int_pin, LOW);
+	digitalWrite(_en_pin, HIGH);
+	_enabled		= true;
+	_snapshotValid	= false;
+
+	_enterState(ES100_STATE_ENABLING, now);
+}
+
+uint8_t ES100::poll(unsigned long now)
+{
+	unsigned long	elapsed = now - _phaseStart;
+	uint8_t			decoded;
+
+	switch (_state) {
+		case ES100_STATE_ENABLING:
+			if (digitalRead(_int_pin)) {
+				_phaseTimes.enable = elapsed;
+				_enterState(ES100_STATE_READY, now);
+			} else if (elapsed >= readyTimeout) {
+				_phaseTimes.timedOutIn = ES100_STATE_ENABLING;
+				if (_stats)
+					_stats->recordResult(false, 0, _tracking);
+				disable();
+				_enterState(ES100_STATE_TIMEOUT, now);
+			}
+			break;
+
+		case ES100_STATE_READY:
+			if (elapsed >= ES100_READY_DELAY) {
+				_phaseTimes.ready = elapsed;
+				if (startRx(_tracking)) {
+					_enterState(ES100_STATE_RX, now);
+				} else {
+					// The bus gave up on the write, the device never started
+					_phaseTimes.timedOutIn = ES100_STATE_READY;
+					if (_stats)
+						_stats->recordResult(false, 0, _tracking);
+					disable();
+					_enterState(ES100_STATE_TIMEOUT, now);
+				}
+			}
+			break;
+
+		case ES100_STATE_RX:
+			if (_rxRead) {
+				// Nothing to do until the window read for the IRQ is in
+				if (_snapshotReq.status < I2C_REQ_DONE) {
+					I2C.poll();
+					break;
+				}
+
+				_rxRead = false;
+				_phaseTimes.read = micros() - _snapshotReq.submitted;
+
+				if (!_endSnapshot()) {
+					// IRQ- is still low, the same IRQ is read again
+					_phaseTimes.irqCount--;
+					break;
+				}
+
+				decoded = _snapshotRegister(ES100_IRQ_STATUS_REG) == 0x01 &&
+						  (_snapshotRegister(ES100_STATUS0_REG) & B00000001);
+
+				if (_stats) {
+					uint8_t antenna = decoded ? (_snapshotRegister(ES100_STATUS0_REG) & B00000010) >> 1
+											  : _cycleAntenna(_phaseTimes.irqCount - 1);
+
+					_stats->recordIRQ(_snapshotRegister(ES100_IRQ_STATUS_REG), antenna, decoded);
+					if (decoded)
+						_stats->recordResult(true, _phaseTimes.rx, _tracking);
+				}
+
+				if (decoded) {
+					// The window stays cached after the device is powered down
+					disable();
+					_enterState(ES100_STATE_DONE, now);
+				}
+			} else if (elapsed >= rxTimeout) {
+				// Checked before IRQ- so a window read that keeps failing, with
+				// IRQ- never released, cannot hold the reception open
+				_phaseTimes.timedOutIn = ES100_STATE_RX;
+				if (_stats)
+					_stats->recordResult(false, elapsed, _tracking);
+				stopRx();
+				disable();
+				_enterState(ES100_STATE_TIMEOUT, now);
+			} else if (!digitalRead(_int_pin)) {
+				// IRQ- asserted: queue one read of the window, it also releases IRQ-
+				_phaseTimes.rx = elapsed;
+				_phaseTimes.irqCount++;
+
+				_beginSnapshot();
+				_rxRead = true;
+			}
+			break;
+	}
 
-void ES100::shiftTime(int *year, int *month, int *day, int *hours, int *minutes, int *seconds)
-{
-  
-		int monthDim[] = { 31,28,31,30,31,30,31,31,30,31,30,31 };
-      
-      while(*seconds < 0)
-      {
-        *seconds += 60;
-        *minutes -= 1;
-      }
-      while(*seconds >= 60)
-      {
-        *seconds -= 60;
-        *minutes += 1;
-      }
-      
-      while(*minutes < 0)
-      {
-        *minutes += 60;
-        *hours -= 1;
-      }
-      while(*minutes >= 60)
-      {
-        *minutes -= 60;
-        *hours += 1;
-      }
-      
-      while(*hours < 0)
-      {
-        *hours += 24;
-        *day -= 1;
-      }
-      while(*hours >= 24)
-      {
-        *hours -= 24;
-        *day += 1;
-      }
-      
-      while(*day < 0)
-      {
-        *month -= 1;
-        *day += monthDim[*month];
-      }
-      while(*day > monthDim[*month])
-      {
-        *day -= monthDim[*month];
-        *month += 1;
-      }
-      
-      while(*month > 12)
-      {
-        *month -= 12;
-        *year += 1;
-      }
-      while(*month < 1)
-      {
-        *month += 12;
-        *year -= 1;
-      }
+	return _state;
+}
+
+void ES100::abortRx()
+{
+	_endSnapshot();
+	_rxRead = false;
+
+	if (_state == ES100_STATE_RX)
+		stopRx();
+
+	if (_enabled)
+		disable();
+
+	_state = ES100_STATE_IDLE;
+}
+
+uint8_t ES100::getState()
+{
+	return _state;
+}
+
+ES100PhaseTimes ES100::getPhaseTimes()
+{
+	return _phaseTimes;
 }
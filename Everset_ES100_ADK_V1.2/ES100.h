@@ -5,9 +5,11 @@ Everset ES100 Library V1.1
 #ifndef ES100_h
 #define ES100_h
 
+#include "I2CBus.h"
+#include "ES100Time.h"
+#include "ES100Stats.h"
 
-#define CLOCK_FREQ					100000		// Hz
-#define DEFAULT_CLOCK				400000		// Hz
+#define CLOCK_FREQ					100000		// Hz, highest SCL frequency of the ES100
 
 #define ES100_ADDR					0x32		// ES100 i2c Address
 #define ES100_EN_DELAY				100000		// ES100 enable delay
@@ -26,6 +28,45 @@ Everset ES100 Library V1.1
 #define ES100_NEXT_DST_HOUR_REG		0x0C
 #define ES100_DEVICE_ID_REG			0x0D
 
+// CONTROL0 bits
+#define ES100_CONTROL0_START		0x01
+#define ES100_CONTROL0_ANT1_OFF		0x02
+#define ES100_CONTROL0_ANT2_OFF		0x04
+#define ES100_CONTROL0_START_ANT2	0x08		// Alternating reception begins on antenna 2
+#define ES100_CONTROL0_TRACKING		0x10
+
+// Antenna modes for ES100::antennaMode, the CONTROL0 antenna bits
+#define ES100_ANT_BOTH				0x00		// Alternate, starting on antenna 1
+#define ES100_ANT_BOTH_START2		ES100_CONTROL0_START_ANT2	// Alternate, starting on antenna 2
+#define ES100_ANT_ONLY1				ES100_CONTROL0_ANT2_OFF		// Antenna 1 only
+#define ES100_ANT_ONLY2				ES100_CONTROL0_ANT1_OFF		// Antenna 2 only
+
+// Reception state machine, see ES100::poll()
+#define ES100_STATE_IDLE			0			// Device disabled, nothing in progress
+#define ES100_STATE_ENABLING		1			// EN high, waiting for IRQ- to go high
+#define ES100_STATE_READY			2			// Device ready, waiting ES100_READY_DELAY before start
+#define ES100_STATE_RX				3			// Reception running, waiting for IRQ-
+#define ES100_STATE_DONE			4			// Valid decode read, device disabled
+#define ES100_STATE_TIMEOUT			5			// A phase ran out of time, device disabled
+
+#define ES100_READY_TIMEOUT			2000		// ms, EN high to IRQ- high
+#define ES100_READY_DELAY			40			// ms, IRQ- high to first register write
+#define ES100_RX_TIMEOUT			600000		// ms, start of reception to valid decode
+
+// Falling edges of IRQ- are captured by the driver's interrupt handler into
+// a single-producer/single-consumer ring. Must be a power of two.
+#define ES100_IRQ_RING_SIZE			8
+
+// Receivers that can run at the same time, each needs its own IRQ pin and
+// either its own mux channel or address. Every slot costs one ISR stub.
+#define ES100_MAX_INSTANCES			3
+
+// Registers IRQ_STATUS (0x02) through NEXT_DST_HOUR (0x0C) are read in a
+// single auto-increment transaction, queued on the bus by ES100::poll()
+// or waited for by ES100::readSnapshot().
+#define ES100_SNAPSHOT_FIRST_REG	ES100_IRQ_STATUS_REG
+#define ES100_SNAPSHOT_LEN			(ES100_NEXT_DST_HOUR_REG - ES100_SNAPSHOT_FIRST_REG + 1)
+
 struct ES100DateTime
 {
 	uint8_t		hour;
@@ -43,6 +84,18 @@ struct ES100NextDst
 	uint8_t		hour;
 };
 
+// The next DST change and leap second as UTC instants (ES100Time.h seconds),
+// worked out from NEXT_DST and STATUS0 whenever a full decode is read. With
+// them local time needs no register read, and a clock can be stepped at the
+// right second on days without reception.
+struct ES100Transitions
+{
+	uint32_t	dstAt;		// UTC of the next DST change, 0 if none is known
+	uint8_t		dst;		// 1 if DST is in effect until dstAt, or for good if dstAt is 0
+	uint32_t	leapAt;		// UTC midnight ending the month with a leap second, 0 if none
+	int8_t		leap;		// 1 when 23:59:60 is inserted before leapAt, -1 when 23:59:59 is dropped
+};
+
 struct ES100Status0
 {
 	// Data in the struct is only valid when rxOk = 1.
@@ -61,47 +114,143 @@ struct ES100Status0
 							// 1 (0x1)  Indicates that the reception attemps was a tracking operation.
 };
 
+struct ES100BusStats
+{
+	uint32_t	transactions;	// Number of i2c write or read transactions issued.
+	uint32_t	bytes;			// Number of data bytes moved over the bus, address byte excluded.
+	uint16_t	snapshotReads;	// Number of register window reads issued by the getters.
+	uint16_t	cacheHits;		// Number of getter calls answered from the cached register window.
+	uint32_t	busMicros;		// Time the ES100's i2c requests held the bus, in us.
+	uint16_t	errors;			// Number of requests that failed after the bus's retries.
+};
+
+struct ES100PhaseTimes
+{
+	unsigned long	enable;			// ms from EN high until IRQ- went high
+	unsigned long	ready;			// ms from IRQ- high until the reception was started
+	unsigned long	rx;				// ms from the start of reception until the last IRQ
+	unsigned long	read;			// us from seeing the last IRQ until its register window was in
+	uint16_t		irqCount;		// IRQs seen during the reception, valid or not
+	uint8_t			timedOutIn;		// State that ran out of time, ES100_STATE_IDLE if none
+};
+
+struct ES100IrqEvent
+{
+	uint32_t	micros;			// micros() at the falling edge of IRQ-, i.e. the second boundary
+	uint16_t	seq;			// Running edge count, gaps mean edges were dropped
+	uint32_t	ticks;			// Timer count latched by the hardware at the edge, see captureIRQ()
+	uint8_t		captured;		// ticks is valid
+};
+
 struct ES100Data
 {
 	ES100DateTime	dateTime;
 	ES100NextDst 	nextDST;
 	ES100Status0 	status;
 	uint8_t			irqStatus;
-	int 			timerValue;		// This hold the millis() when the interrupt occured, will be useful in the user code to handle the second boundary. New valid data should be handled within 65536 milli seconds, after that the variable will overflow and the user won't be able to calculate the right second boundary.
+	unsigned long	timerValue;		// This hold the millis() when the interrupt occured, kept for compatibility. Use irq.micros for the second boundary.
+	ES100IrqEvent	irq;			// The IRQ edge the register window was read for.
 };
 
 class ES100
 {
 	public:
+		~ES100();
 		ES100Data		getData();
+		void			readSnapshot();
+		uint8_t			isSnapshotStale();
 		ES100DateTime	getDateTime();
+		uint32_t		getEpoch();
+		int32_t			getLocalOffset();
+		int32_t			getLocalOffsetAt(uint32_t utc);
+		ES100Transitions	getTransitions();
+		ES100Transitions	restoreTransitions(uint32_t utc, ES100Status0 status, ES100NextDst next);
 		ES100NextDst 	getNextDst();
 		ES100Status0 	getStatus0();
+		void			setBus(uint8_t addr, I2CMux *mux = NULL, uint8_t channel = 0);
 		void			begin(uint8_t int_pin, uint8_t en_pin);
+		void			setStats(ES100Stats *stats);
+		void			captureIRQ(uint32_t ticks);
 		uint8_t			getDeviceID();
 		uint8_t			getIRQStatus();
 		void			enable();
 		void			disable();
-		void			startRx(uint8_t = false);
+		uint8_t			startRx(uint8_t = false);
 		void			stopRx();
+		void			beginRx(unsigned long now, uint8_t tracking = false);
+		uint8_t			poll(unsigned long now);
+		void			abortRx();
+		uint8_t			getState();
+		ES100PhaseTimes	getPhaseTimes();
+		uint16_t		getIRQCount();
+		uint16_t		getIRQDropped();
 		uint8_t 		getRxOk();
 		uint8_t 		getAntenna();
 		uint8_t 		getLeapSecond();
 		uint8_t 		getDstState();
 		uint8_t 		getTracking();
+		ES100BusStats	getBusStats();
+		void			resetBusStats();
 		
-		int timezone   = 0;			    // time shift with a specific timezone. Can be placed any time that int can handle
+		int timezone   = 0;			    // time shift with a specific timezone, in hours
+		int timezoneMinutes = 0;		// additional time shift in minutes, e.g. -30 with timezone -3 for UTC-03:30
 		int DSTenabled = false;			// time shift depending on the DST
+		unsigned long readyTimeout = ES100_READY_TIMEOUT;	// ms, used by enable() and poll()
+		unsigned long rxTimeout    = ES100_RX_TIMEOUT;		// ms, used by poll()
+		uint8_t antennaMode = ES100_ANT_BOTH;				// ES100_ANT_*, used by startRx(). Tracking needs
+															// a single antenna and uses antenna 2 unless ONLY1.
 
 	private:
 		uint8_t			_int_pin;
 		uint8_t			_en_pin;
+		uint8_t			_snapshot[ES100_SNAPSHOT_LEN];	// Raw register window, index 0 is ES100_SNAPSHOT_FIRST_REG
+		uint8_t			_snapshotValid = false;			// Cleared whenever the device state changes
+		ES100IrqEvent	_snapshotIrq = {0, 0, 0, 0};	// Last captured edge at the time of the read
+		uint8_t			_enabled = false;
+		uint8_t			_state = ES100_STATE_IDLE;
+		uint8_t			_tracking = false;
+		uint8_t			_control0 = 0;					// Last value written to start a reception
+		unsigned long	_phaseStart;
+		ES100PhaseTimes	_phaseTimes;
+		ES100BusStats	_busStats = {0, 0, 0, 0, 0, 0};
+		ES100Transitions	_transitions = {0, 0, 0, 0};	// From the last full decode read
+		I2CDevice		_dev = {ES100_ADDR, CLOCK_FREQ, 0, 0, 0, NULL, 0};
+		I2CRequest		_snapshotReq = {NULL, NULL, 0, NULL, 0, NULL, NULL};	// Register window read
+		uint8_t			_readPending = false;			// _snapshotReq submitted, not yet collected
+		uint8_t			_rxRead = false;				// poll() is waiting for the window of an IRQ
+		ES100Stats		*_stats = NULL;
+		uint8_t			_slot = ES100_MAX_INSTANCES;	// Interrupt slot, ES100_MAX_INSTANCES until begin()
+
+		// IRQ edge ring: the ISR is the only writer of _irqHead, the driver
+		// the only writer of _irqTail. Both are single bytes, so no locking
+		// is needed.
+		volatile ES100IrqEvent	_irqRing[ES100_IRQ_RING_SIZE];
+		volatile uint8_t		_irqHead = 0;
+		volatile uint8_t		_irqTail = 0;
+		volatile uint16_t		_irqSeq = 0;
+		volatile uint16_t		_irqDropped = 0;
+		volatile unsigned long	_timerValue = 0;
+
+		friend void	es100Interrupt(uint8_t slot);
+		void		_captureIRQ(uint32_t ticks, uint8_t captured);
 
 		uint8_t 	bcdToDec(uint8_t);
-		void		_writeRegister(uint8_t addr, uint8_t data);
+		uint8_t		_writeRegister(uint8_t addr, uint8_t data);
 		uint8_t		_readRegister(uint8_t addr);
-		void		_I2Cwrite(uint8_t addr, uint8_t numBytes, uint8_t *ptr);
-		void		_I2Cread(uint8_t addr, uint8_t numBytes, uint8_t *ptr);
-		void 		shiftTime(int *year, int *month, int *day, int *hours, int *minutes, int *seconds);
+		uint8_t		_transfer(const uint8_t *txData, uint8_t txLen, uint8_t *rxData, uint8_t rxLen);
+		void		_account(I2CRequest *req);
+		void		_beginSnapshot();
+		uint8_t		_endSnapshot();
+		uint8_t		_snapshotRegister(uint8_t addr);
+		void		_cachedSnapshot();
+		void		_enterState(uint8_t state, unsigned long now);
+		uint8_t		_popIRQ(ES100IrqEvent *event);
+		uint8_t		_cycleAntenna(uint8_t cycle);
+		ES100DateTime	_decodeDateTime();
+		ES100NextDst	_decodeNextDst();
+		ES100Status0	_decodeStatus0();
+		uint32_t	_decodeEpoch();
+		int32_t		_decodeLocalOffset();
+		void		_decodeTransitions();
 };
 #endif
@@ -0,0 +1,91 @@
+/*
+Antenna preference policy for the ES100 library, see ES100Antenna.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <Arduino.h>
+#include "ES100Antenna.h"
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+void ES100Antenna::_hit(uint8_t antenna)
+{
+	// Moving average over about 4 receptions, towards 255
+	_score[antenna] += (255 - _score[antenna] + 3) / 4;
+	if (_decodes[antenna] < 0xFFFF)
+		_decodes[antenna]++;
+}
+
+void ES100Antenna::_miss(uint8_t antenna)
+{
+	_score[antenna] -= (_score[antenna] + 3) / 4;
+}
+
+uint8_t ES100Antenna::_better()
+{
+	return _score[1] > _score[0] ? 1 : 0;
+}
+
+/******************************************************************************
+ * User API
+ ******************************************************************************/
+uint8_t ES100Antenna::next(uint8_t tracking)
+{
+	uint8_t		preferred = getPreferred();
+
+	if (tracking || (preferred != ES100_ANTENNA_NONE && _misses < maxMisses)) {
+		uint8_t antenna = preferred != ES100_ANTENNA_NONE ? preferred : _better();
+		_mode = antenna ? ES100_ANT_ONLY2 : ES100_ANT_ONLY1;
+	} else {
+		_mode = _better() ? ES100_ANT_BOTH_START2 : ES100_ANT_BOTH;
+	}
+
+	return _mode;
+}
+
+void ES100Antenna::finished(uint8_t ok, uint8_t antenna)
+{
+	uint8_t		single = _mode == ES100_ANT_ONLY1 || _mode == ES100_ANT_ONLY2;
+	uint8_t		start = _mode == ES100_ANT_ONLY2 || _mode == ES100_ANT_BOTH_START2;
+
+	antenna &= 1;
+
+	if (ok) {
+		_hit(antenna);
+		// Alternating and decoded on the second antenna: the first one missed
+		if (!single && antenna != start)
+			_miss(start);
+		_misses = 0;
+	} else if (single) {
+		_miss(start);
+		if (_misses < 0xFF)
+			_misses++;
+	} else {
+		_miss(0);
+		_miss(1);
+	}
+}
+
+uint8_t ES100Antenna::getPreferred()
+{
+	uint8_t		best = _better();
+	uint8_t		other = best ^ 1;
+
+	if (_decodes[best] < minDecodes || _score[best] < _score[other] + margin)
+		return ES100_ANTENNA_NONE;
+
+	return best;
+}
+
+uint8_t ES100Antenna::getScore(uint8_t antenna)
+{
+	return _score[antenna & 1];
+}
+
+uint16_t ES100Antenna::getDecodes(uint8_t antenna)
+{
+	return _decodes[antenna & 1];
+}
@@ -0,0 +1,58 @@
+/*
+Antenna preference policy for the ES100 library
+
+The ES100 alternates between its two antennas every reception cycle
+unless CONTROL0 switches one off. Most installs only decode on one
+orientation, so half of the cycles are wasted there. This policy keeps
+a score per antenna from the outcome of every reception and picks the
+CONTROL0 antenna mode for the next one:
+- once an antenna has minDecodes decodes and leads the other by margin,
+  receptions run on that antenna only
+- after maxMisses failed single-antenna receptions in a row, it falls
+  back to alternating, starting on the preferred antenna, until a
+  reception succeeds again
+- without a preference it alternates, starting on the better antenna
+Tracking always needs a single antenna and gets the better one.
+
+Like ES100Sync it does not touch the ES100: the sketch sets
+ES100::antennaMode from next() before beginRx() and reports the result
+with finished().
+*/
+
+#ifndef ES100Antenna_h
+#define ES100Antenna_h
+
+#include <Arduino.h>
+#include "ES100.h"
+
+#define ES100_ANTENNA_NONE			0xFF		// No preferred antenna
+#define ES100_ANTENNA_MIN_DECODES	3			// Decodes on an antenna before it can be preferred
+#define ES100_ANTENNA_MARGIN		64			// Score lead needed to prefer an antenna
+#define ES100_ANTENNA_MISSES		2			// Failed single-antenna receptions before alternating
+#define ES100_ANTENNA_SCORE_PRIOR	128			// Score of an antenna without history, 255 is always decodes
+
+class ES100Antenna
+{
+	public:
+		uint8_t			next(uint8_t tracking = false);
+		void			finished(uint8_t ok, uint8_t antenna);
+		uint8_t			getPreferred();
+		uint8_t			getScore(uint8_t antenna);
+		uint16_t		getDecodes(uint8_t antenna);
+
+		uint8_t			minDecodes	= ES100_ANTENNA_MIN_DECODES;
+		uint8_t			margin		= ES100_ANTENNA_MARGIN;
+		uint8_t			maxMisses	= ES100_ANTENNA_MISSES;
+
+	private:
+		void			_hit(uint8_t antenna);
+		void			_miss(uint8_t antenna);
+		uint8_t			_better();
+
+		uint8_t			_mode = ES100_ANT_BOTH;		// Mode handed out by the last next()
+		uint8_t			_misses = 0;				// Consecutive failed single-antenna receptions
+		uint8_t			_score[2] = { ES100_ANTENNA_SCORE_PRIOR, ES100_ANTENNA_SCORE_PRIOR };
+		uint16_t		_decodes[2] = { 0, 0 };
+};
+
+#endif
@@ -0,0 +1,121 @@
+/*
+Antenna diversity coordinator for the ES100 library, see ES100Diversity.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <Arduino.h>
+#include "ES100Diversity.h"
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+void ES100Diversity::_stopOthers(uint8_t winner)
+{
+	for (uint8_t i = 0; i < _started; i++) {
+		if (i == winner)
+			continue;
+
+		if (_results[i].state != ES100_STATE_DONE && _results[i].state != ES100_STATE_TIMEOUT) {
+			_receivers[i]->abortRx();
+			_results[i].state = ES100_STATE_IDLE;
+		}
+	}
+}
+
+/******************************************************************************
+ * User API
+ ******************************************************************************/
+uint8_t ES100Diversity::add(ES100 *receiver)
+{
+	if (_count >= ES100_MAX_INSTANCES)
+		return ES100_DIVERSITY_NONE;
+
+	_receivers[_count] = receiver;
+	return _count++;
+}
+
+void ES100Diversity::begin(unsigned long now, uint8_t tracking)
+{
+	_begin		= now;
+	_tracking	= tracking;
+	_started	= 0;
+	_winner		= ES100_DIVERSITY_NONE;
+	_elapsed	= 0;
+	_state		= ES100_STATE_RX;
+
+	memset(_results, 0, sizeof(_results));
+}
+
+uint8_t ES100Diversity::poll(unsigned long now)
+{
+	unsigned long	elapsed = now - _begin;
+	uint8_t			running = false;
+
+	if (_state != ES100_STATE_RX)
+		return _state;
+
+	while (_started < _count && elapsed >= _started * stagger) {
+		_receivers[_started]->beginRx(now, _tracking);
+		_results[_started].started	= elapsed;
+		_results[_started].state	= ES100_STATE_ENABLING;
+		_started++;
+	}
+
+	for (uint8_t i = 0; i < _started; i++) {
+		ES100DiversityResult	&result = _results[i];
+
+		if (result.state == ES100_STATE_DONE || result.state == ES100_STATE_TIMEOUT)
+			continue;
+
+		result.state = _receivers[i]->poll(now);
+
+		if (result.state == ES100_STATE_DONE) {
+			result.elapsed	= elapsed - result.started;
+			_winner			= i;
+			_elapsed		= elapsed;
+			_state			= ES100_STATE_DONE;
+			_stopOthers(i);
+			return _state;
+		}
+
+		if (result.state == ES100_STATE_TIMEOUT)
+			result.elapsed = elapsed - result.started;
+		else
+			running = true;
+	}
+
+	if (!running && _started == _count)
+		_state = ES100_STATE_TIMEOUT;
+
+	return _state;
+}
+
+void ES100Diversity::abort()
+{
+	if (_state == ES100_STATE_RX)
+		_stopOthers(ES100_DIVERSITY_NONE);
+
+	_state = ES100_STATE_IDLE;
+}
+
+uint8_t ES100Diversity::getWinner()
+{
+	return _winner;
+}
+
+ES100 *ES100Diversity::getReceiver(uint8_t index)
+{
+	return index < _count ? _receivers[index] : NULL;
+}
+
+unsigned long ES100Diversity::getElapsed()
+{
+	return _elapsed;
+}
+
+ES100DiversityResult ES100Diversity::getResult(uint8_t index)
+{
+	return _results[index];
+}
@@ -0,0 +1,59 @@
+/*
+Antenna diversity coordinator for the ES100 library
+
+Runs a reception on up to ES100_MAX_INSTANCES receivers at once and
+takes the first valid decode. The receivers are started ES100_DIVERSITY_STAGGER
+ms apart, which spreads their power-up current and keeps their IRQs
+from all landing on the same bus slot. As soon as one receiver reaches
+ES100_STATE_DONE the others are stopped and powered down.
+
+Each receiver needs its own IRQ and EN pin and must be reachable on
+its own mux channel (or address), see ES100::setBus(). Like ES100::poll(),
+poll() never blocks and is meant to be called from loop().
+*/
+
+#ifndef ES100Diversity_h
+#define ES100Diversity_h
+
+#include <Arduino.h>
+#include "ES100.h"
+
+#define ES100_DIVERSITY_STAGGER		2000		// ms between starting two receivers
+#define ES100_DIVERSITY_NONE		0xFF		// No winner (yet)
+
+struct ES100DiversityResult
+{
+	uint8_t			state;		// Receiver state at the end: DONE, TIMEOUT, or IDLE if stopped or never started
+	unsigned long	started;	// ms after begin() the receiver was powered up
+	unsigned long	elapsed;	// ms from its start until it finished
+};
+
+class ES100Diversity
+{
+	public:
+		uint8_t			add(ES100 *receiver);
+		void			begin(unsigned long now, uint8_t tracking = false);
+		uint8_t			poll(unsigned long now);
+		void			abort();
+		uint8_t			getWinner();
+		ES100			*getReceiver(uint8_t index);
+		unsigned long	getElapsed();
+		ES100DiversityResult	getResult(uint8_t index);
+
+		unsigned long	stagger = ES100_DIVERSITY_STAGGER;
+
+	private:
+		void			_stopOthers(uint8_t winner);
+
+		ES100			*_receivers[ES100_MAX_INSTANCES];
+		ES100DiversityResult	_results[ES100_MAX_INSTANCES];
+		uint8_t			_count = 0;
+		uint8_t			_started = 0;
+		uint8_t			_state = ES100_STATE_IDLE;
+		uint8_t			_tracking = false;
+		uint8_t			_winner = ES100_DIVERSITY_NONE;
+		unsigned long	_begin;
+		unsigned long	_elapsed = 0;
+};
+
+#endif
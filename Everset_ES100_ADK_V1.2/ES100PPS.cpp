@@ -0,0 +1,351 @@
+/*
+1PPS output for the ES100 library, see ES100PPS.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <Arduino.h>
+#include "ES100PPS.h"
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+// Ticks between "now" and the first pulse after a sync: at least one
+// overflow has to pass so the overflow interrupt can arm the compare.
+#define ES100_PPS_ARM_MARGIN	0x18000L
+
+static ES100PPS		*instance = NULL;
+
+/******************************************************************************
+ * Interrupt handlers
+ ******************************************************************************/
+void es100PPSRise()
+{
+	ES100PPS	*pps = instance;
+	int32_t		fraction;
+
+	pps->_output(HIGH);
+
+	TIMSK1 &= ~_BV(OCIE1A);
+	TIFR1 = _BV(OCF1A);
+	OCR1B = OCR1A + (uint16_t)(pps->pulseWidth * ES100_PPS_TICKS_PER_US);
+	TIFR1 = _BV(OCF1B);
+	TIMSK1 |= _BV(OCIE1B);
+
+	// Whole ticks of the learned rate go into this second, the rest is carried
+	fraction = pps->_fraction + pps->_rate;
+	pps->_target += ES100_PPS_TICKS_PER_SECOND + (fraction >> 8);
+	pps->_fraction = fraction & 0xFF;
+	pps->_targetEpoch++;
+}
+
+void es100PPSFall()
+{
+	instance->_output(LOW);
+	TIMSK1 &= ~_BV(OCIE1B);
+}
+
+void es100PPSOverflow()
+{
+	ES100PPS	*pps = instance;
+
+	pps->_high++;
+
+	// The compare is only armed in the 65536 ticks leading up to the edge
+	if (!pps->_locked || (uint16_t)(pps->_target >> 16) != pps->_high)
+		return;
+
+	OCR1A = (uint16_t)pps->_target;
+	TIFR1 = _BV(OCF1A);
+	TIMSK1 |= _BV(OCIE1A);
+
+	// An edge right after the overflow may have passed while we got here
+	if (TCNT1 >= OCR1A)
+		es100PPSRise();
+}
+
+void es100PPSCapture()
+{
+	ES100PPS	*pps = instance;
+	uint16_t	low = ICR1;
+	uint16_t	high = pps->_high;
+
+	// The capture vector comes before the overflow's: an overflow shortly
+	// before the edge may still be waiting to be counted
+	if ((TIFR1 & _BV(TOV1)) && low < 0x8000)
+		high++;
+
+	if (pps->_onCapture != NULL)
+		pps->_onCapture(((uint32_t)high << 16) | low);
+}
+
+ISR(TIMER1_OVF_vect)
+{
+	es100PPSOverflow();
+}
+
+ISR(TIMER1_COMPA_vect)
+{
+	es100PPSRise();
+}
+
+ISR(TIMER1_COMPB_vect)
+{
+	es100PPSFall();
+}
+
+ISR(TIMER1_CAPT_vect)
+{
+	es100PPSCapture();
+}
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+uint32_t ES100PPS::_ticks()
+{
+	// Interrupts are off: an overflow may be pending and not counted in _high yet
+	uint16_t	high = _high;
+	uint16_t	low = TCNT1;
+
+	if ((TIFR1 & _BV(TOV1)) && low < 0x8000)
+		high++;
+
+	return ((uint32_t)high << 16) | low;
+}
+
+void ES100PPS::_output(uint8_t level)
+{
+#if defined(__AVR__)
+	// digitalWrite() is too slow and uneven to run on the edge
+	if (level)
+		*_port |= _mask;
+	else
+		*_port &= ~_mask;
+#else
+	digitalWrite(_pin, level);
+#endif
+}
+
+void ES100PPS::_schedule(uint32_t edge, uint32_t epoch, uint32_t now)
+{
+	uint32_t	seconds = (now - edge) / ES100_PPS_TICKS_PER_SECOND;
+	uint32_t	target;
+
+	do {
+		seconds++;
+		target = edge + seconds * ES100_PPS_TICKS_PER_SECOND + (int32_t)((int64_t)seconds * _rate / 256);
+	} while ((int32_t)(target - now) < ES100_PPS_ARM_MARGIN);
+
+	_target			= target;
+	_targetEpoch	= epoch + seconds;
+	_fraction		= 0;
+}
+
+uint8_t ES100PPS::_sync(uint32_t edge, uint32_t epoch, uint32_t now)
+{
+	uint32_t	target, targetEpoch;
+	int32_t		rate = _rate;
+
+	noInterrupts();
+	target		= _target;
+	targetEpoch	= _targetEpoch;
+	interrupts();
+
+	edge -= (int32_t)edgeOffset * ES100_PPS_TICKS_PER_US;
+
+	if (_locked) {
+		// Where the free-running output put the edge of this second
+		int32_t		seconds = targetEpoch - epoch;
+		uint32_t	predicted = target - (uint32_t)(((int64_t)ES100_PPS_TICKS_PER_SECOND * 256 + _rate) * seconds / 256);
+		int32_t		error = edge - predicted;		// > 0: the output runs fast
+		uint32_t	elapsed = epoch - _syncEpoch;
+
+		if (elapsed >= minInterval) {
+			// Frequency error since the last sync, in ticks / 256 per second
+			int32_t		correction = (int64_t)error * 256 / (int32_t)elapsed;
+			int32_t		limit = (int64_t)ES100_PPS_TICKS_PER_SECOND * 256 / 1000000L * ES100_PPS_MAX_PPM;
+
+			if (correction > limit || correction < -limit)
+				return false;
+
+			rate += _rated ? correction / 2 : correction;
+			_rated = true;
+		}
+
+		_lastError = error / ES100_PPS_TICKS_PER_US;
+		if ((uint32_t)abs(_lastError) > _maxError)
+			_maxError = abs(_lastError);
+	}
+
+	noInterrupts();
+	TIMSK1 &= ~_BV(OCIE1A);
+	_rate = rate;
+	_schedule(edge, epoch, now);
+	_locked = true;
+	interrupts();
+
+	_syncEpoch = epoch;
+	_syncs++;
+
+	return true;
+}
+
+uint8_t ES100PPS::_syncSecond(uint32_t edge, uint8_t second, uint32_t now)
+{
+	uint32_t	epoch;
+	int			delta;
+
+	if (!_locked)
+		return false;
+
+	// The output's second nearest the edge, pulled onto the received second
+	epoch = getEpoch() - (now - edge) / ES100_PPS_TICKS_PER_SECOND;
+	delta = ((int)second - (int)(epoch % 60) + 90) % 60 - 30;
+
+	return _sync(edge, epoch + delta, now);
+}
+
+/******************************************************************************
+ * User API
+ ******************************************************************************/
+void ES100PPS::begin(uint8_t pin)
+{
+	instance	= this;
+	_pin		= pin;
+	_locked		= false;
+	_high		= 0;
+
+	pinMode(pin, OUTPUT);
+	digitalWrite(pin, LOW);
+#if defined(__AVR__)
+	_port	= portOutputRegister(digitalPinToPort(pin));
+	_mask	= digitalPinToBitMask(pin);
+#endif
+
+	// Normal mode, counting 0 to 0xFFFF at F_CPU/8
+	noInterrupts();
+	TCCR1A	= 0;
+	TCCR1B	= _BV(CS11);
+	TCNT1	= 0;
+	TIFR1	= _BV(TOV1) | _BV(OCF1A) | _BV(OCF1B);
+	TIMSK1	= _BV(TOIE1);
+	interrupts();
+}
+
+void ES100PPS::end()
+{
+	noInterrupts();
+	TIMSK1	= 0;
+	TCCR1B	= 0;
+	_locked	= false;
+	interrupts();
+
+	digitalWrite(_pin, LOW);
+}
+
+void ES100PPS::onCapture(ES100PPSCaptureHandler handler)
+{
+	noInterrupts();
+	_onCapture = handler;
+	// IRQ- falls on the second; the noise canceller delays the latch by
+	// 4 clocks, half a tick
+	TCCR1B = (TCCR1B & ~_BV(ICES1)) | _BV(ICNC1);
+	TIFR1 = _BV(ICF1);
+	if (handler != NULL)
+		TIMSK1 |= _BV(ICIE1);
+	else
+		TIMSK1 &= ~_BV(ICIE1);
+	interrupts();
+}
+
+uint8_t ES100PPS::sync(uint32_t edgeMicros, uint32_t epoch)
+{
+	uint32_t	now, nowMicros;
+
+	noInterrupts();
+	now			= _ticks();
+	nowMicros	= micros();
+	interrupts();
+
+	// micros() and Timer1 run from the same clock, so the edge converts exactly
+	// up to the 4 us resolution of micros()
+	return _sync(now - (nowMicros - edgeMicros) * ES100_PPS_TICKS_PER_US, epoch, now);
+}
+
+uint8_t ES100PPS::syncSecond(uint32_t edgeMicros, uint8_t second)
+{
+	uint32_t	now, nowMicros;
+
+	noInterrupts();
+	now			= _ticks();
+	nowMicros	= micros();
+	interrupts();
+
+	return _syncSecond(now - (nowMicros - edgeMicros) * ES100_PPS_TICKS_PER_US, second, now);
+}
+
+uint8_t ES100PPS::syncTicks(uint32_t edgeTicks, uint32_t epoch)
+{
+	uint32_t	now;
+
+	noInterrupts();
+	now = _ticks();
+	interrupts();
+
+	return _sync(edgeTicks, epoch, now);
+}
+
+uint8_t ES100PPS::syncSecondTicks(uint32_t edgeTicks, uint8_t second)
+{
+	uint32_t	now;
+
+	noInterrupts();
+	now = _ticks();
+	interrupts();
+
+	return _syncSecond(edgeTicks, second, now);
+}
+
+uint8_t ES100PPS::isLocked()
+{
+	return _locked;
+}
+
+uint32_t ES100PPS::getEpoch()
+{
+	uint32_t	epoch;
+
+	noInterrupts();
+	epoch = _targetEpoch - 1;
+	interrupts();
+
+	return epoch;
+}
+
+uint32_t ES100PPS::getHoldover()
+{
+	return _locked ? getEpoch() - _syncEpoch : 0;
+}
+
+int32_t ES100PPS::getLastError()
+{
+	return _lastError;
+}
+
+uint32_t ES100PPS::getMaxError()
+{
+	return _maxError;
+}
+
+int32_t ES100PPS::getRate()
+{
+	// Ticks / 256 per second to parts per billion
+	return (int64_t)_rate * 1000000000L / ((int64_t)ES100_PPS_TICKS_PER_SECOND * 256);
+}
+
+uint16_t ES100PPS::getSyncs()
+{
+	return _syncs;
+}
@@ -0,0 +1,106 @@
+/*
+1PPS output for the ES100 library
+
+Generates a pulse per second on a GPIO from Timer1, phase-locked to the
+second boundary the ES100 marks with the falling edge of IRQ-. Timer1
+runs free at F_CPU/8 (0.5 us at 16 MHz) and is extended to 32 bits by
+counting overflows. The rising edge of every pulse is scheduled on a
+compare match and written straight to the port from the compare
+interrupt, so the output lags the match by a fixed few us and only
+jitters by the longest interrupt that can be running at the time.
+
+Nothing is output until the first sync(). Each later sync() measures
+where the free-running output has drifted to against the new second
+boundary, which is the holdover error reported by getLastError(). The
+error over the time since the previous sync is the crystal's frequency
+error; it is folded into the length of the second, so holdover between
+syncs improves as more syncs come in. Every sync() then steps the
+output back onto the received second.
+
+The ES100 driver has no notion of the PPS: the sketch calls sync() after
+a full decode with the IRQ edge from ES100Data::irq and the UTC epoch
+second (see ES100Time.h) that edge starts. A tracking reception only
+knows the second within the minute; syncSecond() takes the rest from the
+output's own count, which is right as long as the output is within 30 s.
+
+The micros() of the edge is only as good as the latency of the external
+interrupt, 4 us at best and more whenever interrupts happen to be off.
+With IRQ- on ICP1 (D8) instead, onCapture() has Timer1 latch the edge in
+hardware and hands the 32-bit tick count to a handler that passes it on
+to ES100::captureIRQ(); syncTicks() and syncSecondTicks() then take it
+from ES100IrqEvent::ticks, good to a tick no matter how late the
+interrupt runs, as long as that is within one overflow (32 ms).
+
+Timer1 is taken over completely, analogWrite() on pins 9 and 10 no
+longer works once begin() is called.
+*/
+
+#ifndef ES100PPS_h
+#define ES100PPS_h
+
+#include <Arduino.h>
+
+#define ES100_PPS_TICKS_PER_SECOND	(F_CPU / 8)		// Timer1 ticks, prescaler 8
+#define ES100_PPS_TICKS_PER_US		(ES100_PPS_TICKS_PER_SECOND / 1000000L)
+#define ES100_PPS_PULSE_WIDTH		10000		// us, at most 32767 at 16 MHz
+#define ES100_PPS_MIN_INTERVAL		600			// s between syncs before the rate is adjusted
+#define ES100_PPS_MAX_PPM			10000		// Larger frequency errors are taken as a bad sync
+#define ES100_PPS_NO_ERROR			((int32_t)0x80000000)	// getLastError() before the second sync
+
+typedef void (*ES100PPSCaptureHandler)(uint32_t ticks);
+
+class ES100PPS
+{
+	public:
+		void		begin(uint8_t pin);
+		void		end();
+		uint8_t		sync(uint32_t edgeMicros, uint32_t epoch);
+		uint8_t		syncSecond(uint32_t edgeMicros, uint8_t second);
+		void		onCapture(ES100PPSCaptureHandler handler);
+		uint8_t		syncTicks(uint32_t edgeTicks, uint32_t epoch);
+		uint8_t		syncSecondTicks(uint32_t edgeTicks, uint8_t second);
+		uint8_t		isLocked();
+		uint32_t	getEpoch();
+		uint32_t	getHoldover();
+		int32_t		getLastError();
+		uint32_t	getMaxError();
+		int32_t		getRate();
+		uint16_t	getSyncs();
+
+		int16_t		edgeOffset	= 0;						// us from the true second to the captured IRQ edge
+		uint16_t	pulseWidth	= ES100_PPS_PULSE_WIDTH;	// us
+		uint16_t	minInterval	= ES100_PPS_MIN_INTERVAL;	// s
+
+	private:
+		uint32_t			_ticks();
+		void				_output(uint8_t level);
+		void				_schedule(uint32_t edge, uint32_t epoch, uint32_t now);
+		uint8_t				_sync(uint32_t edge, uint32_t epoch, uint32_t now);
+		uint8_t				_syncSecond(uint32_t edge, uint8_t second, uint32_t now);
+
+		friend void			es100PPSOverflow();
+		friend void			es100PPSRise();
+		friend void			es100PPSFall();
+		friend void			es100PPSCapture();
+
+		uint8_t				_pin;
+		volatile uint8_t	*_port;
+		uint8_t				_mask;
+
+		// Written by the Timer1 interrupts
+		volatile uint16_t	_high = 0;			// Timer1 overflows, the upper half of _ticks()
+		volatile uint32_t	_target;			// Ticks of the next rising edge
+		volatile uint32_t	_targetEpoch;		// Epoch second the next rising edge starts
+		volatile int32_t	_fraction = 0;		// Ticks / 256 carried into the next second
+		volatile uint8_t	_locked = false;
+
+		int32_t				_rate = 0;			// Ticks / 256 added to every second
+		uint8_t				_rated = false;		// _rate was measured at least once
+		uint32_t			_syncEpoch;
+		int32_t				_lastError = ES100_PPS_NO_ERROR;
+		uint32_t			_maxError = 0;
+		uint16_t			_syncs = 0;
+		ES100PPSCaptureHandler	_onCapture = NULL;	// Called from the capture interrupt
+};
+
+#endif
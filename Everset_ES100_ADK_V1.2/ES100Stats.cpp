@@ -0,0 +1,161 @@
+/*
+Reception statistics for the ES100 library, see ES100Stats.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <Arduino.h>
+#include "ES100Stats.h"
+
+/******************************************************************************
+ * User API
+ ******************************************************************************/
+void ES100Stats::reset()
+{
+	uint8_t hour = _hour;
+
+	*this = ES100Stats();
+	_hour = hour;
+}
+
+void ES100Stats::setHour(uint8_t hour)
+{
+	_hour = hour % ES100_STATS_HOURS;
+}
+
+void ES100Stats::recordStart()
+{
+	_rxHour = _hour;
+}
+
+void ES100Stats::recordIRQ(uint8_t irqStatus, uint8_t antenna, uint8_t decoded)
+{
+	uint8_t code;
+
+	switch (irqStatus) {
+		case 0x01:	code = ES100_STATS_IRQ_RX_COMPLETE;		break;
+		case 0x04:	code = ES100_STATS_IRQ_CYCLE_COMPLETE;	break;
+		case 0x00:	code = ES100_STATS_IRQ_NONE;			break;
+		default:	code = ES100_STATS_IRQ_OTHER;			break;
+	}
+	_irqCodes[code]++;
+
+	// Only completed cycles say something about an antenna
+	if (code != ES100_STATS_IRQ_RX_COMPLETE && code != ES100_STATS_IRQ_CYCLE_COMPLETE)
+		return;
+
+	antenna &= 1;
+	_cycles[antenna]++;
+	if (decoded)
+		_antennaDecodes[antenna]++;
+}
+
+void ES100Stats::recordResult(uint8_t ok, unsigned long rxMillis, uint8_t tracking)
+{
+	_receptions++;
+
+	if (_hourReceptions[_rxHour] == 0xFF) {
+		_hourReceptions[_rxHour]	>>= 1;
+		_hourDecodes[_rxHour]		>>= 1;
+	}
+	_hourReceptions[_rxHour]++;
+
+	if (!ok)
+		return;
+
+	_decodes++;
+	_hourDecodes[_rxHour]++;
+
+	// Tracking takes a few seconds by design, it would only skew the histogram
+	if (tracking)
+		return;
+
+	unsigned long	seconds = rxMillis / 1000;
+	uint8_t			bucket = 0;
+
+	while (bucket < ES100_STATS_TTF_BUCKETS - 1 && seconds >= getTimeToFixLow(bucket + 1))
+		bucket++;
+	_timeToFix[bucket]++;
+}
+
+uint16_t ES100Stats::getReceptions()
+{
+	return _receptions;
+}
+
+uint16_t ES100Stats::getDecodes()
+{
+	return _decodes;
+}
+
+uint16_t ES100Stats::getCycles(uint8_t antenna)
+{
+	return _cycles[antenna & 1];
+}
+
+uint16_t ES100Stats::getAntennaDecodes(uint8_t antenna)
+{
+	return _antennaDecodes[antenna & 1];
+}
+
+uint16_t ES100Stats::getTimeToFix(uint8_t bucket)
+{
+	return _timeToFix[bucket];
+}
+
+uint16_t ES100Stats::getTimeToFixLow(uint8_t bucket)
+{
+	// 0, 32, 64, 128 ... 2048 s
+	return bucket == 0 ? 0 : ES100_STATS_TTF_FIRST << (bucket - 1);
+}
+
+uint8_t ES100Stats::getMedianBucket()
+{
+	uint16_t	total = 0;
+	uint16_t	seen = 0;
+	uint8_t		i;
+
+	for (i = 0; i < ES100_STATS_TTF_BUCKETS; i++)
+		total += _timeToFix[i];
+
+	if (total == 0)
+		return 0;
+
+	for (i = 0; i < ES100_STATS_TTF_BUCKETS - 1; i++) {
+		seen += _timeToFix[i];
+		if (seen > 0 && (uint32_t)seen * 2 >= total)
+			break;
+	}
+
+	return i;
+}
+
+uint16_t ES100Stats::getIRQCodes(uint8_t code)
+{
+	return _irqCodes[code];
+}
+
+uint8_t ES100Stats::getHourRate(uint8_t hour)
+{
+	if (_hourReceptions[hour] == 0)
+		return ES100_STATS_NO_RATE;
+
+	return (uint16_t)_hourDecodes[hour] * 100 / _hourReceptions[hour];
+}
+
+uint8_t ES100Stats::getBestHour()
+{
+	uint8_t		best = _hour;
+	uint16_t	bestRate = 0;
+
+	for (uint8_t h = 0; h < ES100_STATS_HOURS; h++) {
+		uint8_t rate = getHourRate(h);
+		if (rate != ES100_STATS_NO_RATE && rate > bestRate) {
+			best		= h;
+			bestRate	= rate;
+		}
+	}
+
+	return best;
+}
@@ -0,0 +1,75 @@
+/*
+Reception statistics for the ES100 library
+
+Collects what is needed to judge an antenna site and pick reception
+times, in a fixed ~90 bytes of RAM:
+- reception cycles and decodes per antenna
+- a histogram of the time from start of reception to a full decode, in
+  power-of-two buckets of seconds
+- how often each IRQ_STATUS code was seen
+- decodes per reception by hour of day, aged by halving an hour's
+  counters before they overflow so recent days weigh more
+
+Attach it with ES100::setStats(), the driver then reports every
+reception started with beginRx() and every IRQ seen by poll(). The
+driver has no clock, so the sketch keeps the hour current with setHour().
+
+The ES100 only reports the antenna of a successful decode. A failed
+cycle is attributed to the antenna the ES100 would have used, from the
+CONTROL0 antenna bits: a single antenna, or alternating every cycle from
+the start antenna.
+*/
+
+#ifndef ES100Stats_h
+#define ES100Stats_h
+
+#include <Arduino.h>
+
+#define ES100_STATS_TTF_BUCKETS		8			// Time to fix buckets, see getTimeToFixLow()
+#define ES100_STATS_TTF_FIRST		32			// s, upper end of the first bucket
+#define ES100_STATS_HOURS			24
+#define ES100_STATS_NO_RATE			0xFF		// getHourRate() for an hour without receptions
+
+// Buckets of the IRQ_STATUS distribution
+#define ES100_STATS_IRQ_RX_COMPLETE		0		// 0x01, a decode
+#define ES100_STATS_IRQ_CYCLE_COMPLETE	1		// 0x04, a cycle without a decode
+#define ES100_STATS_IRQ_NONE			2		// 0x00, IRQ- without a status bit
+#define ES100_STATS_IRQ_OTHER			3		// Anything else
+#define ES100_STATS_IRQ_CODES			4
+
+class ES100Stats
+{
+	public:
+		void		reset();
+		void		setHour(uint8_t hour);
+
+		// Called by the ES100 driver
+		void		recordStart();
+		void		recordIRQ(uint8_t irqStatus, uint8_t antenna, uint8_t decoded);
+		void		recordResult(uint8_t ok, unsigned long rxMillis, uint8_t tracking);
+
+		uint16_t	getReceptions();
+		uint16_t	getDecodes();
+		uint16_t	getCycles(uint8_t antenna);
+		uint16_t	getAntennaDecodes(uint8_t antenna);
+		uint16_t	getTimeToFix(uint8_t bucket);
+		uint16_t	getTimeToFixLow(uint8_t bucket);
+		uint8_t		getMedianBucket();
+		uint16_t	getIRQCodes(uint8_t code);
+		uint8_t		getHourRate(uint8_t hour);
+		uint8_t		getBestHour();
+
+	private:
+		uint16_t	_receptions = 0;
+		uint16_t	_decodes = 0;
+		uint16_t	_cycles[2] = {0, 0};
+		uint16_t	_antennaDecodes[2] = {0, 0};
+		uint16_t	_timeToFix[ES100_STATS_TTF_BUCKETS] = {0};
+		uint16_t	_irqCodes[ES100_STATS_IRQ_CODES] = {0};
+		uint8_t		_hourReceptions[ES100_STATS_HOURS] = {0};
+		uint8_t		_hourDecodes[ES100_STATS_HOURS] = {0};
+		uint8_t		_hour = 0;
+		uint8_t		_rxHour = 0;
+};
+
+#endif
@@ -0,0 +1,227 @@
+/*
+Reception scheduler for the ES100 library, see ES100Sync.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <Arduino.h>
+#include "ES100Sync.h"
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+void ES100Sync::_rollDay(unsigned long now)
+{
+	while (now - _dayStart >= ES100_SYNC_DAY) {
+		_stats.onSecondsLastDay	= _onMillisToday / 1000;
+		_onMillisToday			= 0;
+		_dayStart				+= ES100_SYNC_DAY;
+	}
+}
+
+uint8_t ES100Sync::_urgent(unsigned long now)
+{
+	return !_hasSync || now - _lastSync >= syncDeadline;
+}
+
+uint8_t ES100Sync::_inWindow()
+{
+	uint8_t		better = 0;
+
+	for (uint8_t h = 0; h < 24; h++)
+		if (_hourScore[h] > _hourScore[_hour])
+			better++;
+
+	return better < windowHours;
+}
+
+unsigned long ES100Sync::_backoffDelay(unsigned long now)
+{
+	unsigned long	limit = _urgent(now) ? ES100_SYNC_URGENT_BACKOFF : maxBackoff;
+	unsigned long	delay = retryInterval;
+
+	for (uint8_t i = 1; i < _backoff && delay < limit; i++)
+		delay <<= 1;
+
+	return delay < limit ? delay : limit;
+}
+
+void ES100Sync::_learn(uint8_t ok, unsigned long onMillis)
+{
+	// Decodes per receiver-on minute, as a moving average over 4 receptions.
+	// A tracking reception is on for a fraction of a full decode and only
+	// finds the second boundary: its on-time counts as if scaled up to a
+	// full decode's timeout, and the sample at half the weight.
+	int32_t		sample = 0;
+	uint16_t	&score = _hourScore[_rxHour];
+	uint8_t		tracking = _running == ES100_SYNC_TRACKING;
+
+	if (tracking)
+		onMillis *= ES100_SYNC_FULL_TIMEOUT / ES100_SYNC_TRACKING_TIMEOUT;
+
+	if (ok) {
+		sample = (int32_t)ES100_SYNC_SCORE_ONE * 60000 / (onMillis > 1000 ? onMillis : 1000);
+		if (sample > 0xFFFF)
+			sample = 0xFFFF;
+	}
+
+	score += (sample - (int32_t)score) / (tracking ? 8 : 4);
+}
+
+/******************************************************************************
+ * User API
+ ******************************************************************************/
+uint8_t ES100Sync::next(unsigned long now)
+{
+	if (_running != ES100_SYNC_NONE)
+		return ES100_SYNC_NONE;
+
+	// Too long without a good reception, tracking alone cannot recover
+	if (_hasSync && now - _lastSync >= outageLimit)
+		_nextKind = ES100_SYNC_FULL;
+
+	if ((long)(now - _nextAttempt) < 0)
+		return ES100_SYNC_NONE;
+
+	// Wait for a good hour unless the last sync is too old, or it is the
+	// hour whose turn it is to be tried outside the windows
+	if (!_urgent(now) && !_inWindow()
+			&& (_hour != _exploreHour || now - _lastExplore < exploreInterval))
+		return ES100_SYNC_NONE;
+
+	return _nextKind;
+}
+
+void ES100Sync::started(uint8_t kind, unsigned long now)
+{
+	_rollDay(now);
+
+	_running	= kind;
+	_rxStart	= now;
+	_rxHour		= _hour;
+	_exploring	= !_urgent(now) && !_inWindow();
+
+	if (_exploring) {
+		_lastExplore = now;
+		_exploreHour = (_exploreHour + 1) % 24;
+	}
+
+	if (kind == ES100_SYNC_FULL)
+		_stats.full++;
+	else
+		_stats.tracking++;
+}
+
+void ES100Sync::finished(uint8_t ok, unsigned long now)
+{
+	if (_running == ES100_SYNC_NONE)
+		return;
+
+	_rollDay(now);
+	_onMillisToday += now - _rxStart;
+	_learn(ok, now - _rxStart);
+
+	if (!ok && _exploring) {
+		// Only a try of an hour outside the windows, what was due stays due
+		_running	= ES100_SYNC_NONE;
+		_exploring	= false;
+		return;
+	}
+
+	if (ok) {
+		_backoff		= 0;
+		if (_running == ES100_SYNC_FULL) {
+			_stats.fullOk++;
+			_hasSync = true;
+		} else {
+			_stats.trackingOk++;
+		}
+		_failures		= 0;
+		_lastSync		= now;
+		_nextKind		= ES100_SYNC_TRACKING;
+		_nextAttempt	= now + trackingInterval;
+	} else {
+		if (_backoff < 0xFF)
+			_backoff++;
+
+		if (_running == ES100_SYNC_TRACKING && ++_failures < trackingFailures) {
+			_nextKind	= ES100_SYNC_TRACKING;
+		} else {
+			// A failed full decode, or tracking failed too often in a row
+			_failures	= 0;
+			_nextKind	= ES100_SYNC_FULL;
+		}
+		_nextAttempt	= now + _backoffDelay(now);
+	}
+
+	_running	= ES100_SYNC_NONE;
+	_exploring	= false;
+}
+
+void ES100Sync::restore(unsigned long age, unsigned long now)
+{
+	if (_running != ES100_SYNC_NONE)
+		return;
+
+	_hasSync	= true;
+	_lastSync	= now - age;
+	_backoff	= 0;
+	_failures	= 0;
+
+	if (age >= outageLimit) {
+		_nextKind		= ES100_SYNC_FULL;
+		_nextAttempt	= now;
+	} else {
+		_nextKind		= ES100_SYNC_TRACKING;
+		_nextAttempt	= _lastSync + trackingInterval;
+	}
+}
+
+void ES100Sync::requireFull(unsigned long now)
+{
+	if (_running != ES100_SYNC_NONE)
+		return;
+
+	_hasSync		= false;
+	_failures		= 0;
+	_nextKind		= ES100_SYNC_FULL;
+	_nextAttempt	= now;
+}
+
+unsigned long ES100Sync::rxTimeout(uint8_t kind)
+{
+	return kind == ES100_SYNC_TRACKING ? ES100_SYNC_TRACKING_TIMEOUT : ES100_SYNC_FULL_TIMEOUT;
+}
+
+uint8_t ES100Sync::hasSync()
+{
+	return _hasSync;
+}
+
+unsigned long ES100Sync::sinceSync(unsigned long now)
+{
+	return now - _lastSync;
+}
+
+ES100SyncStats ES100Sync::getStats(unsigned long now)
+{
+	_rollDay(now);
+	_stats.onSecondsToday = (_onMillisToday + (_running != ES100_SYNC_NONE ? now - _rxStart : 0)) / 1000;
+
+	return _stats;
+}
+
+void ES100Sync::setHour(uint8_t hour)
+{
+	_hour = hour % 24;
+
+	// An hour in the windows is tried anyway, its turn to be explored passes
+	if (_hour == _exploreHour && _inWindow())
+		_exploreHour = (_exploreHour + 1) % 24;
+}
+
+uint16_t ES100Sync::getHourScore(uint8_t hour)
+{
+	return _hourScore[hour];
+}
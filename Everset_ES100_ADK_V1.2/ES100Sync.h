@@ -0,0 +1,135 @@
+/*
+Reception scheduler for the ES100 library
+
+Decides when to power the receiver and whether to run a full 1-minute
+frame decode or a short tracking reception. A full decode is run after
+boot, after a long outage and when tracking keeps failing. Otherwise the
+RTC is kept phase-locked with tracking receptions at a fixed interval,
+which keep the receiver on for a fraction of a full decode.
+
+The scheduler does not touch the ES100 itself: the sketch asks next()
+what to start, calls started() when it begins the reception and
+finished() when poll() reaches DONE or TIMEOUT. Receiver on-time is
+accounted per day from those calls.
+
+Receptions are only started in the windowHours hours of the day that
+have paid off best so far. Each hour keeps a score: decodes per minute of
+receiver on-time, as a moving average over the receptions started in it.
+A tracking reception counts at half the weight of a full decode, its
+on-time scaled up by the ratio of their timeouts, so the windows keep
+following the propagation after the first sync, when nearly all
+receptions are tracking ones. Hours without history start with an
+optimistic score, so every hour gets tried. Once per exploreInterval one
+reception that is due may start outside the windows, in the hours taken
+in turn, so an hour that had one bad night is tried again; a failed one
+is not counted as a failure. Failed receptions back off exponentially
+from retryInterval up to maxBackoff.
+Once syncDeadline has passed without a good reception, or before the
+first one, windows are ignored and the backoff is capped at
+ES100_SYNC_URGENT_BACKOFF, which bounds the time between syncs by the
+signal alone. The sketch keeps the local hour current with setHour().
+
+After a reboot, restore() takes up from a good reception age ms before
+now, as kept by the sketch across the power cycle: the next reception is
+a tracking one at the usual interval, or a full decode straight away if
+the outage limit has passed.
+
+When the time a tracking reception keeps in phase is lost, e.g. the RTC
+cannot be read or has stopped, requireFull() drops the sync: the next
+reception is a full decode, started at once and outside the windows, as
+after boot.
+*/
+
+#ifndef ES100Sync_h
+#define ES100Sync_h
+
+#include <Arduino.h>
+
+#define ES100_SYNC_NONE				0			// Nothing to start now
+#define ES100_SYNC_FULL				1			// 1-minute frame decode, sets date and time
+#define ES100_SYNC_TRACKING			2			// Tracking reception, second boundary only
+
+#define ES100_SYNC_TRACKING_INTERVAL	21600000UL	// ms between tracking receptions, 6 hours
+#define ES100_SYNC_RETRY_INTERVAL		900000UL	// ms before retrying a failed reception
+#define ES100_SYNC_OUTAGE_LIMIT			86400000UL	// ms without a good reception before a full decode
+#define ES100_SYNC_FULL_TIMEOUT			300000UL	// ms, rx timeout for a full decode
+#define ES100_SYNC_TRACKING_TIMEOUT		30000UL		// ms, rx timeout for a tracking reception
+#define ES100_SYNC_TRACKING_FAILURES	2			// Failed tracking receptions before falling back
+#define ES100_SYNC_MAX_BACKOFF			14400000UL	// ms, longest wait after repeated failures, 4 hours
+#define ES100_SYNC_URGENT_BACKOFF		3600000UL	// ms, longest wait once the deadline has passed
+#define ES100_SYNC_DEADLINE				129600000UL	// ms without a good reception before windows are ignored, 36 hours
+#define ES100_SYNC_WINDOW_HOURS			6			// Best hours of the day receptions are started in
+#define ES100_SYNC_EXPLORE_INTERVAL		86400000UL	// ms between receptions outside the windows, 1 day
+#define ES100_SYNC_SCORE_ONE			1024		// Hour score of one decode per receiver-on minute
+#define ES100_SYNC_SCORE_PRIOR			256			// Hour score without history
+
+#define ES100_SYNC_DAY					86400000UL
+
+struct ES100SyncStats
+{
+	uint16_t	full;				// Full decodes started
+	uint16_t	fullOk;				// Full decodes that succeeded
+	uint16_t	tracking;			// Tracking receptions started
+	uint16_t	trackingOk;			// Tracking receptions that succeeded
+	uint32_t	onSecondsToday;		// Receiver on-time in the current day
+	uint32_t	onSecondsLastDay;	// Receiver on-time in the previous full day
+};
+
+class ES100Sync
+{
+	public:
+		uint8_t			next(unsigned long now);
+		void			started(uint8_t kind, unsigned long now);
+		void			finished(uint8_t ok, unsigned long now);
+		void			restore(unsigned long age, unsigned long now);
+		void			requireFull(unsigned long now);
+		unsigned long	rxTimeout(uint8_t kind);
+		uint8_t			hasSync();
+		unsigned long	sinceSync(unsigned long now);
+		ES100SyncStats	getStats(unsigned long now);
+		void			setHour(uint8_t hour);
+		uint16_t		getHourScore(uint8_t hour);
+
+		unsigned long	trackingInterval	= ES100_SYNC_TRACKING_INTERVAL;
+		unsigned long	retryInterval		= ES100_SYNC_RETRY_INTERVAL;
+		unsigned long	outageLimit			= ES100_SYNC_OUTAGE_LIMIT;
+		uint8_t			trackingFailures	= ES100_SYNC_TRACKING_FAILURES;
+		unsigned long	maxBackoff			= ES100_SYNC_MAX_BACKOFF;
+		unsigned long	syncDeadline		= ES100_SYNC_DEADLINE;
+		uint8_t			windowHours			= ES100_SYNC_WINDOW_HOURS;
+		unsigned long	exploreInterval		= ES100_SYNC_EXPLORE_INTERVAL;
+
+	private:
+		void			_rollDay(unsigned long now);
+		uint8_t			_urgent(unsigned long now);
+		uint8_t			_inWindow();
+		unsigned long	_backoffDelay(unsigned long now);
+		void			_learn(uint8_t ok, unsigned long onMillis);
+
+		uint8_t			_running = ES100_SYNC_NONE;
+		uint8_t			_hasSync = false;		// A full decode succeeded at least once
+		uint8_t			_failures = 0;			// Consecutive failed tracking receptions
+		unsigned long	_lastSync = 0;			// Last good full or tracking reception
+		unsigned long	_nextAttempt = 0;		// Earliest start of the next reception
+		uint8_t			_nextKind = ES100_SYNC_FULL;
+		unsigned long	_rxStart = 0;
+		unsigned long	_dayStart = 0;
+		uint32_t		_onMillisToday = 0;
+		ES100SyncStats	_stats = {0, 0, 0, 0, 0, 0};
+		uint8_t			_backoff = 0;			// Consecutive failed receptions of any kind
+		uint8_t			_hour = 0;
+		uint8_t			_rxHour = 0;			// Hour the running reception was started in
+		uint8_t			_exploring = false;		// The running reception was started outside the windows
+		uint8_t			_exploreHour = 0;		// Next hour to try outside the windows
+		unsigned long	_lastExplore = 0;
+		uint16_t		_hourScore[24] = {
+			ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR,
+			ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR,
+			ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR,
+			ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR,
+			ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR,
+			ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR, ES100_SYNC_SCORE_PRIOR
+		};
+};
+
+#endif
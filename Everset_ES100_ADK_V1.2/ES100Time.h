@@ -0,0 +1,86 @@
+/*
+Epoch based date arithmetic for the ES100 library
+
+Times are kept as seconds since 2000-01-01T00:00:00, the start of the
+century the ES100 reports two digit years for. The conversions between
+days and civil dates are the days-from-civil / civil-from-days
+algorithms (H. Hinnant) working on a year that starts in March, so leap
+days need no special case and every conversion runs in constant time.
+Times are unsigned 32 bit, which covers 2000 through 2136.
+*/
+
+#ifndef ES100Time_h
+#define ES100Time_h
+
+#include <Arduino.h>
+
+#define ES100_EPOCH_YEAR			2000
+#define ES100_SECS_PER_DAY			86400L
+
+// Days from 0000-03-01 to 2000-01-01 in the proleptic Gregorian calendar
+#define ES100_EPOCH_DAYS			730425L
+
+// Days before the first of each month, counted from March 1st
+constexpr uint16_t es100DaysBeforeMonth[12] = {
+	0, 31, 61, 92, 122, 153, 184, 214, 245, 275, 306, 337
+};
+
+constexpr uint8_t es100MonthFromMarch(uint8_t month)
+{
+	return month > 2 ? month - 3 : month + 9;
+}
+
+constexpr bool es100IsLeapYear(int year)
+{
+	return (year % 4 == 0) && (year % 100 != 0 || year % 400 == 0);
+}
+
+// Days since 2000-01-01 for a civil date, month 1..12, day 1..31
+inline int32_t es100DaysFromCivil(int year, uint8_t month, uint8_t day)
+{
+	int32_t		y	= year - (month <= 2);
+	int32_t		era	= (y >= 0 ? y : y - 399) / 400;
+	int32_t		yoe	= y - era * 400;
+	int32_t		doy	= es100DaysBeforeMonth[es100MonthFromMarch(month)] + day - 1;
+	int32_t		doe	= yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097L + doe - ES100_EPOCH_DAYS;
+}
+
+// Civil date for a number of days since 2000-01-01
+inline void es100CivilFromDays(int32_t days, int *year, uint8_t *month, uint8_t *day)
+{
+	int32_t		z	= days + ES100_EPOCH_DAYS;
+	int32_t		era	= (z >= 0 ? z : z - 146096L) / 146097L;
+	int32_t		doe	= z - era * 146097L;
+	int32_t		yoe	= (doe - doe / 1460 + doe / 36524L - doe / 146096L) / 365;
+	int32_t		doy	= doe - (365 * yoe + yoe / 4 - yoe / 100);
+	uint8_t		mp	= (5 * doy + 2) / 153;
+
+	*day	= doy - es100DaysBeforeMonth[mp] + 1;
+	*month	= mp < 10 ? mp + 3 : mp - 9;
+	*year	= yoe + era * 400 + (*month <= 2);
+}
+
+// Seconds since 2000-01-01T00:00:00 for a civil date and time
+inline uint32_t es100MakeTime(int year, uint8_t month, uint8_t day,
+							 uint8_t hour, uint8_t minute, uint8_t second)
+{
+	return (uint32_t)es100DaysFromCivil(year, month, day) * ES100_SECS_PER_DAY +
+		   hour * 3600L + minute * 60 + second;
+}
+
+// Civil date and time for seconds since 2000-01-01T00:00:00
+inline void es100BreakTime(uint32_t t, int *year, uint8_t *month, uint8_t *day,
+						   uint8_t *hour, uint8_t *minute, uint8_t *second)
+{
+	int32_t		days	= t / ES100_SECS_PER_DAY;
+	int32_t		secs	= t % ES100_SECS_PER_DAY;
+
+	es100CivilFromDays(days, year, month, day);
+	*hour	= secs / 3600;
+	*minute	= (secs / 60) % 60;
+	*second	= secs % 60;
+}
+
+#endif
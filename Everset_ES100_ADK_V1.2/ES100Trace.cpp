@@ -0,0 +1,82 @@
+/*
+Compile-time tracing for the ES100 library, see ES100Trace.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <Arduino.h>
+#include "ES100Trace.h"
+
+#if ES100_TRACE_LEVEL > 0
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+static ES100TraceRecord	traceRing[ES100_TRACE_RING_SIZE];
+static uint8_t			traceHead = 0;		// Next record to write
+static uint8_t			traceCount = 0;		// Valid records in the ring
+static uint16_t			traceLost = 0;		// Records overwritten since the last dump
+
+static void printHex(Print &out, uint8_t value)
+{
+	const char digits[] = "0123456789ABCDEF";
+
+	out.write(digits[value >> 4]);
+	out.write(digits[value & 0x0F]);
+}
+
+/******************************************************************************
+ * User API
+ ******************************************************************************/
+void es100Trace(uint8_t event, uint8_t reg, uint8_t value)
+{
+	ES100TraceRecord *rec = &traceRing[traceHead];
+
+	rec->event	= event;
+	rec->reg	= reg;
+	rec->value	= value;
+	rec->micros	= micros();
+
+	traceHead = (traceHead + 1) % ES100_TRACE_RING_SIZE;
+
+	if (traceCount < ES100_TRACE_RING_SIZE)
+		traceCount++;
+	else
+		traceLost++;
+}
+
+void es100TraceDump(Print &out)
+{
+	// Header: version, record count, lost count (little endian), then the
+	// records oldest first, each as event, reg, value, micros (little endian).
+	uint8_t		index = (traceHead + ES100_TRACE_RING_SIZE - traceCount) % ES100_TRACE_RING_SIZE;
+	uint8_t		i;
+	uint8_t		b;
+
+	out.print(F("ES100TRACE:"));
+	printHex(out, ES100_TRACE_VERSION);
+	printHex(out, traceCount);
+	printHex(out, traceLost & 0xFF);
+	printHex(out, traceLost >> 8);
+
+	for (i = 0; i < traceCount; i++) {
+		const uint8_t *raw = (const uint8_t *)&traceRing[index];
+
+		for (b = 0; b < sizeof(ES100TraceRecord); b++)
+			printHex(out, raw[b]);
+
+		index = (index + 1) % ES100_TRACE_RING_SIZE;
+	}
+
+	out.println();
+	es100TraceClear();
+}
+
+void es100TraceClear()
+{
+	traceCount	= 0;
+	traceLost	= 0;
+}
+
+#endif
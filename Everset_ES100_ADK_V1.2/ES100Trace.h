@@ -0,0 +1,75 @@
+/*
+Compile-time tracing for the ES100 library
+
+ES100_TRACE_LEVEL selects which events are recorded:
+  0  tracing compiled out, ES100_TRACE() expands to nothing
+  1  errors and timeouts
+  2  device state changes and register window reads
+  3  every i2c transaction
+
+Events are stored as 7 byte binary records (event id, register, value,
+micros() timestamp) in a RAM ring of ES100_TRACE_RING_SIZE entries. The
+oldest records are overwritten when the ring is full. es100TraceDump()
+prints the ring as a single hex line prefixed with "ES100TRACE:", which
+extras/es100_trace_decode.cpp turns back into readable events.
+
+Set the level here rather than in the sketch: the Arduino build compiles
+ES100.cpp separately and does not see defines made in the .ino file.
+*/
+
+#ifndef ES100Trace_h
+#define ES100Trace_h
+
+#include <Arduino.h>
+
+#ifndef ES100_TRACE_LEVEL
+#define ES100_TRACE_LEVEL			0
+#endif
+
+#define ES100_TRACE_ERROR			1
+#define ES100_TRACE_INFO			2
+#define ES100_TRACE_I2C				3
+
+#define ES100_TRACE_RING_SIZE		32
+#define ES100_TRACE_VERSION			1
+
+// Event ids, keep in sync with extras/es100_trace_decode.cpp
+#define ES100_EV_BEGIN				0x01		// reg = IRQ pin, value = EN pin
+#define ES100_EV_ENABLE				0x02
+#define ES100_EV_DISABLE			0x03
+#define ES100_EV_START_RX			0x04		// reg = CONTROL0, value = written value
+#define ES100_EV_STOP_RX			0x05
+#define ES100_EV_READ_WINDOW		0x06		// reg = first register, value = IRQ_STATUS
+#define ES100_EV_CACHE_HIT			0x07		// value = IRQ_STATUS of the cached window
+#define ES100_EV_WRITE_REG			0x08		// reg, value
+#define ES100_EV_READ_REG			0x09		// reg, value
+#define ES100_EV_STATE				0x0A		// value = new ES100_STATE_*
+#define ES100_EV_TIMEOUT			0x0B		// value = state that timed out
+#define ES100_EV_DST_SHIFT			0x0C		// value = hour shift, signed
+#define ES100_EV_I2C_WRITE			0x0D		// reg = i2c address, value = bytes written
+#define ES100_EV_I2C_READ			0x0E		// reg = i2c address, value = bytes received
+#define ES100_EV_I2C_ERROR			0x0F		// reg = i2c address, value = I2C_REQ_* status
+
+struct ES100TraceRecord
+{
+	uint8_t		event;
+	uint8_t		reg;
+	uint8_t		value;
+	uint32_t	micros;
+} __attribute__((packed));
+
+#if ES100_TRACE_LEVEL > 0
+void		es100Trace(uint8_t event, uint8_t reg, uint8_t value);
+void		es100TraceDump(Print &out);
+void		es100TraceClear();
+
+#define ES100_TRACE(level, event, reg, value) \
+	do { if ((level) <= ES100_TRACE_LEVEL) es100Trace((event), (reg), (value)); } while (0)
+#else
+#define ES100_TRACE(level, event, reg, value)	do { } while (0)
+
+inline void	es100TraceDump(Print &) { }
+inline void	es100TraceClear() { }
+#endif
+
+#endif
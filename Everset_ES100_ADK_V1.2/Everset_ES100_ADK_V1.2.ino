@@ -10,11 +10,27 @@ Version: 1.2 (09/28/2022)
 
 NEW in 1.2: I2C bus clock speed reduced to 100kHz for better compatibility
 with different RTC chips. The following libraries are required:
-- DS1307RTC by Paul Stoffregen (tested with version 1.4.1)
-- Time by Michael Margolis (tested with version 1.6.1)
 - ES100 by UNIVERSAL-SOLDER (version 1.1 required)
-- LiquidCrystal (Arduino standard)
-- Wire (Arduino standard)
+
+The i2c bus is run by I2CBus from the TWI interrupt, the DS1307 is read
+through DS1307.h in this folder. Wire, DS1307RTC and Time are no longer
+used and must not be linked in, they would take the TWI interrupt.
+
+The display is driven by LCDQueue from a Timer2 interrupt instead of
+LiquidCrystal, so drawing it never holds up the loop.
+
+The outcome of the last receptions is kept in the DS1307's RAM by
+SyncJournal.h. After a reset the sketch picks up from the last good one
+and, while the RTC is fresh, waits for the next tracking reception
+instead of starting a full decode at boot.
+
+The serial port carries binary telemetry records rather than text, see
+Telemetry.h; extras/telemetry decodes them on the host.
+
+With IRQ_CAPTURE set to 1 the ES100 IRQ- goes to D8, the Timer1 input
+capture pin, and the LCD D4 line to D2 instead: swap the two wires. The
+second boundary is then latched by the timer to 0.5us rather than
+timestamped by an interrupt handler, see ES100PPS.h.
 
 PLEASE FEEL FREE TO CONTRIBUTE TO THE DEVELOPMENT. CORRECTIONS AND
 ADDITIONS ARE HIGHLY APPRECIATED. SEND YOUR COMMENTS OR CODE TO:
@@ -48,39 +64,76 @@ POSSIBILITY OF SUCH DAMAGE.
 
 
 // include the library code:
-#include <LiquidCrystal.h>
-#include <DS1307RTC.h>
 #include "ES100.h"
-#include <Wire.h>
+#include "ES100Trace.h"
+#include "ES100Sync.h"
+#include "ES100Stats.h"
+#include "ES100Antenna.h"
+#include "ES100PPS.h"
+#include "I2CBus.h"
+#include "DS1307.h"
+#include "SyncJournal.h"
+#include "Telemetry.h"
+#include "LCDFrame.h"
 
 
+// 1: IRQ- on D8 (ICP1) and LCD D4 on D2, 0: the other way round
+#define IRQ_CAPTURE 0
+
 #define lcdRS 4
 #define lcdEN 5
+#if IRQ_CAPTURE
+#define lcdD4 2
+#else
 #define lcdD4 8
+#endif
 #define lcdD5 9
 #define lcdD6 10
 #define lcdD7 11
-LiquidCrystal lcd(lcdRS, lcdEN, lcdD4, lcdD5, lcdD6, lcdD7);
+LCDQueue lcdPanel(lcdRS, lcdEN, lcdD4, lcdD5, lcdD6, lcdD7);
+
+// The display code draws into lcd, showlcd() sends the cells that changed
+LCDFrame lcd;
+unsigned long lcdMicros = 0;      // spent in showlcd(), for the 'L' report
+unsigned long lcdStatsMillis = 0; // start of the 'L' report period
 
 
+#if IRQ_CAPTURE
+#define es100Int 8                // ICP1, the edge is latched by Timer1
+#else
 #define es100Int 2
+#endif
 #define es100En 13
+#define ppsOut 7                  // 1PPS output for other equipment, from Timer1
+#define rtcSqw 3                  // DS1307 SQW/OUT (open drain), for the RTC phase check
 
 ES100 es100;
+ES100Sync sync;                   // decides between full decodes and tracking receptions
+ES100Stats rxStats;               // reception statistics, shown on the rotating LCD lines
+ES100Antenna antenna;             // picks single or alternating antenna reception from past results
+ES100PPS pps;                     // pulse per second on ppsOut, locked to the WWVB second
+
+// The DS1307 shares the bus with the ES100 and is limited to 100kHz.
+DS1307 rtc;
+SyncJournal journal;              // last receptions, in the DS1307 RAM
+Telemetry telemetry;              // binary records on the serial port
+
+// Ages that do not fit lastSyncMillis are shown as this, 46 days
+#define JOURNAL_MAX_AGE 4000000UL
 
 uint8_t     lp = 0;
 
 unsigned long lastMillis = 0;
-volatile unsigned long atomicMillis = 0;
 unsigned long lastSyncMillis = 0;
 
-volatile unsigned int interruptCnt = 0;
+unsigned int interruptCnt = 0;
 unsigned int lastinterruptCnt = 0;
+uint16_t rxStartIrq = 0;          // es100.getIRQCount() when the reception was started
 
 
 boolean receiving = false;        // variable to determine if we are in receiving mode
-boolean trigger = true;           // variable to trigger the reception
-boolean continous = false;        // variable to tell the system to continously receive atomic time, if not it will happen every night at midnight
+uint8_t rxKind = ES100_SYNC_NONE; // ES100_SYNC_FULL or ES100_SYNC_TRACKING while receiving
+boolean continous = false;        // variable to tell the system to continously receive atomic time, if not the ES100Sync schedule is used
 boolean validdecode = false;      // variable to rapidly know if the system had a valid decode done lately
 
 
@@ -88,21 +141,41 @@ ES100DateTime d;
 ES100Status0  status0;
 ES100NextDst  nextDst;
 
+// The RTC keeps local time. The DST change and a leap second are applied to
+// it at their UTC instants from the last full decode, with or without
+// reception on the day.
+ES100Transitions transitions;
+int32_t rtcOffset = 0;            // local - UTC the RTC runs at
+boolean rtcZoneKnown = false;     // rtcOffset and transitions are from a full decode
+uint32_t decodeUtc = 0;           // UTC of the full decode status0 and nextDst are from
+
+// Phase check: the DS1307 SQW output falls as its seconds increment. After
+// each sync the first few edges are timed against the WWVB second the RTC
+// was set from.
+#define PHASE_REPORTS 3
+boolean phaseCheck = true;        // report the RTC phase error on the serial port
+volatile unsigned long sqwMicros = 0;
+volatile uint8_t sqwEdges = 0;
+uint8_t lastSqwEdges = 0;
+unsigned long phaseRef = 0;       // micros() at the WWVB second the RTC was set from
+uint8_t phaseReports = 0;         // edges still to report after the last sync
 
 
-void atomic() {
-  // Called procedure when we receive an interrupt from the ES100
-  // Got a interrupt and store the currect millis for future use if we have a valid decode
-  atomicMillis = millis();
-  interruptCnt++;
-}
 
 char * getISODateStr() {
   static char result[19];
 
-  tmElements_t t;
-  RTC.read(t);                                                                         //TODO:
+  // Show the time read on the last refresh and queue the next read, the
+  // LCD never waits for the bus
+  DS1307Time t;
+  rtc.get(&t);
+  rtc.refresh();
   
+  // The RTC keeps local time, which is what the per-hour statistics and
+  // the reception windows want
+  rxStats.setHour(t.Hour);
+  sync.setHour(t.Hour);
+
 
   result[0]=char(((t.Year + 1970) / 1000)+48);
   result[1]=char((((t.Year + 1970) % 1000) / 100)+48);
@@ -147,6 +220,241 @@ char * getISODateStr() {
   return result;
 }
 
+void sendRtc(uint8_t event, int32_t value) {
+  TMRtc r;
+
+  r.event = event;
+  r.value = value;
+  telemetry.send(TM_RTC, TM_RTC_V, &r, sizeof(r));
+}
+
+// End of a reception, status is that of the reception itself
+void sendRx(uint8_t state, ES100Status0 status, uint32_t utc, int8_t correction) {
+  ES100PhaseTimes phase = es100.getPhaseTimes();
+  TMES100Rx r;
+
+  r.utc = utc;
+  r.offset = rtcOffset;
+  r.kind = rxKind;
+  r.state = state;
+  r.timedOutIn = phase.timedOutIn;
+  r.status0 = status.rxOk | status.antenna << 1 | status.leapSecond << 3 |
+              status.dstState << 5 | status.tracking << 7;
+  r.nextDstMonth = nextDst.month;
+  r.nextDstDay = nextDst.day;
+  r.nextDstHour = nextDst.hour;
+  r.correction = correction;
+  r.enableMs = phase.enable;
+  r.readyMs = phase.ready;
+  r.rxMs = phase.rx;
+  r.readUs = phase.read;
+  r.irqs = phase.irqCount;
+  telemetry.send(TM_ES100_RX, TM_ES100_RX_V, &r, sizeof(r));
+}
+
+// Bus, scheduler and PPS counters after a reception
+void sendRxStats() {
+  ES100BusStats bus = es100.getBusStats();
+  I2CBusStats i2cStats = I2C.getStats();
+  ES100SyncStats syncStats = sync.getStats(millis());
+  TMES100Bus b;
+  TMSync s;
+  TMPps p;
+
+  b.transactions = bus.transactions;
+  b.bytes = bus.bytes;
+  b.snapshotReads = bus.snapshotReads;
+  b.cacheHits = bus.cacheHits;
+  b.busMicros = bus.busMicros;
+  b.errors = bus.errors;
+  b.rtcBusMicros = rtc.device.busMicros;
+  b.rtcRequests = rtc.device.requests;
+  b.rtcErrors = rtc.device.errors;
+  b.clockChanges = I2C.getClockChanges();
+  b.maxDepth = i2cStats.maxDepth;
+  b.maxLatency = i2cStats.maxLatency;
+  b.failed = i2cStats.failed;
+  b.retries = i2cStats.retries;
+  b.nacks = i2cStats.nacks;
+  b.busErrors = i2cStats.errors;
+  b.timeouts = i2cStats.timeouts;
+  b.recoveries = i2cStats.recoveries;
+  telemetry.send(TM_ES100_BUS, TM_ES100_BUS_V, &b, sizeof(b));
+
+  s.full = syncStats.full;
+  s.fullOk = syncStats.fullOk;
+  s.tracking = syncStats.tracking;
+  s.trackingOk = syncStats.trackingOk;
+  s.onSecondsToday = syncStats.onSecondsToday;
+  s.onSecondsLastDay = syncStats.onSecondsLastDay;
+  telemetry.send(TM_SYNC, TM_SYNC_V, &s, sizeof(s));
+
+  p.locked = pps.isLocked();
+  p.lastError = pps.getLastError();
+  p.maxError = pps.getMaxError();
+  p.rate = pps.getRate();
+  p.holdover = pps.getHoldover();
+  telemetry.send(TM_PPS, TM_PPS_V, &p, sizeof(p));
+}
+
+void sqwEdge() {
+  sqwMicros = micros();
+  sqwEdges++;
+}
+
+// The PPS takes the edge as latched by Timer1 if it was, else as micros()
+boolean ppsSync(ES100IrqEvent irq, uint32_t utc) {
+  if (irq.captured)
+    return pps.syncTicks(irq.ticks, utc);
+  return pps.sync(irq.micros, utc);
+}
+
+boolean ppsSyncSecond(ES100IrqEvent irq, uint8_t second) {
+  if (irq.captured)
+    return pps.syncSecondTicks(irq.ticks, second);
+  return pps.syncSecond(irq.micros, second);
+}
+
+#if IRQ_CAPTURE
+void irqCaptured(uint32_t ticks) {
+  es100.captureIRQ(ticks);
+}
+#endif
+
+// Sets the RTC to t, the local time at the WWVB second boundary irqMicros,
+// so that its seconds roll over with the WWVB seconds
+void syncRTC(DS1307Time *t, unsigned long irqMicros) {
+  if (!rtc.writeAt(t, irqMicros)) {
+    sendRtc(TM_RTC_WRITE_FAILED, 0);
+    return;
+  }
+
+  phaseRef = irqMicros;
+  lastSqwEdges = sqwEdges;
+  phaseReports = phaseCheck ? PHASE_REPORTS : 0;
+}
+
+void reportPhase() {
+  unsigned long at;
+  uint8_t edges;
+  long error;
+
+  if (phaseReports == 0)
+    return;
+
+  noInterrupts();
+  at = sqwMicros;
+  edges = sqwEdges;
+  interrupts();
+
+  if (edges == lastSqwEdges)
+    return;
+  lastSqwEdges = edges;
+  phaseReports--;
+
+  error = (at - phaseRef) % 1000000UL;
+  if (error >= 500000)
+    error -= 1000000;
+
+  sendRtc(TM_RTC_PHASE, error);
+}
+
+void journalEntry(SyncJournalEntry *e, uint32_t utc, boolean ok, boolean tracking) {
+  e->utc = utc;
+  e->decodeUtc = decodeUtc;
+  e->status = status0;
+  e->status.rxOk = ok;
+  e->status.tracking = tracking;
+  e->zoneKnown = rtcZoneKnown;
+  e->offset = rtcOffset;
+  e->nextDst = nextDst;
+}
+
+// The RTC was stepped: a restore must not apply the step again
+void journalStep() {
+  SyncJournalEntry e;
+
+  if (!journal.getLast(&e))
+    return;
+
+  journalEntry(&e, e.utc, true, e.status.tracking);
+  journal.update(&e);
+}
+
+// Takes up from the last good reception in the journal, if the RTC kept
+// running since. Returns true if there was one.
+boolean restoreSync() {
+  SyncJournalEntry e;
+  DS1307Time t;
+  uint32_t utc;
+  unsigned long age;
+
+  if (!journal.getLast(&e) || !rtc.read(&t))
+    return false;
+
+  utc = es100MakeTime(t.Year + 1970, t.Month, t.Day, t.Hour, t.Minute, t.Second) - e.offset;
+  if (utc < e.utc)
+    return false;
+
+  age = utc - e.utc;
+  if (age > JOURNAL_MAX_AGE)
+    age = JOURNAL_MAX_AGE;
+
+  lastSyncMillis = millis() - age * 1000;
+  sync.restore(age * 1000, millis());
+
+  if (e.zoneKnown) {
+    validdecode = true;
+    status0 = e.status;
+    nextDst = e.nextDst;
+    decodeUtc = e.decodeUtc;
+    rtcOffset = e.offset;
+    rtcZoneKnown = true;
+    transitions = es100.restoreTransitions(e.decodeUtc, e.status, e.nextDst);
+  }
+
+  sendRtc(TM_RTC_RESTORED, age);
+  return true;
+}
+
+void applyTransitions() {
+  DS1307Time t;
+  uint32_t utc;
+  int32_t offset;
+  int32_t step;
+  int year;
+
+  if (!rtcZoneKnown || !rtc.get(&t))
+    return;
+
+  utc = es100MakeTime(t.Year + 1970, t.Month, t.Day, t.Hour, t.Minute, t.Second) - rtcOffset;
+  offset = es100.getLocalOffsetAt(utc);
+  step = offset - rtcOffset;
+
+  // The RTC knows nothing of leap seconds: after 23:59:60 it shows midnight a
+  // second early, and it reaches 23:59:59 when a dropped one should be midnight
+  if (transitions.leap != 0 && utc + (transitions.leap < 0) >= transitions.leapAt) {
+    step -= transitions.leap;
+    transitions.leap = 0;
+    status0.leapSecond = 0;
+  }
+
+  if (step == 0)
+    return;
+
+  es100BreakTime(utc + rtcOffset + step, &year, &t.Month, &t.Day, &t.Hour, &t.Minute, &t.Second);
+  t.Year = year - 1970;
+
+  // A DST step leaves the seconds alone and the RTC in phase with WWVB, a
+  // leap second restarts its second here until the next sync
+  if (step % 60 == 0 ? rtc.adjust(&t) : rtc.write(&t)) {
+    rtcOffset = offset;
+    journalStep();
+  }
+
+  sendRtc(TM_RTC_STEP, step);
+}
+
 void displayDST() {
   lcd.print("DST ");
   switch (status0.dstState) {
@@ -264,102 +572,126 @@ void displayAntenna() {
       lcd.print("2");
       break;
   }
+  if (antenna.getPreferred() != ES100_ANTENNA_NONE) {
+    lcd.print(" pref ");
+    lcd.print(antenna.getPreferred() + 1);
+  }
+}
+
+void displayRxRate() {
+  lcd.print("Decodes ");
+  lcd.print(rxStats.getDecodes());
+  lcd.print("/");
+  lcd.print(rxStats.getReceptions());
+}
+
+void displayRxAntenna() {
+  for (uint8_t a = 0; a < 2; a++) {
+    lcd.print(a == 0 ? "Ant1 " : " Ant2 ");
+    lcd.print(rxStats.getAntennaDecodes(a));
+    lcd.print("/");
+    lcd.print(rxStats.getCycles(a));
+  }
+}
+
+void displayTimeToFix() {
+  uint8_t bucket = rxStats.getMedianBucket();
+  uint8_t hour = rxStats.getBestHour();
+
+  lcd.print("Fix ");
+  if (bucket < ES100_STATS_TTF_BUCKETS - 1) {
+    lcd.print("<");
+    lcd.print(rxStats.getTimeToFixLow(bucket + 1));
+  } else {
+    lcd.print(">");
+    lcd.print(rxStats.getTimeToFixLow(bucket));
+  }
+  lcd.print("s best ");
+  if (hour < 10) { lcd.print("0"); }
+  lcd.print(hour);
+  lcd.print("h");
 }
 
-void clearLine(unsigned int n) {
-  while (n-- > 0)
-    lcd.print(" ");
+void displayPPS() {
+  lcd.print("PPS ");
+  if (!pps.isLocked()) {
+    lcd.print("not locked");
+    return;
+  }
+  if (pps.getLastError() != ES100_PPS_NO_ERROR) {
+    lcd.print(pps.getLastError());
+    lcd.print("us ");
+  }
+  lcd.print("hold ");
+  lcd.print(pps.getHoldover() / 60);
+  lcd.print("m");
+}
+
+#define STATUS_LINES 10
+
+void displayStatusLine(uint8_t line) {
+  switch (line) {
+    case 0:
+      displayInterrupt();
+      break;
+    case 1:
+      displayLastSync();
+      break;
+    case 2:
+      displayDST();
+      break;
+    case 3:
+      displayNDST();
+      break;
+    case 4:
+      displayLeapSecond();
+      break;
+    case 5:
+      displayAntenna();
+      break;
+    case 6:
+      displayRxRate();
+      break;
+    case 7:
+      displayRxAntenna();
+      break;
+    case 8:
+      displayTimeToFix();
+      break;
+    case 9:
+      displayPPS();
+      break;
+  }
 }
 
 void showlcd() {
+  unsigned long start = micros();
+
   lcd.setCursor(0,0);
   lcd.print(getISODateStr());
 
   if (validdecode) {
-    // Scroll lines every 2 seconds.
-    int lcdLine = (millis() / 2000 % 6) + 1;
+    // Scroll lines every 2 seconds, rows 1 to 3 show consecutive status lines.
+    uint8_t lcdLine = millis() / 2000 % STATUS_LINES;
 
-    lcd.setCursor(0,1);
-    clearLine(20);
-    lcd.setCursor(0,1);
-    switch (lcdLine) {
-      case 1:
-        displayInterrupt();
-        break;
-      case 2:
-        displayLastSync();
-        break;
-      case 3:
-        displayDST();
-        break;
-      case 4:
-        displayNDST();
-        break;
-      case 5:
-        displayLeapSecond();
-        break;
-      case 6:
-        displayAntenna();
-        break;
-    }
-
-    lcd.setCursor(0,2);
-    clearLine(20);
-    lcd.setCursor(0,2);
-    switch (lcdLine) {
-      case 6:
-        displayInterrupt();
-        break;
-      case 1:
-        displayLastSync();
-        break;
-      case 2:
-        displayDST();
-        break;
-      case 3:
-        displayNDST();
-        break;
-      case 4:
-        displayLeapSecond();
-        break;
-      case 5:
-        displayAntenna();
-        break;
-    }
-
-    lcd.setCursor(0,3);
-    clearLine(20);
-    lcd.setCursor(0,3);
-    switch (lcdLine) {
-      case 5:
-        displayInterrupt();
-        break;
-      case 6:
-        displayLastSync();
-        break;
-      case 1:
-        displayDST();
-        break;
-      case 2:
-        displayNDST();
-        break;
-      case 3:
-        displayLeapSecond();
-        break;
-      case 4:
-        displayAntenna();
-        break;
+    for (uint8_t row = 1; row < 4; row++) {
+      lcd.setCursor(0,row);
+      displayStatusLine((lcdLine + row - 1) % STATUS_LINES);
+      lcd.clearToEnd();
     }
   }
   else {
     lcd.setCursor(0,1);
     displayInterrupt();
+    lcd.clearToEnd();
     lcd.setCursor(0,2);
-    clearLine(20);
+    lcd.clearToEnd();
     lcd.setCursor(0,3);
-    clearLine(20);
-
+    lcd.clearToEnd();
   }
+  lcd.flush();
+
+  lcdMicros += micros() - start;
   // ToDo:
   //   Show rolling status of the following informations :
   //   Interrupt Count xxxx  /* Where x = 0 to 9999 */
@@ -368,15 +700,52 @@ void showlcd() {
   //   NDST xxxxxxxxxxxxxxx  /* Next DST : Where x = 2019-11-03T2h00 */
   //   xxxxxxxxxxxxxxxxxxxx  /* Leap Second : Where x = No LS this month / Neg. LS this month / Pos. LS this month */
   //   Antenna used x    /* Antenna Used for reception where x = 1 or 2 */
+  //   Decodes x/y       /* Valid decodes / receptions */
+  //   Ant1 x/y Ant2 x/y /* Decodes / reception cycles per antenna */
+  //   Fix <xs best xxh  /* Median time to fix and the hour with the best decode rate */
+  //   PPS xus hold xm   /* Holdover error found at the last sync and time since it */
+
+}
 
+void reportLCD() {
+  LCDFrameStats stats = lcd.getStats();
+  LCDQueueStats queue = lcdPanel.getStats();
+  unsigned long seconds = (millis() - lcdStatsMillis) / 1000;
+
+  if (seconds == 0)
+    return;
+
+  TMLcd r;
+
+  r.fullRedraw = lcd.fullRedraw;
+  r.seconds = seconds;
+  r.bytes = stats.bytes;
+  r.moves = stats.moves;
+  r.cpuMicros = lcdMicros;
+  r.flushMicros = stats.micros;
+  r.maxDepth = queue.maxDepth;
+  r.overflows = queue.overflows;
+  r.deferred = stats.deferred;
+  telemetry.send(TM_LCD, TM_LCD_V, &r, sizeof(r));
+
+  lcd.resetStats();
+  lcdPanel.resetStats();
+  lcdMicros = 0;
+  lcdStatsMillis = millis();
 }
 
 void setup() {
-  Wire.begin();
+  I2C.begin(I2C_DEFAULT_CLOCK);
   Serial.begin(9600);
+  telemetry.begin(&Serial);
   es100.begin(es100Int, es100En);
-  lcd.begin(20, 4);
-  lcd.clear();
+  es100.setStats(&rxStats);
+  pps.begin(ppsOut);
+#if IRQ_CAPTURE
+  pps.onCapture(irqCaptured);
+#endif
+  lcdPanel.begin(20, 4);
+  lcd.begin(&lcdPanel);
 
   /*  Time zone and DST setting:
    *  The value for es100.timezone can be positive or negative
@@ -390,91 +759,181 @@ void setup() {
   es100.timezone = -5;
   es100.DSTenabled = true;
 
-  
-  attachInterrupt(digitalPinToInterrupt(es100Int), atomic, FALLING);
+  // After the time zone, the transitions are worked out for it
+  journal.begin(&rtc);
+  TMBoot boot = { TM_SKETCH_ES100_ADK, restoreSync() };
+  telemetry.send(TM_BOOT, TM_BOOT_V, &boot, sizeof(boot));
+
+  if (phaseCheck) {
+    rtc.setSQW(DS1307_SQW_1HZ);
+    pinMode(rtcSqw, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(rtcSqw), sqwEdge, DS1307_SQW_EDGE);
+  }
+
+  // es100.begin() attaches the IRQ handler that timestamps each second
+  // boundary, or with IRQ_CAPTURE the PPS hands it the captured edge; no
+  // interrupt needs to be attached here.
 }
 
 void loop() {
   
-  tmElements_t tm;
+  DS1307Time tm;
   
-  if (!receiving && trigger) {
-    interruptCnt = 0;
-    
-    es100.enable();
-    es100.startRx();
+  if (!receiving) {
+    rxKind = continous ? ES100_SYNC_FULL : sync.next(millis());
+  }
+
+  if (!receiving && rxKind != ES100_SYNC_NONE) {
+    // Power-up and reception run in es100.poll(), so the LCD keeps
+    // refreshing while the ES100 is enabled and receiving.
+    es100.resetBusStats();
+    es100.rxTimeout = sync.rxTimeout(rxKind);
+    es100.antennaMode = antenna.next(rxKind == ES100_SYNC_TRACKING);
+    es100.beginRx(millis(), rxKind == ES100_SYNC_TRACKING);
+    sync.started(rxKind, millis());
     
     receiving = true;
-    trigger = false;
-
-    /* Important to set the interrupt counter AFTER the startRx because the es100 
-     * confirm that the rx has started by triggering the interrupt. 
-     * We can't disable interrupts because the wire library will stop working
-     * so we initialize the counters after we start so we can ignore the first false 
-     * trigger
-     */
+
+    rxStartIrq = es100.getIRQCount();
     lastinterruptCnt = 0;
     interruptCnt = 0;
   }
 
-
+  interruptCnt = es100.getIRQCount() - rxStartIrq;
   if (lastinterruptCnt < interruptCnt) {
-    Serial.print("ES100 Interrupt received... ");
-  
-    if (es100.getIRQStatus() == 0x01 && es100.getRxOk() == 0x01) {
-      validdecode = true;
-      Serial.println("Valid decode");
-      // Update lastSyncMillis for lcd display
-      lastSyncMillis = millis();
-      // We received a valid decode
-      d = es100.getDateTime();
-      // Updating the RTC
-      tm.Day = d.day;
-      tm.Month = d.month;
-      tm.Year = (30 + d.year);
-      
-      tm.Hour = d.hour;
-      tm.Minute = d.minute;
-      tm.Second = d.second + ((millis() - atomicMillis)/1000);
-      
-      RTC.write(tm);                                                                         //TODO:
-
-      // Get everything before disabling the chip.
-      status0 = es100.getStatus0();
-      nextDst = es100.getNextDst();
-  
-/* DEBUG */
-      Serial.print("status0.rxOk = B");
-      Serial.println(status0.rxOk, BIN);
-      Serial.print("status0.antenna = B");
-      Serial.println(status0.antenna, BIN);
-      Serial.print("status0.leapSecond = B");
-      Serial.println(status0.leapSecond, BIN);
-      Serial.print("status0.dstState = B");
-      Serial.println(status0.dstState, BIN);
-      Serial.print("status0.tracking = B");
-      Serial.println(status0.tracking, BIN);
-/* END DENUG */
-  
-      if (!continous) {
-        es100.stopRx();
-        es100.disable();
+    TMES100Irq irq = { (uint16_t)interruptCnt };
+    telemetry.send(TM_ES100_IRQ, TM_ES100_IRQ_V, &irq, sizeof(irq));
+    lastinterruptCnt = interruptCnt;
+  }
+
+  if (receiving) {
+    switch (es100.poll(millis())) {
+      case ES100_STATE_DONE: {
+        ES100Data data = es100.getData();
+
+        // Update lastSyncMillis for lcd display
+        lastSyncMillis = millis();
+        sync.finished(true, millis());
+        antenna.finished(true, data.status.antenna);
+
+        if (rxKind == ES100_SYNC_TRACKING && !rtc.read(&tm)) {
+          // The RTC could not be read or has stopped, so there is no date to
+          // pull onto the second: leave the RTC, PPS and journal alone and
+          // get the whole time from a full decode.
+          sync.requireFull(millis());
+          sendRx(ES100_STATE_DONE, data.status, 0, 0);
+        } else if (rxKind == ES100_SYNC_TRACKING) {
+          // A tracking reception only carries the second boundary: keep the
+          // RTC date and time and pull its seconds onto the WWVB second.
+          int year;
+          int delta;
+          uint32_t atIrq;
+
+          // The RTC time at the IRQ, give or take the second that is fixed here
+          atIrq = es100MakeTime(tm.Year + 1970, tm.Month, tm.Day, tm.Hour, tm.Minute, tm.Second) -
+                  (micros() - data.irq.micros) / 1000000;
+          delta = ((int)data.dateTime.second - (int)(atIrq % 60) + 90) % 60 - 30;
+
+          es100BreakTime(atIrq + delta, &year, &tm.Month, &tm.Day, &tm.Hour, &tm.Minute, &tm.Second);
+          tm.Year = year - 1970;
+
+          syncRTC(&tm, data.irq.micros);
+
+          // After a restore the PPS has not been locked by a full decode yet
+          if (!ppsSyncSecond(data.irq, data.dateTime.second) && rtcZoneKnown)
+            ppsSync(data.irq, atIrq + delta - rtcOffset);
+
+          SyncJournalEntry e;
+          journalEntry(&e, atIrq + delta - rtcOffset, true, true);
+          journal.append(&e);
+
+          sendRx(ES100_STATE_DONE, data.status, rtcZoneKnown ? atIrq + delta - rtcOffset : 0, delta);
+        } else {
+          validdecode = true;
+          // We received a valid decode
+          d = data.dateTime;
+          // Updating the RTC
+          tm.Day = d.day;
+          tm.Month = d.month;
+          tm.Year = (30 + d.year);
+          
+          tm.Hour = d.hour;
+          tm.Minute = d.minute;
+          tm.Second = d.second;
+          
+          syncRTC(&tm, data.irq.micros);
+
+          // The register window stays cached after poll() disabled the chip.
+          status0 = data.status;
+          nextDst = data.nextDST;
+          transitions = es100.getTransitions();
+          rtcOffset = es100.getLocalOffset();
+          rtcZoneKnown = true;
+          decodeUtc = es100MakeTime(ES100_EPOCH_YEAR + d.year, d.month, d.day, d.hour, d.minute, d.second) - rtcOffset;
+
+          // The PPS counts UTC seconds, so a DST change does not look like drift
+          ppsSync(data.irq, decodeUtc);
+
+          SyncJournalEntry e;
+          journalEntry(&e, decodeUtc, true, false);
+          journal.append(&e);
+
+          sendRx(ES100_STATE_DONE, data.status, decodeUtc, 0);
+        }
+
+        sendRxStats();
+
+        receiving = false;
+        break;
+      }
+
+      case ES100_STATE_TIMEOUT: {
+        ES100Status0 none = {};
+
+        sync.finished(false, millis());
+        antenna.finished(false, 0);
         receiving = false;
+
+        if (rtc.get(&tm)) {
+          SyncJournalEntry e;
+          journalEntry(&e, es100MakeTime(tm.Year + 1970, tm.Month, tm.Day, tm.Hour, tm.Minute, tm.Second) - rtcOffset,
+                       false, rxKind == ES100_SYNC_TRACKING);
+          journal.append(&e);
+        }
+
+        sendRx(ES100_STATE_TIMEOUT, none, 0, 0);
+        sendRxStats();
+        break;
       }
     }
-    else {
-      Serial.println("Invalid decode");
+  }
+ 
+  // Send 'T' over the serial port to dump the ES100 trace ring, see
+  // ES100Trace.h for the trace level and extras/es100_trace_decode.cpp.
+  // 'L' reports the LCD cost since the last report, 'F' switches between
+  // sending changed cells only and rewriting the whole display.
+  if (Serial.available()) {
+    switch (Serial.read()) {
+      case 'T':
+        telemetry.beginText();
+        es100TraceDump(Serial);
+        telemetry.endText();
+        break;
+      case 'L':
+        reportLCD();
+        break;
+      case 'F':
+        lcd.fullRedraw = !lcd.fullRedraw;
+        break;
     }
-    lastinterruptCnt = interruptCnt;
   }
  
+  reportPhase();
+  telemetry.poll();
+
   if (lastMillis + 100 < millis()) {
+    applyTransitions();
     showlcd();
-
-    // set the trigger to start reception at midnight (UTC-4) if we are not in continous mode.
-    // 4am UTC is midnight for me, adjust to your need
-    trigger = (!continous && !receiving && tm.Hour == 4 && tm.Minute == 0); 
-    
     lastMillis = millis();
   }
 }
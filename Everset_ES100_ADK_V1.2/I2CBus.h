@@ -0,0 +1,152 @@
+/*
+Queued, interrupt-driven I2C master for the ES100 ADK
+
+Drivers describe each bus transaction with an I2CRequest: an optional
+write (usually the register address) followed by an optional read after
+a repeated start. submit() queues the request and returns at once; the
+TWI interrupt runs the queue one bus event at a time, so the CPU never
+waits on the bus. Completion is seen through the request's status, or a
+done callback that runs from the interrupt. transfer() submits and waits,
+for the few calls whose callers need the data before they can go on.
+
+Every device declares the highest SCL frequency it supports. The clock
+is set per request, only when it differs from the previous one, and the
+time each request occupies the bus is accumulated per device.
+
+Devices behind a TCA9548A style mux name the mux and their channel; the
+bus switches the mux only when a different channel is needed, so several
+parts with the same address can share one bus.
+
+A request that is NACKed or hits a bus error is retried up to retries
+times before it fails. Nothing in the TWI hardware times out, so poll()
+watches the request on the bus: one that has not finished in timeout us
+is taken as a stuck bus, usually a target holding SDA low after a reset
+or glitch in the middle of a byte. The bus is then recovered by clocking
+SCL by hand until SDA is released, nine clocks at most, and sending a
+STOP, and the request is retried. Only the TWI interrupt is held off
+while that takes its 100 us or so. A failed request is never half done
+as far as the caller can see: reads complete with every byte asked for
+or end with an error status.
+
+The TWI interrupt vector is taken, so the Wire library cannot be linked
+into the same sketch. Queue depth, the worst submit-to-completion
+latency and every kind of error are counted for tuning.
+*/
+
+#ifndef I2CBus_h
+#define I2CBus_h
+
+#include <Arduino.h>
+
+#define I2C_DEFAULT_CLOCK			100000		// Hz, Wire library default
+#define I2C_MUX_ADDR				0x70		// TCA9548A with A0-A2 low
+#define I2C_MUX_NONE				0xFF		// No channel selected, or not known
+#define I2C_RETRIES					2			// Attempts after the first one
+#define I2C_TIMEOUT					20000		// us an attempt may hold the bus
+#define I2C_RECOVERY_CLOCKS			9			// SCL pulses to free a stuck SDA
+
+// I2CRequest::status
+#define I2C_REQ_IDLE				0			// Never submitted
+#define I2C_REQ_QUEUED				1			// Waiting for the bus
+#define I2C_REQ_ACTIVE				2			// On the bus
+#define I2C_REQ_DONE				3			// Completed
+#define I2C_REQ_NACK				4			// Address or a written byte was not acknowledged
+#define I2C_REQ_ERROR				5			// Bus error or lost arbitration
+#define I2C_REQ_TIMEOUT				6			// Bus stuck, recovered
+
+struct I2CMux
+{
+	uint8_t		addr;			// 7 bit i2c address of the mux
+	uint8_t		channel;		// Selected channel, I2C_MUX_NONE until the first switch
+	uint16_t	switches;		// Channel changes written to the mux
+};
+
+struct I2CDevice
+{
+	uint8_t		addr;			// 7 bit i2c address
+	uint32_t	maxClock;		// Hz, highest SCL frequency the device supports
+	uint32_t	busMicros;		// us the device's requests held the bus
+	uint16_t	requests;		// Requests completed for the device, successful or not
+	uint16_t	errors;			// Requests that failed after all retries
+	I2CMux		*mux;			// Mux the device sits behind, NULL if directly on the bus
+	uint8_t		channel;		// Mux channel 0-7
+};
+
+struct I2CRequest
+{
+	I2CDevice			*dev;
+	const uint8_t		*txData;		// Written first, NULL if txLen is 0
+	uint8_t				txLen;
+	uint8_t				*rxData;		// Read after a repeated start, NULL if rxLen is 0
+	uint8_t				rxLen;
+	void				(*done)(I2CRequest *req);	// Runs in the TWI interrupt, or NULL
+	void				*context;		// For the done callback
+
+	// Owned by the bus from submit() until the status is final
+	volatile uint8_t	status;
+	uint8_t				rxCount;		// Bytes read
+	uint8_t				tries;			// Attempts that failed
+	unsigned long		submitted;		// micros() at submit()
+	I2CRequest			*next;
+};
+
+struct I2CBusStats
+{
+	uint16_t		completed;		// Requests that reached DONE
+	uint16_t		failed;			// Requests that failed after all retries
+	uint16_t		retries;		// Attempts repeated after a failure
+	uint16_t		nacks;			// Attempts ended by a NACK
+	uint16_t		errors;			// Attempts ended by a bus error or lost arbitration
+	uint16_t		timeouts;		// Attempts that ran out of time
+	uint16_t		recoveries;		// Bus recoveries, at start-up or after a timeout
+	uint8_t			depth;			// Requests queued or active now
+	uint8_t			maxDepth;		// Largest depth seen
+	unsigned long	maxLatency;		// us, longest submit() to completion
+};
+
+class I2CBus
+{
+	public:
+		void		begin(uint32_t defaultClock = I2C_DEFAULT_CLOCK);
+		uint8_t		submit(I2CRequest *req);
+		uint8_t		transfer(I2CRequest *req);
+		void		poll();
+		uint8_t		write(I2CDevice *dev, const uint8_t *data, uint8_t len);
+		uint8_t		read(I2CDevice *dev, uint8_t reg, uint8_t *data, uint8_t len);
+		uint8_t		isIdle();
+		uint32_t	getClock();
+		uint16_t	getClockChanges();
+		I2CBusStats	getStats();
+		void		resetStats();
+
+		uint8_t			retries = I2C_RETRIES;
+		unsigned long	timeout = I2C_TIMEOUT;		// us
+
+	private:
+		void		_setClock(uint32_t clock);
+		void		_start();
+		void		_finish(uint8_t status);
+		void		_complete(uint8_t status);
+		void		_recover();
+		void		_line(uint8_t pin, uint8_t level);
+		void		_step();
+		friend void	i2cBusInterrupt();
+
+		// The head of the queue is the request on the bus
+		I2CRequest * volatile	_head = NULL;
+		I2CRequest * volatile	_tail = NULL;
+		uint8_t					_switching;			// Writing the mux channel before the request
+		uint8_t					_reading;			// In the read phase of the request
+		uint8_t					_pos;				// Bytes written in the current write phase
+		uint8_t					_stop = false;		// A STOP is owed, sent with the next START
+		unsigned long			_startedAt;			// micros() when the request got the bus
+
+		uint32_t				_defaultClock = I2C_DEFAULT_CLOCK;
+		uint32_t				_clock = 0;
+		uint16_t				_clockChanges = 0;
+		I2CBusStats				_stats = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+};
+
+extern I2CBus I2C;
+
+#endif
@@ -0,0 +1,160 @@
+/*
+Shadow framebuffer for the ADK's 20x4 HD44780 character display, see
+LCDFrame.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <Arduino.h>
+#include "LCDFrame.h"
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+uint8_t LCDFrame::_move(uint8_t col, uint8_t row)
+{
+	if (_lcdCol == col && _lcdRow == row)
+		return true;
+
+	if (!_lcd->setCursor(col, row))
+		return false;
+
+	_lcdCol = col;
+	_lcdRow = row;
+	_stats.bytes++;
+	_stats.moves++;
+	return true;
+}
+
+uint8_t LCDFrame::_send(uint8_t col, uint8_t row)
+{
+	if (!_lcd->write(_cells[row][col]))
+		return false;
+
+	_shown[row][col] = _cells[row][col];
+	_stats.bytes++;
+
+	// Past the end of a row the address counter jumps to another row
+	if (++_lcdCol >= LCD_FRAME_COLS)
+		_lcdCol = 0xFF;
+	return true;
+}
+
+uint8_t LCDFrame::_flushRow(uint8_t row)
+{
+	uint8_t		col = 0;
+
+	while (col < LCD_FRAME_COLS) {
+		uint8_t		end;
+
+		if (_cells[row][col] == _shown[row][col]) {
+			col++;
+			continue;
+		}
+
+		// Extend the run over later changes, through short unchanged gaps
+		end = col + 1;
+		for (uint8_t i = end; i < LCD_FRAME_COLS; i++) {
+			if (_cells[row][i] != _shown[row][i])
+				end = i + 1;
+			else if (i + 1 - end > LCD_FRAME_GAP)
+				break;
+		}
+
+		if (!_move(col, row))
+			return false;
+		while (col < end)
+			if (!_send(col++, row))
+				return false;
+	}
+
+	return true;
+}
+
+/******************************************************************************
+ * Drawing
+ ******************************************************************************/
+// The display has just been cleared by lcd->begin() or lcd->clear()
+void LCDFrame::begin(LCDQueue *lcd)
+{
+	_lcd = lcd;
+	memset(_cells, ' ', sizeof(_cells));
+	memset(_shown, ' ', sizeof(_shown));
+	_col	= 0;
+	_row	= 0;
+	_lcdCol	= 0;
+	_lcdRow	= 0;
+	_deferred = false;
+	resetStats();
+}
+
+void LCDFrame::setCursor(uint8_t col, uint8_t row)
+{
+	_col = col;
+	_row = row;
+}
+
+// Blanks the current row from the cursor on
+void LCDFrame::clearToEnd()
+{
+	while (_col < LCD_FRAME_COLS)
+		write(' ');
+}
+
+void LCDFrame::clear()
+{
+	memset(_cells, ' ', sizeof(_cells));
+	_col = 0;
+	_row = 0;
+}
+
+size_t LCDFrame::write(uint8_t c)
+{
+	if (_row >= LCD_FRAME_ROWS || _col >= LCD_FRAME_COLS)
+		return 0;
+
+	_cells[_row][_col++] = c;
+	return 1;
+}
+
+// Forgets what the display shows, the next flush() rewrites every cell
+void LCDFrame::invalidate()
+{
+	memset(_shown, 0, sizeof(_shown));
+	_lcdCol = 0xFF;
+}
+
+/******************************************************************************
+ * Display
+ ******************************************************************************/
+void LCDFrame::flush()
+{
+	unsigned long	start = micros();
+
+	if (_lcd == NULL)
+		return;
+
+	if (fullRedraw && !_deferred)
+		invalidate();
+
+	// What did not fit in the queue is still different next time
+	_deferred = false;
+	for (uint8_t row = 0; row < LCD_FRAME_ROWS && !_deferred; row++)
+		_deferred = !_flushRow(row);
+	if (_deferred)
+		_stats.deferred++;
+
+	_stats.micros += micros() - start;
+	_stats.flushes++;
+}
+
+LCDFrameStats LCDFrame::getStats()
+{
+	return _stats;
+}
+
+void LCDFrame::resetStats()
+{
+	memset(&_stats, 0, sizeof(_stats));
+}
@@ -0,0 +1,78 @@
+/*
+Shadow framebuffer for the ADK's 20x4 HD44780 character display
+
+The display code prints into an LCDFrame as it would into LiquidCrystal:
+setCursor(), print() and clearToEnd() only change a 4x20 copy of the
+screen in RAM and cost a few us. flush() compares the copy with what the
+display is known to show and sends only the cells that differ. Changed
+cells in a row are sent as one run after a single cursor move; unchanged
+cells of up to LCD_FRAME_GAP between two changes are sent again, which is
+cheaper than a second cursor move. No cursor move is sent when the
+display's address counter is already at the start of a run.
+
+The cells go to the display through an LCDQueue, which sends one byte,
+character or cursor command, per timer tick. The cost of a flush is the
+number of bytes it sends: a screen that only shows a new second costs
+two bytes instead of 80 and more. When the queue is full the flush stops
+and the cells left over go out with the next one.
+
+Characters printed past the end of a row are dropped rather than
+wrapped. Bytes sent, cursor moves and the time spent in flush() are
+counted for measuring. With fullRedraw set, flush() rewrites every cell
+the way the sketch used to, for comparison, once the previous rewrite
+has gone out.
+*/
+
+#ifndef LCDFrame_h
+#define LCDFrame_h
+
+#include <Arduino.h>
+#include "LCDQueue.h"
+
+#define LCD_FRAME_COLS		20
+#define LCD_FRAME_ROWS		4
+#define LCD_FRAME_GAP		1			// Unchanged cells sent to avoid a cursor move
+
+struct LCDFrameStats
+{
+	uint32_t	bytes;				// Characters and commands sent to the display
+	uint32_t	moves;				// Of which cursor moves
+	uint32_t	micros;				// Spent in flush()
+	uint16_t	flushes;
+	uint16_t	deferred;			// Flushes cut short by a full queue
+};
+
+class LCDFrame : public Print
+{
+	public:
+		void			begin(LCDQueue *lcd);
+		void			setCursor(uint8_t col, uint8_t row);
+		void			clearToEnd();
+		void			clear();
+		size_t			write(uint8_t c);
+		void			flush();
+		void			invalidate();
+		LCDFrameStats	getStats();
+		void			resetStats();
+
+		uint8_t			fullRedraw = false;	// flush() rewrites every cell
+
+		using Print::write;
+
+	private:
+		uint8_t			_move(uint8_t col, uint8_t row);
+		uint8_t			_send(uint8_t col, uint8_t row);
+		uint8_t			_flushRow(uint8_t row);
+
+		LCDQueue		*_lcd = NULL;
+		char			_cells[LCD_FRAME_ROWS][LCD_FRAME_COLS];		// What the display code drew
+		char			_shown[LCD_FRAME_ROWS][LCD_FRAME_COLS];		// What the display shows
+		uint8_t			_col = 0;
+		uint8_t			_row = 0;
+		uint8_t			_lcdCol = 0xFF;		// Display address counter, 0xFF if not known
+		uint8_t			_lcdRow = 0;
+		uint8_t			_deferred = false;	// The last flush() stopped on a full queue
+		LCDFrameStats	_stats;
+};
+
+#endif
@@ -0,0 +1,244 @@
+/*
+Interrupt-driven HD44780 output for the ES100 ADK display, see LCDQueue.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <Arduino.h>
+#include "LCDQueue.h"
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+// Ring entry flags, above the nibble
+#define LCD_QUEUE_RS			0x10		// Data, not a command
+#define LCD_QUEUE_END			0x20		// Second nibble, the controller executes the byte
+#define LCD_QUEUE_LONG			0x40		// Hold the queue for LCD_QUEUE_CLEAR_WAIT after it
+
+#define LCD_QUEUE_MASK			(LCD_QUEUE_SIZE - 1)
+#define LCD_QUEUE_CLEAR_TICKS	((LCD_QUEUE_CLEAR_WAIT + LCD_QUEUE_TICK - 1) / LCD_QUEUE_TICK)
+
+// HD44780 commands
+#define LCD_CLEAR				0x01
+#define LCD_HOME				0x02
+#define LCD_ENTRY_LEFT			0x06		// Address counter increments, no shift
+#define LCD_DISPLAY_ON			0x0C		// Cursor and blink off
+#define LCD_FUNCTION_4BIT		0x20
+#define LCD_FUNCTION_2LINE		0x08
+#define LCD_SET_DDRAM			0x80
+
+// _pins[] order
+#define LCD_PIN_RS				0
+#define LCD_PIN_EN				1
+#define LCD_PIN_D4				2
+
+static LCDQueue		*instance = NULL;
+
+/******************************************************************************
+ * Interrupt handler
+ ******************************************************************************/
+void lcdQueueTick()
+{
+	LCDQueue	*lcd = instance;
+	uint8_t		tail = lcd->_tail;
+	uint8_t		entry;
+
+	if (lcd->_wait > 0) {
+		lcd->_wait--;
+		return;
+	}
+
+	if (tail == lcd->_head) {
+		TIMSK2 &= ~_BV(OCIE2A);
+		return;
+	}
+
+	// Bytes are queued whole, both nibbles go out on this tick
+	do {
+		entry = lcd->_ring[tail];
+		tail = (tail + 1) & LCD_QUEUE_MASK;
+		lcd->_nibble(entry);
+	} while (!(entry & LCD_QUEUE_END));
+
+	lcd->_tail = tail;
+	if (entry & LCD_QUEUE_LONG)
+		lcd->_wait = LCD_QUEUE_CLEAR_TICKS;
+}
+
+ISR(TIMER2_COMPA_vect)
+{
+	lcdQueueTick();
+}
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+void LCDQueue::_pin(uint8_t i, uint8_t level)
+{
+#if defined(__AVR__)
+	// digitalWrite() would take most of the tick
+	if (level)
+		*_ports[i] |= _masks[i];
+	else
+		*_ports[i] &= ~_masks[i];
+#else
+	digitalWrite(_pins[i], level);
+#endif
+}
+
+void LCDQueue::_nibble(uint8_t entry)
+{
+	_pin(LCD_PIN_RS, (entry & LCD_QUEUE_RS) != 0);
+	for (uint8_t i = 0; i < 4; i++)
+		_pin(LCD_PIN_D4 + i, (entry >> i) & 1);
+
+	// The controller latches the nibble on the falling edge, after at least 450 ns high
+	_pin(LCD_PIN_EN, HIGH);
+#if defined(__AVR__)
+	__builtin_avr_delay_cycles(F_CPU / 2000000UL);
+#endif
+	_pin(LCD_PIN_EN, LOW);
+}
+
+uint8_t LCDQueue::_queue(uint8_t value, uint8_t flags)
+{
+	uint8_t		head = _head;
+	uint8_t		depth = (head - _tail) & LCD_QUEUE_MASK;
+
+	if (depth + 2 > LCD_QUEUE_MASK) {
+		_overflows++;
+		return 0;
+	}
+
+	_ring[head] = (value >> 4) | (flags & LCD_QUEUE_RS);
+	_ring[(head + 1) & LCD_QUEUE_MASK] = (value & 0x0F) | flags | LCD_QUEUE_END;
+
+	// Publish the byte before the interrupt can find the ring empty and stop
+	_head = (head + 2) & LCD_QUEUE_MASK;
+	TIMSK2 |= _BV(OCIE2A);
+
+	_bytes++;
+	depth += 2;
+	if (depth > _maxDepth)
+		_maxDepth = depth;
+
+	return 1;
+}
+
+/******************************************************************************
+ * Constructor
+ ******************************************************************************/
+LCDQueue::LCDQueue(uint8_t rs, uint8_t enable, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7)
+{
+	_pins[LCD_PIN_RS]		= rs;
+	_pins[LCD_PIN_EN]		= enable;
+	_pins[LCD_PIN_D4]		= d4;
+	_pins[LCD_PIN_D4 + 1]	= d5;
+	_pins[LCD_PIN_D4 + 2]	= d6;
+	_pins[LCD_PIN_D4 + 3]	= d7;
+}
+
+/******************************************************************************
+ * User API
+ ******************************************************************************/
+void LCDQueue::begin(uint8_t cols, uint8_t rows)
+{
+	instance	= this;
+	_cols		= cols;
+	_rows		= rows;
+	_head		= 0;
+	_tail		= 0;
+	_wait		= 0;
+
+	for (uint8_t i = 0; i < 6; i++) {
+		pinMode(_pins[i], OUTPUT);
+		digitalWrite(_pins[i], LOW);
+#if defined(__AVR__)
+		_ports[i]	= portOutputRegister(digitalPinToPort(_pins[i]));
+		_masks[i]	= digitalPinToBitMask(_pins[i]);
+#endif
+	}
+
+	// Power-up, then switch to 4 bit mode from whatever mode it is in
+	delay(50);
+	_nibble(0x03);
+	delayMicroseconds(4500);
+	_nibble(0x03);
+	delayMicroseconds(4500);
+	_nibble(0x03);
+	delayMicroseconds(150);
+	_nibble(0x02);
+	delayMicroseconds(100);
+
+	// CTC mode, a compare match every LCD_QUEUE_TICK us at F_CPU/8
+	noInterrupts();
+	TIMSK2	= 0;
+	TCCR2A	= _BV(WGM21);
+	TCCR2B	= _BV(CS21);
+	OCR2A	= LCD_QUEUE_TICK * (F_CPU / 8 / 1000000UL) - 1;
+	TCNT2	= 0;
+	TIFR2	= _BV(OCF2A);
+	interrupts();
+
+	command(LCD_FUNCTION_4BIT | (rows > 1 ? LCD_FUNCTION_2LINE : 0));
+	command(LCD_DISPLAY_ON);
+	clear();
+	command(LCD_ENTRY_LEFT);
+}
+
+uint8_t LCDQueue::clear()
+{
+	return _queue(LCD_CLEAR, LCD_QUEUE_LONG);
+}
+
+uint8_t LCDQueue::home()
+{
+	return _queue(LCD_HOME, LCD_QUEUE_LONG);
+}
+
+uint8_t LCDQueue::setCursor(uint8_t col, uint8_t row)
+{
+	// Rows 2 and 3 continue rows 0 and 1 in display RAM
+	static const uint8_t	offsets[] = { 0x00, 0x40 };
+
+	if (row >= _rows)
+		row = _rows - 1;
+
+	return command(LCD_SET_DDRAM | (offsets[row & 1] + (row & 2 ? _cols : 0) + col));
+}
+
+uint8_t LCDQueue::command(uint8_t value)
+{
+	return _queue(value, 0);
+}
+
+size_t LCDQueue::write(uint8_t c)
+{
+	return _queue(c, LCD_QUEUE_RS);
+}
+
+// True once everything queued has been executed
+uint8_t LCDQueue::isIdle()
+{
+	return _head == _tail && _wait == 0;
+}
+
+LCDQueueStats LCDQueue::getStats()
+{
+	LCDQueueStats	stats;
+
+	stats.bytes		= _bytes;
+	stats.overflows	= _overflows;
+	stats.depth		= (_head - _tail) & LCD_QUEUE_MASK;
+	stats.maxDepth	= _maxDepth;
+
+	return stats;
+}
+
+void LCDQueue::resetStats()
+{
+	_bytes		= 0;
+	_overflows	= 0;
+	_maxDepth	= 0;
+}
@@ -0,0 +1,91 @@
+/*
+Interrupt-driven HD44780 output for the ES100 ADK display
+
+A stand-in for LiquidCrystal in 4 bit mode that never waits for the
+display. write(), setCursor(), clear() and command() split each byte
+into its two nibbles and put them in a ring buffer. A Timer2 compare
+interrupt every LCD_QUEUE_TICK us takes one byte off the ring and clocks
+its nibbles out, so the controller gets one byte per tick, after it has
+executed the previous one. clear() and home() hold the queue for
+LCD_QUEUE_CLEAR_WAIT after them. The interrupt is switched off while the
+ring is empty.
+
+The ADK wires R/W to ground, so the busy flag cannot be read and the
+pace is set by the timer. LCD_QUEUE_TICK covers the 37 us execution time
+at the slowest oscillator the HD44780 datasheet allows. LiquidCrystal
+busy-waits 100 us after each of the two nibbles of a byte instead.
+
+If the ring has no room for a whole byte, nothing is queued, the call
+returns 0 and the overflow is counted. The caller decides what to do
+about it; LCDFrame leaves the cells it could not send for its next
+flush(). Queue depth, its maximum and the overflows are kept for tuning.
+
+begin() waits the 50 ms power-up time and runs the 4 bit handshake in
+the foreground, like LiquidCrystal; the rest of the setup is queued.
+
+Timer2 is taken over completely: tone() and analogWrite() on pins 3 and
+11 no longer work once begin() is called. Each interrupt takes a few us,
+which is the most it can delay the ES100 IRQ or the 1PPS compare
+interrupts.
+*/
+
+#ifndef LCDQueue_h
+#define LCDQueue_h
+
+#include <Arduino.h>
+
+#define LCD_QUEUE_SIZE				128			// Nibbles, a power of 2 up to 256
+#define LCD_QUEUE_TICK				60			// us per byte, at most 127
+#define LCD_QUEUE_CLEAR_WAIT		2000		// us after clear() and home()
+
+struct LCDQueueStats
+{
+	uint32_t	bytes;				// Characters and commands queued
+	uint16_t	overflows;			// Bytes refused for want of room
+	uint8_t		depth;				// Nibbles queued now
+	uint8_t		maxDepth;
+};
+
+class LCDQueue : public Print
+{
+	public:
+		LCDQueue(uint8_t rs, uint8_t enable, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7);
+
+		void			begin(uint8_t cols, uint8_t rows);
+		uint8_t			clear();
+		uint8_t			home();
+		uint8_t			setCursor(uint8_t col, uint8_t row);
+		uint8_t			command(uint8_t value);
+		size_t			write(uint8_t c);
+		uint8_t			isIdle();
+		LCDQueueStats	getStats();
+		void			resetStats();
+
+		using Print::write;
+
+	private:
+		uint8_t			_queue(uint8_t value, uint8_t flags);
+		void			_nibble(uint8_t entry);
+		void			_pin(uint8_t i, uint8_t level);
+
+		friend void		lcdQueueTick();
+
+		uint8_t			_pins[6];				// RS, EN, D4-D7
+#if defined(__AVR__)
+		volatile uint8_t	*_ports[6];
+		uint8_t			_masks[6];
+#endif
+		uint8_t			_cols = 20;
+		uint8_t			_rows = 4;
+
+		uint8_t			_ring[LCD_QUEUE_SIZE];	// Nibble in bits 0-3, see LCDQueue.cpp for the flags
+		volatile uint8_t	_head = 0;			// Next free entry, written by the foreground
+		volatile uint8_t	_tail = 0;			// Next entry out, written by the interrupt
+		volatile uint8_t	_wait = 0;			// Ticks to hold the queue for a clear or home
+
+		uint32_t		_bytes = 0;
+		uint16_t		_overflows = 0;
+		uint8_t			_maxDepth = 0;
+};
+
+#endif
@@ -0,0 +1,220 @@
+/*
+Sync journal for the ES100 ADK, kept in the DS1307's RAM, see SyncJournal.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <Arduino.h>
+#include "SyncJournal.h"
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define SYNC_JOURNAL_OK				0x01		// Flag bits of byte 9
+#define SYNC_JOURNAL_TRACKING		0x02
+#define SYNC_JOURNAL_ANTENNA		0x04
+#define SYNC_JOURNAL_ZONE			0x08
+
+#define SYNC_JOURNAL_OFFSET_STEP	900			// s per step of byte 10
+
+static uint8_t crc8(const uint8_t *data, uint8_t len)
+{
+	uint8_t		crc = SYNC_JOURNAL_CRC_INIT;
+
+	// Dallas/Maxim, x^8 + x^5 + x^4 + 1 bit-reversed
+	while (len--) {
+		crc ^= *data++;
+		for (uint8_t i = 0; i < 8; i++)
+			crc = crc & 1 ? (crc >> 1) ^ 0x8C : crc >> 1;
+	}
+
+	return crc;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put32(uint8_t *p, uint32_t value)
+{
+	p[0] = value;
+	p[1] = value >> 8;
+	p[2] = value >> 16;
+	p[3] = value >> 24;
+}
+
+static uint8_t decode(const uint8_t *raw, SyncJournalEntry *e)
+{
+	uint8_t		flags = raw[9];
+	uint16_t	next = raw[11] | raw[12] << 8;
+
+	if (crc8(raw, SYNC_JOURNAL_ENTRY_LEN - 1) != raw[SYNC_JOURNAL_ENTRY_LEN - 1])
+		return false;
+
+	e->utc					= get32(raw + 1);
+	e->decodeUtc			= get32(raw + 5);
+	e->status.rxOk			= (flags & SYNC_JOURNAL_OK) != 0;
+	e->status.tracking		= (flags & SYNC_JOURNAL_TRACKING) != 0;
+	e->status.antenna		= (flags & SYNC_JOURNAL_ANTENNA) != 0;
+	e->zoneKnown			= (flags & SYNC_JOURNAL_ZONE) != 0;
+	e->status.dstState		= (flags >> 4) & 3;
+	e->status.leapSecond	= flags >> 6;
+	e->offset				= (int32_t)(int8_t)raw[10] * SYNC_JOURNAL_OFFSET_STEP;
+	e->nextDst.month		= next & 0x0F;
+	e->nextDst.day			= (next >> 4) & 0x1F;
+	e->nextDst.hour			= next >> 9;
+
+	// A CRC match on stray RAM contents is rare, not impossible
+	return e->nextDst.month <= 12 && e->nextDst.hour <= 23 &&
+		   e->status.leapSecond != 1 && e->decodeUtc <= e->utc;
+}
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+uint8_t SyncJournal::_write(uint8_t slot, uint8_t seq, const SyncJournalEntry *e)
+{
+	uint8_t		*raw = _raw[slot];
+
+	if (e->offset % SYNC_JOURNAL_OFFSET_STEP != 0 || e->offset / SYNC_JOURNAL_OFFSET_STEP < -128 ||
+		e->offset / SYNC_JOURNAL_OFFSET_STEP > 127)
+		return false;
+
+	raw[0] = seq;
+	put32(raw + 1, e->utc);
+	put32(raw + 5, e->decodeUtc);
+	raw[9] = (e->status.rxOk ? SYNC_JOURNAL_OK : 0) |
+			 (e->status.tracking ? SYNC_JOURNAL_TRACKING : 0) |
+			 (e->status.antenna ? SYNC_JOURNAL_ANTENNA : 0) |
+			 (e->zoneKnown ? SYNC_JOURNAL_ZONE : 0) |
+			 (e->status.dstState & 3) << 4 |
+			 (e->status.leapSecond & 3) << 6;
+	raw[10] = (int8_t)(e->offset / SYNC_JOURNAL_OFFSET_STEP);
+	raw[11] = e->nextDst.month | e->nextDst.day << 4;
+	raw[12] = (e->nextDst.day >> 4) | e->nextDst.hour << 1;
+	raw[SYNC_JOURNAL_ENTRY_LEN - 1] = crc8(raw, SYNC_JOURNAL_ENTRY_LEN - 1);
+
+	// A failed write leaves the slot in an unknown state, read it as invalid
+	if (!_rtc->writeRAM(SYNC_JOURNAL_ADDR + slot * SYNC_JOURNAL_ENTRY_LEN, raw, SYNC_JOURNAL_ENTRY_LEN)) {
+		raw[SYNC_JOURNAL_ENTRY_LEN - 1] ^= 0xFF;
+		_scan();
+		return false;
+	}
+
+	_scan();
+	return true;
+}
+
+void SyncJournal::_scan()
+{
+	SyncJournalEntry	e;
+
+	_valid	= 0;
+	_newest	= SYNC_JOURNAL_NONE;
+	_last	= SYNC_JOURNAL_NONE;
+
+	for (uint8_t slot = 0; slot < SYNC_JOURNAL_ENTRIES; slot++) {
+		if (!decode(_raw[slot], &e))
+			continue;
+
+		_valid |= 1 << slot;
+		if (_newest == SYNC_JOURNAL_NONE || (int8_t)(_raw[slot][0] - _raw[_newest][0]) > 0)
+			_newest = slot;
+		if (e.status.rxOk && (_last == SYNC_JOURNAL_NONE || (int8_t)(_raw[slot][0] - _raw[_last][0]) > 0))
+			_last = slot;
+	}
+}
+
+/******************************************************************************
+ * User API
+ ******************************************************************************/
+// Reads the journal from the RTC, returns the number of valid entries
+uint8_t SyncJournal::begin(DS1307 *rtc)
+{
+	_rtc = rtc;
+
+	if (!_rtc->readRAM(SYNC_JOURNAL_ADDR, _raw[0], sizeof(_raw)))
+		memset(_raw, 0, sizeof(_raw));
+	_scan();
+
+	return count();
+}
+
+uint8_t SyncJournal::append(const SyncJournalEntry *e)
+{
+	uint8_t		seq = _newest == SYNC_JOURNAL_NONE ? 0 : _raw[_newest][0] + 1;
+	uint8_t		slot = SYNC_JOURNAL_NONE;
+	uint8_t		age, oldest = 0;
+
+	if (_rtc == NULL)
+		return false;
+
+	// An invalid slot first, then the oldest that is not the newest good entry
+	for (uint8_t i = 0; i < SYNC_JOURNAL_ENTRIES; i++) {
+		if (!(_valid & (1 << i))) {
+			slot = i;
+			break;
+		}
+		if (i == _last && !e->status.rxOk)
+			continue;
+
+		age = seq - _raw[i][0];
+		if (slot == SYNC_JOURNAL_NONE || age > oldest) {
+			slot	= i;
+			oldest	= age;
+		}
+	}
+
+	if (slot == SYNC_JOURNAL_NONE)
+		return false;
+
+	return _write(slot, seq, e);
+}
+
+// Rewrites the newest good entry, keeping its place
+uint8_t SyncJournal::update(const SyncJournalEntry *e)
+{
+	if (_rtc == NULL || _last == SYNC_JOURNAL_NONE)
+		return false;
+
+	return _write(_last, _raw[_last][0], e);
+}
+
+// The newest good entry, false if there is none
+uint8_t SyncJournal::getLast(SyncJournalEntry *e)
+{
+	return _last != SYNC_JOURNAL_NONE && decode(_raw[_last], e);
+}
+
+// Entry i, newest first, good or failed
+uint8_t SyncJournal::getEntry(uint8_t i, SyncJournalEntry *e)
+{
+	uint8_t		top;
+
+	if (_newest == SYNC_JOURNAL_NONE)
+		return false;
+
+	top = _raw[_newest][0];
+	for (uint8_t back = 0; back < 0xFF; back++) {
+		for (uint8_t slot = 0; slot < SYNC_JOURNAL_ENTRIES; slot++) {
+			if ((_valid & (1 << slot)) && (uint8_t)(top - _raw[slot][0]) == back) {
+				if (i-- == 0)
+					return decode(_raw[slot], e);
+			}
+		}
+	}
+
+	return false;
+}
+
+uint8_t SyncJournal::count()
+{
+	uint8_t		n = 0;
+
+	for (uint8_t slot = 0; slot < SYNC_JOURNAL_ENTRIES; slot++)
+		n += (_valid >> slot) & 1;
+
+	return n;
+}
@@ -0,0 +1,82 @@
+/*
+Sync journal for the ES100 ADK, kept in the DS1307's RAM
+
+Everything the sketch knows about its last reception is lost with a
+reset, while the RTC goes on keeping good time from its battery. The
+journal keeps the outcome of the last SYNC_JOURNAL_ENTRIES receptions in
+the DS1307's battery-backed RAM, so that after a reset the sketch can
+pick up the time of the last good reception, the DST and leap second
+flags and the RTC's offset from UTC, and carry on with a tracking
+reception at the usual interval instead of a full decode straight away.
+
+The DS1307 RAM was picked over the AVR's EEPROM: it lives and dies with
+the time in the RTC it describes, and wears nothing out however often
+it is written.
+
+Each entry takes SYNC_JOURNAL_ENTRY_LEN bytes:
+  0      sequence number, the newest entry has the highest, modulo 256
+  1-4    UTC of the end of the reception, ES100Time.h seconds, LSB first
+  5-8    UTC of the full decode the flags and next DST are from
+  9      bit 0 rxOk, 1 tracking, 2 antenna, 3 zone known,
+         4-5 DST state, 6-7 leap second, as in ES100Status0
+  10     RTC offset from UTC in 15 minute steps, signed
+  11-12  next DST change, month | day << 4 | hour << 9, LSB first
+  13     CRC-8 (Dallas/Maxim) of bytes 0-12
+An entry whose CRC or fields do not check out, as after the battery was
+changed, is ignored. A failed reception never takes the place of the
+newest good one, which is the one restored.
+
+After the RTC has been stepped for a DST change or a leap second,
+update() rewrites the newest good entry in place with the new offset
+and flags.
+*/
+
+#ifndef SyncJournal_h
+#define SyncJournal_h
+
+#include <Arduino.h>
+#include "ES100.h"
+#include "DS1307.h"
+
+#define SYNC_JOURNAL_ENTRIES		4			// Receptions kept
+#define SYNC_JOURNAL_ENTRY_LEN		14			// Bytes per entry, see above
+#define SYNC_JOURNAL_ADDR			0			// First byte of DS1307 RAM used
+#define SYNC_JOURNAL_CRC_INIT		0x5A		// Change along with the entry layout
+#define SYNC_JOURNAL_NONE			0xFF		// No valid entry
+
+#if SYNC_JOURNAL_ADDR + SYNC_JOURNAL_ENTRIES * SYNC_JOURNAL_ENTRY_LEN > DS1307_RAM_LEN
+#error "The sync journal does not fit in the DS1307 RAM"
+#endif
+
+struct SyncJournalEntry
+{
+	uint32_t		utc;			// End of the reception
+	uint32_t		decodeUtc;		// Full decode status and nextDst are from
+	ES100Status0	status;			// rxOk is the outcome of the reception
+	uint8_t			zoneKnown;		// offset and the flags are from a full decode
+	int32_t			offset;			// local - UTC the RTC runs at, s
+	ES100NextDst	nextDst;
+};
+
+class SyncJournal
+{
+	public:
+		uint8_t			begin(DS1307 *rtc);
+		uint8_t			append(const SyncJournalEntry *e);
+		uint8_t			update(const SyncJournalEntry *e);
+		uint8_t			getLast(SyncJournalEntry *e);
+		uint8_t			getEntry(uint8_t i, SyncJournalEntry *e);
+		uint8_t			count();
+
+	private:
+		uint8_t			_write(uint8_t slot, uint8_t seq, const SyncJournalEntry *e);
+		void			_scan();
+
+		DS1307			*_rtc = NULL;
+		uint8_t			_raw[SYNC_JOURNAL_ENTRIES][SYNC_JOURNAL_ENTRY_LEN];
+		uint8_t			_valid = 0;					// Bit per slot
+		uint8_t			_newest = SYNC_JOURNAL_NONE;	// Slot of the newest entry
+		uint8_t			_last = SYNC_JOURNAL_NONE;		// Slot of the newest good entry
+};
+
+#endif
@@ -0,0 +1,143 @@
+/*
+Binary serial telemetry, see Telemetry.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <Arduino.h>
+#include "Telemetry.h"
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define TELEMETRY_MASK			(TELEMETRY_RING_SIZE - 1)
+#define TELEMETRY_HEADER		3			// Type, version, sequence
+#define TELEMETRY_CRC_LEN		2
+
+static uint16_t crc16(uint16_t crc, uint8_t c)
+{
+	crc ^= (uint16_t)c << 8;
+	for (uint8_t i = 0; i < 8; i++)
+		crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+
+	return crc;
+}
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+void Telemetry::_put(uint8_t c)
+{
+	_ring[_head] = c;
+	_head = (_head + 1) & TELEMETRY_MASK;
+}
+
+/******************************************************************************
+ * User API
+ ******************************************************************************/
+void Telemetry::begin(Print *port)
+{
+	_port = port;
+	_head = 0;
+	_tail = 0;
+}
+
+// Frames the record into the ring, false if it was dropped
+uint8_t Telemetry::send(uint8_t type, uint8_t version, const void *payload, uint8_t len)
+{
+	const uint8_t	*data = (const uint8_t *)payload;
+	uint8_t			header[TELEMETRY_HEADER] = { type, version, _seq++ };
+	uint8_t			body = TELEMETRY_HEADER + len + TELEMETRY_CRC_LEN;
+	uint8_t			depth = (_head - _tail) & TELEMETRY_MASK;
+	uint8_t			code;				// Index of the COBS code byte being filled
+	uint16_t		crc = TELEMETRY_CRC_INIT;
+	uint8_t			c;
+
+	// A body under 254 bytes gains one COBS code byte, plus the delimiter
+	if (len > TM_MAX_PAYLOAD || depth + body + 2 > TELEMETRY_MASK) {
+		_stats.dropped++;
+		return false;
+	}
+
+	code = _head;
+	_put(1);
+	for (uint8_t i = 0; i < body; i++) {
+		if (i < TELEMETRY_HEADER) {
+			c = header[i];
+			crc = crc16(crc, c);
+		} else if (i < TELEMETRY_HEADER + len) {
+			c = data[i - TELEMETRY_HEADER];
+			crc = crc16(crc, c);
+		} else {
+			c = i == body - TELEMETRY_CRC_LEN ? crc & 0xFF : crc >> 8;
+		}
+
+		if (c == 0) {
+			code = _head;
+			_put(1);
+		} else {
+			_put(c);
+			_ring[code]++;
+		}
+	}
+	_put(0);
+
+	depth = (_head - _tail) & TELEMETRY_MASK;
+	if (depth > _stats.maxDepth)
+		_stats.maxDepth = depth;
+	_stats.frames++;
+
+	poll();
+	return true;
+}
+
+uint8_t Telemetry::text(const char *s)
+{
+	size_t		len = strlen(s);
+
+	return send(TM_TEXT, TM_TEXT_V, s, len < TM_MAX_PAYLOAD ? len : TM_MAX_PAYLOAD);
+}
+
+// Hands the serial port what its buffer takes without waiting
+void Telemetry::poll()
+{
+	int		room;
+
+	if (_port == NULL)
+		return;
+
+	room = _port->availableForWrite();
+	while (room-- > 0 && _tail != _head) {
+		_port->write(_ring[_tail]);
+		_tail = (_tail + 1) & TELEMETRY_MASK;
+		_stats.bytes++;
+	}
+}
+
+// Waits for the ring to drain, text written to the port from here on
+// does not land inside a frame
+void Telemetry::beginText()
+{
+	while (_port != NULL && _tail != _head) {
+		_port->write(_ring[_tail]);
+		_tail = (_tail + 1) & TELEMETRY_MASK;
+		_stats.bytes++;
+	}
+}
+
+void Telemetry::endText()
+{
+	if (_port != NULL)
+		_port->write((uint8_t)0);
+}
+
+TelemetryStats Telemetry::getStats()
+{
+	return _stats;
+}
+
+void Telemetry::resetStats()
+{
+	memset(&_stats, 0, sizeof(_stats));
+}
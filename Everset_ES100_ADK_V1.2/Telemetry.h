@@ -0,0 +1,70 @@
+/*
+Binary serial telemetry for the ES100 ADK and the WWVB clocks
+
+Replaces the Serial.print() debug blocks. At 9600 baud a block of text
+lines held up the loop for most of a second once the 64 byte serial
+buffer was full. send() instead frames a record into a RAM ring and
+returns; poll(), called from loop(), moves only as many bytes to the
+serial port as its buffer has room for, so neither ever waits for the
+UART. A record that does not fit in the ring is dropped whole and
+counted.
+
+On the wire every record is one frame:
+  type, version, sequence, payload, CRC-16
+COBS encoded and ended by a 0x00 byte. COBS keeps 0x00 out of the frame,
+so a receiver that starts listening mid-stream or loses bytes is back
+in step at the next 0x00. The CRC-16/CCITT-FALSE (0x1021, init 0xFFFF)
+covers type to payload and is sent LSB first. The sequence number
+counts frames offered, sent or dropped, so gaps show what was lost.
+Record types and their payloads are in TelemetryRecords.h.
+
+Text written to the same port between beginText() and endText(), like
+the ES100 trace dump, goes out between frames: beginText() drains the
+ring, endText() ends the text with a 0x00. The host decoder passes such
+text through.
+
+Everset_ES100_ADK_V1.2/extras/telemetry decodes captures of one or many
+clocks on Linux.
+*/
+
+#ifndef Telemetry_h
+#define Telemetry_h
+
+#include <Arduino.h>
+#include "TelemetryRecords.h"
+
+#define TELEMETRY_RING_SIZE		128			// Bytes, a power of 2 up to 256
+#define TELEMETRY_CRC_INIT		0xFFFF
+
+struct TelemetryStats
+{
+	uint16_t	frames;				// Records framed into the ring
+	uint16_t	dropped;			// Records that did not fit
+	uint32_t	bytes;				// Bytes handed to the serial port
+	uint8_t		maxDepth;			// Most bytes waiting in the ring
+};
+
+class Telemetry
+{
+	public:
+		void			begin(Print *port);
+		uint8_t			send(uint8_t type, uint8_t version, const void *payload, uint8_t len);
+		uint8_t			text(const char *s);
+		void			poll();
+		void			beginText();
+		void			endText();
+		TelemetryStats	getStats();
+		void			resetStats();
+
+	private:
+		void			_put(uint8_t c);
+
+		Print			*_port = NULL;
+		uint8_t			_ring[TELEMETRY_RING_SIZE];
+		uint8_t			_head = 0;			// Next free byte
+		uint8_t			_tail = 0;			// Next byte to send
+		uint8_t			_seq = 0;
+		TelemetryStats	_stats = { 0, 0, 0, 0 };
+};
+
+#endif
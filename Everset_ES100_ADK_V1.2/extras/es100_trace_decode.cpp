@@ -0,0 +1,152 @@
+/*
+Host-side decoder for ES100 trace dumps
+
+Reads serial log text on stdin, finds the "ES100TRACE:" lines written by
+es100TraceDump() and prints one line per recorded event with the time
+relative to the first record of the dump. Everything else on the input
+is ignored, so a raw capture of the sketch's serial output can be piped
+in directly.
+
+Build and run on Linux:
+  g++ -O2 -o es100_trace_decode es100_trace_decode.cpp
+  ./es100_trace_decode < capture.txt
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Must match ES100Trace.h
+#define ES100_TRACE_VERSION		1
+#define RECORD_SIZE				7
+
+static const char *eventName(uint8_t event)
+{
+	switch (event) {
+		case 0x01:	return "BEGIN";
+		case 0x02:	return "ENABLE";
+		case 0x03:	return "DISABLE";
+		case 0x04:	return "START_RX";
+		case 0x05:	return "STOP_RX";
+		case 0x06:	return "READ_WINDOW";
+		case 0x07:	return "CACHE_HIT";
+		case 0x08:	return "WRITE_REG";
+		case 0x09:	return "READ_REG";
+		case 0x0A:	return "STATE";
+		case 0x0B:	return "TIMEOUT";
+		case 0x0C:	return "DST_SHIFT";
+		case 0x0D:	return "I2C_WRITE";
+		case 0x0E:	return "I2C_READ";
+		case 0x0F:	return "I2C_ERROR";
+	}
+	return "UNKNOWN";
+}
+
+static const char *stateName(uint8_t state)
+{
+	static const char *names[] = { "IDLE", "ENABLING", "READY", "RX", "DONE", "TIMEOUT" };
+
+	return state < sizeof(names) / sizeof(names[0]) ? names[state] : "?";
+}
+
+static int hexNibble(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	return -1;
+}
+
+static bool parseHex(const char *text, std::vector<uint8_t> &out)
+{
+	while (text[0] && text[0] != '\r' && text[0] != '\n') {
+		int hi = hexNibble(text[0]);
+		int lo = hexNibble(text[1]);
+
+		if (hi < 0 || lo < 0)
+			return false;
+		out.push_back((uint8_t)(hi << 4 | lo));
+		text += 2;
+	}
+	return true;
+}
+
+static void decodeDump(const std::vector<uint8_t> &raw, unsigned dumpNo)
+{
+	if (raw.size() < 4 || raw[0] != ES100_TRACE_VERSION) {
+		printf("dump %u: unsupported header\n", dumpNo);
+		return;
+	}
+
+	unsigned count = raw[1];
+	unsigned lost  = raw[2] | raw[3] << 8;
+
+	if (raw.size() != 4 + count * RECORD_SIZE) {
+		printf("dump %u: truncated, %zu bytes for %u records\n", dumpNo, raw.size(), count);
+		return;
+	}
+
+	printf("dump %u: %u records, %u lost\n", dumpNo, count, lost);
+
+	uint32_t first = 0;
+
+	for (unsigned i = 0; i < count; i++) {
+		const uint8_t *rec = &raw[4 + i * RECORD_SIZE];
+		uint8_t  event = rec[0];
+		uint8_t  reg   = rec[1];
+		uint8_t  value = rec[2];
+		uint32_t us    = rec[3] | rec[4] << 8 | rec[5] << 16 | (uint32_t)rec[6] << 24;
+
+		if (i == 0)
+			first = us;
+
+		printf("  %10.3f ms  %-12s", (uint32_t)(us - first) / 1000.0, eventName(event));
+
+		switch (event) {
+			case 0x0A:
+				printf(" %s\n", stateName(value));
+				break;
+			case 0x0B:
+				printf(" in %s\n", stateName(value));
+				break;
+			case 0x0C:
+				printf(" %+d h\n", (int8_t)value);
+				break;
+			case 0x0D:
+			case 0x0E:
+				printf(" addr 0x%02X, %u bytes\n", reg, value);
+				break;
+			case 0x0F:
+				printf(" addr 0x%02X, %s\n", reg, value == 4 ? "NACK" : value == 6 ? "bus stuck" : "bus error");
+				break;
+			default:
+				printf(" reg 0x%02X, value 0x%02X\n", reg, value);
+				break;
+		}
+	}
+}
+
+int main()
+{
+	char		line[4096];
+	unsigned	dumps = 0;
+	const char	*tag = "ES100TRACE:";
+
+	while (fgets(line, sizeof(line), stdin)) {
+		const char *start = strstr(line, tag);
+		std::vector<uint8_t> raw;
+
+		if (!start)
+			continue;
+
+		if (!parseHex(start + strlen(tag), raw)) {
+			printf("dump %u: bad hex\n", ++dumps);
+			continue;
+		}
+		decodeDump(raw, ++dumps);
+	}
+
+	return 0;
+}
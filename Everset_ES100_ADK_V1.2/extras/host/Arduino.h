@@ -0,0 +1,229 @@
+/*
+Host (Linux) stand-in for the parts of the Arduino core used by the ES100
+library, see SimHost.cpp
+
+Time is simulated: millis() and micros() read the simulation clock, and
+delay(), digitalRead() and yield() advance it by what they would cost on
+a 16 MHz AVR. Advancing the clock runs the simulated devices, which
+drive the GPIO lines and fire attached interrupts.
+
+Of the AVR registers only SREG, Timer1 (SimTimer1), Timer2 (SimTimer2)
+and the TWI (SimTWI) are there.
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef uint8_t		byte;
+typedef bool		boolean;
+
+#define HIGH		1
+#define LOW			0
+
+#define INPUT			0
+#define OUTPUT			1
+#define INPUT_PULLUP	2
+
+#define CHANGE		1
+#define FALLING		2
+#define RISING		3
+
+#define DEC			10
+#define HEX			16
+#define BIN			2
+
+#define B00000001	0x01
+#define B00000010	0x02
+#define B00011000	0x18
+#define B01100000	0x60
+#define B10000000	0x80
+
+// Only D2 and D3 have an external interrupt. attachInterrupt() takes the
+// pin number, as the simulated pins are what raise it.
+#define NOT_AN_INTERRUPT			-1
+#define digitalPinToInterrupt(p)	((p) == 2 || (p) == 3 ? (p) : NOT_AN_INTERRUPT)
+
+static const uint8_t	SDA = 18;
+static const uint8_t	SCL = 19;
+#define F(s)						(s)
+
+#define F_CPU		16000000UL
+#define _BV(bit)	(1 << (bit))
+#define ISR(vector)	extern "C" void vector(void)
+
+/******************************************************************************
+ * Simulation clock
+ ******************************************************************************/
+uint64_t		simMicros();
+void			simAdvance(uint64_t us);
+
+inline unsigned long millis()	{ return (unsigned long)(uint32_t)(simMicros() / 1000); }
+inline unsigned long micros()	{ return (unsigned long)(uint32_t)simMicros(); }
+inline void delay(unsigned long ms)				{ simAdvance((uint64_t)ms * 1000); }
+inline void delayMicroseconds(unsigned int us)	{ simAdvance(us); }
+inline void yield()								{ simAdvance(1); }
+
+/******************************************************************************
+ * GPIO and interrupts
+ ******************************************************************************/
+void			pinMode(uint8_t pin, uint8_t mode);
+void			digitalWrite(uint8_t pin, uint8_t value);
+int				digitalRead(uint8_t pin);
+void			attachInterrupt(uint8_t irq, void (*isr)(void), int mode);
+void			detachInterrupt(uint8_t irq);
+void			noInterrupts();
+void			interrupts();
+
+// Only the I bit of SREG is modelled
+struct SimStatusRegister
+{
+	operator uint8_t() const;
+	SimStatusRegister	&operator=(uint8_t value);
+};
+
+extern SimStatusRegister	SREG;
+
+inline void cli()	{ noInterrupts(); }
+inline void sei()	{ interrupts(); }
+
+/******************************************************************************
+ * Timer1, see SimTimer1.cpp
+ ******************************************************************************/
+// TCCR1B
+#define CS10		0
+#define CS11		1
+#define CS12		2
+#define ICES1		6
+#define ICNC1		7
+// TIMSK1
+#define TOIE1		0
+#define OCIE1A		1
+#define OCIE1B		2
+#define ICIE1		5
+// TIFR1
+#define TOV1		0
+#define OCF1A		1
+#define OCF1B		2
+#define ICF1		5
+
+// Edges driven on this pin are captured into ICR1
+#define SIM_ICP1_PIN	8
+
+// TCNT1 counts with the simulation clock, TIFR1 clears the flags written as 1
+struct SimTimer1Count
+{
+	operator uint16_t() const;
+	SimTimer1Count	&operator=(uint16_t value);
+};
+
+struct SimTimer1Flags
+{
+	operator uint8_t() const;
+	SimTimer1Flags	&operator=(uint8_t value);
+};
+
+extern volatile uint8_t		TCCR1A, TCCR1B, TIMSK1;
+extern volatile uint16_t	OCR1A, OCR1B, ICR1;
+extern SimTimer1Count		TCNT1;
+extern SimTimer1Flags		TIFR1;
+
+/******************************************************************************
+ * Timer2, see SimTimer2.cpp
+ ******************************************************************************/
+// TCCR2A
+#define WGM21		1
+// TCCR2B
+#define CS20		0
+#define CS21		1
+#define CS22		2
+// TIMSK2, TIFR2
+#define OCIE2A		1
+#define OCF2A		1
+
+// CTC mode only, TCNT2 and TIFR2 are not read back
+extern volatile uint8_t		TCCR2A, TCCR2B, OCR2A, TIMSK2, TCNT2, TIFR2;
+
+/******************************************************************************
+ * TWI, see SimTWI.cpp
+ ******************************************************************************/
+// TWCR
+#define TWIE		0
+#define TWEN		2
+#define TWWC		3
+#define TWSTO		4
+#define TWSTA		5
+#define TWEA		6
+#define TWINT		7
+// TWSR
+#define TWPS0		0
+#define TWPS1		1
+
+// Writing TWCR starts the next bus event, reading it shows TWINT and TWSTO
+struct SimTWIControl
+{
+	operator uint8_t() const;
+	SimTWIControl	&operator=(uint8_t value);
+};
+
+extern volatile uint8_t		TWBR, TWSR, TWDR;
+extern SimTWIControl		TWCR;
+
+/******************************************************************************
+ * Serial
+ ******************************************************************************/
+class Print
+{
+	public:
+		virtual ~Print() { }
+		virtual size_t	write(uint8_t c) = 0;
+		virtual int		availableForWrite() { return 0; }
+
+		size_t	write(const char *s)				{ size_t n = 0; while (*s) n += write((uint8_t)*s++); return n; }
+		size_t	print(const char *s)				{ return write(s); }
+		size_t	print(char c)						{ return write((uint8_t)c); }
+		size_t	print(unsigned long v, int base = DEC);
+		size_t	print(long v, int base = DEC)		{ return v < 0 && base == DEC ? write('-') + print(-(unsigned long)v) : print((unsigned long)v, base); }
+		size_t	print(unsigned int v, int base = DEC)	{ return print((unsigned long)v, base); }
+		size_t	print(int v, int base = DEC)		{ return print((long)v, base); }
+		size_t	print(uint8_t v, int base = DEC)	{ return print((unsigned long)v, base); }
+		size_t	println()							{ return write('\n'); }
+
+		template<class T> size_t println(T v)		{ size_t n = print(v); return n + println(); }
+		template<class T> size_t println(T v, int base)	{ size_t n = print(v, base); return n + println(); }
+};
+
+// The AVR core's transmit buffer and UART timing: write() waits for room
+// once SIM_SERIAL_TX_BUFFER bytes are waiting, like the real one. Without
+// begin() bytes go out at once, as before.
+#define SIM_SERIAL_TX_BUFFER	64
+
+class HardwareSerial : public Print
+{
+	public:
+		void	begin(unsigned long baud);
+		void	reset();
+		int		available() { return 0; }
+		int		read() { return -1; }
+		int		availableForWrite();
+		size_t	write(uint8_t c);
+		operator bool() { return true; }
+
+		FILE		*out = stdout;			// Where the bytes go, NULL drops them
+		uint64_t	blockedMicros = 0;		// Time write() waited for room
+
+		using Print::write;
+
+	private:
+		uint32_t	_byteMicros = 0;		// 10 bits per byte, 0 before begin()
+		uint64_t	_doneAt = 0;			// Simulation time the last byte is out
+};
+
+extern HardwareSerial Serial;
+
+#endif
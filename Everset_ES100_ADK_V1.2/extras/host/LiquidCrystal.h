@@ -0,0 +1,63 @@
+/*
+Host (Linux) stand-in for the Arduino LiquidCrystal library
+
+Keeps the HD44780's display RAM and address counter, so a test can read
+back what the display shows, and counts the bytes sent to it. Every byte,
+character or command, advances the simulation clock by what the real
+library busy-waits for it in 4 bit mode on a 16 MHz AVR: two nibbles of
+five digitalWrite() calls and an enable pulse followed by 100 us. clear()
+and home() wait another 2 ms.
+*/
+
+#ifndef LiquidCrystal_h
+#define LiquidCrystal_h
+
+#include "SimHost.h"
+
+#define SIM_LCD_BYTE_COST		270			// us per byte sent
+#define SIM_LCD_CLEAR_COST		2000		// us more for clear() and home()
+#define SIM_LCD_DDRAM			0x80
+
+struct SimLCDStats
+{
+	uint32_t	bytes;					// Characters and commands
+	uint32_t	commands;
+	uint64_t	busyMicros;				// Simulated time spent sending them
+};
+
+class LiquidCrystal : public Print
+{
+	public:
+		LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3) { }
+
+		void	begin(uint8_t cols, uint8_t rows)	{ _cols = cols; clear(); }
+		void	clear()								{ _command(SIM_LCD_CLEAR_COST); memset(_ddram, ' ', sizeof(_ddram)); _ac = 0; }
+		void	home()								{ _command(SIM_LCD_CLEAR_COST); _ac = 0; }
+		void	setCursor(uint8_t col, uint8_t row)	{ _command(0); _ac = (_offset(row) + col) % SIM_LCD_DDRAM; }
+
+		size_t	write(uint8_t c)
+		{
+			_spend(SIM_LCD_BYTE_COST);
+			_ddram[_ac] = c;
+			_ac = (_ac + 1) % SIM_LCD_DDRAM;
+			return 1;
+		}
+
+		// What the display shows at col, row
+		char	at(uint8_t col, uint8_t row)		{ return _ddram[(_offset(row) + col) % SIM_LCD_DDRAM]; }
+
+		SimLCDStats		stats = { 0, 0, 0 };
+
+		using Print::write;
+
+	private:
+		uint8_t	_offset(uint8_t row)				{ static const uint8_t offsets[] = { 0x00, 0x40, 0x00, 0x40 }; return offsets[row & 3] + (row & 2 ? _cols : 0); }
+		void	_command(uint16_t extra)			{ stats.commands++; _spend(SIM_LCD_BYTE_COST + extra); }
+		void	_spend(uint16_t us)					{ stats.bytes++; stats.busyMicros += us; simAdvance(us); }
+
+		char	_ddram[SIM_LCD_DDRAM];
+		uint8_t	_ac = 0;
+		uint8_t	_cols = 16;
+};
+
+#endif
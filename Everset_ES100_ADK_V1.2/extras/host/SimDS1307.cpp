@@ -0,0 +1,156 @@
+/*
+Simulated DS1307 real time clock, see SimDS1307.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "SimDS1307.h"
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define DS1307_CONTROL_REG		0x07
+#define DS1307_CONTROL_OUT		0x80
+#define DS1307_CONTROL_SQWE		0x10
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+uint8_t SimDS1307::_bcd(uint8_t value)
+{
+	return ((value / 10) << 4) | (value % 10);
+}
+
+uint8_t SimDS1307::_dec(uint8_t value)
+{
+	return (value >> 4) * 10 + (value & 0x0F);
+}
+
+void SimDS1307::_load()
+{
+	int			year;
+	uint8_t		month, day, hour, minute, second;
+
+	es100BreakTime(_time, &year, &month, &day, &hour, &minute, &second);
+	_regs[0] = _bcd(second);
+	_regs[1] = _bcd(minute);
+	_regs[2] = _bcd(hour);
+	_regs[4] = _bcd(day);
+	_regs[5] = _bcd(month);
+	_regs[6] = _bcd(year - ES100_EPOCH_YEAR);
+}
+
+void SimDS1307::_sqw(uint8_t level)
+{
+	uint8_t		control = _regs[DS1307_CONTROL_REG];
+
+	// With SQWE clear the pin follows OUT
+	if (!(control & DS1307_CONTROL_SQWE))
+		level = (control & DS1307_CONTROL_OUT) ? HIGH : LOW;
+	simDrivePin(_sqwPin, level);
+}
+
+/******************************************************************************
+ * Control
+ ******************************************************************************/
+SimDS1307::SimDS1307(uint8_t sqwPin) : _sqwPin(sqwPin)
+{
+	memset(_regs, 0, sizeof(_regs));
+	_regs[DS1307_CONTROL_REG] = DS1307_CONTROL_OUT;
+}
+
+void SimDS1307::setTime(uint32_t time)
+{
+	_time	= time;
+	_tickAt	= simMicros() + 1000000;
+}
+
+uint32_t SimDS1307::getTime()
+{
+	return _time;
+}
+
+void SimDS1307::poke(uint8_t reg, uint8_t value)
+{
+	_regs[reg & (SIM_DS1307_REGS - 1)] = value;
+}
+
+/******************************************************************************
+ * SimDevice
+ ******************************************************************************/
+uint64_t SimDS1307::nextEvent()
+{
+	return _tickAt < _riseAt ? _tickAt : _riseAt;
+}
+
+void SimDS1307::run(uint64_t now)
+{
+	if (_tickAt <= now) {
+		_time++;
+		lastTickAt	= _tickAt;
+		_tickAt		+= 1000000;
+		_riseAt		= lastTickAt + 500000;
+		_sqw(LOW);
+	}
+
+	if (_riseAt <= now) {
+		_riseAt = SIM_NO_EVENT;
+		_sqw(HIGH);
+	}
+}
+
+/******************************************************************************
+ * SimI2CTarget
+ ******************************************************************************/
+uint8_t SimDS1307::address()
+{
+	return SIM_DS1307_ADDR;
+}
+
+bool SimDS1307::receive(const uint8_t *data, uint8_t numBytes)
+{
+	uint8_t		time = false;
+	uint8_t		restart = false;
+
+	if (numBytes == 0)
+		return true;
+
+	// Registers written are merged into the current time
+	_load();
+
+	_ptr = data[0] & (SIM_DS1307_REGS - 1);
+	for (uint8_t i = 1; i < numBytes; i++) {
+		restart	|= _ptr == 0;
+		time	|= _ptr <= 6 && _ptr != 3;
+		_regs[_ptr] = data[i];
+		_ptr = (_ptr + 1) & (SIM_DS1307_REGS - 1);
+	}
+
+	if (time)
+		_time = es100MakeTime(ES100_EPOCH_YEAR + _dec(_regs[6]), _dec(_regs[5]), _dec(_regs[4]),
+							  _dec(_regs[2] & 0x3F), _dec(_regs[1]), _dec(_regs[0] & 0x7F));
+
+	// The countdown chain starts over with SQW high
+	if (restart) {
+		_tickAt		= simMicros() + 1000000;
+		_riseAt		= SIM_NO_EVENT;
+		lastWriteAt	= simMicros();
+		writes++;
+	}
+	_sqw(restart || simPinLevel(_sqwPin));
+
+	return true;
+}
+
+uint8_t SimDS1307::transmit(uint8_t *data, uint8_t numBytes)
+{
+	_load();
+
+	for (uint8_t i = 0; i < numBytes; i++) {
+		data[i] = _regs[_ptr];
+		_ptr = (_ptr + 1) & (SIM_DS1307_REGS - 1);
+	}
+
+	return numBytes;
+}
@@ -0,0 +1,63 @@
+/*
+Simulated DS1307 real time clock for host builds of the ES100 ADK
+
+Models what the sketch can observe of the real part:
+- the time registers 0x00-0x06, the control register 0x07 and 56 bytes
+  of RAM behind i2c address 0x68, with a register pointer that wraps at
+  0x3F
+- a one second countdown chain that restarts when the seconds register
+  is written, so the next increment comes a full second after the write
+- SQW/OUT at 1 Hz when SQWE is set, falling as the seconds increment
+  and rising half a second later. Other rates are not modelled.
+
+Bytes reach the target at the STOP (see SimTWI), so a write restarts the
+chain up to a few byte times after the real part would.
+*/
+
+#ifndef SimDS1307_h
+#define SimDS1307_h
+
+#include "SimHost.h"
+#include "Wire.h"
+#include "ES100Time.h"
+
+#define SIM_DS1307_ADDR			0x68
+#define SIM_DS1307_REGS			0x40
+
+class SimDS1307 : public SimDevice, public SimI2CTarget
+{
+	public:
+		SimDS1307(uint8_t sqwPin);
+
+		void		setTime(uint32_t time);			// ES100Time seconds, restarts the chain
+		uint32_t	getTime();
+		void		poke(uint8_t reg, uint8_t value);	// Behind the driver's back, to corrupt RAM
+
+		uint64_t	lastTickAt = 0;					// Simulation time of the last increment
+		uint64_t	lastWriteAt = 0;				// Simulation time the seconds were last written
+		uint16_t	writes = 0;
+
+		// SimDevice
+		uint64_t	nextEvent();
+		void		run(uint64_t now);
+
+		// SimI2CTarget
+		uint8_t		address();
+		bool		receive(const uint8_t *data, uint8_t numBytes);
+		uint8_t		transmit(uint8_t *data, uint8_t numBytes);
+
+	private:
+		uint8_t		_bcd(uint8_t value);
+		uint8_t		_dec(uint8_t value);
+		void		_load();
+		void		_sqw(uint8_t level);
+
+		uint8_t		_sqwPin;
+		uint8_t		_regs[SIM_DS1307_REGS];			// Time registers are only current after a read
+		uint8_t		_ptr = 0;
+		uint32_t	_time = 0;
+		uint64_t	_tickAt = 1000000;
+		uint64_t	_riseAt = SIM_NO_EVENT;
+};
+
+#endif
@@ -0,0 +1,317 @@
+/*
+Simulated ES100 WWVB receiver, see SimES100.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "SimES100.h"
+
+#define CONTROL0_START			0x01
+#define CONTROL0_ANT1_OFF		0x02
+#define CONTROL0_ANT2_OFF		0x04
+#define CONTROL0_START_ANT2		0x08
+#define CONTROL0_TRACKING		0x10
+
+/******************************************************************************
+ * Constructors
+ ******************************************************************************/
+SimES100::SimES100(uint8_t enPin, uint8_t irqPin)
+{
+	_enPin	= enPin;
+	_irqPin	= irqPin;
+
+	memset(_regs, 0, sizeof(_regs));
+	memset(&stats, 0, sizeof(stats));
+}
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+uint8_t SimES100::_bcd(uint8_t value)
+{
+	return ((value / 10) << 4) | (value % 10);
+}
+
+void SimES100::_powerUp(uint64_t now)
+{
+	_powered	= true;
+	_ready		= false;
+	_receiving	= false;
+	_poweredAt	= now;
+	_readyAt	= now + bootTime;
+	_resultAt	= SIM_NO_EVENT;
+	_ptr		= 0;
+
+	memset(_regs, 0, sizeof(_regs));
+	_regs[ES100_DEVICE_ID_REG] = SIM_ES100_DEVICE_ID;
+
+	stats.enables++;
+	simDrivePin(_irqPin, LOW);
+}
+
+void SimES100::_powerDown(uint64_t now)
+{
+	_powered	= false;
+	_ready		= false;
+	_receiving	= false;
+	_readyAt	= SIM_NO_EVENT;
+	_resultAt	= SIM_NO_EVENT;
+
+	stats.onMicros += now - _poweredAt;
+	simDrivePin(_irqPin, LOW);
+}
+
+void SimES100::_writeRegister(uint8_t addr, uint8_t value)
+{
+	if (addr > ES100_CONTROL1_REG)
+		return;						// Everything past CONTROL1 is read-only
+
+	_regs[addr] = value;
+
+	if (addr != ES100_CONTROL0_REG)
+		return;
+
+	if (value & CONTROL0_START) {
+		if (!_receiving) {
+			_receiving	= true;
+			_antenna	= (value & CONTROL0_START_ANT2) ? 1 : 0;
+			stats.receptions++;
+			_startStep(simMicros());
+		}
+	} else {
+		_receiving	= false;
+		_resultAt	= SIM_NO_EVENT;
+	}
+}
+
+void SimES100::_startStep(uint64_t now)
+{
+	uint8_t		control0 = _regs[ES100_CONTROL0_REG];
+
+	if (control0 & CONTROL0_ANT1_OFF)
+		_antenna = 1;
+	else if (control0 & CONTROL0_ANT2_OFF)
+		_antenna = 0;
+
+	if (_step < _stepCount) {
+		_current = _steps[_step++];
+	} else if (goodHours != 0) {
+		uint8_t		hour = getUTC(now) / 3600 % 24;
+
+		memset(&_current, 0, sizeof(_current));
+		_current.duration	= (control0 & CONTROL0_TRACKING) ? 20000 : 134000;
+		_current.ok			= ((goodHours >> hour) & 1) && ((goodAntennas >> _antenna) & 1);
+		_current.antenna	= _antenna;
+	} else {
+		_resultAt = SIM_NO_EVENT;	// Out of script: no signal
+		return;
+	}
+
+	// Results are only ever reported on a second boundary
+	uint64_t	at = now + (uint64_t)_current.duration * 1000;
+	_resultAt = (at + 999999) / 1000000 * 1000000;
+}
+
+void SimES100::_completeStep(uint64_t now)
+{
+	const SimES100Step	&step = _current;
+	uint8_t				control0 = _regs[ES100_CONTROL0_REG];
+	uint8_t				tracking = (control0 & CONTROL0_TRACKING) != 0;
+	uint8_t				antenna = step.antenna;
+
+	_resultAt = SIM_NO_EVENT;
+
+	if (control0 & CONTROL0_ANT1_OFF)
+		antenna = 1;
+	else if (control0 & CONTROL0_ANT2_OFF)
+		antenna = 0;
+
+	// Alternating reception: the next cycle runs on the other antenna
+	_antenna ^= 1;
+
+	if (!step.ok) {
+		stats.failures++;
+		_regs[ES100_STATUS0_REG] = 0;
+		_raiseIRQ(now, SIM_ES100_IRQ_CYCLE_COMPLETE);
+
+		// A full reception keeps cycling, tracking is a single attempt
+		if (tracking)
+			_receiving = false;
+		else
+			_startStep(now);
+		return;
+	}
+
+	int			year;
+	uint8_t		month, day, hour, minute, second;
+	uint32_t	utc = getUTC(now);
+
+	es100BreakTime(utc, &year, &month, &day, &hour, &minute, &second);
+
+	// Tracking only re-phases the second, the date registers are untouched
+	if (!tracking) {
+		_regs[ES100_YEAR_REG]			= _bcd(year - ES100_EPOCH_YEAR);
+		_regs[ES100_MONTH_REG]			= _bcd(month);
+		_regs[ES100_DAY_REG]			= _bcd(day);
+		_regs[ES100_HOUR_REG]			= _bcd(hour);
+		_regs[ES100_MINUTE_REG]			= _bcd(minute);
+		_regs[ES100_NEXT_DST_MONTH_REG]	= _bcd(step.nextDstMonth);
+		_regs[ES100_NEXT_DST_DAY_REG]	= _bcd(step.nextDstDay);
+		_regs[ES100_NEXT_DST_HOUR_REG]	= _bcd(step.nextDstHour);
+	}
+	_regs[ES100_SECOND_REG] = _bcd(second);
+
+	_regs[ES100_STATUS0_REG] = 0x01 | (antenna << 1) | ((step.leapSecond & 0x03) << 3) |
+							   ((step.dstState & 0x03) << 5) | (tracking << 7);
+
+	stats.decodes++;
+	lastIrqUTC	= utc;
+	_receiving	= false;
+	_raiseIRQ(now, SIM_ES100_IRQ_RX_COMPLETE);
+}
+
+void SimES100::_raiseIRQ(uint64_t now, uint8_t status)
+{
+	_regs[ES100_IRQ_STATUS_REG] = status;
+
+	// IRQ- is held until IRQ_STATUS is read, a second event gives no new edge
+	if (simPinLevel(_irqPin) == HIGH) {
+		stats.irqs++;
+		lastIrqAt = now;
+	}
+	simDrivePin(_irqPin, LOW);
+}
+
+/******************************************************************************
+ * Script
+ ******************************************************************************/
+void SimES100::setUTC(uint32_t epoch)
+{
+	_utc = epoch;
+}
+
+uint32_t SimES100::getUTC(uint64_t at)
+{
+	return _utc + (uint32_t)(at / 1000000);
+}
+
+void SimES100::clearSteps()
+{
+	_stepCount	= 0;
+	_step		= 0;
+}
+
+void SimES100::addStep(const SimES100Step &step)
+{
+	if (_stepCount < SIM_ES100_STEPS)
+		_steps[_stepCount++] = step;
+}
+
+void SimES100::nackNext(uint8_t transactions)
+{
+	_nack = transactions;
+}
+
+/******************************************************************************
+ * SimDevice
+ ******************************************************************************/
+uint64_t SimES100::nextEvent()
+{
+	return _readyAt < _resultAt ? _readyAt : _resultAt;
+}
+
+void SimES100::run(uint64_t now)
+{
+	if (_readyAt <= now) {
+		_readyAt	= SIM_NO_EVENT;
+		_ready		= true;
+		simDrivePin(_irqPin, HIGH);
+	}
+
+	if (_resultAt <= now)
+		_completeStep(now);
+}
+
+void SimES100::pinChanged(uint8_t pin, uint8_t level)
+{
+	if (pin != _enPin || level == _powered)
+		return;
+
+	if (level)
+		_powerUp(simMicros());
+	else
+		_powerDown(simMicros());
+}
+
+/******************************************************************************
+ * SimI2CTarget
+ ******************************************************************************/
+uint8_t SimES100::address()
+{
+	return ES100_ADDR;
+}
+
+bool SimES100::receive(const uint8_t *data, uint8_t numBytes)
+{
+	if (!_ready)
+		return false;
+
+	if (_nack > 0) {
+		_nack--;
+		return false;
+	}
+
+	if (numBytes == 0)
+		return true;
+
+	_ptr = data[0];
+	for (uint8_t i = 1; i < numBytes; i++)
+		_writeRegister(_ptr++, data[i]);
+
+	return true;
+}
+
+uint8_t SimES100::transmit(uint8_t *data, uint8_t numBytes)
+{
+	if (!_ready)
+		return 0;
+
+	if (_nack > 0) {
+		_nack--;
+		return 0;
+	}
+
+	if (_readStart) {
+		_readStart	= false;
+		_readFirst	= _ptr;
+		_readCount	= 0;
+		stats.reads++;
+	}
+
+	// Bytes come one at a time, the window is complete on its last one
+	_readCount += numBytes;
+	if (_readFirst == ES100_IRQ_STATUS_REG && _readCount == ES100_NEXT_DST_HOUR_REG - ES100_IRQ_STATUS_REG + 1)
+		stats.windowReads++;
+
+	for (uint8_t i = 0; i < numBytes; i++, _ptr++) {
+		data[i] = _ptr <= ES100_DEVICE_ID_REG ? _regs[_ptr] : 0;
+
+		if (_ptr == ES100_IRQ_STATUS_REG) {
+			_regs[ES100_IRQ_STATUS_REG] = 0;
+			simDrivePin(_irqPin, HIGH);
+		}
+	}
+
+	return numBytes;
+}
+
+void SimES100::readStarted()
+{
+	_readStart = true;
+}
+
+bool SimES100::selected()
+{
+	return mux == NULL || mux->isSelected(channel);
+}
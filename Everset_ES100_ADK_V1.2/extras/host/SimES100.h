@@ -0,0 +1,131 @@
+/*
+Simulated ES100 WWVB receiver for host builds of the ES100 library
+
+Models what the driver can observe of the real part:
+- registers 0x00-0x0D behind i2c address 0x32 with an auto-incrementing
+  register pointer, reading IRQ_STATUS clears it and releases IRQ-.
+  Read transactions are counted, and which of them fetched the whole
+  IRQ_STATUS to NEXT_DST_HOUR window.
+- EN: the device NACKs the bus and holds IRQ- low while disabled and
+  for bootTime after EN goes high
+- a reception started through CONTROL0 runs the next step of a script.
+  A step completes on a second boundary of the simulated UTC clock and
+  either loads the BCD time registers and raises IRQ- with RX_COMPLETE,
+  or raises IRQ- with CYCLE_COMPLETE and moves on to the next step the
+  way the ES100 keeps cycling until stopped. When the script runs out
+  the device stays silent, which is what a dead antenna looks like.
+
+The reported time is the simulated UTC clock at the completing second,
+so a test can compare what the driver returns against the truth. For
+long runs goodHours replaces the script with a signal that is only
+decodable at certain hours of the day.
+*/
+
+#ifndef SimES100_h
+#define SimES100_h
+
+#include "SimHost.h"
+#include "SimI2CMux.h"
+#include "Wire.h"
+#include "ES100.h"
+
+#define SIM_ES100_STEPS			32
+#define SIM_ES100_BOOT_TIME		15000		// us, EN high to IRQ- high
+#define SIM_ES100_DEVICE_ID		0x10
+
+#define SIM_ES100_IRQ_RX_COMPLETE		0x01
+#define SIM_ES100_IRQ_CYCLE_COMPLETE	0x04
+
+struct SimES100Step
+{
+	uint32_t	duration;		// ms from start (or end of the previous step) to the result
+	uint8_t		ok;				// Decode succeeded
+	uint8_t		antenna;		// 0 antenna 1, 1 antenna 2
+	uint8_t		dstState;		// STATUS0 DST bits
+	uint8_t		leapSecond;		// STATUS0 LSW bits
+	uint8_t		nextDstMonth;
+	uint8_t		nextDstDay;
+	uint8_t		nextDstHour;
+};
+
+struct SimES100Stats
+{
+	uint16_t	enables;
+	uint16_t	receptions;		// Receptions started through CONTROL0
+	uint16_t	decodes;		// Steps that ended with RX_COMPLETE
+	uint16_t	failures;		// Steps that ended with CYCLE_COMPLETE
+	uint16_t	irqs;			// Falling edges driven on IRQ-
+	uint16_t	reads;			// Read transactions served
+	uint16_t	windowReads;	// ... of them IRQ_STATUS to NEXT_DST_HOUR in one go
+	uint64_t	onMicros;		// Time with EN high
+};
+
+class SimES100 : public SimDevice, public SimI2CTarget
+{
+	public:
+		SimES100(uint8_t enPin, uint8_t irqPin);
+
+		// Script
+		void		setUTC(uint32_t epoch);			// ES100 epoch seconds at simulation time 0
+		uint32_t	getUTC(uint64_t at);
+		void		clearSteps();
+		void		addStep(const SimES100Step &step);
+		void		nackNext(uint8_t transactions);	// Fail the next bus transactions
+		uint64_t	bootTime = SIM_ES100_BOOT_TIME;
+		// Once the script is used up, cycles decode in the UTC hours set here
+		// (bit n for hour n) and fail in the others. 0 keeps the device silent.
+		uint32_t	goodHours = 0;
+		// ... and only on the antennas set here, bit 0 antenna 1, bit 1 antenna 2
+		uint8_t		goodAntennas = 0x03;
+		SimI2CMux	*mux = NULL;					// Mux segment the device sits on, if any
+		uint8_t		channel = 0;
+
+		SimES100Stats	stats;
+		uint64_t	lastIrqAt = 0;					// Simulation time of the last IRQ- edge
+		uint32_t	lastIrqUTC = 0;					// UTC second the last decode reported
+
+		// SimDevice
+		uint64_t	nextEvent();
+		void		run(uint64_t now);
+		void		pinChanged(uint8_t pin, uint8_t level);
+
+		// SimI2CTarget
+		uint8_t		address();
+		bool		receive(const uint8_t *data, uint8_t numBytes);
+		uint8_t		transmit(uint8_t *data, uint8_t numBytes);
+		void		readStarted();
+		bool		selected();
+
+	private:
+		void		_powerUp(uint64_t now);
+		void		_powerDown(uint64_t now);
+		void		_writeRegister(uint8_t addr, uint8_t value);
+		void		_startStep(uint64_t now);
+		void		_completeStep(uint64_t now);
+		void		_raiseIRQ(uint64_t now, uint8_t status);
+		uint8_t		_bcd(uint8_t value);
+
+		uint8_t		_enPin;
+		uint8_t		_irqPin;
+		uint8_t		_regs[ES100_DEVICE_ID_REG + 1];
+		uint8_t		_ptr = 0;
+		uint8_t		_powered = false;
+		uint8_t		_ready = false;
+		uint8_t		_receiving = false;
+		uint8_t		_antenna = 0;						// Antenna of the running cycle
+		uint8_t		_nack = 0;
+		uint8_t		_readStart = false;					// Next transmit() begins a read
+		uint8_t		_readFirst = 0;						// Register the current read began at
+		uint8_t		_readCount = 0;						// Bytes it has sent
+		uint64_t	_readyAt = SIM_NO_EVENT;
+		uint64_t	_resultAt = SIM_NO_EVENT;
+		uint64_t	_poweredAt = 0;
+		uint32_t	_utc = 0;
+
+		SimES100Step	_steps[SIM_ES100_STEPS];
+		SimES100Step	_current;
+		uint8_t		_stepCount = 0;
+		uint8_t		_step = 0;
+};
+
+#endif
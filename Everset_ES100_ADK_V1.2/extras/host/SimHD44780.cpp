@@ -0,0 +1,99 @@
+/*
+Simulated HD44780 character display, see SimHD44780.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "SimHD44780.h"
+
+/******************************************************************************
+ * Constructor
+ ******************************************************************************/
+SimHD44780::SimHD44780(uint8_t rs, uint8_t enable, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7)
+{
+	_pins[0] = rs;
+	_pins[1] = enable;
+	_pins[2] = d4;
+	_pins[3] = d5;
+	_pins[4] = d6;
+	_pins[5] = d7;
+	memset(_ddram, ' ', sizeof(_ddram));
+}
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+void SimHD44780::_execute(uint8_t rs, uint8_t value)
+{
+	uint32_t	length = SIM_HD44780_EXEC;
+
+	stats.bytes++;
+
+	if (rs) {
+		_ddram[_ac] = value;
+		_ac = (_ac + 1) % SIM_HD44780_DDRAM;
+	} else {
+		stats.instructions++;
+
+		if (value & 0x80) {
+			_ac = value & 0x7F;
+		} else if (value & 0x40) {
+			// Character generator RAM, not modelled
+		} else if (value & 0x20) {
+			_fourBit = !(value & 0x10);
+		} else if (value == 0x01) {
+			memset(_ddram, ' ', sizeof(_ddram));
+			_ac		= 0;
+			length	= SIM_HD44780_CLEAR;
+		} else if ((value & 0xFE) == 0x02) {
+			_ac		= 0;
+			length	= SIM_HD44780_CLEAR;
+		}
+	}
+
+	_busyUntil = simMicros() + length;
+}
+
+/******************************************************************************
+ * Display
+ ******************************************************************************/
+char SimHD44780::at(uint8_t col, uint8_t row)
+{
+	static const uint8_t	offsets[] = { 0x00, 0x40, SIM_HD44780_COLS, 0x40 + SIM_HD44780_COLS };
+
+	return _ddram[(offsets[row & 3] + col) % SIM_HD44780_DDRAM];
+}
+
+/******************************************************************************
+ * SimDevice
+ ******************************************************************************/
+void SimHD44780::pinChanged(uint8_t pin, uint8_t level)
+{
+	uint8_t		nibble = 0;
+	uint8_t		rs;
+
+	if (pin != _pins[1] || level != LOW)
+		return;
+
+	rs = simPinLevel(_pins[0]);
+	for (uint8_t i = 0; i < 4; i++)
+		nibble |= simPinLevel(_pins[2 + i]) << i;
+
+	if (simMicros() < _busyUntil)
+		stats.early++;
+
+	if (!_fourBit) {
+		_execute(rs, nibble << 4);
+		return;
+	}
+
+	if (!_half) {
+		_high = nibble;
+		_half = true;
+		return;
+	}
+
+	_half = false;
+	_execute(rs, (_high << 4) | nibble);
+}
@@ -0,0 +1,62 @@
+/*
+Simulated HD44780 character display for host builds of the ES100 ADK
+
+Watches the six MCU pins of a 4 bit interface (RS, E, D4-D7), with R/W
+tied low as on the ADK. A nibble is latched on each falling edge of E.
+After reset the controller is in 8 bit mode, where every nibble is a
+whole instruction with the low bits 0, until a function set selects 4
+bit mode; from then on nibbles are taken in pairs.
+
+The display RAM, the address counter and the clear, home, set DDRAM
+address and function set instructions are modelled. Each instruction
+keeps the controller busy for its execution time. A nibble that arrives
+while it is busy is counted in stats.early, which a real part might
+have ignored or garbled; it is still executed here.
+*/
+
+#ifndef SimHD44780_h
+#define SimHD44780_h
+
+#include "SimHost.h"
+
+#define SIM_HD44780_COLS		20
+#define SIM_HD44780_DDRAM		0x80
+#define SIM_HD44780_EXEC		37			// us for most instructions and data
+#define SIM_HD44780_CLEAR		1520		// us for clear and home
+
+struct SimHD44780Stats
+{
+	uint32_t	bytes;				// Characters and instructions executed
+	uint32_t	instructions;
+	uint32_t	early;				// Nibbles sent while busy
+};
+
+class SimHD44780 : public SimDevice
+{
+	public:
+		SimHD44780(uint8_t rs, uint8_t enable, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7);
+
+		// What the display shows at col, row of a 20x4 panel
+		char		at(uint8_t col, uint8_t row);
+		uint8_t		isFourBit()		{ return _fourBit; }
+
+		SimHD44780Stats	stats = { 0, 0, 0 };
+
+		// SimDevice
+		uint64_t	nextEvent()		{ return SIM_NO_EVENT; }
+		void		run(uint64_t now) { }
+		void		pinChanged(uint8_t pin, uint8_t level);
+
+	private:
+		void		_execute(uint8_t rs, uint8_t value);
+
+		uint8_t		_pins[6];					// RS, E, D4-D7
+		char		_ddram[SIM_HD44780_DDRAM];
+		uint8_t		_ac = 0;
+		uint8_t		_fourBit = false;
+		uint8_t		_half = false;				// First nibble of a pair latched
+		uint8_t		_high = 0;
+		uint64_t	_busyUntil = 0;
+};
+
+#endif
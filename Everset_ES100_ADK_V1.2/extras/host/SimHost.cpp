@@ -0,0 +1,349 @@
+/*
+Simulation host for running the ES100 library on Linux, see SimHost.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "SimHost.h"
+#include "SimTimer1.h"
+#include "SimTimer2.h"
+#include "SimTWI.h"
+#include "Wire.h"
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+static uint64_t		now = 0;
+static SimDevice	*devices[SIM_DEVICES];
+static uint8_t		deviceCount = 0;
+
+static uint8_t		pinModes[SIM_PINS];
+static uint8_t		pinLevels[SIM_PINS];
+static uint8_t		pinLatches[SIM_PINS];		// PORT bit, driven once the pin is an output
+static void			(*isrs[SIM_PINS])(void);
+static int			isrModes[SIM_PINS];
+static uint8_t		isrPending[SIM_PINS];
+static uint8_t		masked = false;
+static uint32_t		interruptCount = 0;
+
+HardwareSerial		Serial;
+SimStatusRegister	SREG;
+TwoWire				Wire;
+
+static void fire(uint8_t pin)
+{
+	if (masked) {
+		isrPending[pin] = true;
+		return;
+	}
+
+	interruptCount++;
+	isrs[pin]();
+}
+
+static void drive(uint8_t pin, uint8_t level)
+{
+	if (pinLevels[pin] == level)
+		return;
+
+	pinLevels[pin] = level;
+
+	for (uint8_t i = 0; i < deviceCount; i++)
+		devices[i]->pinChanged(pin, level);
+}
+
+// The device with the earliest event, NULL if none has one
+static SimDevice *earliest(uint64_t *next)
+{
+	SimDevice	*device = NULL;
+
+	*next = SIM_NO_EVENT;
+	for (uint8_t i = 0; i < deviceCount; i++) {
+		uint64_t	at = devices[i]->nextEvent();
+		if (at < *next) {
+			*next	= at;
+			device	= devices[i];
+		}
+	}
+
+	return device;
+}
+
+/******************************************************************************
+ * Simulation clock
+ ******************************************************************************/
+uint64_t simMicros()
+{
+	return now;
+}
+
+uint64_t simNextEvent()
+{
+	uint64_t	next;
+
+	earliest(&next);
+	return next;
+}
+
+void simAdvance(uint64_t us)
+{
+	uint64_t	target = now + us;
+
+	// Run device events in time order, so an IRQ raised half way through
+	// a delay() is timestamped where it happened.
+	for (;;) {
+		uint64_t	next;
+		SimDevice	*device = earliest(&next);
+
+		if (device == NULL || next > target)
+			break;
+
+		if (next > now)
+			now = next;
+		device->run(now);
+	}
+
+	now = target;
+}
+
+void simReset()
+{
+	now			= 0;
+	deviceCount	= 0;
+	masked		= false;
+	interruptCount = 0;
+
+	memset(pinModes, INPUT, sizeof(pinModes));
+	memset(pinLevels, LOW, sizeof(pinLevels));
+	memset(pinLatches, LOW, sizeof(pinLatches));
+
+	// The i2c lines have pull-ups
+	pinLevels[SDA] = HIGH;
+	pinLevels[SCL] = HIGH;
+	memset(isrs, 0, sizeof(isrs));
+	memset(isrPending, 0, sizeof(isrPending));
+
+	Wire.detachAll();
+	memset(&Wire.stats, 0, sizeof(Wire.stats));
+
+	simTimer1.reset();
+	simAttach(&simTimer1);
+	simTimer2.reset();
+	simAttach(&simTimer2);
+	simTWI.reset();
+	simAttach(&simTWI);
+
+	Serial.reset();
+}
+
+void simAttach(SimDevice *device)
+{
+	if (deviceCount < SIM_DEVICES)
+		devices[deviceCount++] = device;
+}
+
+void simDrivePin(uint8_t pin, uint8_t level)
+{
+	uint8_t		old = pinLevels[pin];
+
+	pinLevels[pin] = level;
+
+	if (pin == SIM_ICP1_PIN && old != level)
+		simTimer1.capture(level);
+
+	if (isrs[pin] == NULL || old == level)
+		return;
+
+	if (isrModes[pin] == CHANGE ||
+		(isrModes[pin] == FALLING && level == LOW) ||
+		(isrModes[pin] == RISING && level == HIGH))
+		fire(pin);
+}
+
+uint8_t simPinLevel(uint8_t pin)
+{
+	return pinLevels[pin];
+}
+
+uint8_t simMasked()
+{
+	return masked;
+}
+
+uint32_t simInterruptCount()
+{
+	return interruptCount;
+}
+
+SimStatusRegister::operator uint8_t() const
+{
+	return masked ? 0x00 : 0x80;
+}
+
+SimStatusRegister &SimStatusRegister::operator=(uint8_t value)
+{
+	if (value & 0x80)
+		interrupts();
+	else
+		noInterrupts();
+	return *this;
+}
+
+/******************************************************************************
+ * GPIO and interrupts
+ ******************************************************************************/
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	uint8_t		was = pinModes[pin];
+
+	pinModes[pin] = mode;
+
+	if (mode == OUTPUT) {
+		drive(pin, pinLatches[pin]);
+	} else if (mode == INPUT_PULLUP) {
+		// Letting go of a line: the pull-up takes it high unless a device pulls it down again
+		pinLatches[pin] = HIGH;
+		if (was == OUTPUT)
+			drive(pin, HIGH);
+	}
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+	pinLatches[pin] = value;
+
+	// On an input this only switches the pull-up, the line stays with the device
+	if (pinModes[pin] == OUTPUT)
+		drive(pin, value);
+}
+
+int digitalRead(uint8_t pin)
+{
+	simAdvance(SIM_DIGITALREAD_COST);
+	return pinLevels[pin];
+}
+
+void attachInterrupt(uint8_t irq, void (*isr)(void), int mode)
+{
+	if (irq >= SIM_PINS)
+		return;
+
+	isrs[irq]		= isr;
+	isrModes[irq]	= mode;
+}
+
+void detachInterrupt(uint8_t irq)
+{
+	if (irq >= SIM_PINS)
+		return;
+
+	isrs[irq] = NULL;
+}
+
+void noInterrupts()
+{
+	masked = true;
+}
+
+void interrupts()
+{
+	masked = false;
+
+	for (uint8_t pin = 0; pin < SIM_PINS; pin++) {
+		if (isrPending[pin] && isrs[pin] != NULL) {
+			isrPending[pin] = false;
+			fire(pin);
+		}
+	}
+
+	for (uint8_t i = 0; i < deviceCount; i++)
+		devices[i]->unmasked();
+}
+
+/******************************************************************************
+ * Serial
+ ******************************************************************************/
+size_t Print::print(unsigned long v, int base)
+{
+	char	buf[33];
+	int		i = sizeof(buf) - 1;
+
+	buf[i] = '\0';
+	do {
+		buf[--i] = "0123456789ABCDEF"[v % base];
+		v /= base;
+	} while (v);
+
+	return print(&buf[i]);
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+	_byteMicros	= baud ? 10000000UL / baud : 0;
+	_doneAt		= simMicros();
+}
+
+void HardwareSerial::reset()
+{
+	begin(0);
+	out				= stdout;
+	blockedMicros	= 0;
+}
+
+int HardwareSerial::availableForWrite()
+{
+	uint64_t	now = simMicros();
+	uint32_t	queued;
+
+	if (_byteMicros == 0 || _doneAt <= now)
+		return SIM_SERIAL_TX_BUFFER - 1;
+
+	// The byte in the shift register has left the buffer
+	queued = (_doneAt - now + _byteMicros - 1) / _byteMicros - 1;
+	return queued < SIM_SERIAL_TX_BUFFER - 1 ? SIM_SERIAL_TX_BUFFER - 1 - queued : 0;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+	uint64_t	start = simMicros();
+
+	if (_byteMicros != 0) {
+		// Room for one more once the buffer is down to SIM_SERIAL_TX_BUFFER - 1
+		if (availableForWrite() == 0)
+			simAdvance(_doneAt - (uint64_t)(SIM_SERIAL_TX_BUFFER - 1) * _byteMicros - start);
+		blockedMicros += simMicros() - start;
+		_doneAt = (_doneAt > simMicros() ? _doneAt : simMicros()) + _byteMicros;
+	}
+
+	if (out != NULL && fputc(c, out) == EOF)
+		return 0;
+	return 1;
+}
+
+/******************************************************************************
+ * Wire
+ ******************************************************************************/
+SimI2CTarget *TwoWire::find(uint8_t addr)
+{
+	for (uint8_t i = 0; i < SIM_WIRE_DEVICES; i++)
+		if (_targets[i] != NULL && _targets[i]->address() == addr && _targets[i]->selected())
+			return _targets[i];
+
+	return NULL;
+}
+
+void TwoWire::attach(SimI2CTarget *target)
+{
+	for (uint8_t i = 0; i < SIM_WIRE_DEVICES; i++) {
+		if (_targets[i] == NULL) {
+			_targets[i] = target;
+			return;
+		}
+	}
+}
+
+void TwoWire::detachAll()
+{
+	memset(_targets, 0, sizeof(_targets));
+}
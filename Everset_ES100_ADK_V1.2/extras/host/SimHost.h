@@ -0,0 +1,49 @@
+/*
+Simulation host for running the ES100 library on Linux
+
+Owns the simulation clock, the GPIO lines and SREG behind the Arduino.h
+and Wire.h stand-ins. Simulated devices register here; the clock only
+moves when the code under test spends time (delay(), digitalRead(),
+waiting on the bus in yield()) or when the test calls simAdvance(). Device events that fall
+inside an advance are run in time order, and a device changing an input
+line fires the interrupt attached to that pin unless interrupts are
+masked, in which case the edge is delivered by interrupts(); an edge on
+SIM_ICP1_PIN is captured by Timer1 as well. The MCU's
+Timer1 (SimTimer1), Timer2 (SimTimer2) and TWI (SimTWI) are always
+attached and cost nothing while idle.
+*/
+
+#ifndef SimHost_h
+#define SimHost_h
+
+#include "Arduino.h"
+
+#define SIM_PINS				32
+#define SIM_DEVICES				8
+#define SIM_NO_EVENT			UINT64_MAX
+#define SIM_DIGITALREAD_COST	4			// us, digitalRead() on a 16 MHz AVR
+
+class SimDevice
+{
+	public:
+		virtual ~SimDevice() { }
+		// Absolute time of the next internal event, SIM_NO_EVENT if none
+		virtual uint64_t	nextEvent() = 0;
+		virtual void		run(uint64_t now) = 0;
+		// An MCU output pin changed level, or went back to its pull-up
+		virtual void		pinChanged(uint8_t pin, uint8_t level) { }
+		// interrupts() was called, deliver what was held back while masked
+		virtual void		unmasked() { }
+};
+
+void		simReset();
+// Time of the next event of any device, SIM_NO_EVENT if nothing is due
+uint64_t	simNextEvent();
+void		simAttach(SimDevice *device);
+// Drive an MCU input pin from a device, firing the attached interrupt on a matching edge
+void		simDrivePin(uint8_t pin, uint8_t level);
+uint8_t		simPinLevel(uint8_t pin);
+uint8_t		simMasked();
+uint32_t	simInterruptCount();
+
+#endif
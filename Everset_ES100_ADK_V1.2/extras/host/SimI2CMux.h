@@ -0,0 +1,44 @@
+/*
+Simulated TCA9548A i2c mux for host builds of the ES100 library
+
+A single control register selects which of the eight downstream
+segments are connected. Targets behind the mux answer only while their
+channel is selected, see SimI2CTarget::selected().
+*/
+
+#ifndef SimI2CMux_h
+#define SimI2CMux_h
+
+#include "Wire.h"
+
+class SimI2CMux : public SimI2CTarget
+{
+	public:
+		SimI2CMux(uint8_t addr) : _addr(addr) { }
+
+		uint8_t		address() { return _addr; }
+		bool		isSelected(uint8_t channel) { return (_control >> channel) & 1; }
+
+		bool receive(const uint8_t *data, uint8_t numBytes)
+		{
+			if (numBytes > 0) {
+				_control = data[numBytes - 1];
+				writes++;
+			}
+			return true;
+		}
+
+		uint8_t transmit(uint8_t *data, uint8_t numBytes)
+		{
+			memset(data, _control, numBytes);
+			return numBytes;
+		}
+
+		uint16_t	writes = 0;
+
+	private:
+		uint8_t		_addr;
+		uint8_t		_control = 0;
+};
+
+#endif
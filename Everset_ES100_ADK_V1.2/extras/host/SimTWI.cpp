@@ -0,0 +1,239 @@
+/*
+Simulated TWI (i2c master) of the ATmega328, see SimTWI.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "SimTWI.h"
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+// What the next TWINT clear clocks out
+#define PHASE_IDLE		0			// Nothing, the last byte was NACKed or no START yet
+#define PHASE_ADDRESS	1			// The address byte in TWDR
+#define PHASE_WRITE		2			// A data byte from TWDR
+#define PHASE_READ		3			// A data byte from the target into TWDR
+
+volatile uint8_t	TWBR, TWSR, TWDR;
+SimTWIControl		TWCR;
+SimTWI				simTWI;
+
+// The handler the code under test may define with ISR()
+extern "C" void TWI_vect(void) __attribute__((weak));
+
+/******************************************************************************
+ * Registers
+ ******************************************************************************/
+SimTWIControl::operator uint8_t() const
+{
+	return simTWI.control();
+}
+
+SimTWIControl &SimTWIControl::operator=(uint8_t value)
+{
+	simTWI.setControl(value);
+	return *this;
+}
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+void SimTWI::_schedule(uint8_t bits, uint8_t status)
+{
+	// SCL = F_CPU / (16 + 2 * TWBR * 4^prescaler)
+	uint64_t	cycles = 16 + 2ULL * TWBR * (1 << (2 * (TWSR & (_BV(TWPS0) | _BV(TWPS1)))));
+
+	_length	= (bits * cycles * 1000000ULL + F_CPU - 1) / F_CPU;
+	_at		= simMicros() + _length;
+	_status	= status;
+}
+
+void SimTWI::_deliver()
+{
+	if (_phase == PHASE_WRITE && _target != NULL && _len > 0)
+		_target->receive(_buf, _len);
+	_len = 0;
+}
+
+void SimTWI::_interrupt()
+{
+	if (!(_twcr & _BV(TWIE)) || TWI_vect == NULL)
+		return;
+
+	if (simMasked()) {
+		_pending = true;
+		return;
+	}
+
+	TWI_vect();
+}
+
+/******************************************************************************
+ * Control
+ ******************************************************************************/
+void SimTWI::reset()
+{
+	TWBR	= 0;
+	TWSR	= 0;
+	TWDR	= 0;
+
+	_twcr		= 0;
+	_phase		= PHASE_IDLE;
+	_busy		= false;
+	_pending	= false;
+	_at			= SIM_NO_EVENT;
+	_target		= NULL;
+	_len		= 0;
+	_hold		= 0;
+	recoveryClocks = 0;
+	maskedClocks = 0;
+}
+
+void SimTWI::holdSDA(uint8_t clocks)
+{
+	_hold = clocks;
+	simDrivePin(SDA, LOW);
+}
+
+uint8_t SimTWI::control()
+{
+	// A STOP is sent at once, so TWSTO always reads back as clear
+	return _twcr;
+}
+
+void SimTWI::setControl(uint8_t value)
+{
+	// TWINT is cleared by writing it as 1, TWSTO and TWSTA only act
+	uint8_t		go = value & _BV(TWINT);
+
+	_twcr = (value & ~(_BV(TWINT) | _BV(TWSTO))) | (go ? 0 : (_twcr & _BV(TWINT)));
+
+	if (!(value & _BV(TWEN))) {
+		// Disabling the TWI drops whatever it was doing
+		_at		= SIM_NO_EVENT;
+		_busy	= false;
+		_phase	= PHASE_IDLE;
+		return;
+	}
+
+	// With SDA held low the TWI waits for a free bus forever
+	if (!go || _hold > 0)
+		return;
+
+	_pending = false;
+
+	if (value & _BV(TWSTO)) {
+		_deliver();
+		_busy	= false;
+		_phase	= PHASE_IDLE;
+		_target	= NULL;
+	}
+
+	if (value & _BV(TWSTA)) {
+		_deliver();
+		_schedule(1, _busy ? 0x10 : 0x08);
+		_busy	= true;
+		_phase	= PHASE_ADDRESS;
+		return;
+	}
+
+	switch (_phase) {
+		case PHASE_ADDRESS:
+			Wire.stats.transactions++;
+			_target	= Wire.find(TWDR >> 1);
+			_len	= 0;
+
+			if (TWDR & 1) {
+				if (_target != NULL)
+					_target->readStarted();
+				if (_target != NULL && _target->transmit(&_rx, 1) == 1) {
+					_phase = PHASE_READ;
+					_schedule(9, 0x40);
+				} else {
+					Wire.stats.nacks++;
+					_phase = PHASE_IDLE;
+					_schedule(9, 0x48);
+				}
+			} else {
+				if (_target != NULL && _target->receive(_buf, 0)) {
+					_phase = PHASE_WRITE;
+					_schedule(9, 0x18);
+				} else {
+					Wire.stats.nacks++;
+					_phase = PHASE_IDLE;
+					_schedule(9, 0x20);
+				}
+			}
+			break;
+
+		case PHASE_WRITE:
+			if (_len < SIM_TWI_BUFFER)
+				_buf[_len++] = TWDR;
+			Wire.stats.bytes++;
+			_schedule(9, 0x28);
+			break;
+
+		case PHASE_READ:
+			// The master's ACK asks the target for the next byte
+			TWDR = _rx;
+			Wire.stats.bytes++;
+			if (value & _BV(TWEA)) {
+				if (_target->transmit(&_rx, 1) != 1)
+					_rx = 0xFF;
+				_schedule(9, 0x50);
+			} else {
+				_phase = PHASE_IDLE;
+				_schedule(9, 0x58);
+			}
+			break;
+	}
+}
+
+/******************************************************************************
+ * SimDevice
+ ******************************************************************************/
+uint64_t SimTWI::nextEvent()
+{
+	return _at;
+}
+
+void SimTWI::run(uint64_t now)
+{
+	_at = SIM_NO_EVENT;
+	Wire.stats.busMicros += _length;
+
+	TWSR	= (TWSR & (_BV(TWPS0) | _BV(TWPS1))) | _status;
+	_twcr	|= _BV(TWINT);
+
+	_interrupt();
+}
+
+void SimTWI::pinChanged(uint8_t pin, uint8_t level)
+{
+	if (_hold == 0)
+		return;
+
+	if (pin == SCL && level == HIGH && !(_twcr & _BV(TWEN))) {
+		recoveryClocks++;
+		if (simMasked())
+			maskedClocks++;
+		if (--_hold == 0) {
+			simDrivePin(SDA, HIGH);
+			return;
+		}
+	}
+
+	// The stuck target keeps pulling SDA down
+	if (pin == SDA && level == HIGH)
+		simDrivePin(SDA, LOW);
+}
+
+void SimTWI::unmasked()
+{
+	if (_pending && (_twcr & _BV(TWINT))) {
+		_pending = false;
+		_interrupt();
+	}
+}
@@ -0,0 +1,67 @@
+/*
+Simulated TWI (i2c master) of the ATmega328, behind the register
+stand-ins in Arduino.h
+
+Every write to TWCR with TWINT set starts one bus event: a START, the
+address byte or a data byte. The event ends a bit time (START) or nine
+bit times (a byte) later at the SCL frequency set by TWBR and the TWSR
+prescaler; TWINT is then set, TWSR holds the master mode status code and
+TWI_vect runs if TWIE is set, from interrupts() if they are masked. A
+STOP takes no time.
+
+The bytes go to the targets attached to Wire, which also counts them.
+Writes are collected and handed to the target at the STOP or repeated
+start, reads are fetched one byte at a time as the master clocks them.
+Arbitration and bus errors are not modelled.
+
+holdSDA() stands in for a target stuck in the middle of a byte: SDA is
+held low, so no START gets onto the bus and the TWI never sets TWINT,
+until SCL has been clocked by hand (with TWEN clear) enough times.
+*/
+
+#ifndef SimTWI_h
+#define SimTWI_h
+
+#include "SimHost.h"
+#include "Wire.h"
+
+#define SIM_TWI_BUFFER		32
+
+class SimTWI : public SimDevice
+{
+	public:
+		void		reset();
+		uint8_t		control();
+		void		setControl(uint8_t value);
+		void		holdSDA(uint8_t clocks);
+
+		uint64_t	nextEvent();
+		void		run(uint64_t now);
+		void		unmasked();
+		void		pinChanged(uint8_t pin, uint8_t level);
+
+		uint16_t	recoveryClocks = 0;		// SCL pulses seen while SDA was held
+		uint16_t	maskedClocks = 0;		// Of those, pulses with interrupts masked
+
+	private:
+		void		_schedule(uint8_t bits, uint8_t status);
+		void		_deliver();
+		void		_interrupt();
+
+		uint8_t		_twcr = 0;
+		uint8_t		_phase = 0;				// What the next TWINT clear clocks out, see SimTWI.cpp
+		uint8_t		_busy = false;			// START sent, no STOP yet
+		uint8_t		_pending = false;		// TWINT set while interrupts were masked
+		uint64_t	_at = SIM_NO_EVENT;		// End of the bus event in progress
+		uint64_t	_length = 0;			// us, length of the bus event in progress
+		uint8_t		_status = 0;			// TWSR status at _at
+		SimI2CTarget	*_target = NULL;
+		uint8_t		_buf[SIM_TWI_BUFFER];	// Bytes written in the current transaction
+		uint8_t		_len = 0;
+		uint8_t		_rx = 0;				// Byte the target puts on the bus next
+		uint8_t		_hold = 0;				// SCL pulses until SDA is let go, 0 if not held
+};
+
+extern SimTWI	simTWI;
+
+#endif
@@ -0,0 +1,234 @@
+/*
+Simulated Timer1 of the ATmega328, see SimTimer1.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <math.h>
+#include "SimTimer1.h"
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define SOURCES		3
+
+volatile uint8_t	TCCR1A, TCCR1B, TIMSK1;
+volatile uint16_t	OCR1A, OCR1B, ICR1;
+SimTimer1Count		TCNT1;
+SimTimer1Flags		TIFR1;
+SimTimer1			simTimer1;
+
+// Handlers the code under test may define with ISR()
+extern "C" void TIMER1_COMPA_vect(void) __attribute__((weak));
+extern "C" void TIMER1_COMPB_vect(void) __attribute__((weak));
+extern "C" void TIMER1_OVF_vect(void) __attribute__((weak));
+extern "C" void TIMER1_CAPT_vect(void) __attribute__((weak));
+
+// In vector order, which is the priority order. The TIMSK1 enable bit of
+// each source is at the same position as its TIFR1 flag. The input
+// capture comes before all of them and is not scheduled like them, a
+// device's edge triggers it.
+static const uint8_t	sourceFlags[SOURCES] = { OCF1A, OCF1B, TOV1 };
+
+static void (*sourceVectors(uint8_t source))(void)
+{
+	switch (source) {
+		case 0:		return TIMER1_COMPA_vect;
+		case 1:		return TIMER1_COMPB_vect;
+		default:	return TIMER1_OVF_vect;
+	}
+}
+
+/******************************************************************************
+ * Registers
+ ******************************************************************************/
+SimTimer1Count::operator uint16_t() const
+{
+	return simTimer1.count();
+}
+
+SimTimer1Count &SimTimer1Count::operator=(uint16_t value)
+{
+	simTimer1.setCount(value);
+	return *this;
+}
+
+SimTimer1Flags::operator uint8_t() const
+{
+	return simTimer1.flags();
+}
+
+SimTimer1Flags &SimTimer1Flags::operator=(uint8_t value)
+{
+	simTimer1.clearFlags(value);
+	return *this;
+}
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+uint64_t SimTimer1::_ticksAt(uint64_t at)
+{
+	long double	rate = SIM_TIMER1_TICKS_PER_US * (1.0L + ppb * 1e-9L);
+
+	return (uint64_t)((int64_t)floorl(at * rate) + _offset);
+}
+
+uint64_t SimTimer1::_timeOf(uint64_t tick)
+{
+	long double	rate = SIM_TIMER1_TICKS_PER_US * (1.0L + ppb * 1e-9L);
+
+	return (uint64_t)ceill((long double)((int64_t)tick - _offset) / rate);
+}
+
+uint8_t SimTimer1::_next(uint64_t *tick)
+{
+	uint8_t		next = SOURCES;
+
+	if ((TCCR1B & (_BV(CS10) | _BV(CS11) | _BV(CS12))) == 0)
+		return SOURCES;
+
+	for (uint8_t source = 0; source < SOURCES; source++) {
+		uint8_t		flag = sourceFlags[source];
+		uint16_t	match = flag == TOV1 ? 0 : flag == OCF1A ? OCR1A : OCR1B;
+		// Sources after the last delivered one may still fire on its tick
+		uint64_t	from = source > _doneSource ? _done : _done + 1;
+		uint64_t	at;
+
+		if (!(TIMSK1 & _BV(flag)))
+			continue;
+
+		at = from + (uint16_t)(match - (uint16_t)from);
+		if (next == SOURCES || at < *tick) {
+			next	= source;
+			*tick	= at;
+		}
+	}
+
+	return next;
+}
+
+void SimTimer1::_handle(uint8_t source)
+{
+	void	(*vector)(void) = sourceVectors(source);
+
+	_flags &= ~_BV(sourceFlags[source]);
+	if (vector != NULL)
+		vector();
+}
+
+void SimTimer1::_handleCapture()
+{
+	_flags &= ~_BV(ICF1);
+	if (TIMER1_CAPT_vect != NULL)
+		TIMER1_CAPT_vect();
+}
+
+/******************************************************************************
+ * Control
+ ******************************************************************************/
+void SimTimer1::reset()
+{
+	TCCR1A	= 0;
+	TCCR1B	= 0;
+	TIMSK1	= 0;
+	OCR1A	= 0;
+	OCR1B	= 0;
+	ICR1	= 0;
+
+	ppb			= 0;
+	_offset		= 0;
+	_done		= 0;
+	_doneSource	= SOURCES;
+	_flags		= 0;
+}
+
+uint16_t SimTimer1::count()
+{
+	return (uint16_t)_ticksAt(simMicros());
+}
+
+void SimTimer1::setCount(uint16_t value)
+{
+	uint64_t	now = _ticksAt(simMicros());
+
+	_offset		+= (int64_t)value - (uint16_t)now;
+	_done		= _ticksAt(simMicros());
+	_doneSource	= SOURCES;
+}
+
+uint8_t SimTimer1::flags()
+{
+	return _flags;
+}
+
+void SimTimer1::clearFlags(uint8_t mask)
+{
+	_flags &= ~mask;
+}
+
+// The count is latched on the edge whatever the CPU is doing, only the
+// interrupt waits for interrupts()
+void SimTimer1::capture(uint8_t level)
+{
+	if ((TCCR1B & (_BV(CS10) | _BV(CS11) | _BV(CS12))) == 0)
+		return;
+	if (level != ((TCCR1B & _BV(ICES1)) ? HIGH : LOW))
+		return;
+
+	ICR1	= count();
+	_flags	|= _BV(ICF1);
+
+	if ((TIMSK1 & _BV(ICIE1)) && !simMasked())
+		_handleCapture();
+}
+
+/******************************************************************************
+ * SimDevice
+ ******************************************************************************/
+uint64_t SimTimer1::nextEvent()
+{
+	uint64_t	tick;
+	uint64_t	at;
+
+	// Stopped, the usual case: writing TCNT1 on start catches _done up
+	if ((TCCR1B & (_BV(CS10) | _BV(CS11) | _BV(CS12))) == 0)
+		return SIM_NO_EVENT;
+
+	if (_next(&tick) == SOURCES) {
+		// Nothing can fire: enabling a source later only sees the ticks from then on
+		_done		= _ticksAt(simMicros());
+		_doneSource	= SOURCES;
+		return SIM_NO_EVENT;
+	}
+
+	at = _timeOf(tick);
+	return at > simMicros() ? at : simMicros();
+}
+
+void SimTimer1::run(uint64_t now)
+{
+	uint64_t	tick;
+	uint8_t		source;
+
+	while ((source = _next(&tick)) != SOURCES && _timeOf(tick) <= now) {
+		_done		= tick;
+		_doneSource	= source;
+
+		if (simMasked())
+			_flags |= _BV(sourceFlags[source]);
+		else
+			_handle(source);
+	}
+}
+
+void SimTimer1::unmasked()
+{
+	if ((_flags & _BV(ICF1)) && (TIMSK1 & _BV(ICIE1)))
+		_handleCapture();
+
+	for (uint8_t source = 0; source < SOURCES; source++)
+		if ((_flags & _BV(sourceFlags[source])) && (TIMSK1 & _BV(sourceFlags[source])))
+			_handle(source);
+}
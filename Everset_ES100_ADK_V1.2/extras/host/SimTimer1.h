@@ -0,0 +1,53 @@
+/*
+Simulated Timer1 of the ATmega328, behind the register stand-ins in
+Arduino.h
+
+Only what the ES100 library uses is modelled: normal mode counting at
+F_CPU/8 whenever a clock select bit is set, the overflow and the two
+output compare interrupts, and the input capture of an edge that a
+device drives on SIM_ICP1_PIN into ICR1. The counter derives from the simulation
+clock, skewed by ppb to stand in for the error of the MCU's crystal
+against true time; millis() and micros() are left exact. An event that
+happens while interrupts are masked sets its TIFR1 flag and the handler
+runs from interrupts(), highest priority first, like on the AVR.
+*/
+
+#ifndef SimTimer1_h
+#define SimTimer1_h
+
+#include "SimHost.h"
+
+#define SIM_TIMER1_TICKS_PER_US		(F_CPU / 8 / 1000000.0)
+
+class SimTimer1 : public SimDevice
+{
+	public:
+		void		reset();
+		uint16_t	count();
+		void		setCount(uint16_t value);
+		uint8_t		flags();
+		void		clearFlags(uint8_t mask);
+		void		capture(uint8_t level);
+
+		uint64_t	nextEvent();
+		void		run(uint64_t now);
+		void		unmasked();
+
+		int32_t		ppb = 0;		// Crystal error, > 0 counts fast
+
+	private:
+		uint64_t	_ticksAt(uint64_t at);
+		uint64_t	_timeOf(uint64_t tick);
+		uint8_t		_next(uint64_t *tick);
+		void		_handle(uint8_t flag);
+		void		_handleCapture();
+
+		int64_t		_offset = 0;	// Added to the ticks derived from the clock
+		uint64_t	_done = 0;		// Last tick that events were delivered for
+		uint8_t		_doneSource = 3;	// Source delivered on _done, 3 if none
+		uint8_t		_flags = 0;
+};
+
+extern SimTimer1	simTimer1;
+
+#endif
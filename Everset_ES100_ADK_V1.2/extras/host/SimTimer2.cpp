@@ -0,0 +1,84 @@
+/*
+Simulated Timer2 of the ATmega328, see SimTimer2.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "SimTimer2.h"
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define CLOCKS_PER_US		(F_CPU / 1000000UL)
+
+volatile uint8_t	TCCR2A, TCCR2B, OCR2A, TIMSK2, TCNT2, TIFR2;
+SimTimer2			simTimer2;
+
+// The handler the code under test may define with ISR()
+extern "C" void TIMER2_COMPA_vect(void) __attribute__((weak));
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+// CPU clocks between compare matches, 0 if stopped
+uint32_t SimTimer2::_period()
+{
+	static const uint16_t	prescalers[] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+
+	return (uint32_t)(OCR2A + 1) * prescalers[TCCR2B & (_BV(CS20) | _BV(CS21) | _BV(CS22))];
+}
+
+/******************************************************************************
+ * Control
+ ******************************************************************************/
+void SimTimer2::reset()
+{
+	TCCR2A	= 0;
+	TCCR2B	= 0;
+	OCR2A	= 0;
+	TIMSK2	= 0;
+	TCNT2	= 0;
+	TIFR2	= 0;
+
+	_done		= 0;
+	_pending	= false;
+}
+
+/******************************************************************************
+ * SimDevice
+ ******************************************************************************/
+uint64_t SimTimer2::nextEvent()
+{
+	uint64_t	period = _period();
+	uint64_t	from = _done + 1 > simMicros() ? _done + 1 : simMicros();
+
+	if (period == 0 || !(TIMSK2 & _BV(OCIE2A)))
+		return SIM_NO_EVENT;
+
+	// The first match at or after from, in whole us
+	return ((from * CLOCKS_PER_US + period - 1) / period * period + CLOCKS_PER_US - 1) / CLOCKS_PER_US;
+}
+
+void SimTimer2::run(uint64_t now)
+{
+	_done = now;
+
+	if (simMasked()) {
+		_pending = true;
+		return;
+	}
+
+	if (TIMER2_COMPA_vect != NULL)
+		TIMER2_COMPA_vect();
+}
+
+void SimTimer2::unmasked()
+{
+	if (!_pending)
+		return;
+
+	_pending = false;
+	if ((TIMSK2 & _BV(OCIE2A)) && TIMER2_COMPA_vect != NULL)
+		TIMER2_COMPA_vect();
+}
@@ -0,0 +1,35 @@
+/*
+Simulated Timer2 of the ATmega328, behind the register stand-ins in
+Arduino.h
+
+Only what LCDQueue uses is modelled: CTC mode with the compare A
+interrupt. The counter runs from the start of the simulation, so compare
+matches fall on multiples of (OCR2A + 1) prescaled clocks whenever a
+clock select bit is set; OCIE2A only decides whether they interrupt. A
+match while interrupts are masked runs the handler from interrupts().
+*/
+
+#ifndef SimTimer2_h
+#define SimTimer2_h
+
+#include "SimHost.h"
+
+class SimTimer2 : public SimDevice
+{
+	public:
+		void		reset();
+
+		uint64_t	nextEvent();
+		void		run(uint64_t now);
+		void		unmasked();
+
+	private:
+		uint32_t	_period();
+
+		uint64_t	_done = 0;			// Simulation time of the last match delivered
+		uint8_t		_pending = false;	// Match while interrupts were masked
+};
+
+extern SimTimer2	simTimer2;
+
+#endif
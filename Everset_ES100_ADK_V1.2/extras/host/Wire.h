@@ -0,0 +1,59 @@
+/*
+Host (Linux) stand-in for the i2c bus, see SimHost.cpp
+
+The ES100 library drives the TWI registers itself (I2CBus), so nothing
+of the Wire library is left but the name: Wire holds the simulated
+devices on the bus, registered with Wire.attach(), and counts the
+traffic SimTWI moves to them, so a test can see what an API call costs
+on the bus.
+*/
+
+#ifndef Wire_h
+#define Wire_h
+
+#include "Arduino.h"
+
+#define SIM_WIRE_DEVICES		4
+
+class SimI2CTarget
+{
+	public:
+		virtual ~SimI2CTarget() { }
+		virtual uint8_t	address() = 0;
+		// Returns false to NACK the address, e.g. while powered down. Called
+		// with no data on the address, then with the bytes written at the STOP.
+		virtual bool	receive(const uint8_t *data, uint8_t numBytes) = 0;
+		// Returns the number of bytes sent, 0 to NACK the address. Called
+		// for one byte at a time.
+		virtual uint8_t	transmit(uint8_t *data, uint8_t numBytes) = 0;
+		// Called on the address of a read, right before its first transmit()
+		virtual void	readStarted() { }
+		// False while a mux has the target's segment switched off
+		virtual bool	selected() { return true; }
+};
+
+struct SimWireStats
+{
+	uint32_t	transactions;			// Address bytes sent
+	uint32_t	bytes;					// Data bytes moved
+	uint32_t	nacks;					// Address bytes not acknowledged
+	uint64_t	busMicros;				// Simulated time spent on the wire
+};
+
+class TwoWire
+{
+	public:
+		void		attach(SimI2CTarget *target);
+		void		detachAll();
+		// The target answering addr, NULL if none is on the bus
+		SimI2CTarget	*find(uint8_t addr);
+
+		SimWireStats	stats;
+
+	private:
+		SimI2CTarget	*_targets[SIM_WIRE_DEVICES] = { NULL };
+};
+
+extern TwoWire Wire;
+
+#endif
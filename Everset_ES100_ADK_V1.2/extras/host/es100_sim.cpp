@@ -0,0 +1,1935 @@
+/*
+Host-side simulation runner for the ES100 library
+
+Builds the ES100 library (every .cpp next to the ADK sketch) for Linux
+against the Arduino.h / Wire.h / LiquidCrystal.h stand-ins in this
+directory, with a simulated ES100 (SimES100), DS1307 (SimDS1307) and
+HD44780 display (SimHD44780).
+Simulated time only advances when the code spends it, so a ten minute
+reception replays in milliseconds.
+
+Without arguments it runs the built-in scenarios, prints what each ES100
+API call costs on the bus and in simulated time, and exits non-zero if
+any check failed, so it can run in CI. With a script file it replays the
+script instead, see example.scn for the syntax.
+
+Build and run on Linux, from this directory:
+  g++ -std=gnu++11 -O2 -I. -I../.. -I../telemetry -o es100_sim *.cpp \
+      ../telemetry/TelemetryDecoder.cpp $(find ../.. -maxdepth 1 -name '*.cpp')
+  ./es100_sim
+  ./es100_sim example.scn
+
+Add -DES100_TRACE_LEVEL=3 to get the driver trace after each scripted
+reception, ready for extras/es100_trace_decode.
+*/
+
+#include <stdlib.h>
+#include <time.h>
+#include <chrono>
+#include <vector>
+
+#include "SimHost.h"
+#include "SimES100.h"
+#include "SimTimer1.h"
+#include "SimTWI.h"
+#include "SimDS1307.h"
+#include "SimHD44780.h"
+#include "ES100.h"
+#include "ES100Sync.h"
+#include "ES100Diversity.h"
+#include "ES100Antenna.h"
+#include "ES100PPS.h"
+#include "ES100Trace.h"
+#include "DS1307.h"
+#include "SyncJournal.h"
+#include "LCDFrame.h"
+#include "LCDQueue.h"
+#include "Telemetry.h"
+#include "TelemetryDecoder.h"
+#include <LiquidCrystal.h>
+
+#define IRQ_PIN			2
+#define EN_PIN			13
+#define PPS_PIN			7
+#define SQW_PIN			3
+#define LOOP_PERIOD		1000		// us between poll() calls, like the ADK loop()
+
+static int		checks = 0;
+static int		failures = 0;
+
+#define CHECK(cond)		check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char *what, int line)
+{
+	checks++;
+	if (ok)
+		return;
+
+	failures++;
+	printf("  FAIL line %d: %s\n", line, what);
+}
+
+/******************************************************************************
+ * Bench
+ ******************************************************************************/
+struct Bench
+{
+	SimES100	dev;
+	ES100		es100;
+
+	Bench(uint8_t irqPin = IRQ_PIN) : dev(EN_PIN, irqPin)
+	{
+		simReset();
+		simAttach(&dev);
+		Wire.attach(&dev);
+		I2C.begin(I2C_DEFAULT_CLOCK);
+		es100.begin(irqPin, EN_PIN);
+		dev.setUTC(es100MakeTime(2024, 3, 10, 6, 58, 0));
+	}
+
+	void step(uint32_t duration, uint8_t ok, uint8_t antenna = 0, uint8_t dstState = 0)
+	{
+		SimES100Step	s = { duration, ok, antenna, dstState, 0, 11, 3, 2 };
+		dev.addStep(s);
+	}
+
+	uint8_t reception(uint8_t tracking = false)
+	{
+		uint8_t		state;
+
+		es100.beginRx(millis(), tracking);
+		do {
+			simAdvance(LOOP_PERIOD);
+			state = es100.poll(millis());
+		} while (state != ES100_STATE_DONE && state != ES100_STATE_TIMEOUT);
+
+		return state;
+	}
+};
+
+/******************************************************************************
+ * API cost
+ ******************************************************************************/
+struct Cost
+{
+	SimWireStats	wire;
+	uint64_t		start;
+	std::chrono::steady_clock::time_point	host;
+
+	void begin()
+	{
+		wire	= Wire.stats;
+		start	= simMicros();
+		host	= std::chrono::steady_clock::now();
+	}
+
+	void end(const char *call)
+	{
+		long	ns = (long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now() - host).count();
+
+		printf("  %-26s %4u %6u %10llu %10llu %10ld\n", call,
+			   Wire.stats.transactions - wire.transactions, Wire.stats.bytes - wire.bytes,
+			   (unsigned long long)(Wire.stats.busMicros - wire.busMicros),
+			   (unsigned long long)(simMicros() - start), ns);
+	}
+};
+
+static void benchmark()
+{
+	Bench	b;
+	Cost	cost;
+
+	printf("API cost (bus transactions, bytes, bus us, simulated us, host ns)\n");
+
+	b.step(134000, true, 1, 2);
+
+	cost.begin();
+	b.es100.enable();
+	cost.end("enable()");
+
+	cost.begin();
+	b.es100.getDeviceID();
+	cost.end("getDeviceID()");
+
+	cost.begin();
+	b.es100.startRx();
+	cost.end("startRx()");
+
+	// Let the decode complete without touching the bus
+	simAdvance(140000000ULL);
+
+	cost.begin();
+	b.es100.getIRQStatus();
+	cost.end("getIRQStatus() stale");
+
+	cost.begin();
+	b.es100.getIRQStatus();
+	cost.end("getIRQStatus() cached");
+
+	cost.begin();
+	b.es100.getDateTime();
+	cost.end("getDateTime() cached");
+
+	cost.begin();
+	b.es100.getData();
+	cost.end("getData() cached");
+
+	cost.begin();
+	b.es100.readSnapshot();
+	cost.end("readSnapshot()");
+
+	cost.begin();
+	b.es100.stopRx();
+	cost.end("stopRx()");
+
+	cost.begin();
+	b.es100.disable();
+	cost.end("disable()");
+
+	Bench	full;
+	full.step(134000, false);
+	full.step(134000, true);
+
+	cost.begin();
+	full.reception();
+	cost.end("beginRx()..poll() DONE");
+	printf("\n");
+}
+
+/******************************************************************************
+ * Scenarios
+ ******************************************************************************/
+static void decodeAfterFailedCycles()
+{
+	Bench	b;
+
+	ES100Stats	stats;
+
+	printf("decode after two failed cycles\n");
+	stats.setHour(6);
+	b.es100.setStats(&stats);
+	b.step(134000, false);
+	b.step(134000, false);
+	b.step(134000, true, 1, 2);
+
+	uint8_t			state = b.reception();
+	ES100Data		data = b.es100.getData();
+	ES100PhaseTimes	phase = b.es100.getPhaseTimes();
+
+	CHECK(state == ES100_STATE_DONE);
+	CHECK(data.irqStatus == 0x01);
+	CHECK(data.status.rxOk == 1);
+	CHECK(data.status.antenna == 1);
+	CHECK(b.es100.getEpoch() == b.dev.lastIrqUTC);
+	CHECK(data.irq.micros == (uint32_t)b.dev.lastIrqAt);
+	CHECK(phase.irqCount == 3);
+	CHECK(b.dev.stats.irqs == 3);
+	CHECK(b.es100.getIRQDropped() == 0);
+	CHECK(simPinLevel(EN_PIN) == LOW);
+
+	// Cycles alternate from antenna 1, the decode came in on antenna 2
+	CHECK(stats.getReceptions() == 1 && stats.getDecodes() == 1);
+	CHECK(stats.getCycles(0) == 1 && stats.getCycles(1) == 2);
+	CHECK(stats.getAntennaDecodes(0) == 0 && stats.getAntennaDecodes(1) == 1);
+	CHECK(stats.getIRQCodes(ES100_STATS_IRQ_CYCLE_COMPLETE) == 2);
+	CHECK(stats.getIRQCodes(ES100_STATS_IRQ_RX_COMPLETE) == 1);
+	CHECK(stats.getMedianBucket() == 4 && stats.getTimeToFixLow(4) == 256);
+	CHECK(stats.getHourRate(6) == 100 && stats.getHourRate(7) == ES100_STATS_NO_RATE);
+}
+
+// Every decode cycle ends in one IRQ, which costs one burst read of the
+// register window and nothing else; the getters are served from it
+static void snapshotReads()
+{
+	Bench	b;
+
+	printf("one window read per decode cycle\n");
+	b.step(134000, false);
+	b.step(134000, false);
+	b.step(134000, true, 1, 2);
+
+	CHECK(b.reception() == ES100_STATE_DONE);
+	CHECK(b.dev.stats.irqs == 3);
+	CHECK(b.dev.stats.reads == b.dev.stats.irqs);
+	CHECK(b.dev.stats.windowReads == b.dev.stats.irqs);
+
+	uint16_t	reads = b.dev.stats.reads;
+
+	b.es100.getIRQStatus();
+	b.es100.getStatus0();
+	b.es100.getDateTime();
+	b.es100.getData();
+	CHECK(b.dev.stats.reads == reads);
+}
+
+static void localTime()
+{
+	Bench	b;
+
+	printf("local time with DST\n");
+	b.es100.timezone	= -5;
+	b.es100.DSTenabled	= true;
+	b.step(60000, true, 0, 2);
+
+	CHECK(b.reception() == ES100_STATE_DONE);
+
+	ES100DateTime	utc;
+	int				year;
+	ES100DateTime	local = b.es100.getDateTime();
+
+	es100BreakTime(b.dev.lastIrqUTC - 4 * 3600L, &year, &utc.month, &utc.day,
+				   &utc.hour, &utc.minute, &utc.second);
+
+	CHECK(local.year == year - ES100_EPOCH_YEAR);
+	CHECK(local.month == utc.month && local.day == utc.day);
+	CHECK(local.hour == utc.hour && local.minute == utc.minute && local.second == utc.second);
+	CHECK(b.es100.getNextDst().month == 11);
+}
+
+// ES100::shiftTime() as it was before ES100Time.h, kept for the timing
+// below. monthDim is indexed with the 1-based month, so it is padded to
+// keep December in bounds; the answers it gives are counted, not checked.
+static void legacyShiftTime(int *year, int *month, int *day, int *hours, int *minutes, int *seconds)
+{
+	int monthDim[] = { 31,28,31,30,31,30,31,31,30,31,30,31,31 };
+
+	while (*seconds < 0)		{ *seconds += 60;	*minutes -= 1; }
+	while (*seconds >= 60)		{ *seconds -= 60;	*minutes += 1; }
+	while (*minutes < 0)		{ *minutes += 60;	*hours -= 1; }
+	while (*minutes >= 60)		{ *minutes -= 60;	*hours += 1; }
+	while (*hours < 0)			{ *hours += 24;		*day -= 1; }
+	while (*hours >= 24)		{ *hours -= 24;		*day += 1; }
+	while (*day < 0)			{ *month -= 1;		*day += monthDim[*month]; }
+	while (*day > monthDim[*month])	{ *day -= monthDim[*month];	*month += 1; }
+	while (*month > 12)			{ *month -= 12;		*year += 1; }
+	while (*month < 1)			{ *month += 12;		*year -= 1; }
+}
+
+// Every hour of 2000-2099, at a minute and second that walk through the
+// hour, against gmtime() / timegm(): the round trip through ES100Time.h
+// and the local time getDateTime() derives with each offset
+static void epochRange()
+{
+	static const int32_t	offsets[] = {
+		-12 * 3600L, -(9 * 3600L + 30 * 60), -5 * 3600L, -4 * 3600L, 0,
+		1 * 3600L, 5 * 3600L + 45 * 60, 14 * 3600L
+	};
+	const uint32_t			hours = (uint32_t)es100DaysFromCivil(2100, 1, 1) * 24;
+	const time_t			unixEpoch = 946684800;		// 2000-01-01T00:00:00Z
+	uint32_t				roundTrip = 0, shifted = 0, legacyWrong = 0;
+	volatile uint32_t		sink = 0;		// Keeps the timed loops from being dropped
+
+	printf("epoch arithmetic, every hour of 2000-2099\n");
+
+	for (uint32_t h = 0; h < hours; h++) {
+		uint32_t	t = h * 3600 + (h * 61) % 3600;
+		time_t		ref = unixEpoch + t;
+		struct tm	tm;
+		int			year;
+		uint8_t		month, day, hour, minute, second;
+
+		gmtime_r(&ref, &tm);
+		es100BreakTime(t, &year, &month, &day, &hour, &minute, &second);
+		if (year == tm.tm_year + 1900 && month == tm.tm_mon + 1 && day == tm.tm_mday &&
+			hour == tm.tm_hour && minute == tm.tm_min && second == tm.tm_sec &&
+			es100MakeTime(year, month, day, hour, minute, second) == (uint32_t)(timegm(&tm) - unixEpoch))
+			roundTrip++;
+
+		for (uint8_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+			time_t		local = ref + offsets[i];
+			struct tm	lt;
+
+			// Before 2000-01-01 UTC + offset the local time is not representable
+			if ((int64_t)t + offsets[i] < 0) {
+				shifted++;
+				continue;
+			}
+
+			gmtime_r(&local, &lt);
+			es100BreakTime(t + offsets[i], &year, &month, &day, &hour, &minute, &second);
+			if (year == lt.tm_year + 1900 && month == lt.tm_mon + 1 && day == lt.tm_mday &&
+				hour == lt.tm_hour && minute == lt.tm_min && second == lt.tm_sec)
+				shifted++;
+
+			if (offsets[i] % 3600 == 0) {
+				int		y = tm.tm_year + 1900, mo = tm.tm_mon + 1, d = tm.tm_mday;
+				int		hr = tm.tm_hour + offsets[i] / 3600, mn = tm.tm_min, sc = tm.tm_sec;
+
+				legacyShiftTime(&y, &mo, &d, &hr, &mn, &sc);
+				if (y != lt.tm_year + 1900 || mo != lt.tm_mon + 1 || d != lt.tm_mday || hr != lt.tm_hour)
+					legacyWrong++;
+			}
+		}
+	}
+
+	CHECK(roundTrip == hours);
+	CHECK(shifted == hours * (sizeof(offsets) / sizeof(offsets[0])));
+
+	// The conversion getDateTime() does, timed on the same fields with
+	// the same -5 h shift: fields to epoch and back, against the loops on
+	// the fields the old driver ran
+	struct Fields { uint16_t year; uint8_t month, day, hour, minute, second; };
+	std::vector<Fields>	fields(hours);
+
+	for (uint32_t h = 0; h < hours; h++) {
+		int		year;
+
+		es100BreakTime(h * 3600 + (h * 61) % 3600, &year, &fields[h].month, &fields[h].day,
+					   &fields[h].hour, &fields[h].minute, &fields[h].second);
+		fields[h].year = year;
+	}
+
+	std::chrono::steady_clock::time_point	start = std::chrono::steady_clock::now();
+	for (uint32_t h = 0; h < hours; h++) {
+		const Fields	&f = fields[h];
+		int				year;
+		uint8_t			month, day, hour, minute, second;
+
+		es100BreakTime(es100MakeTime(f.year, f.month, f.day, f.hour, f.minute, f.second) - 5 * 3600L,
+					   &year, &month, &day, &hour, &minute, &second);
+		sink += year + month + day + hour + minute + second;
+	}
+	double		newNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / hours;
+
+	start = std::chrono::steady_clock::now();
+	for (uint32_t h = 0; h < hours; h++) {
+		const Fields	&f = fields[h];
+		int				year = f.year, month = f.month, day = f.day;
+		int				hour = f.hour - 5, minute = f.minute, second = f.second;
+
+		legacyShiftTime(&year, &month, &day, &hour, &minute, &second);
+		sink += year + month + day + hour + minute + second;
+	}
+	double		oldNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / hours;
+
+	printf("  %u hours, %u round trips and %u shifted times match\n", hours, roundTrip, shifted);
+	printf("  old shiftTime() wrong for %u whole-hour shifts\n", legacyWrong);
+	printf("  host ns per shift: epoch %.1f, old shiftTime() %.1f\n", newNs, oldNs);
+}
+
+static void transitions()
+{
+	Bench				b;
+	ES100Transitions	tr;
+	SimES100Step		beginsToday	= { 60000, true, 0, 2, 3, 3, 10, 2 };
+	SimES100Step		inEffect	= { 60000, true, 0, 3, 0, 11, 3, 2 };
+
+	printf("DST and leap second instants\n");
+	b.es100.timezone	= -5;
+	b.es100.DSTenabled	= true;
+
+	// 06:59 UTC on the day DST begins at 02:00 EST, a leap second at the end of March
+	b.dev.addStep(beginsToday);
+	CHECK(b.reception() == ES100_STATE_DONE);
+	tr = b.es100.getTransitions();
+	CHECK(tr.dstAt == es100MakeTime(2024, 3, 10, 7, 0, 0) && tr.dst == 0);
+	CHECK(tr.leapAt == es100MakeTime(2024, 4, 1, 0, 0, 0) && tr.leap == 1);
+	CHECK(b.es100.getLocalOffset() == -5 * 3600L && b.es100.getDateTime().hour == 1);
+	CHECK(b.es100.getLocalOffsetAt(tr.dstAt - 1) == -5 * 3600L);
+	CHECK(b.es100.getLocalOffsetAt(tr.dstAt) == -4 * 3600L);
+
+	// Once in effect the registers name the end of DST, 02:00 EDT
+	b.dev.addStep(inEffect);
+	CHECK(b.reception() == ES100_STATE_DONE);
+	tr = b.es100.getTransitions();
+	CHECK(tr.dstAt == es100MakeTime(2024, 11, 3, 6, 0, 0) && tr.dst == 1);
+	CHECK(tr.leapAt == 0 && tr.leap == 0);
+	CHECK(b.es100.getLocalOffsetAt(tr.dstAt) == -5 * 3600L);
+
+	b.es100.DSTenabled = false;
+	CHECK(b.es100.getLocalOffsetAt(tr.dstAt - 1) == -5 * 3600L);
+}
+
+static void tracking()
+{
+	Bench	b;
+
+	printf("tracking reception\n");
+	b.step(20000, true);
+
+	CHECK(b.reception(true) == ES100_STATE_DONE);
+
+	ES100Data	data = b.es100.getData();
+
+	CHECK(data.status.tracking == 1);
+	CHECK(data.status.antenna == 1);		// CONTROL0 0x13 switches antenna 1 off
+	CHECK(data.dateTime.second == b.dev.lastIrqUTC % 60);
+}
+
+static void noSignal()
+{
+	Bench	b;
+
+	ES100Stats	stats;
+
+	printf("no signal\n");
+	b.es100.setStats(&stats);
+	b.es100.rxTimeout = 60000;
+
+	CHECK(b.reception() == ES100_STATE_TIMEOUT);
+	CHECK(b.es100.getPhaseTimes().timedOutIn == ES100_STATE_RX);
+	CHECK(b.dev.stats.receptions == 1);
+	CHECK(simPinLevel(EN_PIN) == LOW);
+	CHECK(stats.getReceptions() == 1 && stats.getDecodes() == 0);
+	CHECK(stats.getHourRate(0) == 0);
+}
+
+static void slowBoot()
+{
+	Bench	b;
+
+	printf("device never ready\n");
+	b.dev.bootTime = 5000000;
+
+	CHECK(b.reception() == ES100_STATE_TIMEOUT);
+	CHECK(b.es100.getPhaseTimes().timedOutIn == ES100_STATE_ENABLING);
+	CHECK(b.dev.stats.receptions == 0);
+}
+
+static void scheduledDay()
+{
+	Bench		b;
+	ES100Sync	sync;
+	uint8_t		kind = ES100_SYNC_NONE;
+	uint8_t		receiving = false;
+
+	printf("one day of scheduled receptions\n");
+	b.step(134000, true);
+	for (uint8_t i = 0; i < 8; i++)
+		b.step(i == 1 ? 15000 : 20000, i != 1);
+
+	// Same flow as the ADK loop(), with the loop period stretched while idle
+	while (simMicros() < 86400000000ULL) {
+		if (!receiving) {
+			kind = sync.next(millis());
+			if (kind != ES100_SYNC_NONE) {
+				b.es100.rxTimeout = sync.rxTimeout(kind);
+				b.es100.beginRx(millis(), kind == ES100_SYNC_TRACKING);
+				sync.started(kind, millis());
+				receiving = true;
+			}
+		}
+
+		if (receiving) {
+			uint8_t state = b.es100.poll(millis());
+			if (state == ES100_STATE_DONE || state == ES100_STATE_TIMEOUT) {
+				sync.finished(state == ES100_STATE_DONE, millis());
+				receiving = false;
+			}
+		}
+
+		simAdvance(receiving ? LOOP_PERIOD : 100000);
+	}
+
+	ES100SyncStats	stats = sync.getStats(millis());
+
+	printf("  full %u/%u, tracking %u/%u, receiver on %llus\n",
+		   stats.fullOk, stats.full, stats.trackingOk, stats.tracking,
+		   (unsigned long long)(b.dev.stats.onMicros / 1000000));
+
+	CHECK(stats.full == 1 && stats.fullOk == 1);
+	CHECK(stats.tracking >= 4 && stats.trackingOk == stats.tracking - 1);
+	CHECK(b.dev.stats.onMicros < 600000000ULL);
+}
+
+struct ScheduleResult
+{
+	ES100SyncStats	stats;
+	uint64_t		onMicros;
+	uint64_t		maxGap;				// Longest time between good receptions
+	uint16_t		lastDayOk;			// Good receptions in the last day
+	uint16_t		hourScore[24];
+};
+
+// goodHours turn into laterHours from day shiftDay on
+static ScheduleResult runSchedule(uint8_t windowHours, uint32_t goodHours, uint8_t days,
+								  uint32_t laterHours = 0, uint8_t shiftDay = 0xFF)
+{
+	Bench			b;
+	ES100Sync		sync;
+	ScheduleResult	result;
+	uint8_t			receiving = false;
+	uint64_t		lastGood = 0;
+
+	b.dev.goodHours		= goodHours;
+	sync.windowHours	= windowHours;
+	result.maxGap		= 0;
+	result.lastDayOk	= 0;
+
+	while (simMicros() < days * 86400000000ULL) {
+		if (simMicros() >= shiftDay * 86400000000ULL)
+			b.dev.goodHours = laterHours;
+		sync.setHour(b.dev.getUTC(simMicros()) / 3600 % 24);
+
+		if (!receiving) {
+			uint8_t kind = sync.next(millis());
+			if (kind != ES100_SYNC_NONE) {
+				b.es100.rxTimeout = sync.rxTimeout(kind);
+				b.es100.beginRx(millis(), kind == ES100_SYNC_TRACKING);
+				sync.started(kind, millis());
+				receiving = true;
+			}
+		}
+
+		if (receiving) {
+			uint8_t state = b.es100.poll(millis());
+			if (state == ES100_STATE_DONE || state == ES100_STATE_TIMEOUT) {
+				sync.finished(state == ES100_STATE_DONE, millis());
+				receiving = false;
+				if (state == ES100_STATE_DONE) {
+					if (simMicros() - lastGood > result.maxGap)
+						result.maxGap = simMicros() - lastGood;
+					lastGood = simMicros();
+					if (simMicros() >= (days - 1) * 86400000000ULL)
+						result.lastDayOk++;
+				}
+			}
+		}
+
+		simAdvance(receiving ? LOOP_PERIOD : 100000);
+	}
+
+	result.stats	= sync.getStats(millis());
+	result.onMicros	= b.dev.stats.onMicros;
+	for (uint8_t h = 0; h < 24; h++)
+		result.hourScore[h] = sync.getHourScore(h);
+	return result;
+}
+
+static void adaptiveWindows()
+{
+	// WWVB only decodes from 03:00 to 08:59 UTC at this site
+	uint32_t		night = 0x1F8;
+	ScheduleResult	fixed = runSchedule(24, night, 14);
+	ScheduleResult	adaptive = runSchedule(ES100_SYNC_WINDOW_HOURS, night, 14);
+
+	printf("two weeks at a night-only site\n");
+	printf("  any hour: full %u/%u, tracking %u/%u, receiver on %llus, longest gap %llus\n",
+		   fixed.stats.fullOk, fixed.stats.full, fixed.stats.trackingOk, fixed.stats.tracking,
+		   (unsigned long long)(fixed.onMicros / 1000000), (unsigned long long)(fixed.maxGap / 1000000));
+	printf("  windowed: full %u/%u, tracking %u/%u, receiver on %llus, longest gap %llus\n",
+		   adaptive.stats.fullOk, adaptive.stats.full, adaptive.stats.trackingOk, adaptive.stats.tracking,
+		   (unsigned long long)(adaptive.onMicros / 1000000), (unsigned long long)(adaptive.maxGap / 1000000));
+
+	CHECK(adaptive.onMicros < fixed.onMicros);
+	CHECK(adaptive.stats.full - adaptive.stats.fullOk < fixed.stats.full - fixed.stats.fullOk);
+	CHECK(adaptive.maxGap <= (ES100_SYNC_DEADLINE + ES100_SYNC_URGENT_BACKOFF + ES100_SYNC_FULL_TIMEOUT) * 1000ULL);
+}
+
+static void propagationShift()
+{
+	// A week of night-only decodes, then the season moves them to 12:00 to
+	// 17:59 UTC, long after the first sync when tracking is all that runs
+	uint32_t		night = 0x1F8;
+	uint32_t		later = 0x3F000;
+	ScheduleResult	r = runSchedule(ES100_SYNC_WINDOW_HOURS, night, 21, later, 7);
+	uint8_t			followed = 0;
+
+	printf("propagation shifting after a week\n");
+	printf("  full %u/%u, tracking %u/%u, good receptions on the last day %u\n  hour scores:",
+		   r.stats.fullOk, r.stats.full, r.stats.trackingOk, r.stats.tracking, r.lastDayOk);
+	for (uint8_t h = 0; h < 24; h++)
+		printf(" %u", r.hourScore[h]);
+	printf("\n");
+
+	// The windows are the hours no more than windowHours others beat
+	for (uint8_t h = 0; h < 24; h++) {
+		uint8_t	better = 0;
+
+		for (uint8_t o = 0; o < 24; o++)
+			if (r.hourScore[o] > r.hourScore[h])
+				better++;
+		if (better < ES100_SYNC_WINDOW_HOURS && (later >> h & 1))
+			followed++;
+	}
+
+	CHECK(followed == ES100_SYNC_WINDOW_HOURS);
+	for (uint8_t h = 0; h < 24; h++)
+		if (night >> h & 1)
+			CHECK(r.hourScore[h] < ES100_SYNC_SCORE_PRIOR);
+	CHECK(r.lastDayOk >= 1);
+	CHECK(r.maxGap <= (ES100_SYNC_DEADLINE + ES100_SYNC_URGENT_BACKOFF + ES100_SYNC_FULL_TIMEOUT) * 1000ULL);
+
+	// Tracking outcomes move the score of their hour, and an hour outside
+	// the windows gets its try once a day without backing off what is due
+	ES100Sync		sync;
+	unsigned long	now = 0;
+
+	sync.windowHours = 1;
+	sync.setHour(0);
+	CHECK(sync.next(now) == ES100_SYNC_FULL);
+	sync.started(ES100_SYNC_FULL, now);
+	sync.finished(true, now += 134000);
+	uint16_t		synced = sync.getHourScore(0);
+
+	now += ES100_SYNC_TRACKING_INTERVAL;
+	CHECK(sync.next(now) == ES100_SYNC_TRACKING);
+	sync.started(ES100_SYNC_TRACKING, now);
+	sync.finished(true, now += 10000);
+	CHECK(sync.getHourScore(0) > synced);
+
+	now += ES100_SYNC_EXPLORE_INTERVAL - ES100_SYNC_TRACKING_INTERVAL;
+	sync.setHour(1);
+	CHECK(sync.next(now) == ES100_SYNC_TRACKING);
+	sync.started(ES100_SYNC_TRACKING, now);
+	sync.finished(false, now += ES100_SYNC_TRACKING_TIMEOUT);
+	CHECK(sync.getHourScore(1) < ES100_SYNC_SCORE_PRIOR);
+	CHECK(sync.next(now) == ES100_SYNC_NONE);
+	sync.setHour(2);
+	CHECK(sync.next(now) == ES100_SYNC_NONE);
+	sync.setHour(0);
+	CHECK(sync.next(now) == ES100_SYNC_TRACKING);
+}
+
+static unsigned long antennaRun(ES100Antenna *policy, uint8_t receptions)
+{
+	Bench			b;
+	unsigned long	total = 0;
+
+	b.dev.goodHours		= 0xFFFFFF;
+	b.dev.goodAntennas	= 0x02;
+
+	for (uint8_t i = 0; i < receptions; i++) {
+		b.es100.antennaMode = policy ? policy->next() : ES100_ANT_BOTH;
+
+		uint8_t		state = b.reception();
+
+		if (policy)
+			policy->finished(state == ES100_STATE_DONE, b.es100.getAntenna());
+		total += b.es100.getPhaseTimes().rx;
+		simAdvance(3600000000ULL);
+	}
+
+	return total / receptions;
+}
+
+static void antennaPreference()
+{
+	ES100Antenna	policy;
+	unsigned long	both = antennaRun(NULL, 12);
+	unsigned long	learned = antennaRun(&policy, 12);
+
+	printf("site that only decodes on antenna 2\n");
+	printf("  mean time to fix: alternating %lus, with preference %lus, preferred antenna %u\n",
+		   both / 1000, learned / 1000, policy.getPreferred() + 1);
+
+	CHECK(policy.getPreferred() == 1);
+	CHECK(policy.next() == ES100_ANT_ONLY2);
+	CHECK(learned < both * 3 / 4);
+
+	// Misses on the preferred antenna fall back to alternating from it
+	policy.finished(false, 0);
+	policy.next();
+	policy.finished(false, 0);
+	CHECK(policy.next() == ES100_ANT_BOTH_START2);
+	policy.finished(true, 1);
+	CHECK(policy.next() == ES100_ANT_ONLY2);
+}
+
+// Rising edges of the PPS output against the true second
+struct PPSProbe : public SimDevice
+{
+	uint32_t	pulses = 0;
+	int64_t		firstOffset = 0;	// us, > 0 is late
+	int64_t		lastOffset = 0;
+	int64_t		maxOffset = 0;		// us, largest magnitude since clear()
+
+	void clear()			{ maxOffset = 0; }
+	uint64_t nextEvent()	{ return SIM_NO_EVENT; }
+	void run(uint64_t now)	{ }
+
+	void pinChanged(uint8_t pin, uint8_t level)
+	{
+		if (pin != PPS_PIN || !level)
+			return;
+
+		int64_t		offset = (int64_t)(simMicros() % 1000000);
+
+		if (offset >= 500000)
+			offset -= 1000000;
+
+		if (pulses++ == 0)
+			firstOffset = offset;
+		lastOffset = offset;
+		if (llabs(offset) > llabs(maxOffset))
+			maxOffset = offset;
+	}
+};
+
+static void ppsHoldover()
+{
+	Bench		b;
+	PPSProbe	probe;
+	ES100PPS	pps;
+	int64_t		firstHoldover = 0;
+
+	printf("1PPS from a 40 ppm fast crystal, hourly tracking\n");
+	simAttach(&probe);
+	simTimer1.ppb		= 40000;
+	b.dev.goodHours		= 0xFFFFFF;
+	pps.begin(PPS_PIN);
+
+	CHECK(b.reception() == ES100_STATE_DONE);
+
+	ES100DateTime	d = b.es100.getDateTime();
+	uint32_t		epoch = es100MakeTime(ES100_EPOCH_YEAR + d.year, d.month, d.day, d.hour, d.minute, d.second);
+
+	CHECK(epoch == b.dev.lastIrqUTC);
+	CHECK(pps.sync(b.es100.getData().irq.micros, epoch));
+	CHECK(pps.getLastError() == ES100_PPS_NO_ERROR);
+
+	simAdvance(5000000);
+	printf("  first pulse %lldus, 5s later %lldus\n", (long long)probe.firstOffset, (long long)probe.lastOffset);
+	CHECK(probe.pulses >= 4);
+	CHECK(llabs(probe.firstOffset) < 100);		// Within 40 ppm of the received edge
+	CHECK(probe.lastOffset < probe.firstOffset);
+	CHECK(pps.getHoldover() >= 4);
+
+	for (uint8_t i = 0; i < 6; i++) {
+		probe.clear();
+		simAdvance(3600000000ULL);
+
+		CHECK(b.reception(true) == ES100_STATE_DONE);
+
+		int64_t		drift = probe.lastOffset;
+
+		CHECK(b.es100.getData().dateTime.second == b.dev.lastIrqUTC % 60);
+		CHECK(pps.syncSecond(b.es100.getData().irq.micros, b.es100.getData().dateTime.second));
+		CHECK(pps.getEpoch() - b.dev.getUTC(simMicros()) + 1 <= 1);
+
+		// What the output measured against what the probe saw
+		CHECK(llabs(pps.getLastError() + drift) < 20);
+		printf("  sync %u: holdover error %ldus, worst pulse %lldus, rate %ldppb\n", i + 2,
+			   (long)pps.getLastError(), (long long)probe.maxOffset, (long)pps.getRate());
+
+		if (i == 0)
+			firstHoldover = llabs(probe.maxOffset);
+	}
+
+	CHECK(firstHoldover > 100000);
+	CHECK(llabs(probe.maxOffset) < 50);
+	CHECK(pps.getRate() > 39900 && pps.getRate() < 40100);
+	CHECK(pps.getSyncs() == 7);
+
+	// A sync that implies a 2% crystal error is refused
+	simAdvance(600000000ULL);
+	CHECK(!pps.sync(micros() - 12000000, b.dev.getUTC(simMicros())));
+	CHECK(pps.getSyncs() == 7);
+
+	pps.end();
+}
+
+// Masks interrupts from just before each second boundary for up to
+// BLOCK_MAX us after it, as a long ISR or critical section elsewhere in a
+// sketch would now and then
+#define BLOCK_LEAD		10			// us before the second
+#define BLOCK_MAX		60			// us after it, pseudo-random up to this
+
+struct Blocker : public SimDevice
+{
+	uint8_t		active = false;
+	uint64_t	until = 0;			// Unmask at, 0 while not masking
+	uint32_t	seed = 1;
+
+	uint64_t nextEvent()
+	{
+		if (until != 0)
+			return until;
+		if (!active)
+			return SIM_NO_EVENT;
+		return (simMicros() + BLOCK_LEAD) / 1000000 * 1000000 + 1000000 - BLOCK_LEAD;
+	}
+
+	void run(uint64_t now)
+	{
+		if (until != 0) {
+			until = 0;
+			interrupts();
+			return;
+		}
+
+		seed	= seed * 1103515245 + 12345;
+		until	= now + BLOCK_LEAD + (seed >> 16) % (BLOCK_MAX + 1);
+		noInterrupts();
+	}
+};
+
+static ES100	*capturedBy = NULL;
+
+static void irqCaptured(uint32_t ticks)
+{
+	capturedBy->captureIRQ(ticks);
+}
+
+// Full decodes with the IRQ edge held up by a Blocker, each followed by a
+// sync; returns the worst first pulse against the true second
+static int64_t captureRun(uint8_t irqPin, uint8_t syncs)
+{
+	Bench		b(irqPin);
+	PPSProbe	probe;
+	Blocker		blocker;
+	ES100PPS	pps;
+	uint8_t		capture = irqPin == SIM_ICP1_PIN;
+	int64_t		worst = 0;
+
+	simAttach(&probe);
+	simAttach(&blocker);
+	b.dev.goodHours = 0xFFFFFF;
+	pps.begin(PPS_PIN);
+	if (capture) {
+		capturedBy = &b.es100;
+		pps.onCapture(irqCaptured);
+	}
+
+	for (uint8_t i = 0; i < syncs; i++) {
+		blocker.active = true;
+		CHECK(b.reception() == ES100_STATE_DONE);
+		blocker.active = false;
+
+		ES100Data		data = b.es100.getData();
+		ES100DateTime	d = data.dateTime;
+		uint32_t		epoch = es100MakeTime(ES100_EPOCH_YEAR + d.year, d.month, d.day, d.hour, d.minute, d.second);
+
+		CHECK(data.irq.captured == capture);
+		CHECK(epoch == b.dev.lastIrqUTC);
+		CHECK(capture ? pps.syncTicks(data.irq.ticks, epoch) : pps.sync(data.irq.micros, epoch));
+
+		// The first pulse is where the sync put the second
+		probe.pulses = 0;
+		simAdvance(1500000);
+		if (llabs(probe.firstOffset) > llabs(worst))
+			worst = probe.firstOffset;
+
+		simAdvance(60000000);
+	}
+
+	pps.onCapture(NULL);
+	pps.end();
+	return worst;
+}
+
+static void irqCapture()
+{
+	int64_t		external, captured;
+
+	printf("IRQ- edge from INT0 and micros() against ICP1, up to %dus interrupt latency\n", BLOCK_MAX);
+	external = captureRun(IRQ_PIN, 20);
+	captured = captureRun(SIM_ICP1_PIN, 20);
+	printf("  worst first pulse after a sync: INT0 %lldus, ICP1 %lldus\n", (long long)external, (long long)captured);
+
+	CHECK(llabs(external) > 20);
+	CHECK(llabs(captured) < 3);
+}
+
+static void diversity()
+{
+	SimI2CMux		mux(I2C_MUX_ADDR);
+	SimES100		dev0(EN_PIN, IRQ_PIN);
+	SimES100		dev1(EN_PIN - 1, IRQ_PIN + 1);
+	I2CMux			bus = { I2C_MUX_ADDR, I2C_MUX_NONE, 0 };
+	ES100			rx0, rx1;
+	ES100Diversity	diversity;
+	uint8_t			state;
+
+	printf("two receivers behind a mux\n");
+	simReset();
+	simAttach(&dev0);
+	simAttach(&dev1);
+	Wire.attach(&mux);
+	Wire.attach(&dev0);
+	Wire.attach(&dev1);
+	I2C.begin(I2C_DEFAULT_CLOCK);
+
+	dev0.mux = &mux;
+	dev0.channel = 0;
+	dev1.mux = &mux;
+	dev1.channel = 1;
+	dev1.setUTC(es100MakeTime(2024, 3, 10, 6, 58, 0));
+
+	// Receiver 0 hears nothing, receiver 1 decodes on its second cycle
+	SimES100Step	fail = { 134000, false, 0, 0, 0, 0, 0, 0 };
+	SimES100Step	ok = { 134000, true, 0, 3, 0, 11, 3, 2 };
+	dev1.addStep(fail);
+	dev1.addStep(ok);
+
+	rx0.setBus(ES100_ADDR, &bus, 0);
+	rx0.begin(IRQ_PIN, EN_PIN);
+	rx1.setBus(ES100_ADDR, &bus, 1);
+	rx1.begin(IRQ_PIN + 1, EN_PIN - 1);
+	diversity.add(&rx0);
+	diversity.add(&rx1);
+
+	diversity.begin(millis());
+	do {
+		simAdvance(LOOP_PERIOD);
+		state = diversity.poll(millis());
+	} while (state == ES100_STATE_RX);
+
+	ES100DiversityResult	r0 = diversity.getResult(0);
+	ES100DiversityResult	r1 = diversity.getResult(1);
+
+	printf("  winner %u after %lums, started at %lu/%lums, mux switches %u\n",
+		   diversity.getWinner(), diversity.getElapsed(), r0.started, r1.started, bus.switches);
+
+	CHECK(state == ES100_STATE_DONE);
+	CHECK(diversity.getWinner() == 1);
+	CHECK(r1.started == ES100_DIVERSITY_STAGGER);
+	CHECK(r1.elapsed + r1.started == diversity.getElapsed());
+	CHECK(r0.state == ES100_STATE_IDLE);
+	CHECK(simPinLevel(EN_PIN) == LOW && simPinLevel(EN_PIN - 1) == LOW);
+	CHECK(rx1.getEpoch() == dev1.lastIrqUTC);
+	CHECK(rx1.getData().irq.micros == (uint32_t)dev1.lastIrqAt);
+	CHECK(rx1.getPhaseTimes().irqCount == 2);
+	CHECK(dev0.stats.receptions == 1 && dev0.stats.decodes == 0);
+}
+
+static uint8_t	queuedDone = 0;
+
+static void countDone(I2CRequest *req)
+{
+	queuedDone++;
+}
+
+static void queuedBus()
+{
+	Bench			b;
+	I2CDevice		fast = { ES100_ADDR, 400000, 0, 0, 0, NULL, 0 };
+	uint8_t			reg = ES100_DEVICE_ID_REG;
+	uint8_t			id[2] = { 0, 0 };
+	I2CRequest		r0 = { &fast, &reg, 1, &id[0], 1, countDone, NULL };
+	I2CRequest		r1 = { &fast, &reg, 1, &id[1], 1, countDone, NULL };
+	uint64_t		longest = 0;
+	uint8_t			state;
+
+	printf("i2c requests queued behind the loop\n");
+	b.step(60000, true);
+	I2C.resetStats();
+
+	// poll() only queues the window read, it never waits for the bus
+	b.es100.beginRx(millis());
+	do {
+		uint8_t		rx = b.es100.getState() == ES100_STATE_RX;
+		uint64_t	at;
+
+		simAdvance(LOOP_PERIOD);
+		at		= simMicros();
+		state	= b.es100.poll(millis());
+		if (rx && simMicros() - at > longest)
+			longest = simMicros() - at;
+	} while (state != ES100_STATE_DONE && state != ES100_STATE_TIMEOUT);
+
+	I2CBusStats	stats = I2C.getStats();
+
+	printf("  longest poll() %lluus, window read %luus after the IRQ, latency %luus\n",
+		   (unsigned long long)longest, b.es100.getPhaseTimes().read, stats.maxLatency);
+
+	CHECK(state == ES100_STATE_DONE);
+	CHECK(longest < 100);
+	CHECK(stats.maxLatency > 1000 && stats.maxLatency < 2000);
+	CHECK(b.es100.getPhaseTimes().read >= stats.maxLatency);
+	CHECK(stats.completed == 2 && stats.failed == 0 && stats.maxDepth == 1);
+	CHECK(b.es100.getData().status.rxOk == 1);
+
+	// Two reads at the device's own clock, queued and run one after the other
+	b.es100.enable();
+	I2C.resetStats();
+	CHECK(I2C.submit(&r0) && I2C.submit(&r1));
+	CHECK(!I2C.submit(&r1));
+	CHECK(I2C.getStats().depth == 2 && !I2C.isIdle());
+	while (!I2C.isIdle())
+		yield();
+	CHECK(r0.status == I2C_REQ_DONE && r1.status == I2C_REQ_DONE && queuedDone == 2);
+	CHECK(id[0] == SIM_ES100_DEVICE_ID && id[1] == SIM_ES100_DEVICE_ID);
+	CHECK(I2C.getClock() == 400000 && fast.requests == 2);
+	CHECK(I2C.getStats().maxDepth == 2 && I2C.getStats().depth == 0);
+
+	// A NACKed address fails the request once the retries are used up, and the queue goes on
+	b.dev.nackNext(1 + I2C.retries);
+	CHECK(I2C.transfer(&r0) == I2C_REQ_NACK);
+	CHECK(I2C.transfer(&r1) == I2C_REQ_DONE);
+	CHECK(I2C.getStats().failed == 1 && I2C.getStats().completed == 3);
+	CHECK(fast.errors == 1 && I2C.getStats().nacks == 1 + I2C.retries);
+	b.es100.disable();
+}
+
+static void busRecovery()
+{
+	Bench			b;
+	I2CDevice		dev = { ES100_ADDR, 100000, 0, 0, 0, NULL, 0 };
+	uint8_t			reg = ES100_DEVICE_ID_REG;
+	uint8_t			id = 0;
+	I2CRequest		req = { &dev, &reg, 1, &id, 1, NULL, NULL };
+	I2CBusStats		stats;
+	uint64_t		at;
+
+	printf("i2c retries and bus recovery\n");
+	b.step(60000, true);
+	b.es100.enable();
+	I2C.resetStats();
+
+	// A single NACK is retried and never seen by the caller
+	b.dev.nackNext(1);
+	CHECK(b.es100.getDeviceID() == SIM_ES100_DEVICE_ID);
+	stats = I2C.getStats();
+	CHECK(stats.retries == 1 && stats.nacks == 1 && stats.failed == 0);
+	CHECK(b.es100.getBusStats().errors == 0);
+
+	// A target holding SDA low stalls the START until the watchdog clocks it free
+	simTWI.holdSDA(5);
+	at = simMicros();
+	CHECK(I2C.transfer(&req) == I2C_REQ_DONE && id == SIM_ES100_DEVICE_ID);
+	stats = I2C.getStats();
+	printf("  recovered in %lluus after %u clocks\n",
+		   (unsigned long long)(simMicros() - at), simTWI.recoveryClocks);
+	CHECK(stats.timeouts == 1 && stats.recoveries == 1 && stats.failed == 0);
+	CHECK(simTWI.recoveryClocks == 5 && simPinLevel(SDA) == HIGH);
+	CHECK(simTWI.maskedClocks == 0);
+	CHECK(simMicros() - at >= I2C.timeout && simMicros() - at < I2C.timeout + 1000);
+
+	// A device gone for good fails every attempt, the driver says so
+	b.dev.nackNext(1 + I2C.retries);
+	CHECK(b.es100.getDeviceID() == 0);
+	CHECK(b.es100.getBusStats().errors == 1 && I2C.getStats().failed == 1);
+
+	// startRx() NACKed: the reception ends at once instead of waiting for the timeout
+	b.es100.disable();
+	b.es100.beginRx(millis());
+	while (b.es100.getState() == ES100_STATE_ENABLING) {
+		simAdvance(LOOP_PERIOD);
+		b.es100.poll(millis());
+	}
+	b.dev.nackNext(1 + I2C.retries);
+	while (b.es100.getState() == ES100_STATE_READY) {
+		simAdvance(LOOP_PERIOD);
+		b.es100.poll(millis());
+	}
+	CHECK(b.es100.getState() == ES100_STATE_TIMEOUT);
+	CHECK(b.es100.getPhaseTimes().timedOutIn == ES100_STATE_READY);
+	CHECK(simPinLevel(EN_PIN) == LOW);
+}
+
+// The device drops off the bus with IRQ- asserted: every window read
+// fails after its retries and IRQ- is never released, yet the reception
+// still ends at rxTimeout like any other that timed out
+static void stuckWindowRead()
+{
+	Bench		b;
+	ES100Stats	stats;
+	uint8_t		state;
+	uint64_t	start;
+
+	printf("window read failing with IRQ- held low\n");
+	b.es100.setStats(&stats);
+	b.es100.rxTimeout = 30000;
+	b.step(20000, true);
+
+	start = simMicros();
+	b.es100.beginRx(millis());
+	do {
+		simAdvance(LOOP_PERIOD);
+		state = b.es100.poll(millis());
+		if (state == ES100_STATE_RX)
+			Wire.detachAll();
+	} while (state != ES100_STATE_DONE && state != ES100_STATE_TIMEOUT &&
+			 simMicros() - start < 120000000ULL);
+
+	CHECK(state == ES100_STATE_TIMEOUT);
+	CHECK(b.es100.getPhaseTimes().timedOutIn == ES100_STATE_RX);
+	CHECK(b.dev.stats.irqs == 1 && I2C.getStats().failed > 0);
+	CHECK(simMicros() - start < 31000000ULL);
+	CHECK(simPinLevel(EN_PIN) == LOW);
+	CHECK(stats.getReceptions() == 1 && stats.getDecodes() == 0);
+}
+
+static volatile uint64_t	sqwFellAt = 0;
+
+static void sqwFell()
+{
+	sqwFellAt = simMicros();
+}
+
+static void rtcPhase()
+{
+	Bench			b;
+	SimDS1307		clock(SQW_PIN);
+	DS1307			rtc;
+	DS1307Time		tm;
+	ES100Data		data;
+	int64_t			error;
+
+	printf("RTC set in phase with the decode\n");
+	simAttach(&clock);
+	Wire.attach(&clock);
+	b.step(60000, true);
+	CHECK(b.reception() == ES100_STATE_DONE);
+	data = b.es100.getData();
+
+	// The decoded time belongs to the IRQ, some ms before the write can start
+	tm.Year		= data.dateTime.year + 30;
+	tm.Month	= data.dateTime.month;
+	tm.Day		= data.dateTime.day;
+	tm.Hour		= data.dateTime.hour;
+	tm.Minute	= data.dateTime.minute;
+	tm.Second	= data.dateTime.second;
+	CHECK(rtc.setSQW(DS1307_SQW_1HZ));
+	attachInterrupt(digitalPinToInterrupt(SQW_PIN), sqwFell, DS1307_SQW_EDGE);
+	CHECK(rtc.writeAt(&tm, data.irq.micros));
+	simAdvance(2500000);
+
+	error = (int64_t)(sqwFellAt % 1000000);
+	if (error >= 500000)
+		error -= 1000000;
+	printf("  SQW falls %lldus after the WWVB second, write %lluus after the IRQ\n",
+		   (long long)error, (unsigned long long)(clock.lastWriteAt - b.dev.lastIrqAt));
+
+	CHECK(sqwFellAt == clock.lastTickAt && sqwFellAt > clock.lastWriteAt);
+	CHECK(error >= 0 && error < 10000);
+	CHECK(clock.getTime() == b.dev.getUTC(simMicros()));
+	CHECK(rtc.read(&tm) && tm.Wday == 1);		// 2024-03-10 was a Sunday
+
+	// A whole-hour step leaves the countdown chain alone
+	tm.Hour++;
+	CHECK(rtc.adjust(&tm));
+	simAdvance(1000000);
+	CHECK(clock.writes == 1 && clock.getTime() == b.dev.getUTC(simMicros()) + 3600);
+	CHECK(sqwFellAt % 1000000 == (uint64_t)error);
+}
+
+// Something like the ADK screen at time t: the date line ticks every
+// second, the three status lines scroll every two seconds
+template<class Display> static void drawScreen(Display &lcd, uint32_t t, bool blank)
+{
+	static const char	*lines[] = { "Interrupt Count 12", "Last sync 03m27s", "DST is In Effect",
+									 "NDST 11/03 02:00", "No LS this month", "Antenna used 2" };
+	char				date[21];
+
+	snprintf(date, sizeof(date), "2024-03-10T%02u:%02u:%02u",
+			 (unsigned)(t / 3600000 % 24), (unsigned)(t / 60000 % 60), (unsigned)(t / 1000 % 60));
+	lcd.setCursor(0, 0);
+	lcd.print(date);
+
+	for (uint8_t row = 1; row < 4; row++) {
+		lcd.setCursor(0, row);
+		if (blank) {
+			for (uint8_t i = 0; i < 20; i++)
+				lcd.print(" ");
+			lcd.setCursor(0, row);
+		}
+		lcd.print(lines[(t / 2000 + row) % 6]);
+	}
+}
+
+// Pins of the ADK display
+#define LCD_PINS		4, 5, 8, 9, 10, 11
+
+static void lcdFrame()
+{
+	LiquidCrystal	direct(LCD_PINS);
+	LCDQueue		queue(LCD_PINS);
+	SimHD44780		panel(LCD_PINS);
+	LCDFrame		screen;
+	LCDFrameStats	stats;
+	uint32_t		oldBytes, oldMicros;
+	bool			same = true;
+
+	printf("LCD shadow framebuffer\n");
+	simReset();
+	simAttach(&panel);
+	queue.begin(20, 4);
+	screen.begin(&queue);
+
+	screen.setCursor(0, 1);
+	screen.print("Decodes 3/4");
+	screen.clearToEnd();
+	screen.flush();
+	CHECK(screen.getStats().bytes == 1 + 11 && screen.getStats().moves == 1);
+
+	// Nothing changed, nothing sent
+	screen.resetStats();
+	screen.setCursor(0, 1);
+	screen.print("Decodes 3/4");
+	screen.clearToEnd();
+	screen.flush();
+	CHECK(screen.getStats().bytes == 0 && screen.getStats().flushes == 1);
+
+	// One cell, then two changes one cell apart go as a single run
+	screen.setCursor(10, 1);
+	screen.print("5");
+	screen.flush();
+	CHECK(screen.getStats().bytes == 2);
+	screen.setCursor(8, 1);
+	screen.print("4/6");
+	screen.flush();
+	CHECK(screen.getStats().bytes == 2 + 1 + 3 && screen.getStats().moves == 2);
+
+	// Two cells apart, two cursor moves; the next row needs its own
+	screen.setCursor(0, 1);
+	screen.print("Fix");
+	screen.setCursor(0, 2);
+	screen.print("PPS");
+	screen.resetStats();
+	screen.flush();
+	CHECK(screen.getStats().bytes == 2 * (1 + 3) && screen.getStats().moves == 2);
+
+	// Printing past the end of a row does not spill into the next one
+	screen.setCursor(18, 3);
+	screen.print("Ant1 ");
+	screen.flush();
+	simAdvance(10000);
+	for (uint8_t row = 0; row < LCD_FRAME_ROWS; row++)
+		for (uint8_t col = 0; col < LCD_FRAME_COLS; col++)
+			same = same && panel.at(col, row) == (row == 1 && col < 11 ? "Fixodes 4/6"[col] :
+												  row == 2 && col < 3 ? "PPS"[col] :
+												  row == 3 && col >= 18 ? "An"[col - 18] : ' ');
+	CHECK(same && panel.stats.early == 0);
+
+	// Ten seconds of 100 ms refreshes drawn the old way, then through the frame
+	direct.begin(20, 4);
+	direct.stats = SimLCDStats { 0, 0, 0 };
+	for (uint32_t t = 0; t < 10000; t += 100)
+		drawScreen(direct, t, true);
+	oldBytes	= direct.stats.bytes;
+	oldMicros	= (uint32_t)direct.stats.busyMicros;
+
+	screen.resetStats();
+	for (uint32_t t = 0; t < 10000; t += 100) {
+		screen.clear();
+		drawScreen(screen, t, false);
+		screen.flush();
+		simAdvance(100000);
+	}
+	stats = screen.getStats();
+
+	printf("  LiquidCrystal: %u bytes/s, loop blocked %uus/s\n", oldBytes / 10, oldMicros / 10);
+	printf("  LCDFrame:      %u bytes/s (%u cursor moves), loop blocked %uus/s\n",
+		   stats.bytes / 10, stats.moves / 10, stats.micros / 10);
+	CHECK(stats.bytes * 10 < oldBytes);
+	CHECK(stats.micros * 10 < oldMicros);
+
+	// The display ends up showing the last screen drawn, at 9.9 s
+	same = true;
+	for (uint8_t col = 0; col < LCD_FRAME_COLS; col++)
+		same = same && panel.at(col, 1) == (col < 14 ? "Antenna used 2"[col] : ' ');
+	CHECK(same && panel.at(18, 0) == '9' && panel.at(12, 0) == '0');
+}
+
+static void lcdQueue()
+{
+	LCDQueue		queue(LCD_PINS);
+	SimHD44780		panel(LCD_PINS);
+	LCDFrame		screen;
+	LCDQueueStats	stats;
+	uint64_t		at;
+	bool			same = true;
+
+	printf("LCD write queue\n");
+	simReset();
+	simAttach(&panel);
+	queue.begin(20, 4);
+	while (!queue.isIdle())
+		simAdvance(1);
+	CHECK(panel.isFourBit() && panel.stats.instructions == 4 + 4);
+
+	// Queueing costs the caller nothing, the timer sends a byte per tick
+	at = simMicros();
+	CHECK(queue.setCursor(0, 2) && queue.print("Hello") == 5);
+	CHECK(simMicros() == at && queue.getStats().depth == 2 * 6);
+	while (!queue.isIdle())
+		simAdvance(1);
+	printf("  6 bytes out in %lluus, after setup in %lluus\n",
+		   (unsigned long long)(simMicros() - at), (unsigned long long)at);
+	CHECK(simMicros() - at <= 7 * LCD_QUEUE_TICK);
+	CHECK(panel.at(0, 2) == 'H' && panel.at(4, 2) == 'o');
+
+	// The tick stops once it finds the queue empty
+	simAdvance(LCD_QUEUE_TICK);
+	CHECK(!(TIMSK2 & _BV(OCIE2A)));
+
+	// A clear holds the queue until the controller has done it
+	CHECK(queue.clear() && queue.print("x") == 1);
+	at = simMicros();
+	while (!queue.isIdle())
+		simAdvance(1);
+	CHECK(simMicros() - at >= SIM_HD44780_CLEAR && panel.at(0, 0) == 'x' && panel.at(0, 2) == ' ');
+
+	// A full ring refuses whole bytes and counts them
+	queue.resetStats();
+	for (uint8_t i = 0; i < 100; i++)
+		queue.write('0' + i % 10);
+	stats = queue.getStats();
+	printf("  100 bytes at once: %u queued, %u overflows, depth %u\n",
+		   stats.bytes, stats.overflows, stats.maxDepth);
+	CHECK(stats.bytes == (LCD_QUEUE_SIZE - 1) / 2 && stats.overflows == 100 - stats.bytes);
+	CHECK(stats.maxDepth == 2 * stats.bytes);
+	simAdvance(10000);
+
+	// A frame that does not fit goes out over two flushes
+	screen.begin(&queue);
+	queue.clear();
+	for (uint8_t row = 0; row < LCD_FRAME_ROWS; row++) {
+		screen.setCursor(0, row);
+		for (uint8_t col = 0; col < LCD_FRAME_COLS; col++)
+			screen.write('A' + row + col);
+	}
+	screen.flush();
+	CHECK(screen.getStats().deferred == 1);
+	simAdvance(100000);
+	screen.flush();
+	simAdvance(100000);
+	printf("  a whole screen over two flushes: %u bytes\n", screen.getStats().bytes);
+	CHECK(screen.getStats().deferred == 1 && screen.getStats().bytes == 3 + 80);
+	for (uint8_t row = 0; row < LCD_FRAME_ROWS; row++)
+		for (uint8_t col = 0; col < LCD_FRAME_COLS; col++)
+			same = same && panel.at(col, row) == 'A' + row + col;
+	CHECK(same && panel.stats.early == 0);
+}
+
+/******************************************************************************
+ * Sync journal
+ ******************************************************************************/
+static SyncJournalEntry journalEntry(uint32_t utc, uint8_t ok)
+{
+	SyncJournalEntry	e = SyncJournalEntry();
+
+	e.utc				= utc;
+	e.decodeUtc			= utc - 3600;
+	e.status.rxOk		= ok;
+	e.status.dstState	= 3;
+	e.status.leapSecond	= 3;
+	e.zoneKnown			= true;
+	e.offset			= -4 * 3600L;
+	e.nextDst.month		= 11;
+	e.nextDst.day		= 3;
+	e.nextDst.hour		= 2;
+
+	return e;
+}
+
+static void syncJournal()
+{
+	Bench				b;
+	SimDS1307			clock(SQW_PIN);
+	DS1307				rtc;
+	SyncJournal			journal;
+	SyncJournalEntry	e, got;
+	ES100Transitions	tr;
+	uint32_t			t = es100MakeTime(2024, 6, 1, 12, 0, 0);
+
+	printf("sync journal in DS1307 RAM\n");
+	simAttach(&clock);
+	Wire.attach(&clock);
+
+	// Cleared RAM holds no entries
+	CHECK(journal.begin(&rtc) == 0 && !journal.getLast(&got));
+
+	// Wraps after SYNC_JOURNAL_ENTRIES, newest first
+	for (uint8_t i = 0; i < SYNC_JOURNAL_ENTRIES + 2; i++) {
+		e = journalEntry(t + i * 60, true);
+		CHECK(journal.append(&e));
+	}
+	CHECK(journal.count() == SYNC_JOURNAL_ENTRIES);
+	CHECK(journal.getEntry(0, &got) && got.utc == t + (SYNC_JOURNAL_ENTRIES + 1) * 60);
+	CHECK(journal.getEntry(SYNC_JOURNAL_ENTRIES - 1, &got) && got.utc == t + 2 * 60);
+	CHECK(!journal.getEntry(SYNC_JOURNAL_ENTRIES, &got));
+	CHECK(got.offset == -4 * 3600L && got.status.dstState == 3 && got.status.leapSecond == 3);
+	CHECK(got.nextDst.month == 11 && got.nextDst.day == 3 && got.nextDst.hour == 2);
+
+	// Failures fill the journal but never push out the last good entry
+	for (uint8_t i = 0; i < 2 * SYNC_JOURNAL_ENTRIES; i++) {
+		e = journalEntry(t + 3600 + i * 60, false);
+		CHECK(journal.append(&e));
+	}
+	CHECK(journal.getEntry(0, &got) && !got.status.rxOk);
+	CHECK(journal.getLast(&got) && got.utc == t + (SYNC_JOURNAL_ENTRIES + 1) * 60);
+
+	// Survives a reboot, a corrupted entry is skipped
+	SyncJournal		reboot;
+	e = journalEntry(t + 7200, true);
+	CHECK(journal.append(&e));
+	CHECK(reboot.begin(&rtc) == SYNC_JOURNAL_ENTRIES);
+	CHECK(reboot.getLast(&got) && got.utc == t + 7200);
+
+	// update() rewrites the newest good entry in place
+	e.offset = -5 * 3600L;
+	CHECK(reboot.update(&e) && reboot.getLast(&got) && got.offset == -5 * 3600L);
+	CHECK(reboot.count() == SYNC_JOURNAL_ENTRIES);
+
+	for (uint8_t slot = 0; slot < SYNC_JOURNAL_ENTRIES; slot++) {
+		uint8_t		raw[SYNC_JOURNAL_ENTRY_LEN];
+
+		CHECK(rtc.readRAM(SYNC_JOURNAL_ADDR + slot * SYNC_JOURNAL_ENTRY_LEN, raw, sizeof(raw)));
+		if (raw[1] == (uint8_t)(t + 7200))
+			clock.poke(0x08 + SYNC_JOURNAL_ADDR + slot * SYNC_JOURNAL_ENTRY_LEN + 4, raw[4] ^ 0x01);
+	}
+	CHECK(reboot.begin(&rtc) == SYNC_JOURNAL_ENTRIES - 1);
+	CHECK(!reboot.getLast(&got));		// The rest are the failures
+
+	// A bad offset is refused rather than stored wrong
+	e.offset = 1000;
+	CHECK(!reboot.append(&e));
+
+	// The transitions worked out from a journal entry are those of the decode
+	b.es100.timezone	= -5;
+	b.es100.DSTenabled	= true;
+	b.step(60000, true, 0, 3);
+	CHECK(b.reception() == ES100_STATE_DONE);
+	tr = b.es100.getTransitions();
+	ES100Transitions	restored = b.es100.restoreTransitions(b.es100.getEpoch(), b.es100.getStatus0(),
+															 b.es100.getNextDst());
+	CHECK(restored.dstAt == tr.dstAt && restored.dst == tr.dst);
+	CHECK(restored.leapAt == tr.leapAt && restored.leap == tr.leap);
+}
+
+struct BootResult
+{
+	uint64_t	readyMicros;		// Boot to a valid time and zone
+	uint64_t	onMicros;			// Receiver on-time in the day after boot
+	uint16_t	full;
+	uint16_t	tracking;
+};
+
+// The day after a reboot 2 hours after the last good full decode, with or
+// without restoring from the journal, along the lines of the ADK setup()
+// and loop()
+static BootResult bootDay(bool restore)
+{
+	Bench				b;
+	SimDS1307			clock(SQW_PIN);
+	DS1307				rtc;
+	SyncJournal			journal;
+	ES100Sync			sync;
+	SyncJournalEntry	e;
+	DS1307Time			tm;
+	BootResult			result = { 0, 0, 0, 0 };
+	uint8_t				kind = ES100_SYNC_NONE;
+	uint8_t				receiving = false;
+	uint8_t				ready = false;
+	uint32_t			utc = b.dev.getUTC(simMicros());
+	uint64_t			boot;
+
+	simAttach(&clock);
+	Wire.attach(&clock);
+	b.es100.timezone	= -5;
+	b.es100.DSTenabled	= true;
+	clock.setTime(utc - 5 * 3600L);
+
+	// What the last run left behind
+	e = journalEntry(utc - 7200, true);
+	e.decodeUtc	= e.utc;
+	e.offset	= -5 * 3600L;
+	journal.begin(&rtc);
+	CHECK(journal.append(&e));
+	boot = simMicros();
+
+	if (restore) {
+		CHECK(journal.begin(&rtc) == 1 && journal.getLast(&e) && rtc.read(&tm));
+		utc = es100MakeTime(tm.Year + 1970, tm.Month, tm.Day, tm.Hour, tm.Minute, tm.Second) - e.offset;
+		sync.restore((utc - e.utc) * 1000UL, millis());
+		b.es100.restoreTransitions(e.decodeUtc, e.status, e.nextDst);
+		ready = true;
+		result.readyMicros = simMicros() - boot;
+		for (uint8_t i = 0; i < 8; i++)
+			b.step(20000, true);
+	} else {
+		b.step(134000, true);
+		for (uint8_t i = 0; i < 7; i++)
+			b.step(20000, true);
+	}
+
+	while (simMicros() < 86400000000ULL) {
+		if (!receiving) {
+			kind = sync.next(millis());
+			if (kind != ES100_SYNC_NONE) {
+				b.es100.rxTimeout = sync.rxTimeout(kind);
+				b.es100.beginRx(millis(), kind == ES100_SYNC_TRACKING);
+				sync.started(kind, millis());
+				receiving = true;
+			}
+		}
+
+		if (receiving) {
+			uint8_t state = b.es100.poll(millis());
+			if (state == ES100_STATE_DONE || state == ES100_STATE_TIMEOUT) {
+				sync.finished(state == ES100_STATE_DONE, millis());
+				receiving = false;
+				if (state == ES100_STATE_DONE && kind == ES100_SYNC_FULL && !ready) {
+					ready = true;
+					result.readyMicros = simMicros() - boot;
+				}
+			}
+		}
+
+		simAdvance(receiving ? LOOP_PERIOD : 100000);
+	}
+
+	ES100SyncStats	stats = sync.getStats(millis());
+
+	result.onMicros	= b.dev.stats.onMicros;
+	result.full		= stats.full;
+	result.tracking	= stats.tracking;
+	return result;
+}
+
+static void journalBoot()
+{
+	BootResult	cold, warm;
+
+	printf("boot with and without the sync journal\n");
+	cold = bootDay(false);
+	warm = bootDay(true);
+
+	printf("  without: ready after %llums, receiver on %llus, full %u, tracking %u\n",
+		   (unsigned long long)(cold.readyMicros / 1000), (unsigned long long)(cold.onMicros / 1000000),
+		   cold.full, cold.tracking);
+	printf("  with:    ready after %llums, receiver on %llus, full %u, tracking %u\n",
+		   (unsigned long long)(warm.readyMicros / 1000), (unsigned long long)(warm.onMicros / 1000000),
+		   warm.full, warm.tracking);
+
+	CHECK(cold.full == 1 && warm.full == 0);
+	CHECK(warm.readyMicros < 100000 && cold.readyMicros > 100000000ULL);
+	CHECK(warm.onMicros < cold.onMicros);
+}
+
+// A tracking sync with no RTC to read: the DONE case of the ADK loop()
+// drops the sync and asks for a full decode at once, in or out of window
+static void lostRTC()
+{
+	Bench		b;
+	DS1307		rtc;
+	ES100Sync	sync;
+	DS1307Time	tm;
+
+	printf("tracking with the RTC gone\n");
+	sync.restore(3600000UL, millis());
+	CHECK(sync.hasSync() && sync.next(millis()) == ES100_SYNC_NONE);
+
+	// No DS1307 on the bus, the read is NACKed
+	CHECK(!rtc.read(&tm));
+	sync.requireFull(millis());
+	CHECK(!sync.hasSync());
+	CHECK(sync.next(millis()) == ES100_SYNC_FULL);
+}
+
+/******************************************************************************
+ * Telemetry
+ ******************************************************************************/
+struct Capture
+{
+	uint32_t	frames[256];
+	uint32_t	rxUtc;
+	size_t		text;
+};
+
+static void captureFrame(void *context, const TelemetryFrame *frame)
+{
+	Capture		*c = (Capture *)context;
+	TMES100Rx	rx;
+
+	c->frames[frame->type]++;
+	if (frame->type == TM_ES100_RX && frame->len == sizeof(rx)) {
+		memcpy(&rx, frame->payload, sizeof(rx));
+		c->rxUtc = rx.utc;
+	}
+}
+
+static void captureText(void *context, const char *text, size_t len)
+{
+	((Capture *)context)->text += len;
+}
+
+// The text block the ADK printed after each reception, same lines and
+// numbers, for the time it held up the loop
+static void printDebugBlock(ES100 *es100)
+{
+	ES100Status0	status = es100->getStatus0();
+	ES100BusStats	bus = es100->getBusStats();
+	ES100PhaseTimes	phase = es100->getPhaseTimes();
+
+	Serial.println("Valid decode");
+	Serial.println("pps holdover error = none yet");
+	Serial.print("status0.rxOk = B");			Serial.println(status.rxOk, BIN);
+	Serial.print("status0.antenna = B");		Serial.println(status.antenna, BIN);
+	Serial.print("status0.leapSecond = B");		Serial.println(status.leapSecond, BIN);
+	Serial.print("status0.dstState = B");		Serial.println(status.dstState, BIN);
+	Serial.print("status0.tracking = B");		Serial.println(status.tracking, BIN);
+	Serial.print("i2c transactions = ");		Serial.print(bus.transactions);
+	Serial.print(", bytes = ");					Serial.print(bus.bytes);
+	Serial.print(", register window reads = ");	Serial.print(bus.snapshotReads);
+	Serial.print(", cache hits = ");			Serial.print(bus.cacheHits);
+	Serial.print(", errors = ");				Serial.println(bus.errors);
+	Serial.print("es100 bus time = ");			Serial.print(bus.busMicros);
+	Serial.print("us, rtc bus time = 0us in 0 requests (0 failed), clock changes = ");
+	Serial.println(I2C.getClockChanges());
+	Serial.println("i2c queue depth max = 1, worst latency = 0us, failed = 0");
+	Serial.println("i2c retries = 0, nacks = 0, bus errors = 0, timeouts = 0, recoveries = 0");
+	Serial.print("enable = ");					Serial.print(phase.enable);
+	Serial.print("ms, ready = ");				Serial.print(phase.ready);
+	Serial.print("ms, rx = ");					Serial.print(phase.rx);
+	Serial.print("ms, read = ");				Serial.print(phase.read);
+	Serial.print("us, irqs = ");				Serial.println(phase.irqCount);
+	Serial.println("full = 1/1, tracking = 0/0, receiver on today = 60s, last day = 0s");
+}
+
+// The records the ADK sends in place of the block
+static void sendRecords(Telemetry *tm, ES100 *es100)
+{
+	ES100PhaseTimes	phase = es100->getPhaseTimes();
+	TMES100Rx		rx = TMES100Rx();
+	TMES100Bus		bus = TMES100Bus();
+	TMSync			s = TMSync();
+	TMPps			p = TMPps();
+
+	rx.utc		= es100->getEpoch();
+	rx.state	= ES100_STATE_DONE;
+	rx.status0	= es100->getStatus0().rxOk;
+	rx.enableMs	= phase.enable;
+	rx.readyMs	= phase.ready;
+	rx.rxMs		= phase.rx;
+	rx.readUs	= phase.read;
+	rx.irqs		= phase.irqCount;
+	bus.transactions	= es100->getBusStats().transactions;
+	bus.busMicros		= es100->getBusStats().busMicros;
+	s.full = s.fullOk	= 1;
+	p.lastError			= INT32_MIN;
+
+	CHECK(tm->send(TM_ES100_RX, TM_ES100_RX_V, &rx, sizeof(rx)));
+	CHECK(tm->send(TM_ES100_BUS, TM_ES100_BUS_V, &bus, sizeof(bus)));
+	CHECK(tm->send(TM_SYNC, TM_SYNC_V, &s, sizeof(s)));
+	CHECK(tm->send(TM_PPS, TM_PPS_V, &p, sizeof(p)));
+}
+
+// Capture of the serial port so far, through the host decoder
+static TelemetryDecoderStats decodeCapture(FILE *f, Capture *c, long corruptAt = -1)
+{
+	TelemetryDecoder	decoder(captureFrame, captureText, c);
+	uint8_t				buf[4096];
+	size_t				n;
+
+	memset(c, 0, sizeof(*c));
+	fflush(f);
+	rewind(f);
+	n = fread(buf, 1, sizeof(buf), f);
+	if (corruptAt >= 0 && (size_t)corruptAt < n)
+		buf[corruptAt] ^= 0x40;
+	decoder.feed(buf, n);
+	decoder.finish();
+
+	return decoder.stats;
+}
+
+static void serialTelemetry()
+{
+	Bench					b;
+	Telemetry				tm;
+	Capture					c;
+	TelemetryDecoderStats	stats;
+	FILE					*capture = tmpfile();
+	uint64_t				start, textHeld, recordsHeld, drained;
+
+	printf("serial telemetry at 9600 baud\n");
+	b.step(60000, true);
+	CHECK(b.reception() == ES100_STATE_DONE);
+
+	// The old text block
+	Serial.begin(9600);
+	Serial.out = NULL;
+	start = simMicros();
+	printDebugBlock(&b.es100);
+	textHeld = simMicros() - start;
+
+	// The records, then loop() polls until they are out
+	Serial.reset();
+	Serial.begin(9600);
+	Serial.out = capture;
+	tm.begin(&Serial);
+	start = simMicros();
+	sendRecords(&tm, &b.es100);
+	recordsHeld = simMicros() - start;
+	// poll() leaves bytes in the ring only while the serial buffer is full
+	while (Serial.availableForWrite() < SIM_SERIAL_TX_BUFFER - 1) {
+		simAdvance(LOOP_PERIOD);
+		tm.poll();
+	}
+	drained = simMicros() - start;
+
+	printf("  text block:  loop held %llums\n", (unsigned long long)(textHeld / 1000));
+	printf("  records:     loop held %llums, %u bytes out in %llums, ring depth max %u, dropped %u\n",
+		   (unsigned long long)(recordsHeld / 1000), (unsigned)tm.getStats().bytes,
+		   (unsigned long long)(drained / 1000), tm.getStats().maxDepth, tm.getStats().dropped);
+	CHECK(textHeld > 500000 && recordsHeld == 0 && Serial.blockedMicros == 0);
+	CHECK(tm.getStats().dropped == 0);
+
+	// A trace dump between records passes through as text
+	tm.beginText();
+	Serial.print("ES100TRACE:0102\n");
+	tm.endText();
+	CHECK(tm.send(TM_ES100_IRQ, TM_ES100_IRQ_V, "\x01\x00", 2));
+	tm.beginText();
+
+	stats = decodeCapture(capture, &c);
+	CHECK(stats.frames == 5 && stats.lost == 0 && stats.crcErrors == 0 && stats.badFrames == 0);
+	CHECK(c.frames[TM_ES100_RX] == 1 && c.frames[TM_PPS] == 1 && c.frames[TM_ES100_IRQ] == 1);
+	CHECK(c.rxUtc == b.es100.getEpoch() && c.text == 16);
+
+	// A damaged frame costs only itself
+	stats = decodeCapture(capture, &c, 10);
+	CHECK(stats.frames == 4 && stats.crcErrors + stats.badFrames == 1 && c.frames[TM_ES100_BUS] == 1);
+
+	// Records that do not fit are dropped whole and show as a sequence gap
+	Serial.reset();
+	Serial.begin(9600);
+	capture = freopen(NULL, "w+b", capture);
+	Serial.out = capture;
+	tm.resetStats();
+	for (uint8_t i = 0; i < 40; i++)
+		tm.send(TM_ES100_IRQ, TM_ES100_IRQ_V, &i, 1);
+	CHECK(tm.getStats().dropped > 0 && Serial.blockedMicros == 0);
+	while (Serial.availableForWrite() < SIM_SERIAL_TX_BUFFER - 1) {
+		simAdvance(LOOP_PERIOD);
+		tm.poll();
+	}
+	CHECK(tm.send(TM_ES100_IRQ, TM_ES100_IRQ_V, "\x01\x00", 2));
+	tm.beginText();
+	stats = decodeCapture(capture, &c);
+	CHECK(stats.frames == 41u - tm.getStats().dropped && stats.lost == tm.getStats().dropped);
+	printf("  40 records at once: %u sent, %u dropped and seen as lost\n",
+		   (unsigned)stats.frames - 1, (unsigned)stats.lost);
+
+	fclose(capture);
+	Serial.reset();
+}
+
+/******************************************************************************
+ * Script replay
+ ******************************************************************************/
+static int replay(const char *path)
+{
+	FILE	*f = fopen(path, "r");
+	char	line[128];
+	int		lineNo = 0;
+	Bench	b;
+
+	if (f == NULL) {
+		perror(path);
+		return 2;
+	}
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		SimES100Step	s = { 0, 0, 0, 0, 0, 0, 0, 0 };
+		char			cmd[16] = "";
+		char			*arg;
+		unsigned		a, c, d, e, g, h;
+		int				n = 0;
+
+		lineNo++;
+		if (sscanf(line, "%15s %n", cmd, &n) != 1 || cmd[0] == '#')
+			continue;
+		arg = line + n;
+
+		if (!strcmp(cmd, "utc") && sscanf(arg, "%u-%u-%u %u:%u:%u", &a, &c, &d, &e, &g, &h) == 6) {
+			b.dev.setUTC(es100MakeTime(a, c, d, e, g, h) - (uint32_t)(simMicros() / 1000000));
+		} else if (!strcmp(cmd, "boot") && sscanf(arg, "%u", &a) == 1) {
+			b.dev.bootTime = a * 1000ULL;
+		} else if (!strcmp(cmd, "tz") && sscanf(arg, "%d %d", &b.es100.timezone, &b.es100.timezoneMinutes) >= 1) {
+		} else if (!strcmp(cmd, "dst")) {
+			b.es100.DSTenabled = strncmp(arg, "on", 2) == 0;
+		} else if (!strcmp(cmd, "ok") || !strcmp(cmd, "fail")) {
+			char	*p;
+
+			s.duration	= strtoul(arg, &p, 10);
+			s.ok		= cmd[0] == 'o';
+			while ((p = strchr(p, ' ')) != NULL) {
+				p++;
+				if (sscanf(p, "ant=%u", &a) == 1)		s.antenna = a;
+				if (sscanf(p, "dst=%u", &a) == 1)		s.dstState = a;
+				if (sscanf(p, "leap=%u", &a) == 1)		s.leapSecond = a;
+				if (sscanf(p, "next=%u/%u/%u", &a, &c, &d) == 3) {
+					s.nextDstMonth = a; s.nextDstDay = c; s.nextDstHour = d;
+				}
+			}
+			b.dev.addStep(s);
+		} else if (!strcmp(cmd, "wait") && sscanf(arg, "%u", &a) == 1) {
+			simAdvance(a * 1000ULL);
+		} else if (!strcmp(cmd, "rx")) {
+			uint8_t		tracking = strncmp(arg, "tracking", 8) == 0;
+			char		*p = strchr(arg, ' ');
+
+			if (p != NULL)
+				b.es100.rxTimeout = strtoul(p, NULL, 10);
+
+			uint8_t			state = b.reception(tracking);
+			ES100Data		data = b.es100.getData();
+			ES100PhaseTimes	phase = b.es100.getPhaseTimes();
+			ES100BusStats	bus = b.es100.getBusStats();
+
+			printf("%8.3fs rx %s: %s", simMicros() / 1e6, tracking ? "tracking" : "full",
+				   state == ES100_STATE_DONE ? "DONE" : "TIMEOUT");
+			if (state == ES100_STATE_DONE && data.status.tracking)
+				printf(" second %02u ant %u", data.dateTime.second, data.status.antenna);
+			else if (state == ES100_STATE_DONE)
+				printf(" 20%02u-%02u-%02u %02u:%02u:%02u ant %u dst %u",
+					   data.dateTime.year, data.dateTime.month, data.dateTime.day,
+					   data.dateTime.hour, data.dateTime.minute, data.dateTime.second,
+					   data.status.antenna, data.status.dstState);
+			else
+				printf(" in state %u", phase.timedOutIn);
+			printf(", enable %lums, rx %lums, irqs %u, i2c %u/%uB\n",
+				   phase.enable, phase.rx, phase.irqCount, bus.transactions, bus.bytes);
+
+			b.es100.resetBusStats();
+			es100TraceDump(Serial);
+			es100TraceClear();
+		} else {
+			fprintf(stderr, "%s:%d: cannot parse: %s", path, lineNo, line);
+			fclose(f);
+			return 2;
+		}
+	}
+
+	fclose(f);
+	return 0;
+}
+
+/******************************************************************************
+ * Main
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+	if (argc > 1)
+		return replay(argv[1]);
+
+	std::chrono::steady_clock::time_point	start = std::chrono::steady_clock::now();
+
+	benchmark();
+	decodeAfterFailedCycles();
+	snapshotReads();
+	localTime();
+	epochRange();
+	transitions();
+	tracking();
+	noSignal();
+	slowBoot();
+	scheduledDay();
+	adaptiveWindows();
+	propagationShift();
+	antennaPreference();
+	ppsHoldover();
+	irqCapture();
+	diversity();
+	queuedBus();
+	busRecovery();
+	stuckWindowRead();
+	rtcPhase();
+	lcdFrame();
+	lcdQueue();
+	syncJournal();
+	journalBoot();
+	lostRTC();
+	serialTelemetry();
+
+	double	wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("\n%d checks, %d failed, %.2fs wall clock\n", checks, failures, wall);
+	return failures ? 1 : 0;
+}
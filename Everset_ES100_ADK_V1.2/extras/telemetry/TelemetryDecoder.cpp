@@ -0,0 +1,362 @@
+/*
+Host-side decoder for the binary serial telemetry, see TelemetryDecoder.h
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "TelemetryDecoder.h"
+
+#define HEADER_LEN		3
+#define CRC_LEN			2
+
+/******************************************************************************
+ * CRC and COBS
+ ******************************************************************************/
+// CRC-16/CCITT-FALSE, as Telemetry.cpp
+uint16_t telemetryCrc(const uint8_t *data, size_t len)
+{
+	uint16_t	crc = 0xFFFF;
+
+	while (len--) {
+		crc ^= (uint16_t)*data++ << 8;
+		for (int i = 0; i < 8; i++)
+			crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+
+	return crc;
+}
+
+// Returns the decoded length, or -1 if in is not valid COBS
+static int cobsDecode(const uint8_t *in, size_t len, uint8_t *out, size_t size)
+{
+	size_t	i = 0, n = 0;
+
+	while (i < len) {
+		uint8_t		code = in[i++];
+
+		if (code == 0 || i + code - 1 > len || n + code - 1 > size)
+			return -1;
+		memcpy(out + n, in + i, code - 1);
+		n += code - 1;
+		i += code - 1;
+
+		if (code < 0xFF && i < len) {
+			if (n >= size)
+				return -1;
+			out[n++] = 0;
+		}
+	}
+
+	return (int)n;
+}
+
+static bool isText(uint8_t c)
+{
+	return (c >= 0x20 && c < 0x7F) || c == '\r' || c == '\n' || c == '\t';
+}
+
+/******************************************************************************
+ * Decoder
+ ******************************************************************************/
+TelemetryDecoder::TelemetryDecoder(TelemetryFrameHandler onFrame, TelemetryTextHandler onText, void *context) :
+	_onFrame(onFrame), _onText(onText), _context(context)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+void TelemetryDecoder::_text()
+{
+	stats.textBytes += _len;
+	if (_onText != NULL)
+		_onText(_context, (const char *)_run, _len);
+	_len = 0;
+}
+
+void TelemetryDecoder::_end()
+{
+	uint8_t			body[TELEMETRY_FRAME_MAX];
+	int				n;
+	TelemetryFrame	frame;
+
+	if (_len == 0 && !_long)
+		return;
+
+	n = _long ? -1 : cobsDecode(_run, _len, body, sizeof(body));
+	if (n >= HEADER_LEN + CRC_LEN &&
+		telemetryCrc(body, n - CRC_LEN) == (body[n - 2] | body[n - 1] << 8)) {
+		frame.type		= body[0];
+		frame.version	= body[1];
+		frame.seq		= body[2];
+		frame.payload	= body + HEADER_LEN;
+		frame.len		= n - HEADER_LEN - CRC_LEN;
+
+		// The sequence starts over at a reboot
+		if (_lastSeq >= 0 && frame.type != TM_BOOT)
+			stats.lost += (uint8_t)(frame.seq - _lastSeq - 1);
+		_lastSeq = frame.seq;
+
+		stats.frames++;
+		if (_onFrame != NULL)
+			_onFrame(_context, &frame);
+	} else if (_printable) {
+		if (_len > 0)
+			_text();
+	} else if (n >= HEADER_LEN + CRC_LEN) {
+		stats.crcErrors++;
+	} else {
+		stats.badFrames++;
+	}
+
+	_len		= 0;
+	_printable	= true;
+	_long		= false;
+}
+
+void TelemetryDecoder::feed(const uint8_t *data, size_t len)
+{
+	stats.bytes += len;
+
+	for (size_t i = 0; i < len; i++) {
+		uint8_t		c = data[i];
+
+		if (c == 0) {
+			_end();
+			continue;
+		}
+
+		_printable = _printable && isText(c);
+		if (_len == sizeof(_run)) {
+			// Too long for a frame: text goes out in pieces, anything else is dropped
+			if (_printable)
+				_text();
+			else
+				_len = 0;
+		}
+		_run[_len++] = c;
+		if (_len > TELEMETRY_FRAME_MAX)
+			_long = true;
+	}
+}
+
+// End of the capture, a run without its delimiter can only be text
+void TelemetryDecoder::finish()
+{
+	if (_len > 0 && _printable)
+		_text();
+	else if (_len > 0)
+		stats.badFrames++;
+
+	_len		= 0;
+	_printable	= true;
+	_long		= false;
+}
+
+/******************************************************************************
+ * Formatting
+ ******************************************************************************/
+struct Out
+{
+	char	*buf;
+	size_t	size;
+	size_t	len;
+
+	void add(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+	{
+		va_list	ap;
+		int		n;
+
+		if (len >= size)
+			return;
+		va_start(ap, fmt);
+		n = vsnprintf(buf + len, size - len, fmt, ap);
+		va_end(ap);
+		if (n > 0)
+			len += (size_t)n < size - len ? (size_t)n : size - len - 1;
+	}
+};
+
+// Copies the payload out, so the packed fields are read without alignment
+// trouble. false if it is too short for the record.
+template<class T> static bool payload(const TelemetryFrame *frame, T *record)
+{
+	if (frame->len < sizeof(T))
+		return false;
+	memcpy(record, frame->payload, sizeof(T));
+	return true;
+}
+
+const char *telemetryTypeName(uint8_t type)
+{
+	switch (type) {
+		case TM_TEXT:			return "text";
+		case TM_BOOT:			return "boot";
+		case TM_ES100_RX:		return "es100_rx";
+		case TM_ES100_IRQ:		return "es100_irq";
+		case TM_ES100_BUS:		return "es100_bus";
+		case TM_SYNC:			return "sync";
+		case TM_PPS:			return "pps";
+		case TM_RTC:			return "rtc";
+		case TM_LCD:			return "lcd";
+		case TM_WWVB_FRAME:		return "wwvb_frame";
+		case TM_WWVB_PULSES:	return "wwvb_pulses";
+		case TM_WWVB_ZONE:		return "wwvb_zone";
+	}
+	return "unknown";
+}
+
+static const char *rtcEventName(uint8_t event)
+{
+	switch (event) {
+		case TM_RTC_PHASE:			return "phase";
+		case TM_RTC_STEP:			return "step";
+		case TM_RTC_WRITE_FAILED:	return "write_failed";
+		case TM_RTC_RESTORED:		return "restored";
+	}
+	return "?";
+}
+
+static bool formatKnown(const TelemetryFrame *f, Out &out)
+{
+	switch (f->type) {
+		case TM_TEXT:
+			if (f->version != TM_TEXT_V)
+				return false;
+			out.add(" \"%.*s\"", (int)f->len, (const char *)f->payload);
+			return true;
+
+		case TM_BOOT: {
+			TMBoot	r;
+			if (f->version != TM_BOOT_V || !payload(f, &r))
+				return false;
+			out.add(" sketch=%u restored=%u", r.sketch, r.restored);
+			return true;
+		}
+
+		case TM_ES100_RX: {
+			TMES100Rx	r;
+			if (f->version != TM_ES100_RX_V || !payload(f, &r))
+				return false;
+			out.add(" utc=%u offset=%d kind=%u state=%u timed_out_in=%u rx_ok=%u antenna=%u"
+					" leap=%u dst=%u tracking=%u next_dst=%02u/%02u:%02u correction=%d"
+					" enable_ms=%u ready_ms=%u rx_ms=%u read_us=%u irqs=%u",
+					r.utc, r.offset, r.kind, r.state, r.timedOutIn, r.status0 & 1, (r.status0 >> 1) & 1,
+					(r.status0 >> 3) & 3, (r.status0 >> 5) & 3, r.status0 >> 7,
+					r.nextDstMonth, r.nextDstDay, r.nextDstHour, r.correction,
+					r.enableMs, r.readyMs, r.rxMs, r.readUs, r.irqs);
+			return true;
+		}
+
+		case TM_ES100_IRQ: {
+			TMES100Irq	r;
+			if (f->version != TM_ES100_IRQ_V || !payload(f, &r))
+				return false;
+			out.add(" count=%u", r.count);
+			return true;
+		}
+
+		case TM_ES100_BUS: {
+			TMES100Bus	r;
+			if (f->version != TM_ES100_BUS_V || !payload(f, &r))
+				return false;
+			out.add(" transactions=%u bytes=%u window_reads=%u cache_hits=%u bus_us=%u errors=%u"
+					" rtc_bus_us=%u rtc_requests=%u rtc_errors=%u clock_changes=%u max_depth=%u"
+					" max_latency_us=%u failed=%u retries=%u nacks=%u bus_errors=%u timeouts=%u recoveries=%u",
+					r.transactions, r.bytes, r.snapshotReads, r.cacheHits, r.busMicros, r.errors,
+					r.rtcBusMicros, r.rtcRequests, r.rtcErrors, r.clockChanges, r.maxDepth,
+					r.maxLatency, r.failed, r.retries, r.nacks, r.busErrors, r.timeouts, r.recoveries);
+			return true;
+		}
+
+		case TM_SYNC: {
+			TMSync	r;
+			if (f->version != TM_SYNC_V || !payload(f, &r))
+				return false;
+			out.add(" full=%u/%u tracking=%u/%u on_today_s=%u on_last_day_s=%u",
+					r.fullOk, r.full, r.trackingOk, r.tracking, r.onSecondsToday, r.onSecondsLastDay);
+			return true;
+		}
+
+		case TM_PPS: {
+			TMPps	r;
+			if (f->version != TM_PPS_V || !payload(f, &r))
+				return false;
+			out.add(" locked=%u", r.locked);
+			if (r.lastError != INT32_MIN)
+				out.add(" error_us=%d", r.lastError);
+			out.add(" max_error_us=%u rate_ppb=%d holdover_s=%u", r.maxError, r.rate, r.holdover);
+			return true;
+		}
+
+		case TM_RTC: {
+			TMRtc	r;
+			if (f->version != TM_RTC_V || !payload(f, &r))
+				return false;
+			out.add(" event=%s value=%d", rtcEventName(r.event), r.value);
+			return true;
+		}
+
+		case TM_LCD: {
+			TMLcd	r;
+			if (f->version != TM_LCD_V || !payload(f, &r))
+				return false;
+			out.add(" full_redraw=%u seconds=%u bytes=%u moves=%u cpu_us=%u flush_us=%u"
+					" max_depth=%u overflows=%u deferred=%u",
+					r.fullRedraw, r.seconds, r.bytes, r.moves, r.cpuMicros, r.flushMicros,
+					r.maxDepth, r.overflows, r.deferred);
+			return true;
+		}
+
+		case TM_WWVB_FRAME: {
+			TMWwvbFrame	r;
+			if (f->version != TM_WWVB_FRAME_V || !payload(f, &r))
+				return false;
+			out.add(" year=%u day=%u time=%02u:%02u dut=%c0.%u leap_year=%u leap_second=%u dst=%u",
+					r.year, r.day, r.hour, r.minute, r.dutSign == 5 ? '+' : r.dutSign == 2 ? '-' : '?',
+					r.dut, r.leapYear, r.leapSecond, r.dst);
+			return true;
+		}
+
+		case TM_WWVB_PULSES: {
+			TMWwvbPulses	r;
+			if (f->version != TM_WWVB_PULSES_V || f->len < 2 || f->len > sizeof(r))
+				return false;
+			memset(&r, 0, sizeof(r));
+			memcpy(&r, f->payload, f->len);
+			if (r.count > sizeof(r.width) || f->len < 2 + r.count)
+				return false;
+			out.add(" sample_hz=%u width=", r.sampleHz);
+			for (uint8_t i = 0; i < r.count; i++)
+				out.add(i ? ",%u" : "%u", r.width[i]);
+			return true;
+		}
+
+		case TM_WWVB_ZONE: {
+			TMWwvbZone	r;
+			if (f->version != TM_WWVB_ZONE_V || !payload(f, &r))
+				return false;
+			out.add(" hours=%d", r.hours);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+size_t telemetryFormat(const TelemetryFrame *frame, char *buf, size_t size)
+{
+	Out		out = { buf, size, 0 };
+
+	if (size == 0)
+		return 0;
+	buf[0] = '\0';
+
+	out.add("%s seq=%u", telemetryTypeName(frame->type), frame->seq);
+	if (!formatKnown(frame, out)) {
+		out.len = 0;
+		out.add("%s seq=%u type=0x%02X version=%u len=%u not decoded",
+				telemetryTypeName(frame->type), frame->seq, frame->type, frame->version, frame->len);
+	}
+
+	return out.len;
+}
@@ -0,0 +1,75 @@
+/*
+Host-side decoder for the binary serial telemetry, see Telemetry.h
+
+Takes the raw bytes captured from one clock's serial port in chunks of
+any size, splits them at the 0x00 delimiters, undoes the COBS encoding,
+checks the CRC and hands each good frame to a callback. Runs of printable
+characters that are not a frame, like an ES100 trace dump, go to a second
+callback. Nothing is allocated after construction, so one decoder per
+clock can run through hours of captures at memory speed.
+
+telemetryFormat() turns a frame into one line of text, field=value pairs
+after the record name, for the record types and versions it knows.
+*/
+
+#ifndef TelemetryDecoder_h
+#define TelemetryDecoder_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "TelemetryRecords.h"
+
+#define TELEMETRY_FRAME_MAX		(3 + TM_MAX_PAYLOAD + 2 + 1)	// Header, payload, CRC, COBS code
+#define TELEMETRY_TEXT_MAX		256								// Longest text run handed over at once
+
+struct TelemetryFrame
+{
+	uint8_t			type;
+	uint8_t			version;
+	uint8_t			seq;
+	const uint8_t	*payload;
+	uint8_t			len;
+};
+
+struct TelemetryDecoderStats
+{
+	uint64_t		bytes;				// Fed in
+	uint64_t		frames;				// Good frames
+	uint64_t		crcErrors;			// Frames that decoded but failed the CRC
+	uint64_t		badFrames;			// Runs that were neither a frame nor text
+	uint64_t		lost;				// Frames missing by their sequence numbers
+	uint64_t		textBytes;
+};
+
+typedef void (*TelemetryFrameHandler)(void *context, const TelemetryFrame *frame);
+typedef void (*TelemetryTextHandler)(void *context, const char *text, size_t len);
+
+class TelemetryDecoder
+{
+	public:
+		TelemetryDecoder(TelemetryFrameHandler onFrame, TelemetryTextHandler onText, void *context);
+
+		void			feed(const uint8_t *data, size_t len);
+		void			finish();
+
+		TelemetryDecoderStats	stats;
+
+	private:
+		void			_end();
+		void			_text();
+
+		TelemetryFrameHandler	_onFrame;
+		TelemetryTextHandler	_onText;
+		void			*_context;
+		uint8_t			_run[TELEMETRY_TEXT_MAX];	// Bytes since the last delimiter
+		size_t			_len = 0;
+		bool			_printable = true;			// Every byte of the run so far
+		bool			_long = false;				// The run outgrew a frame
+		int				_lastSeq = -1;
+};
+
+uint16_t	telemetryCrc(const uint8_t *data, size_t len);
+size_t		telemetryFormat(const TelemetryFrame *frame, char *buf, size_t size);
+const char	*telemetryTypeName(uint8_t type);
+
+#endif
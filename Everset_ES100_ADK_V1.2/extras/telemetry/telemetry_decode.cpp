@@ -0,0 +1,168 @@
+/*
+Decodes binary telemetry captures of one or many clocks
+
+Each file argument is the raw serial capture of one clock, "-" reads
+stdin. Every record is printed as one line prefixed with the clock's
+name, the file name without its directory and extension:
+  shed es100_rx seq=12 utc=... state=4 ...
+Text between frames, like an ES100 trace dump, is printed as it came,
+prefixed the same way, so the "ES100TRACE:" lines can be piped on to
+es100_trace_decode. A summary per clock goes to stderr at the end.
+
+  -s        summary only, no record lines
+  -t TYPE   only records of this type, by name (es100_rx, pps, ...)
+
+Build and run on Linux, from this directory:
+  g++ -std=gnu++11 -O2 -I. -I../.. -o telemetry_decode *.cpp
+  ./telemetry_decode shed.bin kitchen.bin
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "TelemetryDecoder.h"
+
+#define READ_CHUNK		(1 << 16)
+
+struct Clock
+{
+	char		name[64];
+	FILE		*out;
+	bool		quiet;
+	int			type;				// Only this record type, -1 for all
+	uint64_t	perType[256];
+	char		line[2048];
+};
+
+static void onFrame(void *context, const TelemetryFrame *frame)
+{
+	Clock	*clock = (Clock *)context;
+	size_t	n;
+
+	clock->perType[frame->type]++;
+	if (clock->quiet || (clock->type >= 0 && frame->type != clock->type))
+		return;
+
+	n = strlen(clock->name);
+	memcpy(clock->line, clock->name, n);
+	clock->line[n++] = ' ';
+	n += telemetryFormat(frame, clock->line + n, sizeof(clock->line) - n - 1);
+	clock->line[n++] = '\n';
+	fwrite(clock->line, 1, n, clock->out);
+}
+
+static void onText(void *context, const char *text, size_t len)
+{
+	Clock	*clock = (Clock *)context;
+
+	if (clock->quiet || clock->type >= 0)
+		return;
+
+	// Line by line, each with the clock's name
+	while (len > 0) {
+		const char	*nl = (const char *)memchr(text, '\n', len);
+		size_t		n = nl ? nl - text + 1 : len;
+
+		if (n > 1 || text[0] != '\n')
+			fprintf(clock->out, "%s text %.*s%s", clock->name, (int)n, text, nl ? "" : "\n");
+		text += n;
+		len -= n;
+	}
+}
+
+static int typeByName(const char *name)
+{
+	for (int type = 0; type < 256; type++)
+		if (strcmp(telemetryTypeName(type), name) == 0)
+			return type;
+	return -2;
+}
+
+static void clockName(const char *path, char *name, size_t size)
+{
+	const char	*base = strrchr(path, '/');
+	const char	*dot;
+	size_t		n;
+
+	base = base ? base + 1 : path;
+	dot = strrchr(base, '.');
+	n = dot && dot != base ? (size_t)(dot - base) : strlen(base);
+	if (n >= size)
+		n = size - 1;
+	memcpy(name, base, n);
+	name[n] = '\0';
+}
+
+int main(int argc, char **argv)
+{
+	bool		quiet = false;
+	int			type = -1;
+	int			first = 1;
+	int			status = 0;
+	uint64_t	totalBytes = 0;
+	static uint8_t	buf[READ_CHUNK];
+	std::chrono::steady_clock::time_point	start = std::chrono::steady_clock::now();
+
+	for (; first < argc && argv[first][0] == '-' && argv[first][1] != '\0'; first++) {
+		if (strcmp(argv[first], "-s") == 0) {
+			quiet = true;
+		} else if (strcmp(argv[first], "-t") == 0 && first + 1 < argc) {
+			type = typeByName(argv[++first]);
+			if (type < 0) {
+				fprintf(stderr, "unknown record type %s\n", argv[first]);
+				return 2;
+			}
+		} else {
+			fprintf(stderr, "usage: %s [-s] [-t type] capture...\n", argv[0]);
+			return 2;
+		}
+	}
+	if (first >= argc) {
+		fprintf(stderr, "usage: %s [-s] [-t type] capture...\n", argv[0]);
+		return 2;
+	}
+
+	for (int i = first; i < argc; i++) {
+		Clock				*clock = (Clock *)calloc(1, sizeof(Clock));
+		TelemetryDecoder	decoder(onFrame, onText, clock);
+		FILE				*in = strcmp(argv[i], "-") == 0 ? stdin : fopen(argv[i], "rb");
+		size_t				n;
+
+		if (in == NULL) {
+			perror(argv[i]);
+			free(clock);
+			status = 1;
+			continue;
+		}
+
+		clockName(strcmp(argv[i], "-") == 0 ? "stdin" : argv[i], clock->name, sizeof(clock->name));
+		clock->out		= stdout;
+		clock->quiet	= quiet;
+		clock->type		= type;
+
+		while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+			decoder.feed(buf, n);
+		decoder.finish();
+		if (in != stdin)
+			fclose(in);
+
+		fprintf(stderr, "%s: %llu bytes, %llu records, %llu lost, %llu CRC errors, %llu bad frames, %llu text bytes\n",
+				clock->name, (unsigned long long)decoder.stats.bytes,
+				(unsigned long long)decoder.stats.frames, (unsigned long long)decoder.stats.lost,
+				(unsigned long long)decoder.stats.crcErrors, (unsigned long long)decoder.stats.badFrames,
+				(unsigned long long)decoder.stats.textBytes);
+		for (int t = 0; t < 256; t++)
+			if (clock->perType[t])
+				fprintf(stderr, "  %-12s %llu\n", telemetryTypeName(t), (unsigned long long)clock->perType[t]);
+
+		totalBytes += decoder.stats.bytes;
+		free(clock);
+	}
+
+	double	wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (argc - first > 1)
+		fprintf(stderr, "%d captures, %.1f MB in %.2fs\n", argc - first, totalBytes / 1e6, wall);
+	return status;
+}
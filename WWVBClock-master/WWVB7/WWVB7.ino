@@ -1,41 +1,14 @@
 #include <SparkFunDS3234RTC.h>
     // Library from https://learn.sparkfun.com/tutorials/deadon-rtc-breakout-hookup-guide
+#include "WWVBDecoder.h"
+    // Soft-decision decoder voting over consecutive minutes, also in WWVB8
 
 #define DEBUG_PIN           5
 
 #define CENTURY 2000
 
 // WWVB reference https://www.nist.gov/sites/default/files/documents/2017/04/28/SP-432-NIST-Time-and-Frequency-Services-2012-02-13.pdf
-// Indices for parts of WWVB frame
-enum {
-    FPRM, // Frame reference marker: .8L+.2H
-    FPUU, // Unweighted: .2L+.8H
-    // d1: .5L+.5H / 0 = .2L+.8H
-    FPM1, // 10 minutes
-    FPM2, //  1 minutes
-    FPH1, // 10 hours
-    FPH2, //  1 hours
-    FPD1, //100 days
-    FPD2, // 10 days
-    FPD3, //  1 days
-    FPUS, // UTC sign
-    FPUC, // UTC correction
-    FPY1, // 10 years
-    FPY2, //  1 years
-    FPLY, // Leap year
-    FPLS, // Leap second
-    FPDS, // Daylight saving time
-    FPEF}; // End of frame same as FPRM
-// Order of received frame, one per second
-const byte FramePattern[] =
-    // .0   .1   .2   .3   .4   .5   .6   .7   .8   .9
-/*0.*/{FPRM,FPM1,FPM1,FPM1,FPUU,FPM2,FPM2,FPM2,FPM2,FPRM,
-/*1.*/ FPUU,FPUU,FPH1,FPH1,FPUU,FPH2,FPH2,FPH2,FPH2,FPRM,
-/*2.*/ FPUU,FPUU,FPD1,FPD1,FPUU,FPD2,FPD2,FPD2,FPD2,FPRM,
-/*3.*/ FPD3,FPD3,FPD3,FPD3,FPUU,FPUU,FPUS,FPUS,FPUS,FPRM,
-/*4.*/ FPUC,FPUC,FPUC,FPUC,FPUU,FPY1,FPY1,FPY1,FPY1,FPRM,
-/*5.*/ FPY2,FPY2,FPY2,FPY2,FPUU,FPLY,FPLS,FPDS,FPDS,FPEF};
-#define FRAME_SIZE 60
+// WWVBDecoder.cpp has the layout of the frame
 
 // Receiver module http://canaduino.ca/downloads/60khz.pdf
 // Receiver IC http://canaduino.ca/downloads/MAS6180C.pdf
@@ -59,6 +32,7 @@ byte samples, samplesHigh, samplesLow, prevMod;
 #define CODE_P 3
 #define CODE_X 4
 byte code = CODE_N;
+byte width;  // samplesLow of the last second, with code
 unsigned long cyclesSinceTimeSet = 0x80000000;
 
 /* Timer 1 interrupt to measure signal
@@ -86,6 +60,7 @@ ISR(TIMER1_COMPA_vect)  {
     else if (samplesLow > 33*SAMPLE_HZ/100 && samplesLow < 60*SAMPLE_HZ/100) code = CODE_W;
     else if (samplesLow >  5*SAMPLE_HZ/100 && samplesLow < 30*SAMPLE_HZ/100) code = CODE_U;
     else code = CODE_X;
+    width = samplesLow;
     samples = SAMPLE_HZ; samplesLow = samplesHigh = 0; // clear for next sample
   }
 }
@@ -130,46 +105,24 @@ void displaySend(void) {
 
 int zoneHours = 0;
 
-byte frame[FRAME_SIZE], frameIndex = 0;
-short decode[FPEF];   // accumulated parts of frame
+WWVBDecoder wwvb;
 boolean timeSet = false;
 byte daysInMonth[] = {0,31,28,31,30,31,30,31,31,30,31,30,31};
 //                     JanFebMarAprMayJunJulAugSepOctNovDec  
 
 void decodeAndSetTime(void) {
-  // Decode frame parts
-  memset(decode,0,sizeof decode);
-  for (int x = 0; x < FRAME_SIZE; x++) {
-    byte p = FramePattern[x], c = frame[x];
-    switch (p) {
-    case FPRM:  // Frame reference marker: .8L+.2H
-      if (c != CODE_P) return;
-      break;
-    case FPEF:  // End of frame same as FPRM
-      if (c != CODE_P) return;
-      break;
-    case FPUU:  // Unweighted: .2L+.8H
-      if (c != CODE_U) return;
-      break;
-    default:  // bit 1: .5L+.5H / 0 = .2L+.8H
-      // binary coding
-      if (c == CODE_U) decode[p] = (decode[p] << 1);
-      else if (c == CODE_W) decode[p] = (decode[p] << 1) | 1;
-      else return;
-      break;
-    }
-  }
-  // Combine decimal digits
+  // Fields of the minute that just ended, decoded over the last few
+  WWVBTime t = wwvb.getTime();
   int mn, hr, dy, us, uc, yr, ly, ls, ds;
-  mn = decode[FPM1]*10 + decode[FPM2];
-  hr = decode[FPH1]*10 + decode[FPH2];
-  dy = decode[FPD1]*100 + decode[FPD2]*10 + decode[FPD3];
-  us = decode[FPUS];
-  uc = decode[FPUC];
-  yr = decode[FPY1]*10 + decode[FPY2] + CENTURY;
-  ly = decode[FPLY];
-  ls = decode[FPLS];
-  ds = decode[FPDS];
+  mn = t.minute;
+  hr = t.hour;
+  dy = t.day;
+  us = t.dutSign;
+  uc = t.dut;
+  yr = t.year;
+  ly = t.leapYear;
+  ls = t.leapSecond;
+  ds = t.dst;
   if (Serial) {
     Serial.print("Y"); Serial.print(yr);
     Serial.print("D"); Serial.print(dy);
@@ -262,6 +215,7 @@ void setup(void) {
   radioPort = digitalPinToPort(RADIO_OUT_PIN);  // for optimized digitalRead
   radioBit = digitalPinToBitMask(RADIO_OUT_PIN);
   samples = SAMPLE_HZ; samplesLow = samplesHigh = 0;
+  wwvb.begin();
   // Start timer1 for periodic interrupt at SAMPLE_HZ per second
   noInterrupts(); {
   	TCCR1A = 0;
@@ -297,13 +251,12 @@ void loop(void) {
     // once per second
     if (code == CODE_P && prevCode == CODE_P) {
       // once per minute
-      if (frameIndex == FRAME_SIZE) {
-        decodeAndSetTime();
-      }
       if (Serial) { Serial.write('\r'); Serial.write('\n'); }
-      frameIndex = 0;
     } 
-    if (frameIndex < FRAME_SIZE) frame[frameIndex++] = code;
+    // The decoder finds the minute by its own markers
+    if (wwvb.addSecond(width * (1000 / SAMPLE_HZ))) {
+      decodeAndSetTime();
+    }
       if (Serial) { Serial.write(printCode[code]); }
   	prevCode = code;  code = CODE_N;
   } else if (digitalRead(RTC_INTERRUPT_PIN) != lastCycle) {
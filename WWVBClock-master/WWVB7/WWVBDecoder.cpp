@@ -0,0 +1,321 @@
+/*
+Soft-decision WWVB time code decoder, see WWVBDecoder.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <Arduino.h>
+#include "WWVBDecoder.h"
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+// WWVB frame, one second each, after NIST SP 432:
+//       .0 .1 .2 .3 .4 .5 .6 .7 .8 .9
+//  0.   P  M1 M1 M1 0  M2 M2 M2 M2 P
+//  1.   0  0  H1 H1 0  H2 H2 H2 H2 P
+//  2.   0  0  D1 D1 0  D2 D2 D2 D2 P
+//  3.   D3 D3 D3 D3 0  0  US US US P
+//  4.   UC UC UC UC 0  Y1 Y1 Y1 Y1 P
+//  5.   Y2 Y2 Y2 Y2 0  LY LS DS DS P
+// P is a marker, 0.8 s low; a bit is 0.5 s low for 1 and 0.2 s for 0, as
+// are the unweighted seconds. The parts that carry bits are each a run of
+// seconds, most significant bit first.
+enum {
+	PART_M1, PART_M2, PART_H1, PART_H2, PART_D1, PART_D2, PART_D3,
+	PART_US, PART_UC, PART_Y1, PART_Y2, PART_LY, PART_LS, PART_DS, PARTS
+};
+
+static const uint8_t	partFirst[PARTS]	= { 1, 5, 12, 15, 22, 25, 30, 36, 40, 45, 50, 55, 56, 57 };
+static const uint8_t	partBits[PARTS]		= { 3, 4,  2,  4,  2,  4,  4,  3,  4,  4,  4,  1,  1,  2 };
+
+// Seconds that carry a marker, 0.8 s low
+static const uint8_t	markers[]			= { 0, 9, 19, 29, 39, 49, 59 };
+
+#define MARKERS			(sizeof(markers) / sizeof(markers[0]))
+#define NO_SCORE		(-0x7FFF - 1)
+
+// Best value of a field and the lead it has over the runner-up
+struct Vote
+{
+	uint16_t	value;
+	int16_t		best;
+	int16_t		next;
+
+	Vote() : value(0), best(NO_SCORE), next(NO_SCORE) { }
+
+	void add(uint16_t v, int16_t score)
+	{
+		if (score > best) {
+			next	= best;
+			best	= score;
+			value	= v;
+		} else if (score > next) {
+			next	= score;
+		}
+	}
+
+	int16_t lead()	{ return best - next; }
+};
+
+static int8_t clampSoft(int16_t v)
+{
+	if (v > WWVB_SOFT_MAX)
+		return WWVB_SOFT_MAX;
+	if (v < -WWVB_SOFT_MAX)
+		return -WWVB_SOFT_MAX;
+	return v;
+}
+
+// < 0 for 200 ms, > 0 for 500 ms. A marker length or a missing pulse says
+// nothing about the bit.
+static int8_t softBit(uint16_t width)
+{
+	if (width < 100 || width > 650)
+		return 0;
+	return clampSoft(((int16_t)width - 350) / WWVB_SOFT_STEP);
+}
+
+// > 0 for 800 ms, < 0 for the data widths
+static int8_t softMarker(uint16_t width)
+{
+	if (width < 100 || width > 950)
+		return 0;
+	return clampSoft(((int16_t)width - 650) / WWVB_SOFT_STEP);
+}
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+// The phase with the strongest markers, if it leads every other one by
+// WWVB_PHASE_MARGIN; otherwise the current one stays
+uint8_t WWVBDecoder::_findPhase()
+{
+	int16_t		best = NO_SCORE, next = NO_SCORE;
+	uint8_t		bestPhase = 0;
+
+	for (uint8_t phase = 0; phase < 60; phase++) {
+		int16_t		score = 0;
+
+		for (uint8_t i = 0; i < MARKERS; i++) {
+			uint8_t		slot = phase + markers[i];
+			score += _marker[slot < 60 ? slot : slot - 60];
+		}
+
+		if (score > best) {
+			next		= best;
+			best		= score;
+			bestPhase	= phase;
+		} else if (score > next) {
+			next = score;
+		}
+	}
+
+	return best - next >= WWVB_PHASE_MARGIN ? bestPhase : _phase;
+}
+
+// Agreement of the soft bits of a part with digit, frame 0 the newest
+int16_t WWVBDecoder::_score(uint8_t frame, uint8_t part, uint8_t digit)
+{
+	const int8_t	*soft = _soft[(_newest + WWVB_FRAMES - frame) % WWVB_FRAMES] + partFirst[part];
+	uint8_t			bits = partBits[part];
+	int16_t			score = 0;
+
+	for (uint8_t i = 0; i < bits; i++)
+		score += (digit >> (bits - 1 - i)) & 1 ? soft[i] : -soft[i];
+
+	return score;
+}
+
+// The bits of a part that seldom changes, each by the sign of its sum over
+// the frames. Flipping one costs twice its sum, which is its lead.
+uint8_t WWVBDecoder::_majority(uint8_t part, uint8_t frames)
+{
+	uint8_t		value = 0;
+
+	for (uint8_t i = 0; i < partBits[part]; i++) {
+		int16_t		sum = 0;
+
+		for (uint8_t k = 0; k < frames; k++)
+			sum += _soft[(_newest + WWVB_FRAMES - k) % WWVB_FRAMES][partFirst[part] + i];
+
+		value = value << 1 | (sum > 0);
+		if (2 * abs(sum) < _margin)
+			_margin = 2 * abs(sum);
+	}
+
+	return value;
+}
+
+uint8_t WWVBDecoder::_decode()
+{
+	Vote		minute, hour, day, year;
+	uint8_t		dayFrames;
+	uint8_t		dutSign, dut, leapSecond, dst;
+
+	// The minute goes back one per frame
+	for (uint8_t m = 0; m < 60; m++) {
+		int16_t		score = 0;
+
+		for (uint8_t k = 0; k < _frames; k++) {
+			uint8_t		mk = (m + 60 - k) % 60;
+			score += _score(k, PART_M1, mk / 10) + _score(k, PART_M2, mk % 10);
+		}
+		minute.add(m, score);
+	}
+
+	// Frames from before the minute wrapped are in the previous hour
+	for (uint8_t h = 0; h < 24; h++) {
+		int16_t		score = 0;
+
+		for (uint8_t k = 0; k < _frames; k++) {
+			uint8_t		hk = k > minute.value ? (h + 23) % 24 : h;
+			score += _score(k, PART_H1, hk / 10) + _score(k, PART_H2, hk % 10);
+		}
+		hour.add(h, score);
+	}
+
+	// ... and after midnight those are the previous day, maybe year
+	dayFrames = hour.value == 0 && _frames > minute.value + 1 ? minute.value + 1 : _frames;
+
+	for (uint16_t d = 1; d <= 366; d++) {
+		int16_t		score = 0;
+
+		for (uint8_t k = 0; k < dayFrames; k++)
+			score += _score(k, PART_D1, d / 100) + _score(k, PART_D2, d / 10 % 10) + _score(k, PART_D3, d % 10);
+		day.add(d, score);
+	}
+
+	for (uint8_t y = 0; y < 100; y++) {
+		int16_t		score = 0;
+
+		for (uint8_t k = 0; k < dayFrames; k++)
+			score += _score(k, PART_Y1, y / 10) + _score(k, PART_Y2, y % 10);
+		year.add(y, score);
+	}
+
+	_margin = minute.lead();
+	if (hour.lead() < _margin)
+		_margin = hour.lead();
+	if (day.lead() < _margin)
+		_margin = day.lead();
+	if (year.lead() < _margin)
+		_margin = year.lead();
+
+	dutSign		= _majority(PART_US, _frames);
+	dut			= _majority(PART_UC, _frames);
+	leapSecond	= _majority(PART_LS, dayFrames);
+	dst			= _majority(PART_DS, dayFrames);
+
+	if (_margin < commitMargin)
+		return false;
+
+	// 2000 to 2099 are leap years every fourth year
+	if (day.value == 366 && year.value % 4 != 0)
+		return false;
+
+	_time.year		= 2000 + year.value;
+	_time.day		= day.value;
+	_time.hour		= hour.value;
+	_time.minute	= minute.value;
+	_time.leapYear	= year.value % 4 == 0;
+	_time.dutSign	= dutSign;
+	_time.dut		= dut;
+	_time.leapSecond = leapSecond;
+	_time.dst		= dst;
+
+	return true;
+}
+
+/******************************************************************************
+ * User API
+ ******************************************************************************/
+void WWVBDecoder::begin()
+{
+	memset(_marker, 0, sizeof(_marker));
+	_slot	= 0;
+	_phase	= WWVB_NO_PHASE;
+	_second	= WWVB_NO_PHASE;
+	_newest	= 0;
+	_filled	= 0;
+	_frames	= 0;
+	_margin	= 0;
+	_badMarkers = 0;
+}
+
+// One call per second, true when the minute that just ended was decoded
+uint8_t WWVBDecoder::addSecond(uint16_t widthMs)
+{
+	uint8_t		phase;
+	uint8_t		decoded = false;
+
+	// Half the evidence of a slot goes every minute, so after a lost or
+	// extra pulse the new phase leads within a minute or two
+	_marker[_slot] += softMarker(widthMs) - _marker[_slot] / 2;
+
+	phase = _findPhase();
+	if (phase != _phase) {
+		// The minutes collected so far are at the wrong seconds
+		_phase	= phase;
+		_filled	= 0;
+		_frames	= 0;
+	}
+
+	if (_phase == WWVB_NO_PHASE) {
+		_slot = (_slot + 1) % 60;
+		return false;
+	}
+
+	_second = (_slot + 60 - _phase) % 60;
+	if (_second == 0) {
+		uint8_t		bad = softMarker(widthMs) < 0;
+
+		// The marker of second 0 ends the minute before; it only counts if
+		// all of it came in at this phase, with its markers where they belong
+		if (_filled == 59 && _badMarkers + bad < WWVB_BAD_MARKERS) {
+			if (_frames < WWVB_FRAMES)
+				_frames++;
+			decoded = _decode();
+		} else {
+			_frames = 0;
+		}
+
+		// The oldest frame is overwritten from here on, the new one takes
+		// its place in the count once it is complete
+		_newest		= (_newest + 1) % WWVB_FRAMES;
+		_filled		= 0;
+		_badMarkers	= bad;
+	} else {
+		_soft[_newest][_second] = softBit(widthMs);
+		_filled++;
+		if (_second % 10 == 9 && softMarker(widthMs) < 0)
+			_badMarkers++;
+	}
+
+	_slot = (_slot + 1) % 60;
+	return decoded;
+}
+
+WWVBTime WWVBDecoder::getTime()
+{
+	return _time;
+}
+
+// Second of the minute of the last width added, WWVB_NO_PHASE until the
+// markers have been found
+uint8_t WWVBDecoder::getSecond()
+{
+	return _second;
+}
+
+// Minutes the last decode voted over
+uint8_t WWVBDecoder::getFrames()
+{
+	return _frames;
+}
+
+int16_t WWVBDecoder::getMargin()
+{
+	return _margin;
+}
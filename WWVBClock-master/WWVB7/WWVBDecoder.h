@@ -0,0 +1,97 @@
+/*
+Soft-decision WWVB time code decoder for the WWVB clocks
+
+decodeAndSetTime() used to take a minute only if every one of its 60
+seconds classified exactly as the frame layout says, so one misread second
+anywhere threw the minute away, and each minute was decoded on its own.
+This decoder keeps how sure it is of every second and votes over
+consecutive minutes instead:
+
+- each pulse width becomes a soft bit, negative towards a 0 (200 ms),
+  positive towards a 1 (500 ms), larger the clearer the width. A width
+  that is neither, a marker in a data second or no pulse at all, counts
+  as 0 rather than forcing a wrong bit.
+- the start of the minute is the phase whose seven marker seconds have
+  looked most like markers over the last minutes, not one pair of
+  markers in a row. It is only moved when another phase leads clearly.
+- at the start of every minute the fields are decoded over the last
+  WWVB_FRAMES complete minutes together. Every value a field can take is
+  scored against the soft bits of each minute, counting one minute back
+  per frame and carrying into the hour and the day; minutes from the
+  previous day do not vote on the day and year. A minute in which
+  WWVB_BAD_MARKERS of its eight markers, counting the ones on both ends,
+  do not look like markers has most likely lost or gained a pulse and
+  does not vote; it starts the count of minutes over.
+- the time is committed only when the best value of every field leads
+  its runner-up by WWVB_COMMIT_MARGIN, and every bit of DUT1, leap
+  second and DST is that far from flipping. A marginal minute waits for the
+  next one instead of setting a wrong time.
+
+The sketch calls addSecond() with the width of every second's pulse in
+ms, in order. It returns true when the minute that just ended decoded
+with confidence; getTime() then has its fields, as they were sent, i.e.
+still one minute behind. A lost or extra pulse shifts the phase, which
+the markers find again within a minute or two.
+
+WWVB7 and WWVB8 each have a copy of this file. wwvb_decode_bench
+measures it against the exact-match decoder on Linux (extras/host).
+*/
+
+#ifndef WWVBDecoder_h
+#define WWVBDecoder_h
+
+#include <Arduino.h>
+
+#define WWVB_FRAMES				5			// Minutes voted over, 60 bytes each
+#define WWVB_SOFT_MAX			15			// Soft value of a clean 200 or 500 ms width
+#define WWVB_SOFT_STEP			7			// ms per soft unit, clean from 100 ms off the middle
+#define WWVB_COMMIT_MARGIN		45			// Lead every field needs, one and a half clean bits
+#define WWVB_PHASE_MARGIN		30			// Lead a new phase needs over the others
+#define WWVB_BAD_MARKERS		2			// Markers of a minute that may not look like one
+#define WWVB_NO_PHASE			0xFF
+
+struct WWVBTime
+{
+	uint16_t	year;				// 2000 to 2099
+	uint16_t	day;				// Day of the year, 1 is January 1
+	uint8_t		hour;
+	uint8_t		minute;
+	uint8_t		dutSign;			// 5 +, 2 -
+	uint8_t		dut;				// Tenths of a second
+	uint8_t		leapYear;
+	uint8_t		leapSecond;
+	uint8_t		dst;				// 0 none, 3 in effect, 2 begins today, 1 ends today
+};
+
+class WWVBDecoder
+{
+	public:
+		void		begin();
+		uint8_t		addSecond(uint16_t widthMs);
+		WWVBTime	getTime();
+		uint8_t		getSecond();
+		uint8_t		getFrames();
+		int16_t		getMargin();
+
+		int16_t		commitMargin = WWVB_COMMIT_MARGIN;
+
+	private:
+		uint8_t		_findPhase();
+		int16_t		_score(uint8_t frame, uint8_t part, uint8_t digit);
+		uint8_t		_majority(uint8_t part, uint8_t frames);
+		uint8_t		_decode();
+
+		int8_t		_soft[WWVB_FRAMES][60];		// Soft bits by second of the minute, ring
+		int8_t		_marker[60];				// Decaying marker evidence by slot
+		uint8_t		_slot = 0;					// Slot of the next second, counts 0 to 59
+		uint8_t		_phase = WWVB_NO_PHASE;		// Slot second 0 falls in
+		uint8_t		_second = WWVB_NO_PHASE;	// Second of the minute last added
+		uint8_t		_newest = 0;				// _soft frame being filled
+		uint8_t		_filled = 0;				// Seconds added to it at the current phase
+		uint8_t		_badMarkers = 0;			// In it, that did not look like one
+		uint8_t		_frames = 0;				// Complete consecutive minutes in _soft
+		int16_t		_margin = 0;				// Smallest field lead of the last decode
+		WWVBTime	_time;
+};
+
+#endif
@@ -0,0 +1,171 @@
+/*
+Record layouts of the binary serial telemetry, see Telemetry.h
+
+Shared by the sketches that send telemetry and by the host decoder in
+extras/telemetry, so it only needs <stdint.h>. Every record type carries
+its own version: a change to a layout gets a new version number, and the
+decoder keeps reading logs written with the old one.
+
+All fields are little-endian as on the AVR, records are packed.
+*/
+
+#ifndef TelemetryRecords_h
+#define TelemetryRecords_h
+
+#include <stdint.h>
+
+#define TM_MAX_PAYLOAD			64			// Bytes, longest record
+
+// Record types
+#define TM_TEXT					0x01		// Short message, payload is the characters
+#define TM_BOOT					0x02		// TMBoot
+#define TM_ES100_RX				0x10		// TMES100Rx, end of a reception
+#define TM_ES100_IRQ			0x11		// TMES100Irq, IRQ- during a reception
+#define TM_ES100_BUS			0x12		// TMES100Bus, i2c cost of the last reception
+#define TM_SYNC					0x13		// TMSync, reception scheduler counters
+#define TM_PPS					0x14		// TMPps, 1PPS holdover after a sync
+#define TM_RTC					0x15		// TMRtc, RTC events
+#define TM_LCD					0x16		// TMLcd, display cost
+#define TM_WWVB_FRAME			0x20		// TMWwvbFrame, a decoded WWVB minute
+#define TM_WWVB_PULSES			0x21		// TMWwvbPulses, pulse widths of a minute
+#define TM_WWVB_ZONE			0x22		// TMWwvbZone
+
+// Sketches, TMBoot::sketch
+#define TM_SKETCH_ES100_ADK		1
+#define TM_SKETCH_WWVB8			2
+
+// TMRtc::event
+#define TM_RTC_PHASE			1			// value = SQW edge - WWVB second, us
+#define TM_RTC_STEP				2			// value = step for DST or a leap second, s
+#define TM_RTC_WRITE_FAILED		3
+#define TM_RTC_RESTORED			4			// value = age of the restored sync, s
+
+#define TM_TEXT_V				1
+
+#define TM_BOOT_V				1
+struct TMBoot
+{
+	uint8_t		sketch;
+	uint8_t		restored;			// State was picked up from the sync journal
+} __attribute__((packed));
+
+#define TM_ES100_RX_V			1
+struct TMES100Rx
+{
+	uint32_t	utc;				// ES100Time.h seconds at the IRQ, 0 if not known
+	int32_t		offset;				// local - UTC, s
+	uint8_t		kind;				// ES100_SYNC_FULL or ES100_SYNC_TRACKING
+	uint8_t		state;				// ES100_STATE_DONE or ES100_STATE_TIMEOUT
+	uint8_t		timedOutIn;			// ES100_STATE_* that ran out of time
+	uint8_t		status0;			// rxOk | antenna << 1 | leapSecond << 3 | dstState << 5 | tracking << 7
+	uint8_t		nextDstMonth;
+	uint8_t		nextDstDay;
+	uint8_t		nextDstHour;
+	int8_t		correction;			// s the RTC was pulled by a tracking reception
+	uint32_t	enableMs;
+	uint32_t	readyMs;
+	uint32_t	rxMs;
+	uint32_t	readUs;
+	uint16_t	irqs;
+} __attribute__((packed));
+
+#define TM_ES100_IRQ_V			1
+struct TMES100Irq
+{
+	uint16_t	count;				// IRQs since the reception was started
+} __attribute__((packed));
+
+#define TM_ES100_BUS_V			1
+struct TMES100Bus
+{
+	uint32_t	transactions;
+	uint32_t	bytes;
+	uint16_t	snapshotReads;
+	uint16_t	cacheHits;
+	uint32_t	busMicros;
+	uint16_t	errors;
+	uint32_t	rtcBusMicros;
+	uint16_t	rtcRequests;
+	uint16_t	rtcErrors;
+	uint16_t	clockChanges;
+	uint8_t		maxDepth;			// I2CBusStats from here on
+	uint32_t	maxLatency;
+	uint16_t	failed;
+	uint16_t	retries;
+	uint16_t	nacks;
+	uint16_t	busErrors;
+	uint16_t	timeouts;
+	uint16_t	recoveries;
+} __attribute__((packed));
+
+#define TM_SYNC_V				1
+struct TMSync
+{
+	uint16_t	full;
+	uint16_t	fullOk;
+	uint16_t	tracking;
+	uint16_t	trackingOk;
+	uint32_t	onSecondsToday;
+	uint32_t	onSecondsLastDay;
+} __attribute__((packed));
+
+#define TM_PPS_V				1
+struct TMPps
+{
+	uint8_t		locked;
+	int32_t		lastError;			// us, INT32_MIN if none yet
+	uint32_t	maxError;			// us
+	int32_t		rate;				// ppb
+	uint32_t	holdover;			// s since the last sync
+} __attribute__((packed));
+
+#define TM_RTC_V				1
+struct TMRtc
+{
+	uint8_t		event;				// TM_RTC_*
+	int32_t		value;
+} __attribute__((packed));
+
+#define TM_LCD_V				1
+struct TMLcd
+{
+	uint8_t		fullRedraw;
+	uint32_t	seconds;			// Period the counts are over
+	uint32_t	bytes;
+	uint32_t	moves;
+	uint32_t	cpuMicros;			// In showlcd()
+	uint32_t	flushMicros;
+	uint8_t		maxDepth;			// Nibbles
+	uint16_t	overflows;
+	uint16_t	deferred;
+} __attribute__((packed));
+
+#define TM_WWVB_FRAME_V			1
+struct TMWwvbFrame
+{
+	uint16_t	year;
+	uint16_t	day;				// Day of the year
+	uint8_t		hour;
+	uint8_t		minute;
+	uint8_t		dutSign;			// 5 +, 2 -
+	uint8_t		dut;				// Tenths of a second
+	uint8_t		leapYear;
+	uint8_t		leapSecond;
+	uint8_t		dst;
+} __attribute__((packed));
+
+#define TM_WWVB_PULSES_V		1
+struct TMWwvbPulses
+{
+	uint8_t		sampleHz;			// Units of width
+	uint8_t		count;
+	uint8_t		width[60];			// Low carrier time of each second, in samples
+} __attribute__((packed));
+
+#define TM_WWVB_ZONE_V			1
+struct TMWwvbZone
+{
+	int8_t		hours;
+} __attribute__((packed));
+
+#endif
@@ -1,38 +1,14 @@
 #include <SparkFunDS3234RTC.h>
     // Library from https://learn.sparkfun.com/tutorials/deadon-rtc-breakout-hookup-guide
+#include "Telemetry.h"
+    // Binary serial records, decoded on the host by Everset_ES100_ADK_V1.2/extras/telemetry
+#include "WWVBDecoder.h"
+    // Soft-decision decoder voting over consecutive minutes, also in WWVB7
 
 #define CENTURY 2000
 
 // WWVB reference https://www.nist.gov/sites/default/files/documents/2017/04/28/SP-432-NIST-Time-and-Frequency-Services-2012-02-13.pdf
-// Indices for parts of WWVB frame
-enum {
-	FPRM, // Frame reference marker: .8L+.2H
-	FPUU, // Unweighted: .2L+.8H
-	// d1: .5L+.5H / 0 = .2L+.8H
-	FPM1, // 10 minutes
-	FPM2, //  1 minutes
-	FPH1, // 10 hours
-	FPH2, //  1 hours
-	FPD1, //100 days
-	FPD2, // 10 days
-	FPD3, //  1 days
-	FPUS, // UTC sign
-	FPUC, // UTC correction
-	FPY1, // 10 years
-	FPY2, //  1 years
-	FPLY, // Leap year
-	FPLS, // Leap second
-	FPDS, // Daylight saving time
-	FPEF}; // End of frame same as FPRM
-// Order of received frame, one per second
-const byte FramePattern[] =
-	// .0   .1   .2   .3   .4   .5   .6   .7   .8   .9
-/*0.*/{FPRM,FPM1,FPM1,FPM1,FPUU,FPM2,FPM2,FPM2,FPM2,FPRM,
-/*1.*/ FPUU,FPUU,FPH1,FPH1,FPUU,FPH2,FPH2,FPH2,FPH2,FPRM,
-/*2.*/ FPUU,FPUU,FPD1,FPD1,FPUU,FPD2,FPD2,FPD2,FPD2,FPRM,
-/*3.*/ FPD3,FPD3,FPD3,FPD3,FPUU,FPUU,FPUS,FPUS,FPUS,FPRM,
-/*4.*/ FPUC,FPUC,FPUC,FPUC,FPUU,FPY1,FPY1,FPY1,FPY1,FPRM,
-/*5.*/ FPY2,FPY2,FPY2,FPY2,FPUU,FPLY,FPLS,FPDS,FPDS,FPEF};
+// WWVBDecoder.cpp has the layout of the frame
 #define FRAME_SIZE 60
 
 // Receiver module http://canaduino.ca/downloads/60khz.pdf
@@ -128,58 +104,38 @@ void displaySend(void) {
 // SS - D10
 
 int zoneHours = 0;
+Telemetry telemetry;
 
-byte frame[FRAME_SIZE], frameIndex = 0;
-short decode[FPEF];   // accumulated parts of frame
+void sendZone(void) {
+  TMWwvbZone z = { (int8_t)zoneHours };
+  telemetry.send(TM_WWVB_ZONE, TM_WWVB_ZONE_V, &z, sizeof(z));
+}
+
+WWVBDecoder wwvb;
+byte frameIndex = 0;
+byte widths[FRAME_SIZE];  // modulated samples of each second, for the telemetry
 boolean timeSet = false;
 byte daysInMonth[] = {0,31,28,31,30,31,30,31,31,30,31,30,31};
 //                     JanFebMarAprMayJunJulAugSepOctNovDec  
 
 void decodeAndSetTime(void) {
-  // Decode frame parts
-  memset(decode,0,sizeof decode);
-  for (int x = 0; x < FRAME_SIZE; x++) {
-    byte p = FramePattern[x], c = frame[x];
-    switch (p) {
-    case FPRM:  // Frame reference marker: .8L+.2H
-      if (c != CODE_P) return;
-      break;
-    case FPEF:  // End of frame same as FPRM
-      if (c != CODE_P) return;
-      break;
-    case FPUU:  // Unweighted: .2L+.8H
-      if (c != CODE_U) return;
-      break;
-    default:  // bit 1: .5L+.5H / 0 = .2L+.8H
-      // binary coding
-      if (c == CODE_U) decode[p] = (decode[p] << 1);
-      else if (c == CODE_W) decode[p] = (decode[p] << 1) | 1;
-      else return;
-      break;
-    }
-  }
-  // Combine decimal digits
+  // Fields of the minute that just ended, decoded over the last few
+  WWVBTime t = wwvb.getTime();
   int mn, hr, dy, us, uc, yr, ly, ls, ds;
-  mn = decode[FPM1]*10 + decode[FPM2];
-  hr = decode[FPH1]*10 + decode[FPH2];
-  dy = decode[FPD1]*100 + decode[FPD2]*10 + decode[FPD3];
-  us = decode[FPUS];
-  uc = decode[FPUC];
-  yr = decode[FPY1]*10 + decode[FPY2] + CENTURY;
-  ly = decode[FPLY];
-  ls = decode[FPLS];
-  ds = decode[FPDS];
-  if (Serial) {
-    Serial.print("Y"); Serial.print(yr);
-    Serial.print("D"); Serial.print(dy);
-    Serial.print("H"); Serial.print(hr);
-    Serial.print("M"); Serial.print(mn);
-    Serial.print("US"); if (us==5) Serial.write('+'); else if (us==2) Serial.write('-'); else Serial.print(us);
-    Serial.print("UC"); Serial.print(uc);
-    Serial.print("LY"); Serial.print(ly);
-    Serial.print("LS"); Serial.print(ls);
-    Serial.print("DS"); Serial.print(ds);
-  }
+  mn = t.minute;
+  hr = t.hour;
+  dy = t.day;
+  us = t.dutSign;
+  uc = t.dut;
+  yr = t.year;
+  ly = t.leapYear;
+  ls = t.leapSecond;
+  ds = t.dst;
+  TMWwvbFrame f;
+  f.year = yr;  f.day = dy;  f.hour = hr;  f.minute = mn;
+  f.dutSign = us;  f.dut = uc;
+  f.leapYear = ly;  f.leapSecond = ls;  f.dst = ds;
+  telemetry.send(TM_WWVB_FRAME, TM_WWVB_FRAME_V, &f, sizeof(f));
   // Correct for 1 minute coding delay from on-time point
   mn += 1;
   if (mn >= 60) {
@@ -275,14 +231,9 @@ void timeToDisplay(void) {
 
 char X[] = "     56789!@#";
 //char X[] = " 123456789!@#";
-//                    1         2         3         4         5
-//          012345678901234567890123456789012345678901234567890123456789
-char L[] = ".abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
 int wrap, n;
 
 byte prevCode = CODE_N;
-//                          _N  _U  _W  _P  _X
-char printCode[CODE_X+1] = {' ','.','-','|','*'};
 byte signalSegments[] = {
       /*0*/~(0x80),
       /*1*/~(0x08),
@@ -307,24 +258,24 @@ void loop(void) {
       else if (d >= 38*SAMPLE_HZ/100 && d < 60*SAMPLE_HZ/100) code = CODE_W;
       else if (d >=  8*SAMPLE_HZ/100 && d < 30*SAMPLE_HZ/100) code = CODE_U;
       else code = CODE_X;
-      if (Serial) {
-        if (code != CODE_X) Serial.write(printCode[code]);
-        else Serial.write(L[d]);  // diagnostic detail
-      }
       // show codes while waiting for lock
 //      displayShift(signalSegments[code]);
-      static_assert(SAMPLE_HZ<sizeof L, "SAMPLE_HZ exceeds length of L");
+      static_assert(SAMPLE_HZ<256, "SAMPLE_HZ does not fit TMWwvbPulses");
       if (code == CODE_P && prevCode == CODE_P) {
-        // once per minute
-        if (frameIndex == FRAME_SIZE) {
-          decodeAndSetTime();
-        }
-        if (Serial) {
-          Serial.write('\r'); Serial.write('\n');
-        }
+        // once per minute, the pulses then the frame they decode to
+        TMWwvbPulses w;
+        w.sampleHz = SAMPLE_HZ;  w.count = frameIndex;
+        memcpy(w.width, widths, frameIndex);
+        telemetry.send(TM_WWVB_PULSES, TM_WWVB_PULSES_V, &w, 2 + frameIndex);
         frameIndex = 0;
       } 
-      if (frameIndex < FRAME_SIZE) frame[frameIndex++] = code;
+      if (frameIndex < FRAME_SIZE) {
+        widths[frameIndex++] = d;
+      }
+      // The decoder finds the minute by its own markers
+      if (wwvb.addSecond(d * (1000 / SAMPLE_HZ))) {
+        decodeAndSetTime();
+      }
       prevCode = code;  code = CODE_N;    
     } else {
 //      Serial.write(' ');
@@ -351,16 +302,19 @@ void loop(void) {
       if (r >= '0' && r <= '9') {
         zoneHours = '0' - r;
         rtc.writeToSRAM(0,'Z'); rtc.writeToSRAM(1,r);
-        Serial.print("Zone hours ");
-        Serial.println(zoneHours);
+        sendZone();
       }
     }
     prevSerial = r;
   }
+  telemetry.poll();
 }
 
 void setup(void) {
   Serial.begin(115200);
+  telemetry.begin(&Serial);
+  TMBoot boot = { TM_SKETCH_WWVB8, 0 };
+  telemetry.send(TM_BOOT, TM_BOOT_V, &boot, sizeof(boot));
   pinMode(LED_BUILTIN, OUTPUT);
   pinMode(RADIO_POWERDOWN_PIN, OUTPUT);
   pinMode(RADIO_IN_PIN, INPUT);
@@ -374,16 +328,14 @@ void setup(void) {
   rtc.writeSQW(SQW_SQUARE_1);  // 1Hz signal on RTC_INTERRUPT_PIN
   if (rtc.readFromSRAM(0) == 'Z') {
     zoneHours = '0' - rtc.readFromSRAM(1);
-    if (Serial) {
-      Serial.print("Zone hours ");
-      Serial.println(zoneHours);
-    }
+    sendZone();
   }
   // Start radio
   digitalWrite(RADIO_POWERDOWN_PIN, LOW);  // turn on radio
   radioPort = digitalPinToPort(RADIO_IN_PIN);  // for optimized digitalRead
   radioBit = digitalPinToBitMask(RADIO_IN_PIN);
   avg = 0; xpast = 0; pr = EMPTY;
+  wwvb.begin();
   wrap = 0; n = 0;
   // Start timer1 for periodic interrupt at SAMPLE_HZ per second
   noInterrupts(); {
@@ -0,0 +1,13 @@
+/*
+Host (Linux) stand-in for the little of the Arduino core that
+WWVBDecoder.cpp uses: the integer types, memset() and abs().
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#endif
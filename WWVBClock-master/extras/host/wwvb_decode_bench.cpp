@@ -0,0 +1,414 @@
+/*
+Sync probability of the WWVB decoders against the per-second error rate
+
+Generates the WWVB time code for consecutive minutes and feeds the pulse
+widths, as WWVB8 measures them, to two decoders:
+- exact match: WWVB8's loop() and decodeAndSetTime() before WWVBDecoder,
+  classifying each width, framing on two markers in a row and taking a
+  minute only if all 60 seconds are what the frame layout says
+- soft: WWVBDecoder, the copy in ../../WWVB8
+
+Every pulse width jitters by WIDTH_SIGMA ms. At the error rate, a
+second's width is replaced by one drawn evenly from 0 to 999 ms, which
+may still happen to read right. A width under one sample is no pulse at
+all and, as in WWVB8, not passed on, so the decoders also see seconds go
+missing. Each trial starts at a random second of a random minute from
+2000 to 2099 and runs the given number of minutes.
+
+Per error rate it prints, for each decoder, the share of trials that set
+the right time at least once, the mean minutes until they first did, and
+how many times a wrong time was committed. It also decodes across a new
+year's midnight, and exits non-zero if a check failed, so it can run in
+CI: the soft decoder has to sync at least as often, bar 1% of the trials
+when both almost always do, and commit under 1% of the wrong times.
+
+Build and run on Linux, from this directory:
+  g++ -std=gnu++11 -O2 -I. -I../../WWVB8 -o wwvb_decode_bench \
+      wwvb_decode_bench.cpp ../../WWVB8/WWVBDecoder.cpp
+  ./wwvb_decode_bench
+  ./wwvb_decode_bench 2000 30        trials per error rate, minutes per trial
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include "Arduino.h"
+#include "WWVBDecoder.h"
+
+#define SAMPLE_HZ		50			// As WWVB8
+#define WIDTH_SIGMA		30			// ms
+#define TRIALS			500
+#define MINUTES			10
+
+static int		checks = 0;
+static int		failures = 0;
+
+#define CHECK(cond)		check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char *what, int line)
+{
+	checks++;
+	if (ok)
+		return;
+
+	failures++;
+	printf("  FAIL line %d: %s\n", line, what);
+}
+
+/******************************************************************************
+ * Time code
+ ******************************************************************************/
+// Howard Hinnant's days_from_civil / civil_from_days, counted from 2000-01-01
+static int32_t daysFromCivil(int32_t y, uint8_t m, uint8_t d)
+{
+	y -= m <= 2;
+	int32_t		era = y / 400;
+	uint32_t	yoe = y - era * 400;
+	uint32_t	doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	uint32_t	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + (int32_t)doe - 730425;
+}
+
+static uint16_t yearOfDays(int32_t z)
+{
+	z += 730425;
+	int32_t		era = z / 146097;
+	uint32_t	doe = z - era * 146097;
+	uint32_t	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	uint32_t	doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	uint32_t	mp = (5 * doy + 2) / 153;
+
+	return yoe + era * 400 + (mp >= 10);
+}
+
+// What a minute's frame carries
+struct Fields
+{
+	uint16_t	year;
+	uint16_t	day;
+	uint8_t		hour;
+	uint8_t		minute;
+	uint8_t		dutSign;
+	uint8_t		dut;
+	uint8_t		leapYear;
+	uint8_t		leapSecond;
+	uint8_t		dst;
+
+	bool operator==(const Fields &o) const
+	{
+		return year == o.year && day == o.day && hour == o.hour && minute == o.minute &&
+			   dutSign == o.dutSign && dut == o.dut && leapYear == o.leapYear &&
+			   leapSecond == o.leapSecond && dst == o.dst;
+	}
+};
+
+// Minutes from 2000-01-01 00:00 UTC
+static Fields fieldsAt(uint32_t minute, uint8_t dutSign, uint8_t dut, uint8_t dst)
+{
+	int32_t		days = minute / 1440;
+	Fields		f;
+
+	f.year			= yearOfDays(days);
+	f.day			= days - daysFromCivil(f.year, 1, 1) + 1;
+	f.hour			= minute / 60 % 24;
+	f.minute		= minute % 60;
+	f.dutSign		= dutSign;
+	f.dut			= dut;
+	f.leapYear		= f.year % 4 == 0;
+	f.leapSecond	= 0;
+	f.dst			= dst;
+	return f;
+}
+
+// The parts of the frame as in WWVBDecoder.cpp, first second and bits
+static const uint8_t	partFirst[]	= { 1, 5, 12, 15, 22, 25, 30, 36, 40, 45, 50, 55, 56, 57 };
+static const uint8_t	partBits[]	= { 3, 4,  2,  4,  2,  4,  4,  3,  4,  4,  4,  1,  1,  2 };
+
+// Nominal low carrier time of each second, ms
+static void encode(const Fields &f, uint16_t *width)
+{
+	uint8_t		value[] = {
+		(uint8_t)(f.minute / 10), (uint8_t)(f.minute % 10), (uint8_t)(f.hour / 10), (uint8_t)(f.hour % 10),
+		(uint8_t)(f.day / 100), (uint8_t)(f.day / 10 % 10), (uint8_t)(f.day % 10), f.dutSign, f.dut,
+		(uint8_t)(f.year % 100 / 10), (uint8_t)(f.year % 10), f.leapYear, f.leapSecond, f.dst
+	};
+
+	for (uint8_t s = 0; s < 60; s++)
+		width[s] = s == 0 || s % 10 == 9 ? 800 : 200;
+
+	for (uint8_t p = 0; p < sizeof(value); p++)
+		for (uint8_t i = 0; i < partBits[p]; i++)
+			if ((value[p] >> (partBits[p] - 1 - i)) & 1)
+				width[partFirst[p] + i] = 500;
+}
+
+/******************************************************************************
+ * Channel
+ ******************************************************************************/
+static uint64_t		rngState = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t rnd()
+{
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 7;
+	rngState ^= rngState << 17;
+	return rngState >> 32;
+}
+
+static double uniform()
+{
+	return (rnd() + 0.5) / 4294967296.0;
+}
+
+static double gauss()
+{
+	return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+}
+
+// Width as WWVB8 measures it, in samples
+static uint8_t receive(uint16_t width, double errorRate)
+{
+	double		ms = uniform() < errorRate ? uniform() * 1000 : width + WIDTH_SIGMA * gauss();
+	long		samples = lround(ms * SAMPLE_HZ / 1000);
+
+	return samples < 0 ? 0 : samples > SAMPLE_HZ ? SAMPLE_HZ : samples;
+}
+
+/******************************************************************************
+ * Exact-match decoder
+ ******************************************************************************/
+#define CODE_N 0
+#define CODE_U 1
+#define CODE_W 2
+#define CODE_P 3
+#define CODE_X 4
+
+struct ExactDecoder
+{
+	uint8_t		frame[60];
+	uint8_t		frameIndex = 0;
+	uint8_t		prevCode = CODE_N;
+	Fields		time;
+
+	bool decode()
+	{
+		short	decode[14] = { 0 };
+
+		for (uint8_t s = 0; s < 60; s++) {
+			uint8_t		c = frame[s];
+			int			part = -1;
+
+			for (uint8_t p = 0; p < sizeof(partFirst); p++)
+				if (s >= partFirst[p] && s < partFirst[p] + partBits[p])
+					part = p;
+
+			if (s == 0 || s % 10 == 9) {
+				if (c != CODE_P)
+					return false;
+			} else if (part < 0) {
+				if (c != CODE_U)
+					return false;
+			} else if (c == CODE_U) {
+				decode[part] = decode[part] << 1;
+			} else if (c == CODE_W) {
+				decode[part] = decode[part] << 1 | 1;
+			} else {
+				return false;
+			}
+		}
+
+		time.minute		= decode[0] * 10 + decode[1];
+		time.hour		= decode[2] * 10 + decode[3];
+		time.day		= decode[4] * 100 + decode[5] * 10 + decode[6];
+		time.dutSign	= decode[7];
+		time.dut		= decode[8];
+		time.year		= decode[9] * 10 + decode[10] + 2000;
+		time.leapYear	= decode[11];
+		time.leapSecond	= decode[12];
+		time.dst		= decode[13];
+		return true;
+	}
+
+	// As WWVB8's loop(), for a pulse of d samples
+	bool addPulse(uint8_t d)
+	{
+		uint8_t		code;
+		bool		decoded = false;
+
+		     if (d >= 68*SAMPLE_HZ/100 && d < 90*SAMPLE_HZ/100) code = CODE_P;
+		else if (d >= 38*SAMPLE_HZ/100 && d < 60*SAMPLE_HZ/100) code = CODE_W;
+		else if (d >=  8*SAMPLE_HZ/100 && d < 30*SAMPLE_HZ/100) code = CODE_U;
+		else code = CODE_X;
+
+		if (code == CODE_P && prevCode == CODE_P) {
+			if (frameIndex == 60)
+				decoded = decode();
+			frameIndex = 0;
+		}
+		if (frameIndex < 60)
+			frame[frameIndex++] = code;
+		prevCode = code;
+
+		return decoded;
+	}
+};
+
+/******************************************************************************
+ * Benchmark
+ ******************************************************************************/
+struct Outcome
+{
+	uint32_t	synced;				// Trials that set the right time
+	uint64_t	firstMinutes;		// Summed over those, until they first did
+	uint32_t	wrong;				// Wrong times committed
+};
+
+struct Trial
+{
+	uint32_t	start;				// Minute
+	uint8_t		second;				// Of the first pulse
+	uint8_t		dutSign, dut, dst;
+};
+
+static Trial randomTrial()
+{
+	Trial	t;
+
+	t.start		= rnd() % (uint32_t)(daysFromCivil(2099, 12, 31) * 1440);
+	t.second	= rnd() % 60;
+	t.dutSign	= rnd() & 1 ? 5 : 2;
+	t.dut		= rnd() % 10;
+	t.dst		= rnd() & 1 ? 3 : 0;
+	return t;
+}
+
+static void run(const Trial &t, uint8_t minutes, double errorRate, Outcome *exact, Outcome *soft,
+				WWVBDecoder *decoder = NULL)
+{
+	WWVBDecoder		own;
+	ExactDecoder	e;
+	uint16_t		width[60];
+	bool			exactSynced = false, softSynced = false;
+
+	if (decoder == NULL)
+		decoder = &own;
+	decoder->begin();
+
+	for (uint32_t m = 0; m < minutes; m++) {
+		// The decoders finish a minute on the marker that starts the next
+		Fields		before = fieldsAt(t.start + m - 1, t.dutSign, t.dut, t.dst);
+
+		encode(fieldsAt(t.start + m, t.dutSign, t.dut, t.dst), width);
+		for (uint8_t s = m == 0 ? t.second : 0; s < 60; s++) {
+			uint8_t		d = receive(width[s], errorRate);
+
+			if (d == 0)
+				continue;
+
+			if (e.addPulse(d)) {
+				if (!(e.time == before)) {
+					exact->wrong++;
+				} else if (!exactSynced) {
+					exactSynced = true;
+					exact->synced++;
+					exact->firstMinutes += m;
+				}
+			}
+
+			if (decoder->addSecond(d * 1000 / SAMPLE_HZ)) {
+				WWVBTime	w = decoder->getTime();
+				Fields		f = { w.year, w.day, w.hour, w.minute, w.dutSign, w.dut, w.leapYear, w.leapSecond, w.dst };
+
+				if (!(f == before)) {
+					soft->wrong++;
+				} else if (!softSynced) {
+					softSynced = true;
+					soft->synced++;
+					soft->firstMinutes += m;
+				}
+			}
+		}
+	}
+}
+
+static void printOutcome(const Outcome &o, uint32_t trials)
+{
+	if (o.synced)
+		printf("  %5.1f%% %6.1f %6u", 100.0 * o.synced / trials, (double)o.firstMinutes / o.synced, o.wrong);
+	else
+		printf("  %5.1f%% %6s %6u", 0.0, "-", o.wrong);
+}
+
+static void errorRates(uint32_t trials, uint8_t minutes)
+{
+	static const double		rates[] = { 0, 0.005, 0.01, 0.02, 0.03, 0.05, 0.08, 0.10, 0.15, 0.20, 0.30 };
+	uint32_t				exactWrong = 0, softWrong = 0;
+
+	printf("%u trials of %u minutes per error rate\n", trials, minutes);
+	printf("               exact match              soft\n");
+	printf("error rate   sync  first  wrong    sync  first  wrong\n");
+
+	for (uint8_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+		Outcome		exact = { 0, 0, 0 }, soft = { 0, 0, 0 };
+
+		for (uint32_t i = 0; i < trials; i++)
+			run(randomTrial(), minutes, rates[r], &exact, &soft);
+
+		printf("  %5.1f%%  ", rates[r] * 100);
+		printOutcome(exact, trials);
+		printOutcome(soft, trials);
+		printf("\n");
+
+		// Where the exact match all but always syncs, the soft decoder's
+		// second minute may not fit into the run
+		if (rates[r] == 0)
+			CHECK(exact.synced == trials && soft.synced == trials && soft.wrong == 0);
+		CHECK(soft.synced >= exact.synced || soft.synced >= trials * 99 / 100);
+		exactWrong += exact.wrong;
+		softWrong += soft.wrong;
+	}
+
+	printf("wrong times committed: exact match %u, soft %u\n", exactWrong, softWrong);
+	CHECK(softWrong * 100 <= exactWrong);
+}
+
+// Across a new year into a leap year and out of one
+static void newYear()
+{
+	static const Trial		trials[] = {
+		{ (uint32_t)daysFromCivil(2024, 1, 1) * 1440 - 7, 30, 5, 3, 0 },
+		{ (uint32_t)daysFromCivil(2025, 1, 1) * 1440 - 7, 30, 2, 4, 0 },
+	};
+	WWVBDecoder		decoder;
+
+	printf("\nnew year\n");
+	for (uint8_t i = 0; i < 2; i++) {
+		Outcome		exact = { 0, 0, 0 }, soft = { 0, 0, 0 };
+
+		run(trials[i], 20, 0.02, &exact, &soft, &decoder);
+		WWVBTime	w = decoder.getTime();
+		printf("  last decode %u day %u %02u:%02u over %u frames, margin %d\n", w.year, w.day, w.hour, w.minute,
+			   decoder.getFrames(), decoder.getMargin());
+		CHECK(soft.synced == 1 && soft.wrong == 0);
+		CHECK(w.year == 2024 + i && w.day == 1 && w.hour == 0);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t	trials = argc > 1 ? atoi(argv[1]) : TRIALS;
+	uint8_t		minutes = argc > 2 ? atoi(argv[2]) : MINUTES;
+
+	std::chrono::steady_clock::time_point	start = std::chrono::steady_clock::now();
+
+	errorRates(trials, minutes);
+	newYear();
+
+	double	wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("\n%d checks, %d failed, %.2fs wall clock\n", checks, failures, wall);
+	return failures ? 1 : 0;
+}
@@ -6,13 +6,23 @@
   
   
  #include "DS1307.h" 
- #include <Wire.h>
 
 
+ static const byte rtc_start = 0x00; 
   
  DS1307::DS1307() 
  { 
-   Wire.begin(); 
+   dev.addr = DS1307_CTRL_ID; 
+   dev.maxClock = DS1307_CLOCK; 
+   dev.mux = NULL; 
+   raw_wanted = false; 
+   req.dev = &dev; 
+   req.txData = &rtc_start; 
+   req.txLen = 1; 
+   req.rxData = rtc_raw; 
+   req.rxLen = 7; 
+   req.done = NULL; 
+   req.status = I2C_REQ_IDLE; 
  } 
 
 
@@ -22,35 +32,67 @@
  // refresh the buffer 
  void DS1307::read_rtc(void) 
  { 
-   // use the Wire lib to connect to tho rtc 
-   // reset the register pointer to zero 
-   Wire.beginTransmission(DS1307_CTRL_ID); 
-     Wire.write(0x00); 
-   Wire.endTransmission(); 
+   byte data[7]; 
   
-   // request the 7 bytes of data    (secs, min, hr, dow, date. mth, yr)  
-   Wire.requestFrom(DS1307_CTRL_ID, 7); 
+   // a background read started before this one is older, drop it 
+   drop_refresh(); 
+  
+   // read the 7 bytes of data from register 0 (secs, min, hr, dow, date. mth, yr)  
+   // a read that failed after the retries leaves the buffer as it was 
+   if (I2C.read(&dev, rtc_start, data, 7) == I2C_REQ_DONE) 
+     memcpy(rtc_bcd, data, 7); 
+ } 
+  
+ // update the data on the IC from the bcd formatted data in the buffer 
+ // false if the write failed after the retries, the chip keeps its old time 
+ boolean DS1307::save_rtc(void) 
+ { 
+   byte data[8]; 
+  
+   // a background read would bring back the time before the change 
+   drop_refresh(); 
+  
+   data[0]=rtc_start; // reset register pointer 
    for(int i=0; i<7; i++) 
    { 
-     // store data in raw bcd format 
-     rtc_bcd[i]=Wire.read(); 
+     data[i+1]=rtc_bcd[i]; 
    } 
+   return I2C.write(&dev, data, 8) == I2C_REQ_DONE; 
  } 
   
- // update the data on the IC from the bcd formatted data in the buffer 
- void DS1307::save_rtc(void) 
+ // wait for a background read still on the bus and forget its result 
+ void DS1307::drop_refresh(void) 
  { 
-   Wire.beginTransmission(DS1307_CTRL_ID); 
-   Wire.write(0x00); // reset register pointer 
-   for(int i=0; i<7; i++) 
+   while (req.status == I2C_REQ_QUEUED || req.status == I2C_REQ_ACTIVE) 
    { 
-     Wire.write(rtc_bcd[i]); 
+     I2C.poll(); 
+     yield(); 
    } 
-   Wire.endTransmission(); 
+   raw_wanted = false; 
  } 
   
   
  // PUBLIC FUNCTIONS 
+ void DS1307::begin(void) 
+ { 
+   I2C.begin(DS1307_CLOCK); 
+   read_rtc(); // the first refresh() has nothing in yet 
+ } 
+  
+ // Take the background read queued last time into the buffer, if it is in, 
+ // and queue the next one. Never waits for the bus. 
+ void DS1307::refresh(void) 
+ { 
+   I2C.poll(); // times out a read stuck on the bus 
+   if (req.status == I2C_REQ_QUEUED || req.status == I2C_REQ_ACTIVE) 
+     return; 
+  
+   if (raw_wanted && req.status == I2C_REQ_DONE) 
+     memcpy(rtc_bcd, rtc_raw, 7); 
+  
+   raw_wanted = I2C.submit(&req); 
+ } 
+  
  void DS1307::get(int *rtc, boolean refresh)   // Aquire data from buffer and convert to int, refresh buffer if required 
  { 
    if(refresh) read_rtc(); 
@@ -91,7 +133,7 @@
    return v; 
  }  
   
- void DS1307::set(int c, int v)  // Update buffer, then update the chip 
+ boolean DS1307::set(int c, int v)  // Update buffer, then update the chip, false if the chip was not written 
  { 
    switch(c) 
    { 
@@ -141,7 +183,7 @@
      } 
      break; 
    } // end switch 
-   save_rtc(); 
+   return save_rtc(); 
  } 
   
  int DS1307::min_of_day(boolean refresh) 
@@ -152,66 +194,53 @@
      return MoD;  
  } 
   
- void DS1307::stop(void) 
+ boolean DS1307::stop(void) 
  { 
          // set the ClockHalt bit high to stop the rtc 
          // this bit is part of the seconds byte 
      rtc_bcd[DS1307_SEC]=rtc_bcd[DS1307_SEC] | DS1307_CLOCKHALT; 
-     save_rtc(); 
+     return save_rtc(); 
  } 
   
- void DS1307::start(void) 
+ boolean DS1307::start(void) 
  { 
          // unset the ClockHalt bit to start the rtc 
      rtc_bcd[DS1307_SEC]=rtc_bcd[DS1307_SEC] & ~DS1307_CLOCKHALT; 
-     save_rtc(); 
+     return save_rtc(); 
  } 
   
 #ifdef DS1307_SRAM
  void DS1307::get_sram_data(byte *sram_data) 
  { 
    // set the register to the sram area and read 56 bytes 
-   Wire.beginTransmission(DS1307_CTRL_ID); 
-     Wire.write(DS1307_DATASTART); 
-   Wire.endTransmission(); 
-    
-   for(int i=0;i<56;i++) 
-   { 
-         Wire.requestFrom(DS1307_CTRL_ID, 56); 
-     sram_data[i]=Wire.read(); 
-   } 
+   I2C.read(&dev, DS1307_DATASTART, sram_data, DS1307_SRAM_LEN); 
  } 
   
- void DS1307::set_sram_data(byte *sram_data) 
+ boolean DS1307::set_sram_data(byte *sram_data) 
  { 
    // set the register to the sram area and save 56 bytes 
-   Wire.beginTransmission(DS1307_CTRL_ID); 
-     Wire.write(DS1307_DATASTART); 
-    
-   for(int i=0;i<56;i++) 
-   { 
-     Wire.write(sram_data[i]); 
-   } 
-   Wire.endTransmission(); 
+   byte data[1+DS1307_SRAM_LEN]; 
+  
+   data[0]=DS1307_DATASTART; 
+   memcpy(data+1, sram_data, DS1307_SRAM_LEN); 
+   return I2C.write(&dev, data, sizeof(data)) == I2C_REQ_DONE; 
  } 
   
  byte DS1307::get_sram_byte(int p) 
  { 
      // set the register to a specific the sram location and read a single byte 
-     Wire.beginTransmission(DS1307_CTRL_ID); 
-     Wire.write(DS1307_DATASTART+p); 
-     Wire.endTransmission();   
-     Wire.requestFrom(DS1307_CTRL_ID, 1); 
-     return Wire.read(); 
+     byte b=0; 
+     I2C.read(&dev, DS1307_DATASTART+p, &b, 1); 
+     return b; 
  } 
   
- void DS1307::set_sram_byte(byte b, int p) 
+ boolean DS1307::set_sram_byte(byte b, int p) 
  { 
      // set the register to a specific the sram location and save a single byte 
-     Wire.beginTransmission(DS1307_CTRL_ID); 
-     Wire.write(DS1307_DATASTART+p); 
-     Wire.write(b); 
-     Wire.endTransmission();   
+     byte data[2]; 
+     data[0]=DS1307_DATASTART+p; 
+     data[1]=b; 
+     return I2C.write(&dev, data, 2) == I2C_REQ_DONE; 
  } 
 #endif
 
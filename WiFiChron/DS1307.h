@@ -12,8 +12,8 @@
  // include types & constants of Wiring core API 
  #include <Arduino.h> 
   
- // include types & constants of Wire ic2 lib 
- #include <Wire.h> 
+ // include the queued i2c bus, Wire would take the TWI interrupt 
+ #include "I2CBus.h" 
   
  #define DS1307_SEC 0 
  #define DS1307_MIN 1 
@@ -42,6 +42,8 @@
  #define DS1307_HI_YR   B11110000 
   
  #define DS1307_DATASTART 0x08 
+ #define DS1307_SRAM_LEN 56 
+ #define DS1307_CLOCK 100000  // Hz, highest SCL frequency 
   
  // library interface description 
  class DS1307 
@@ -49,23 +51,30 @@
    // user-accessible "public" interface 
    public: 
      DS1307(); 
+     void begin(void); 
+     void refresh(void); 
      void get(int *, boolean); 
      int get(int, boolean); 
      int min_of_day(boolean); 
-         void set(int, int); 
-     void start(void); 
-     void stop(void); 
+         boolean set(int, int); 
+     boolean start(void); 
+     boolean stop(void); 
 #ifdef DS1307_SRAM
      void get_sram_data(byte *); 
-     void set_sram_data(byte *); 
+     boolean set_sram_data(byte *); 
      byte get_sram_byte(int); 
-     void set_sram_byte(byte, int); 
+     boolean set_sram_byte(byte, int); 
 #endif
    // library-accessible "private" interface 
    private: 
      byte rtc_bcd[7]; // used prior to read/set ds1307 registers; 
+     byte rtc_raw[7]; // filled by the background read, see refresh() 
+     boolean raw_wanted; 
+     I2CDevice dev; 
+     I2CRequest req; 
          void read_rtc(void); 
-         void save_rtc(void); 
+         boolean save_rtc(void); 
+         void drop_refresh(void); 
  }; 
   
 
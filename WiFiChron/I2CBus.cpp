@@ -0,0 +1,416 @@
+/*
+Queued, interrupt-driven I2C master, see I2CBus.h
+*/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <Arduino.h>
+#include "I2CBus.h"
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+// TWSR status codes with the prescaler bits masked, master modes only
+#define TW_START			0x08
+#define TW_REP_START		0x10
+#define TW_MT_SLA_ACK		0x18
+#define TW_MT_SLA_NACK		0x20
+#define TW_MT_DATA_ACK		0x28
+#define TW_MT_DATA_NACK		0x30
+#define TW_MT_ARB_LOST		0x38
+#define TW_MR_SLA_ACK		0x40
+#define TW_MR_SLA_NACK		0x48
+#define TW_MR_DATA_ACK		0x50
+#define TW_MR_DATA_NACK		0x58
+#define TW_BUS_ERROR		0x00
+#define TW_STATUS_MASK		0xF8
+
+// TWCR values: go on with the next bus event, with or without a start
+#define TWCR_NEXT			(_BV(TWINT) | _BV(TWEN) | _BV(TWIE))
+#define TWCR_START			(TWCR_NEXT | _BV(TWSTA))
+
+/******************************************************************************
+ * Interrupt handlers
+ ******************************************************************************/
+void i2cBusInterrupt()
+{
+	I2C._step();
+}
+
+ISR(TWI_vect)
+{
+	i2cBusInterrupt();
+}
+
+/******************************************************************************
+ * Private
+ ******************************************************************************/
+void I2CBus::_setClock(uint32_t clock)
+{
+	// Reprogramming the bit rate is only done when the speed changes
+	if (clock == _clock)
+		return;
+
+	// SCL = F_CPU / (16 + 2 * TWBR), prescaler 1
+	TWBR	= ((F_CPU / clock) - 16) / 2;
+	_clock	= clock;
+	_clockChanges++;
+}
+
+void I2CBus::_start()
+{
+	// Interrupts are off. Starts the request at the head of the queue.
+	I2CRequest	*req = _head;
+	I2CDevice	*dev = req->dev;
+
+	_setClock(dev->maxClock);
+
+	req->status	= I2C_REQ_ACTIVE;
+	_startedAt	= micros();
+	_switching	= dev->mux != NULL && dev->mux->channel != dev->channel;
+	_reading	= !_switching && req->txLen == 0 && req->rxLen > 0;
+	_pos		= 0;
+
+	if (_stop) {
+		// The STOP the last request owes goes out right before this START
+		_stop = false;
+		TWCR = TWCR_START | _BV(TWSTO);
+	} else {
+		// Not called from the TWI interrupt, where a STOP sent a moment ago
+		// takes a few us to go out
+		while (TWCR & _BV(TWSTO))
+			;
+		TWCR = TWCR_START;
+	}
+}
+
+void I2CBus::_finish(uint8_t status)
+{
+	// The STOP is held back in case _complete() starts a retry or the next
+	// request, which then sends it along with the START instead of waiting
+	// in the interrupt for it to go out
+	_stop = true;
+	_complete(status);
+	if (_stop) {
+		_stop = false;
+		TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+	}
+}
+
+void I2CBus::_complete(uint8_t status)
+{
+	I2CRequest		*req = _head;
+	I2CDevice		*dev = req->dev;
+	unsigned long	now = micros();
+
+	dev->busMicros += now - _startedAt;
+
+	if (status == I2C_REQ_NACK)
+		_stats.nacks++;
+	else if (status == I2C_REQ_ERROR)
+		_stats.errors++;
+	else if (status == I2C_REQ_TIMEOUT)
+		_stats.timeouts++;
+
+	// A failed attempt goes again at once, it still heads the queue
+	if (status != I2C_REQ_DONE && req->tries < retries) {
+		req->tries++;
+		req->rxCount = 0;
+		_stats.retries++;
+		_start();
+		return;
+	}
+
+	dev->requests++;
+	if (status == I2C_REQ_DONE) {
+		_stats.completed++;
+	} else {
+		_stats.failed++;
+		dev->errors++;
+	}
+	if (now - req->submitted > _stats.maxLatency)
+		_stats.maxLatency = now - req->submitted;
+	_stats.depth--;
+
+	_head = req->next;
+	if (_head == NULL)
+		_tail = NULL;
+
+	// The callback may submit again, which starts the bus if it went idle
+	req->status = status;
+	if (req->done != NULL)
+		req->done(req);
+
+	if (_head != NULL && _head->status == I2C_REQ_QUEUED)
+		_start();
+}
+
+void I2CBus::_line(uint8_t pin, uint8_t level)
+{
+	// Open drain: driven low, or let go to the pull-up
+	if (level == LOW) {
+		digitalWrite(pin, LOW);
+		pinMode(pin, OUTPUT);
+	} else {
+		pinMode(pin, INPUT_PULLUP);
+	}
+}
+
+void I2CBus::_recover()
+{
+	// Take the pins from the TWI and clock SCL until the target that holds
+	// SDA low has shifted out the rest of its byte and lets go
+	TWCR = 0;
+	_line(SDA, HIGH);
+	_line(SCL, HIGH);
+
+	for (uint8_t i = 0; i < I2C_RECOVERY_CLOCKS && !digitalRead(SDA); i++) {
+		_line(SCL, LOW);
+		delayMicroseconds(5);
+		_line(SCL, HIGH);
+		delayMicroseconds(5);
+	}
+
+	// A START and a STOP put every target back to waiting for its address
+	_line(SDA, LOW);
+	delayMicroseconds(5);
+	_line(SDA, HIGH);
+	delayMicroseconds(5);
+
+	_stats.recoveries++;
+	TWCR = _BV(TWEN);
+}
+
+void I2CBus::_step()
+{
+	I2CRequest	*req = _head;
+	I2CMux		*mux = req->dev->mux;
+
+	switch (TWSR & TW_STATUS_MASK) {
+		case TW_START:
+		case TW_REP_START:
+			if (_switching)
+				TWDR = mux->addr << 1;
+			else
+				TWDR = (req->dev->addr << 1) | (_reading ? 1 : 0);
+			TWCR = TWCR_NEXT;
+			break;
+
+		case TW_MT_SLA_ACK:
+		case TW_MT_DATA_ACK:
+			if (_switching) {
+				if (_pos == 0) {
+					TWDR = 1 << req->dev->channel;
+					_pos++;
+					TWCR = TWCR_NEXT;
+					break;
+				}
+
+				// The mux connects the channel on STOP, then the request starts over
+				mux->channel = req->dev->channel;
+				mux->switches++;
+				_switching	= false;
+				_reading	= req->txLen == 0 && req->rxLen > 0;
+				_pos		= 0;
+				TWCR = TWCR_START | _BV(TWSTO);
+			} else if (_pos < req->txLen) {
+				TWDR = req->txData[_pos++];
+				TWCR = TWCR_NEXT;
+			} else if (req->rxLen > 0) {
+				_reading = true;
+				TWCR = TWCR_START;
+			} else {
+				_finish(I2C_REQ_DONE);
+			}
+			break;
+
+		case TW_MR_SLA_ACK:
+			// ACK every byte but the last one
+			TWCR = TWCR_NEXT | (req->rxLen > 1 ? _BV(TWEA) : 0);
+			break;
+
+		case TW_MR_DATA_ACK:
+			req->rxData[req->rxCount++] = TWDR;
+			TWCR = TWCR_NEXT | (req->rxCount < req->rxLen - 1 ? _BV(TWEA) : 0);
+			break;
+
+		case TW_MR_DATA_NACK:
+			req->rxData[req->rxCount++] = TWDR;
+			_finish(I2C_REQ_DONE);
+			break;
+
+		case TW_MT_SLA_NACK:
+		case TW_MT_DATA_NACK:
+		case TW_MR_SLA_NACK:
+			if (_switching)
+				mux->channel = I2C_MUX_NONE;
+			_finish(I2C_REQ_NACK);
+			break;
+
+		case TW_MT_ARB_LOST:
+			// Another master has the bus, let go without a STOP
+			TWCR = _BV(TWINT) | _BV(TWEN);
+			_complete(I2C_REQ_ERROR);
+			break;
+
+		default:
+			// Bus error, a STOP resets the TWI without touching the lines
+			_finish(I2C_REQ_ERROR);
+			break;
+	}
+}
+
+/******************************************************************************
+ * User API
+ ******************************************************************************/
+void I2CBus::begin(uint32_t defaultClock)
+{
+	// Internal pull-ups, like the Wire library
+	_line(SDA, HIGH);
+	_line(SCL, HIGH);
+
+	_defaultClock	= defaultClock;
+	_clock			= 0;
+	_head			= NULL;
+	_tail			= NULL;
+
+	TWSR = 0;
+	_setClock(_defaultClock);
+
+	// A reset in the middle of a read can leave a target driving SDA
+	if (!digitalRead(SDA))
+		_recover();
+	TWCR = _BV(TWEN);
+}
+
+uint8_t I2CBus::submit(I2CRequest *req)
+{
+	uint8_t		sreg;
+
+	if (req->status == I2C_REQ_QUEUED || req->status == I2C_REQ_ACTIVE)
+		return false;
+
+	req->status		= I2C_REQ_QUEUED;
+	req->rxCount	= 0;
+	req->tries		= 0;
+	req->next		= NULL;
+	req->submitted	= micros();
+
+	// Callbacks submit from the TWI interrupt, so the mask is restored, not enabled
+	sreg = SREG;
+	cli();
+
+	if (_stats.depth++ >= _stats.maxDepth)
+		_stats.maxDepth = _stats.depth;
+
+	if (_head == NULL) {
+		_head = _tail = req;
+		_start();
+	} else {
+		_tail->next	= req;
+		_tail		= req;
+	}
+
+	SREG = sreg;
+
+	return true;
+}
+
+uint8_t I2CBus::transfer(I2CRequest *req)
+{
+	// Interrupts must be enabled, the queue is run by the TWI interrupt
+	if (!submit(req))
+		return I2C_REQ_ERROR;
+
+	while (req->status < I2C_REQ_DONE) {
+		poll();
+		yield();
+	}
+
+	return req->status;
+}
+
+void I2CBus::poll()
+{
+	uint8_t		stuck;
+
+	// Anything waiting on a request calls this, so a stuck bus is noticed
+	noInterrupts();
+	stuck = _head != NULL && _head->status == I2C_REQ_ACTIVE && micros() - _startedAt > timeout;
+	if (stuck) {
+		// Whatever the mux took from the recovery clocks, its channel is not known now
+		if (_head->dev->mux != NULL)
+			_head->dev->mux->channel = I2C_MUX_NONE;
+		// Only the TWI interrupt is held off while SCL is clocked by hand, the
+		// request stays at the head so submit() only queues behind it
+		TWCR = 0;
+	}
+	interrupts();
+
+	if (!stuck)
+		return;
+
+	_recover();
+
+	noInterrupts();
+	_complete(I2C_REQ_TIMEOUT);
+	interrupts();
+}
+
+uint8_t I2CBus::write(I2CDevice *dev, const uint8_t *data, uint8_t len)
+{
+	I2CRequest	req = { dev, data, len, NULL, 0, NULL, NULL };
+
+	return transfer(&req);
+}
+
+uint8_t I2CBus::read(I2CDevice *dev, uint8_t reg, uint8_t *data, uint8_t len)
+{
+	I2CRequest	req = { dev, &reg, 1, data, len, NULL, NULL };
+
+	return transfer(&req);
+}
+
+uint8_t I2CBus::isIdle()
+{
+	return _head == NULL;
+}
+
+uint32_t I2CBus::getClock()
+{
+	return _clock;
+}
+
+uint16_t I2CBus::getClockChanges()
+{
+	return _clockChanges;
+}
+
+I2CBusStats I2CBus::getStats()
+{
+	I2CBusStats	stats;
+
+	noInterrupts();
+	stats = _stats;
+	interrupts();
+
+	return stats;
+}
+
+void I2CBus::resetStats()
+{
+	noInterrupts();
+	_stats.completed	= 0;
+	_stats.failed		= 0;
+	_stats.retries		= 0;
+	_stats.nacks		= 0;
+	_stats.errors		= 0;
+	_stats.timeouts		= 0;
+	_stats.recoveries	= 0;
+	_stats.maxDepth		= _stats.depth;
+	_stats.maxLatency	= 0;
+	interrupts();
+}
+
+I2CBus I2C;
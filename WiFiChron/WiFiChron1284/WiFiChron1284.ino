@@ -55,7 +55,6 @@ a year.
 /******************************************************************************/
 #include <Arduino.h>
 #include "digitalWriteFast.h"
-#include <Wire.h>
 #include "DS1307.h"
 #include <avr/eeprom.h>
 #include "sound.h"
@@ -496,7 +495,15 @@ void getTimeFromRTC(int ls)
   int rtc[7];
   utime_t tt;
 
-  RTC_DS1307.get(rtc, true);
+  // From loop() the RTC is read in the background and the buffer holds the
+  // read queued on the previous call, so the display never waits for the
+  // bus. ls == 100 asks for a fresh read, after the time was set.
+  if (ls == 100) {
+    RTC_DS1307.get(rtc, true);
+  } else {
+    RTC_DS1307.refresh();
+    RTC_DS1307.get(rtc, false);
+  }
 
   if (ls != rtc[DS1307_SEC]) {
     // check to avoid glitches;
@@ -534,8 +541,9 @@ void getTimeFromRTC(int ls)
       utcTm.Hour = 12;
       utcTm.Minute = 34;
       utcTm.Second = 56;
-      setTime(&utcTm);
-      setDate(&utcTm);
+      // try again on the next call if the RTC did not take it
+      wasTimeEverSet = setTime(&utcTm);
+      wasTimeEverSet = setDate(&utcTm) && wasTimeEverSet;
     }
   }  
 #ifdef _DEBUG_
@@ -559,26 +567,34 @@ void getTimeFromRTC(int ls)
 /******************************************************************************/
 
 /******************************************************************************/
-void setTime(tmElements_t *tm)
+boolean setTime(tmElements_t *tm)
 {  
+  boolean ok;
+
   // NOTE: when setting, year is 2 digits; when reading, year is 4 digits;
-  RTC_DS1307.stop();
-  RTC_DS1307.set(DS1307_SEC,  tm->Second);
-  RTC_DS1307.set(DS1307_MIN,  tm->Minute);
-  RTC_DS1307.set(DS1307_HR,   tm->Hour);
-  RTC_DS1307.start();
+  // false if any write failed; start() is tried anyway so the clock is not left halted
+  ok = RTC_DS1307.stop();
+  ok = RTC_DS1307.set(DS1307_SEC,  tm->Second) && ok;
+  ok = RTC_DS1307.set(DS1307_MIN,  tm->Minute) && ok;
+  ok = RTC_DS1307.set(DS1307_HR,   tm->Hour) && ok;
+  ok = RTC_DS1307.start() && ok;
+  return ok;
 }
 /******************************************************************************/
 
 /******************************************************************************/
-void setDate(tmElements_t *tm)
+boolean setDate(tmElements_t *tm)
 {
-  RTC_DS1307.stop();
-  RTC_DS1307.set(DS1307_YR,   tm->Year);
-  RTC_DS1307.set(DS1307_MTH,  tm->Month);
-  RTC_DS1307.set(DS1307_DATE, tm->Day);
-  RTC_DS1307.set(DS1307_DOW,  tm->Wday);
-  RTC_DS1307.start();
+  boolean ok;
+
+  // false if any write failed, as for setTime()
+  ok = RTC_DS1307.stop();
+  ok = RTC_DS1307.set(DS1307_YR,   tm->Year) && ok;
+  ok = RTC_DS1307.set(DS1307_MTH,  tm->Month) && ok;
+  ok = RTC_DS1307.set(DS1307_DATE, tm->Day) && ok;
+  ok = RTC_DS1307.set(DS1307_DOW,  tm->Wday) && ok;
+  ok = RTC_DS1307.start() && ok;
+  return ok;
 }
 /******************************************************************************/
 
@@ -676,7 +692,11 @@ void checkBlueTooth()
 	  locTt = makeTime(&locTm);
 	  utcTt = locTt - delta;
 	  breakTime(utcTt, &utcTm);
-	  setTime(&utcTm);
+	  if (!setTime(&utcTm)) {
+	    // show the failure in place of the command
+	    strcpy_P(bt_buf, PSTR("RTC write failed"));
+	    bt_valid = true;
+	  }
 	}
       }
     }
@@ -793,6 +813,8 @@ void setup()
   Serial.println("in setup");
 #endif
 
+  RTC_DS1307.begin();
+
 #ifdef __AVR_ATmega1284P__
   uint8_t tmp = 1<<JTD;		// Disable JTAG
   MCUCR = tmp;			// Disable JTAG
@@ -1636,6 +1658,7 @@ boolean checkButtons(uint32_t ms)
       mode = MENU_TIME;
       break;
   }
+  // read back what the RTC took, a failed write shows the old value to set again
   if (setRTC) getTimeFromRTC(100);
   dispMode(ms);			// update display for appropriate menu item
   if (mode != MENU_TIME) timeLeaveMenu = ms + 15000;  // switch back to TIME mode in 15s
@@ -1655,12 +1678,21 @@ void loop()
   if (esp8266.sntpValid) {
     esp8266.sntpValid = false;
     if (utcTt != esp8266.sntpTt) {
-      utcTt = esp8266.sntpTt;
-      breakTime(utcTt, &utcTm);
-      setTime(&utcTm);
-      setDate(&utcTm);
-      locTt = toLocal(utcTt);
-      breakTime(locTt, &locTm);
+      tmElements_t sntpTm;
+      boolean ok;
+
+      breakTime(esp8266.sntpTt, &sntpTm);
+      ok = setTime(&sntpTm);
+      ok = setDate(&sntpTm) && ok;
+      if (ok) {
+        utcTt = esp8266.sntpTt;
+        utcTm = sntpTm;
+        locTt = toLocal(utcTt);
+        breakTime(locTt, &locTm);
+      } else {
+        // the RTC did not take it, try again on the next loop
+        esp8266.sntpValid = true;
+      }
     }
   }
 #endif
@@ -1676,11 +1708,15 @@ void loop()
     ||  (gps.tme.Year != utcTm.Year)
     ) {
       gps.tme.Wday = zellersDow(&gps.tme);
-      utcTm = gps.tme;
-      setTime(&utcTm);
-      utcTt = makeTime(&utcTm);
-      locTt = toLocal(utcTt);
-      breakTime(locTt, &locTm);
+      if (setTime(&gps.tme)) {
+        utcTm = gps.tme;
+        utcTt = makeTime(&utcTm);
+        locTt = toLocal(utcTt);
+        breakTime(locTt, &locTm);
+      } else {
+        // the RTC did not take it, try again on the next loop
+        gps.doSync = true;
+      }
     }
   }
 #endif